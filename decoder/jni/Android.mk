@@ -11,6 +11,19 @@ OPENCORE_MP3 	:=	$(opencore-top.dir)/codecs_v2/audio/mp3/dec
 OSCL_DIR	 	:=	$(opencore-top.dir)/oscl/oscl
 LOGLEVEL 		:=	$(jni.loglevel)
 
+# The tuning of the 64-bit ABIs - used by all the modules (the Android.mk is evaluated for each ABI).
+# Only the features guaranteed by the ABI are used - no runtime detection is needed:
+#   arm64-v8a - the OpenCORE fixed-point 32x32->64 multiplies are the generic C versions,
+#               compiled to single smull / smulh instructions
+#   x86_64    - SSE4.2 and POPCNT are the baseline of the Android x86_64 ABI
+ABI_CFLAGS		:=
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+	ABI_CFLAGS	:=	-O3
+endif
+ifeq ($(TARGET_ARCH_ABI),x86_64)
+	ABI_CFLAGS	:=	-O3 -msse4.2 -mpopcnt
+endif
+
 
 include $(mydir)/aac-decoder/Android.mk
 include $(mydir)/opencore-aacdec/Android.mk
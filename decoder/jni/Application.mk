@@ -1 +1,4 @@
-APP_ABI := all
+# All the ABIs are built natively - the JNI handles are 64-bit (Java long),
+# so the 64-bit devices do not need to run the 32-bit library.
+# The per-ABI tuning is in Android.mk (ABI_CFLAGS):
+APP_ABI := armeabi armeabi-v7a arm64-v8a x86 x86_64
@@ -24,11 +24,18 @@ endif
 cflags_loglevels	:= $(foreach ll,$(LOGLEVELS),-DAACD_LOGLEVEL_$(ll))
 
 
+# The OpenSL ES headers come from the android-9 platform (64-bit ABIs start at android-21),
+# but libOpenSLES.so is loaded at runtime - so the library still runs on older devices:
+opensles_platform	:= $(if $(filter %64,$(TARGET_ARCH)),21,9)
+opensles_includes	:= $(NDK_ROOT)/platforms/android-$(opensles_platform)/arch-$(TARGET_ARCH)/usr/include
+
+
 # Final library:
 LOCAL_MODULE 			:= aacdecoder
-LOCAL_SRC_FILES 		:= aac-decoder.c
-LOCAL_CFLAGS 			:= $(cflags_loglevels)
-LOCAL_LDLIBS 			:= -llog
+LOCAL_SRC_FILES 		:= aac-decoder.c aac-common.c aac-sync.c aac-index.c aac-pool.c aac-reader-mmap.c aac-reader-http.c aac-output.c aac-sink.c aac-sink-opensl.c aac-engine.c aac-parallel.c aac-pcm.c aac-post.c aac-mp4.c aac-metrics.c
+LOCAL_C_INCLUDES 		:= $(opensles_includes)
+LOCAL_CFLAGS 			:= $(cflags_loglevels) $(ABI_CFLAGS)
+LOCAL_LDLIBS 			:= -llog -ldl
 LOCAL_STATIC_LIBRARIES 	:= decoder-opencore-aacdec decoder-opencore-mp3dec libpv_aac_dec libpv_mp3_dec
 include $(BUILD_SHARED_LIBRARY)
 
@@ -0,0 +1,942 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2011 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define AACD_MODULE "Decoder"
+
+#include "aac-common.h"
+#include "aac-metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef __ANDROID__
+#include <stdarg.h>
+#include <stdio.h>
+#endif
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+extern AACDDecoder aacd_opencore_decoder;
+extern AACDDecoder aacd_opencoremp3_decoder;
+extern AACDDecoder aacd_opencore_flv_decoder;
+extern AACDDecoder aacd_opencore_mp4_decoder;
+
+#define AACD_DECODERS_COUNT 4
+static struct AACDDecoder* aacd_decoders[AACD_DECODERS_COUNT] = { &aacd_opencore_decoder, &aacd_opencoremp3_decoder, &aacd_opencore_flv_decoder, &aacd_opencore_mp4_decoder };
+
+/**
+ * The size of the stitch area - must hold at least one whole frame
+ * (the ADTS frame length is 13 bits).
+ */
+#define AACD_STITCH_SIZE 8192
+
+/**
+ * The input read before the stream is probed - the sync needs a whole frame and the header
+ * of the next one, but a network reader can return just a few bytes at first.
+ */
+#define AACD_START_BYTES 2048
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+#ifndef __ANDROID__
+/**
+ * Prints a log message to stderr.
+ */
+void aacd_log_print( const char *prio, const char *tag, const char *fmt, ... )
+{
+    va_list args;
+
+    fprintf( stderr, "%s/%s: ", prio, tag );
+
+    va_start( args, fmt );
+    vfprintf( stderr, fmt, args );
+    va_end( args );
+
+    fputc( '\n', stderr );
+}
+#endif
+
+
+/**
+ * Returns the decoder by its name or NULL.
+ */
+AACDDecoder* aacd_decoder_get_by_name( const char *name )
+{
+    int i;
+
+    for (i=0; i < AACD_DECODERS_COUNT; i++)
+    {
+        AACDDecoder *dec = aacd_decoders[i];
+
+        if (!strcmp( name, dec->name())) return dec;
+    }
+
+    return NULL;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Buffers
+ ****************************************************************************************************/
+
+/**
+ * Prepares input buffer by joining the rest of the old one and the new one.
+ * The caller must store exactly len bytes at the returned address.
+ */
+unsigned char* aacd_prepare_buffer( AACDInfo *info, unsigned long len )
+{
+    unsigned long newlen = info->bytesleft + len;
+
+    if (info->bbsize2 < newlen)
+    {
+        if (info->buffer_block2 != NULL) free( info->buffer_block2 );
+
+        unsigned long realsize = newlen + (newlen >> 1); // avoid realocating by a few bytes only
+
+        info->buffer_block2 = (unsigned char*) malloc( realsize );
+        info->bbsize2 = realsize;
+    }
+
+    if (info->bytesleft != 0) memcpy( info->buffer_block2, info->buffer, info->bytesleft );
+
+    unsigned char *dest = info->buffer_block2 + info->bytesleft;
+
+    info->buffer = info->buffer_block;
+    info->buffer_block = info->buffer_block2;
+    info->buffer_block2 = info->buffer;
+    info->buffer = info->buffer_block;
+
+    unsigned long tmp;
+    tmp = info->bbsize;
+    info->bbsize = info->bbsize2;
+    info->bbsize2 = tmp;
+
+    info->bytesleft += len;
+
+    return dest;
+}
+
+
+/**
+ * Moves back from the stitch area to the direct buffer
+ * as soon as the stitched frame was consumed.
+ */
+static void aacd_direct_unstitch( AACDInfo *info )
+{
+    if (!info->direct) return;
+
+    unsigned long pos = info->buffer - info->buffer_block;
+
+    if (pos < info->stitchlen) return;
+
+    pos = pos - info->stitchlen;
+
+    AACD_TRACE( "direct_unstitch() continuing in direct buffer at offset %lu", pos );
+
+    info->buffer = info->direct + pos;
+    info->bytesleft = info->directlen - pos;
+    info->direct = NULL;
+}
+
+
+/**
+ * Saves the unconsumed input bytes of the direct buffer into the stitch area.
+ * Must be called before the current direct buffer is released by the reader.
+ */
+void aacd_direct_save( AACDInfo *info )
+{
+    aacd_direct_unstitch( info );
+
+    unsigned char *tail = NULL;
+    unsigned long taillen = 0;
+
+    // still in the stitch area - the rest of the direct buffer must be saved too:
+    if (info->direct)
+    {
+        tail = info->direct + info->directoff;
+        taillen = info->directlen - info->directoff;
+        info->direct = NULL;
+    }
+
+    unsigned long len = info->bytesleft + taillen;
+    unsigned long size = len + AACD_STITCH_SIZE;
+
+    if (info->bbsize < size)
+    {
+        unsigned char *block = (unsigned char*) malloc( size );
+
+        if (info->bytesleft) memcpy( block, info->buffer, info->bytesleft );
+        if (info->buffer_block) free( info->buffer_block );
+
+        info->buffer_block = block;
+        info->bbsize = size;
+    }
+    else if (info->bytesleft) memmove( info->buffer_block, info->buffer, info->bytesleft );
+
+    if (taillen) memcpy( info->buffer_block + info->bytesleft, tail, taillen );
+
+    info->buffer = info->buffer_block;
+    info->bytesleft = len;
+}
+
+
+/**
+ * Sets a new direct buffer - the data are not copied, but they must stay valid
+ * until the next call of aacd_direct_save().
+ */
+void aacd_direct_buffer( AACDInfo *info, unsigned char *data, unsigned long len )
+{
+    if (!info->bytesleft)
+    {
+        info->buffer = data;
+        info->bytesleft = len;
+        info->direct = NULL;
+
+        return;
+    }
+
+    if (info->buffer != info->buffer_block || info->bbsize < info->bytesleft + AACD_STITCH_SIZE) aacd_direct_save( info );
+
+    // copy just the beginning of the new data after the leftover - enough for one frame:
+    unsigned long n = len < AACD_STITCH_SIZE ? len : AACD_STITCH_SIZE;
+
+    memcpy( info->buffer_block + info->bytesleft, data, n );
+
+    AACD_TRACE( "direct_buffer() stitched %lu + %lu bytes", info->bytesleft, n );
+
+    info->direct = data;
+    info->directlen = len;
+    info->directoff = n;
+    info->stitchlen = info->bytesleft;
+    info->bytesleft += n;
+}
+
+
+/**
+ * Reads next buffer.
+ */
+static unsigned char* aacd_read_buffer( AACDInfo *info )
+{
+    if (aacd_read( info ) <= 0) return NULL;
+
+    return info->buffer;
+}
+
+
+/**
+ * Reads until the input holds the longest frame seen - a reader can return
+ * just a few bytes (e.g. a short network segment), which is not the end of the stream.
+ * @return 0 if the stream ended before
+ */
+static int aacd_read_frame( AACDInfo *info )
+{
+    while (info->bytesleft <= info->frame_max_bytesconsumed)
+    {
+        if (!aacd_read_buffer( info )) return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+ * Reads next input buffer by calling the reader.
+ */
+long aacd_read( AACDInfo *info )
+{
+    unsigned long t0 = aacd_metrics_now();
+
+    long ret = info->reader->read( info );
+
+    unsigned long t1 = aacd_metrics_since( AACD_HIST_READ, t0 );
+
+    aacd_metrics_count( AACD_METRIC_READS, 1 );
+    if (t1 && t1 - t0 >= AACD_METRICS_STARVED_US) aacd_metrics_count( AACD_METRIC_STARVED, 1 );
+
+    return ret;
+}
+
+
+/**
+ * Consumes the next bytes of the input - reads as much as needed.
+ */
+int aacd_read_bytes( AACDInfo *info, unsigned char *dest, unsigned long len )
+{
+    while (len)
+    {
+        aacd_direct_unstitch( info );
+
+        if (!info->bytesleft && aacd_read( info ) <= 0) return -1;
+
+        unsigned long n = len < info->bytesleft ? len : info->bytesleft;
+
+        if (dest)
+        {
+            memcpy( dest, info->buffer, n );
+            dest += n;
+        }
+
+        info->buffer += n;
+        info->bytesleft -= n;
+        info->stream_pos += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Prepares output buffer.
+ */
+short* aacd_prepare_samples( AACDInfo *info, int outLen )
+{
+    if (info->samplesLen < outLen)
+    {
+        // keep the content - the pending first samples may be stored there:
+        info->samples = realloc( info->samples, sizeof( short ) * outLen );
+        info->samplesLen = outLen;
+    }
+
+    return info->samples;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Lifecycle
+ ****************************************************************************************************/
+
+static unsigned long aacd_now_us()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (unsigned long) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+
+/**
+ * Starts the service - initializes resources, syncs the stream and
+ * calls the decoder's start() function.
+ * On failure the reader is destroyed as well.
+ * @return the new info struct or NULL on failure
+ */
+AACDInfo* aacd_start( AACDDecoder *decoder, AACDReader *reader, void *reader_ext )
+{
+    AACD_INFO( "start() starting native decoder - %s, reader - %s", decoder->name(), reader->name());
+
+    AACDInfo *info = (AACDInfo*) calloc( 1, sizeof( struct AACDInfo ));
+
+    info->decoder = decoder;
+    info->reader = reader;
+    info->reader_ext = reader_ext;
+
+    AACDStartTimes *times = &info->start_times;
+    unsigned long t0 = aacd_now_us();
+
+    info->ext = aacd_pool_get( decoder );
+
+    unsigned long t1 = aacd_now_us();
+    times->init = t1 - t0;
+
+    while (info->bytesleft < AACD_START_BYTES && aacd_read_buffer( info ));
+
+    // the container is parsed first - the input is positioned at the first frame then:
+    if (decoder->open)
+    {
+        if (decoder->open( info ))
+        {
+            AACD_ERROR( "start() failed - cannot open the container" );
+            aacd_stop( info );
+
+            return NULL;
+        }
+
+        aacd_direct_unstitch( info );
+
+        if (!info->bytesleft) aacd_read_buffer( info );
+    }
+
+    t0 = aacd_now_us();
+    times->read = t0 - t1;
+
+    unsigned char* buffer = info->buffer;
+    unsigned long buffer_size = info->bytesleft;
+
+    int pos = info->decoder->sync( info, buffer, buffer_size );
+
+    if (pos < 0)
+    {
+        AACD_ERROR( "start() failed - SYNC word not found" );
+        aacd_stop( info );
+
+        return NULL;
+    }
+
+    AACD_DEBUG( "start() SYNC word found at offset=%d", pos );
+
+    aacd_metrics_count( AACD_METRIC_SKIPPED, pos );
+
+    buffer += pos;
+    buffer_size -= pos;
+
+    t1 = aacd_now_us();
+    times->sync = t1 - t0;
+
+    long err = info->decoder->start( info, buffer, buffer_size );
+
+    times->decode = aacd_now_us() - t1;
+
+    if (err < 0)
+    {
+        AACD_ERROR( "start() failed err=%ld", err );
+        aacd_stop( info );
+
+        return NULL;
+    }
+
+    // the MP3 Xing / VBRI tag is stored in the first frame:
+    unsigned long first = err - info->frame_bytesconsumed;
+    aacd_toc_parse( info, buffer + first, buffer_size - first, pos + first );
+
+    // remember pointers for first decode round:
+    info->buffer = buffer + err;
+    info->bytesleft = buffer_size - err;
+    info->stream_pos += pos + err;
+    info->full_samplerate = info->samplerate;
+
+    // the first frame predicts the next ones - the next round reads in advance
+    // (e.g. when the container skips a unit without audio before the next frame):
+    info->frame_max_bytesconsumed_exact = info->frame_bytesconsumed;
+    info->frame_max_bytesconsumed = info->frame_bytesconsumed * 3 / 2;
+
+    info->sample_pos = info->channels ? info->frame_samples / info->channels : 0;
+    info->first_pending = info->samples && info->frame_samples;
+
+    AACD_DEBUG( "start() bytesleft=%lu", info->bytesleft );
+
+    return info;
+}
+
+
+/**
+ * Stops the service and frees resources.
+ */
+void aacd_stop( AACDInfo *info )
+{
+    AACD_INFO( "stop() stopping native decoder" );
+
+    if (info == NULL) return;
+
+    // the decoder's context is reused by the next stream if possible:
+    if (info->decoder && !aacd_pool_put( info->decoder, info->ext )) info->decoder->destroy( info );
+
+    info->ext = NULL;
+    if (info->reader && info->reader->destroy) info->reader->destroy( info );
+
+    aacd_index_destroy( info );
+
+    if (info->buffer_block != NULL)
+    {
+        free( info->buffer_block );
+        info->buffer_block = NULL;
+        info->bbsize = 0;
+    }
+
+    if (info->buffer_block2 != NULL)
+    {
+        free( info->buffer_block2 );
+        info->buffer_block2 = NULL;
+        info->bbsize2 = 0;
+    }
+
+    if (info->samples != NULL)
+    {
+        free( info->samples );
+        info->samplesLen = 0;
+    }
+
+    free( info );
+}
+
+
+/**
+ * Returns the duration of the last frame in samples per channel of the full quality sampling rate.
+ */
+static unsigned long aacd_frame_length( AACDInfo *info )
+{
+    unsigned long len = info->frame_samples / info->channels;
+
+    // a lower quality level can decode the stream at the half sampling rate:
+    if (info->samplerate && info->samplerate < info->full_samplerate) len *= info->full_samplerate / info->samplerate;
+
+    return len;
+}
+
+
+/**
+ * Stores the statistics of the frame just decoded.
+ */
+static void aacd_frame_stats( AACDInfo *info, unsigned long offset, int flags )
+{
+    if (!info->frame_stats || info->round_frames >= info->frame_stats_len) return;
+
+    AACDFrameStats *fs = info->frame_stats + info->round_frames;
+
+    fs->offset = (int) offset;
+    fs->bytes = (int) info->frame_bytesconsumed;
+    fs->samples = (int) info->frame_samples;
+    fs->flags = flags;
+}
+
+
+/**
+ * Starts a new decoding round - resets the round statistics
+ * and returns the pending first samples if any.
+ */
+static void aacd_round_start( AACDInfo *info, short *samples, int outLen )
+{
+    info->round_frames = 0;
+    info->round_bytesconsumed = 0;
+    info->round_samples = 0;
+
+    if (!info->first_pending || outLen < (int) info->frame_samples) return;
+
+    AACD_DEBUG( "decode() returning first samples - %lu", info->frame_samples );
+
+    if (samples != info->samples) memcpy( samples, info->samples, sizeof( short ) * info->frame_samples );
+
+    aacd_frame_stats( info, info->stream_pos - info->frame_bytesconsumed, AACD_FRAME_FIRST );
+
+    info->round_frames = 1;
+    info->round_bytesconsumed = info->frame_bytesconsumed;
+    info->round_samples = info->frame_samples;
+    info->first_pending = 0;
+}
+
+
+/**
+ * The decoding loop shared by aacd_decode() and aacd_decode_noread().
+ * It does not reset the round statistics.
+ * @param canRead if 0, then the reader is not called - the loop returns instead
+ * @return 1 if more input is needed (only if canRead is 0), 0 if the round is finished
+ */
+static int aacd_decode_loop( AACDInfo *info, short *samples, int outLen, int canRead )
+{
+    while (outLen >= (int) info->frame_samples
+            && (!info->frame_stats || info->round_frames < info->frame_stats_len))
+    {
+        aacd_direct_unstitch( info );
+
+        // check if input buffer is filled:
+        if (info->bytesleft <= info->frame_max_bytesconsumed)
+        {
+            if (!canRead) return 1;
+
+            AACD_TRACE( "decode() reading input buffer" );
+
+            if (!aacd_read_frame( info ))
+            {
+                AACD_INFO( "decode() detected end-of-file" );
+                break;
+            }
+        }
+
+        AACD_TRACE( "decode() frame - frames=%lu, consumed=%lu, samples=%lu, bytesleft=%lu, frame_maxconsumed=%lu, frame_samples=%lu, outLen=%d", info->round_frames, info->round_bytesconsumed, info->round_samples, info->bytesleft, info->frame_max_bytesconsumed, info->frame_samples, outLen);
+
+        int attempts = 10;
+        int flags = 0;
+        unsigned long t0;
+
+        info->frame_skipped = 0;
+
+        do
+        {
+            t0 = aacd_metrics_now();
+
+            if (!info->decoder->decode( info, info->buffer, info->bytesleft, samples, outLen )) break;
+
+            flags |= AACD_FRAME_RESYNC;
+            aacd_metrics_count( AACD_METRIC_RESYNCS, 1 );
+
+            AACD_WARN( "decode() failed to decode a frame" );
+            AACD_DEBUG( "decode() failed to decode a frame - frames=%lu, consumed=%lu, samples=%lu, bytesleft=%lu, frame_maxconsumed=%lu, frame_samples=%lu, outLen=%d", info->round_frames, info->round_bytesconsumed, info->round_samples, info->bytesleft, info->frame_max_bytesconsumed, info->frame_samples, outLen);
+
+            if (info->bytesleft <= info->frame_max_bytesconsumed)
+            {
+                if (!canRead) return 1;
+
+                if (!aacd_read_frame( info ))
+                {
+                    AACD_INFO( "decode() detected end-of-file after partial frame error" );
+                    attempts = 0;
+                    break;
+                }
+            }
+
+            int pos = info->decoder->sync( info, info->buffer+1, info->bytesleft-1 );
+
+            if (pos >= 0) {
+                info->buffer += pos+1;
+                info->bytesleft -= pos+1;
+                info->stream_pos += pos+1;
+                aacd_metrics_count( AACD_METRIC_SKIPPED, pos+1 );
+            }
+            else {
+                int move = info->bytesleft < 2048 ? (info->bytesleft >> 1) : 1024;
+                info->buffer += move;
+                info->bytesleft -= move;
+                info->stream_pos += move;
+                aacd_metrics_count( AACD_METRIC_SKIPPED, move );
+            }
+        }
+        while (--attempts > 0);
+
+        if ( !attempts )
+        {
+            AACD_WARN( "decode() failed after several attempts");
+            break;
+        }
+
+        // no audio (e.g. a FLV video tag) - only the input is consumed;
+        // nothing consumed means that the next frame is not complete:
+        if (info->frame_skipped)
+        {
+            if (!info->frame_bytesconsumed)
+            {
+                if (!canRead) return 1;
+
+                if (!aacd_read_buffer( info ))
+                {
+                    AACD_INFO( "decode() detected end-of-file in the middle of a frame" );
+                    break;
+                }
+
+                continue;
+            }
+
+            info->bytesleft -= info->frame_bytesconsumed;
+            info->buffer += info->frame_bytesconsumed;
+            info->stream_pos += info->frame_bytesconsumed;
+
+            continue;
+        }
+
+        aacd_metrics_frame( info->decoder, t0 );
+        aacd_metrics_count( AACD_METRIC_FRAMES, 1 );
+        aacd_metrics_count( AACD_METRIC_BYTES, info->frame_bytesconsumed );
+
+        aacd_frame_stats( info, info->stream_pos, flags );
+        aacd_index_frame( info, info->stream_pos, info->frame_bytesconsumed, info->sample_pos );
+
+        info->sample_pos += aacd_frame_length( info );
+        info->round_frames++;
+        info->round_bytesconsumed += info->frame_bytesconsumed;
+        info->bytesleft -= info->frame_bytesconsumed;
+        info->buffer += info->frame_bytesconsumed;
+        info->stream_pos += info->frame_bytesconsumed;
+
+        if (info->frame_bytesconsumed > info->frame_max_bytesconsumed)
+        {
+            info->frame_max_bytesconsumed_exact = info->frame_bytesconsumed;
+            info->frame_max_bytesconsumed = info->frame_bytesconsumed * 3 / 2;
+        }
+
+        samples += info->frame_samples;
+        outLen -= info->frame_samples;
+        info->round_samples += info->frame_samples;
+    }
+
+    AACD_DEBUG( "decode() round - frames=%lu, consumed=%lu, samples=%lu, bytesleft=%lu, frame_maxconsumed=%lu, frame_samples=%lu, outLen=%d", info->round_frames, info->round_bytesconsumed, info->round_samples, info->bytesleft, info->frame_max_bytesconsumed, info->frame_samples, outLen);
+
+    return 0;
+}
+
+
+/**
+ * Decodes the stream - one round until the output buffer is (almost) filled.
+ */
+void aacd_decode( AACDInfo *info, short *samples, int outLen )
+{
+    AACD_DEBUG( "decode() start" );
+
+    unsigned long t0 = aacd_metrics_now();
+
+    aacd_round_start( info, samples, outLen );
+
+    aacd_decode_loop( info, samples + info->round_samples, outLen - info->round_samples, 1 );
+
+    aacd_metrics_since( AACD_HIST_ROUND, t0 );
+}
+
+
+/**
+ * Decodes the stream like aacd_decode(), but never calls the reader.
+ * When the input is exhausted, it returns and the caller should call aacd_read()
+ * and then continue the same round by calling this function again with cont=1.
+ */
+int aacd_decode_noread( AACDInfo *info, short *samples, int outLen, int cont )
+{
+    if (!cont)
+    {
+        AACD_DEBUG( "decode_noread() start" );
+
+        aacd_round_start( info, samples, outLen );
+    }
+
+    return aacd_decode_loop( info, samples + info->round_samples, outLen - info->round_samples, 0 );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Seeking
+ ****************************************************************************************************/
+
+/**
+ * The max distance (in seconds) beyond the indexed area walked by the frame headers -
+ * further the TOC is used if available.
+ */
+#define AACD_SEEK_WALK_MAX_SECS 30
+
+
+/**
+ * Repositions the reader and drops the buffered input.
+ */
+int aacd_seek_input( AACDInfo *info, unsigned long offset )
+{
+    if (info->reader->seek( info, offset ))
+    {
+        AACD_ERROR( "seek() reader cannot seek to offset %lu", offset );
+        return -1;
+    }
+
+    info->buffer = info->buffer_block;
+    info->bytesleft = 0;
+    info->direct = NULL;
+    info->stitchlen = 0;
+    info->stream_pos = offset;
+
+    return 0;
+}
+
+
+static void aacd_seek_skip( AACDInfo *info, unsigned long len )
+{
+    info->buffer += len;
+    info->bytesleft -= len;
+    info->stream_pos += len;
+}
+
+
+/**
+ * Skips the frames by parsing their headers until the frame containing the sample is reached.
+ * The index is extended on the way.
+ * @return 0=OK, -1 if the end of stream was reached
+ */
+static int aacd_seek_walk( AACDInfo *info, unsigned long sample )
+{
+    unsigned long fs = aacd_frame_length( info );
+
+    while (info->sample_pos + fs <= sample)
+    {
+        aacd_direct_unstitch( info );
+
+        // the longest header (ADTS) is 7 bytes:
+        int len = info->bytesleft >= 8 ? info->decoder->header( info->buffer, info->bytesleft ) : 0;
+
+        if (!len || len > (long) info->bytesleft)
+        {
+            if (aacd_read( info ) <= 0) return -1;
+
+            continue;
+        }
+
+        if (len < 0)
+        {
+            int pos = info->decoder->sync( info, info->buffer + 1, info->bytesleft - 1 );
+
+            // keep the bytes which can be a part of the next header:
+            aacd_seek_skip( info, pos >= 0 ? pos + 1 : info->bytesleft - 7 );
+
+            continue;
+        }
+
+        aacd_index_frame( info, info->stream_pos, len, info->sample_pos );
+        aacd_seek_skip( info, len );
+
+        info->sample_pos += fs;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Jumps to the approximate position given by the TOC.
+ */
+static int aacd_seek_toc( AACDInfo *info, AACDSeekPoint *t, unsigned long sample )
+{
+    unsigned long offset = t->offset;
+
+    // interpolate between the TOC entries:
+    if (t + 1 < info->toc + info->toclen && t[1].sample > t->sample && t[1].offset > t->offset)
+    {
+        offset += (unsigned long) ((unsigned long long) (t[1].offset - t->offset)
+                    * (sample - t->sample) / (t[1].sample - t->sample));
+    }
+
+    if (aacd_seek_input( info, offset )) return -1;
+
+    for (;;)
+    {
+        aacd_direct_unstitch( info );
+
+        if (aacd_read( info ) <= 0) return -1;
+
+        int pos = info->decoder->sync( info, info->buffer, info->bytesleft );
+
+        if (pos >= 0)
+        {
+            aacd_seek_skip( info, pos );
+            break;
+        }
+
+        aacd_seek_skip( info, info->bytesleft > 7 ? info->bytesleft - 7 : 0 );
+    }
+
+    // the index cannot be extended from an approximate position:
+    info->index->sync = 0;
+    info->sample_pos = sample;
+
+    return 0;
+}
+
+
+/**
+ * Jumps to the frame found by the container's index - the position is exact.
+ */
+static int aacd_seek_locate( AACDInfo *info, unsigned long sample )
+{
+    AACDSeekPoint p;
+
+    if (info->decoder->locate( info, sample, &p ))
+    {
+        AACD_ERROR( "seek() sample %lu not found", sample );
+        return -1;
+    }
+
+    if (aacd_seek_input( info, p.offset )) return -1;
+
+    // the frame index must stay contiguous:
+    if (info->index) info->index->sync = 0;
+
+    info->sample_pos = p.sample;
+
+    AACD_DEBUG( "seek() located sample=%lu, offset=%lu", info->sample_pos, info->stream_pos );
+
+    if (info->decoder->reset) info->decoder->reset( info );
+
+    info->first_pending = 0;
+
+    return 0;
+}
+
+
+/**
+ * Seeks to the frame containing the sample position (samples per channel).
+ */
+int aacd_seek( AACDInfo *info, unsigned long sample )
+{
+    AACDIndex *idx = info->index;
+
+    // the container has its own index:
+    if (info->decoder->locate && info->reader->seek) return aacd_seek_locate( info, sample );
+
+    if (!idx || !info->reader->seek || !info->decoder->header || !info->frame_samples)
+    {
+        AACD_ERROR( "seek() not supported" );
+        return -1;
+    }
+
+    AACDSeekPoint *p = aacd_index_find( idx->points, idx->len, sample );
+    AACDSeekPoint *t = aacd_index_find( info->toc, info->toclen, sample );
+
+    AACD_DEBUG( "seek() sample=%lu, indexed=%lu", sample, idx->next_sample );
+
+    // far beyond the indexed area:
+    if (t && t->sample > p->sample && sample > idx->next_sample
+            && sample - idx->next_sample > AACD_SEEK_WALK_MAX_SECS * info->full_samplerate)
+    {
+        if (aacd_seek_toc( info, t, sample )) return -1;
+    }
+    else
+    {
+        if (aacd_seek_input( info, p->offset )) return -1;
+
+        info->sample_pos = p->sample;
+        idx->sync = 1;
+
+        if (aacd_seek_walk( info, sample )) AACD_INFO( "seek() reached end of stream" );
+    }
+
+    AACD_DEBUG( "seek() positioned at sample=%lu, offset=%lu", info->sample_pos, info->stream_pos );
+
+    if (info->decoder->reset) info->decoder->reset( info );
+
+    info->first_pending = 0;
+
+    return 0;
+}
+
+
+/**
+ * Switches the quality level.
+ */
+int aacd_set_quality( AACDInfo *info, int level )
+{
+    if (level < AACD_QUALITY_FULL || level > AACD_QUALITY_MONO)
+    {
+        AACD_WARN( "set_quality() unknown level %d", level );
+        return info->quality;
+    }
+
+    if (level == info->quality) return level;
+
+    if (!info->decoder->quality) return AACD_QUALITY_FULL;
+
+    // the pending first samples were decoded at the previous level - the next round must not mix them:
+    if (info->first_pending)
+    {
+        AACD_DEBUG( "set_quality() dropping the first samples" );
+        info->first_pending = 0;
+    }
+
+    info->quality = info->decoder->quality( info, level );
+
+    AACD_INFO( "set_quality() level=%d -> %d, samplerate=%lu, channels=%d", level, info->quality, info->samplerate, info->channels );
+
+    return info->quality;
+}
@@ -21,45 +21,56 @@
 #ifndef AAC_COMMON_H
 #define AAC_COMMON_H
 
-#include <jni.h>
-#include <android/log.h>
-
 #ifndef AACD_MODULE
 #error "Please specify AACD_MODULE at the top of your file."
 #endif
 
 
+/*
+ * The core does not depend on JNI - it can be built for the host as well.
+ * On Android the messages go to logcat, otherwise to stderr.
+ */
+#ifdef __ANDROID__
+#include <android/log.h>
+#define AACD_LOG_PRINT(prio, tag, ...) \
+    __android_log_print(ANDROID_LOG_##prio, tag, __VA_ARGS__)
+#else
+#define AACD_LOG_PRINT(prio, tag, ...) \
+    aacd_log_print(#prio, tag, __VA_ARGS__)
+#endif
+
+
 #ifdef AACD_LOGLEVEL_TRACE
 #define AACD_TRACE(...) \
-    __android_log_print(ANDROID_LOG_VERBOSE, AACD_MODULE, __VA_ARGS__)
+    AACD_LOG_PRINT(VERBOSE, AACD_MODULE, __VA_ARGS__)
 #else
 #define AACD_TRACE(...) //
 #endif
 
 #ifdef AACD_LOGLEVEL_DEBUG
 #define AACD_DEBUG(...) \
-    __android_log_print(ANDROID_LOG_DEBUG, AACD_MODULE, __VA_ARGS__)
+    AACD_LOG_PRINT(DEBUG, AACD_MODULE, __VA_ARGS__)
 #else
 #define AACD_DEBUG(...) //
 #endif
 
 #ifdef AACD_LOGLEVEL_INFO
 #define AACD_INFO(...) \
-    __android_log_print(ANDROID_LOG_INFO, AACD_MODULE, __VA_ARGS__)
+    AACD_LOG_PRINT(INFO, AACD_MODULE, __VA_ARGS__)
 #else
 #define AACD_INFO(...) //
 #endif
 
 #ifdef AACD_LOGLEVEL_WARN
 #define AACD_WARN(...) \
-    __android_log_print(ANDROID_LOG_WARN, AACD_MODULE, __VA_ARGS__)
+    AACD_LOG_PRINT(WARN, AACD_MODULE, __VA_ARGS__)
 #else
 #define AACD_WARN(...) //
 #endif
 
 #ifdef AACD_LOGLEVEL_ERROR
 #define AACD_ERROR(...) \
-    __android_log_print(ANDROID_LOG_ERROR, AACD_MODULE, __VA_ARGS__)
+    AACD_LOG_PRINT(ERROR, AACD_MODULE, __VA_ARGS__)
 #else
 #error "Ha AACD_LOGLEVEL_ERROR is not defined"
 #define AACD_ERROR(...) //
@@ -71,6 +82,102 @@ extern "C" {
 #endif
 
 
+/**
+ * The frame was preceded by a decoding error - some input bytes were skipped.
+ */
+#define AACD_FRAME_RESYNC   0x01
+
+/**
+ * The frame was decoded already by the decoder's start() function.
+ */
+#define AACD_FRAME_FIRST    0x02
+
+
+/**
+ * The FLV tag types - see aacd_flv_header().
+ */
+#define AACD_FLV_AUDIO      8
+#define AACD_FLV_VIDEO      9
+#define AACD_FLV_SCRIPT     18
+
+/**
+ * The size of the FLV tag header - the payload follows it.
+ */
+#define AACD_FLV_TAG_HEADER 11
+
+
+/**
+ * The PCM output formats - see aacd_pcm_convert().
+ * The decoders produce 16-bit samples - the other formats are their exact conversions.
+ */
+#define AACD_PCM_16         0   // 16-bit signed integers
+#define AACD_PCM_32         1   // 32-bit signed integers - full scale (the 16-bit sample * 65536)
+#define AACD_PCM_FLOAT      2   // 32-bit floats in [-1.0, 1.0)
+
+
+/**
+ * The quality levels - see aacd_set_quality().
+ * Each level saves more decoding work (power) than the previous one and includes its savings.
+ */
+#define AACD_QUALITY_FULL   0   // all the tools of the stream (HE-AACv2)
+#define AACD_QUALITY_SBR    1   // no parametric stereo
+#define AACD_QUALITY_CORE   2   // no SBR - the core AAC at the half sampling rate
+#define AACD_QUALITY_MONO   3   // no SBR, mono
+
+
+/**
+ * Per-frame statistics - filled by the decoding loop when requested.
+ * The layout is shared with Java (FrameStats) - 4 ints per frame.
+ */
+typedef struct AACDFrameStats {
+    int offset;     // the stream offset of the frame (lower 32 bits)
+    int bytes;      // bytes consumed
+    int samples;    // samples produced (all channels)
+    int flags;      // AACD_FRAME_* flags
+} AACDFrameStats;
+
+
+/**
+ * The time-to-first-samples breakdown of aacd_start() - all in microseconds.
+ */
+typedef struct AACDStartTimes {
+    unsigned long init;     // the decoder's context (pooled or created)
+    unsigned long read;     // the first input buffer
+    unsigned long sync;     // searching for the first frame
+    unsigned long decode;   // the decoder's start() - the configuration and the first frame
+} AACDStartTimes;
+
+
+/**
+ * Seek point - the stream offset of a frame and its position in samples per channel.
+ */
+typedef struct AACDSeekPoint {
+    unsigned long offset;
+    unsigned long sample;
+} AACDSeekPoint;
+
+
+/**
+ * Frame index - a sparse list of seek points covering a contiguous area from the first frame.
+ * See aacd_index_enable().
+ */
+typedef struct AACDIndex {
+    AACDSeekPoint *points;
+    unsigned long len;
+    unsigned long cap;
+
+    // the number of frames in the indexed area:
+    unsigned long frames;
+
+    // the end of the indexed area = the next frame to be recorded:
+    unsigned long next_offset;
+    unsigned long next_sample;
+
+    // the decoded frames follow the indexed area (cleared by approximate seeking):
+    int sync;
+} AACDIndex;
+
+
 /**
  * Common info struct used for storing info between calls.
  */
@@ -82,19 +189,14 @@ typedef struct AACDInfo {
     struct AACDDecoder *decoder;
 
     /**
-     * The input buffer reader object.
+     * The input reader.
      */
-    jobject *reader;
+    struct AACDReader *reader;
 
     /**
-     * The last known JNIEnv.
+     * Reader's own data - e.g. the Java objects or the memory block.
      */
-    JNIEnv *env;
-
-    /**
-     * The callback variable - Decoder.Info.
-     */
-    jobject *aacInfo;
+    void *reader_ext;
 
     /**
      * Extended info - each decoder can use it for its own purposes:
@@ -111,18 +213,36 @@ typedef struct AACDInfo {
     unsigned char *buffer;
     unsigned long bytesleft;
 
+    // direct (zero-copy) input - the data are decoded in place;
+    // only the frame straddling two chunks is stitched in buffer_block:
+    unsigned char *direct;
+    unsigned long directlen;
+    unsigned long directoff;
+    unsigned long stitchlen;
+
     // internal output buffer
-    jshort *samples;
+    short *samples;
     unsigned long samplesLen;
 
-    // start() function will fill these:
+    // start() function will fill these (the decoder updates them if the quality level changes them):
     unsigned long samplerate;
     unsigned char channels;
 
+    // the sampling rate of the full quality - the positions (sample_pos, seeking) are kept in it:
+    unsigned long full_samplerate;
+
+    // the current quality level - see AACD_QUALITY_*:
+    int quality;
+
     // decode() function will fill these:
     unsigned long frame_bytesconsumed;
     unsigned long frame_samples;
 
+    // set by decode() if the bytes consumed contained no audio (e.g. a FLV video tag) -
+    // then frame_samples is only the max of the next frame;
+    // no bytes consumed means that more input is needed to complete the next frame:
+    int frame_skipped;
+
     // max statistics allowing to predict when to finish decoding:
     unsigned long frame_max_bytesconsumed;
     unsigned long frame_max_bytesconsumed_exact;
@@ -132,6 +252,34 @@ typedef struct AACDInfo {
     unsigned long round_bytesconsumed;
     unsigned long round_samples;
 
+    // the stream offset of the input buffer pointer:
+    unsigned long stream_pos;
+
+    // the samples decoded by start() were not passed to the caller yet -
+    // they will be returned by the first decoding round:
+    int first_pending;
+
+    // optional per-frame statistics - set by the caller before a decoding round;
+    // the round then also stops when frame_stats_len frames are decoded:
+    AACDFrameStats *frame_stats;
+    unsigned long frame_stats_len;
+
+    // the position of the next frame in samples per channel:
+    unsigned long sample_pos;
+
+    // optional frame index - see aacd_index_enable():
+    AACDIndex *index;
+
+    // the MP3 Xing / VBRI table of contents - approximate seek points:
+    AACDSeekPoint *toc;
+    unsigned long toclen;
+
+    // the duration in samples per channel or 0 if unknown:
+    unsigned long duration;
+
+    // filled by aacd_start():
+    AACDStartTimes start_times;
+
 } AACDInfo;
 
 
@@ -159,9 +307,10 @@ typedef struct AACDDecoder {
 
     /**
      * Decodes one frame.
+     * A container can consume a unit without audio instead - see frame_skipped.
      * @return 0=OK, otherwise error.
      */
-    int (*decode)( AACDInfo*, unsigned char *, unsigned long, jshort*, jint);
+    int (*decode)( AACDInfo*, unsigned char *, unsigned long, short*, int);
 
     /**
      * Destroys the decoder - the decoder should free all resources.
@@ -175,20 +324,434 @@ typedef struct AACDDecoder {
      */
     int (*sync)( AACDInfo*, unsigned char *, int );
 
+    /**
+     * Parses the frame header without decoding - used when seeking.
+     * @return the frame length or -1 if the header is not valid
+     */
+    int (*header)( const unsigned char*, int );
+
+    /**
+     * Resets the decoder state after the stream was repositioned. Can be null.
+     */
+    void (*reset)( AACDInfo* );
+
+    /**
+     * Prepares the internal structure returned by init() for a new stream -
+     * so it can be pooled and reused without being allocated again.
+     * Can be null - then the structure is not pooled.
+     * @return 0=OK, otherwise error (the structure is destroyed then).
+     */
+    int (*recycle)( void* );
+
+    /**
+     * Switches the quality level in the middle of the stream - applied from the next frame on.
+     * The decoder updates the samplerate and the channels of the info (possibly only
+     * after the next frame is decoded) and sets frame_samples to the max of the next frame.
+     * Can be null - then only the full quality is supported.
+     * @return the level actually used - the nearest supported one
+     */
+    int (*quality)( AACDInfo*, int );
+
+    /**
+     * Parses the container before the stream is synced - e.g. the MP4 sample index.
+     * It can read the input (aacd_read_bytes()) and reposition it (aacd_seek_input()) -
+     * the input must be positioned at the first frame when it returns.
+     * Can be null - the stream starts by the first frame found by sync().
+     * @return 0=OK, otherwise error.
+     */
+    int (*open)( AACDInfo* );
+
+    /**
+     * Finds the frame containing the sample position (samples per channel) by the container's index.
+     * Can be null - then the frames are found by the frame index and by walking the headers.
+     * @param point filled by the stream offset and the sample position of the frame
+     * @return 0=OK, otherwise error.
+     */
+    int (*locate)( AACDInfo*, unsigned long, AACDSeekPoint* );
+
 } AACDDecoder;
 
 
 /**
- * Searches for ADTS 0xfff header.
- * Returns the offset of ADTS frame.
+ * Input reader definition.
+ * The reader is called whenever the decoder needs more input data.
+ */
+typedef struct AACDReader {
+    /**
+     * Returns the name of the reader.
+     */
+    const char* (*name)();
+
+    /**
+     * Reads the next chunk of the stream and appends it
+     * to the input buffer - usually by calling aacd_prepare_buffer().
+     * @return the number of bytes appended; 0 means end-of-stream
+     */
+    long (*read)( AACDInfo* );
+
+    /**
+     * Destroys the reader - frees the reader_ext. Can be null.
+     */
+    void (*destroy)( AACDInfo* );
+
+    /**
+     * Repositions the stream - the next read() returns the data from the offset.
+     * Can be null if the stream is not seekable.
+     * @return 0=OK, otherwise error.
+     */
+    int (*seek)( AACDInfo*, unsigned long offset );
+
+} AACDReader;
+
+
+/**
+ * Memory mapped file - see aac-reader-mmap.c.
+ */
+typedef struct AACDMmap AACDMmap;
+
+
+/**
+ * The reader of a memory mapped file - the reader_ext is AACDMmap
+ * (it is closed by the reader's destroy()).
+ */
+extern AACDReader aacd_mmap_reader;
+
+
+/**
+ * HTTP / ICY stream - see aac-reader-http.c.
+ */
+typedef struct AACDHttp AACDHttp;
+
+
+/**
+ * The reader of a HTTP stream - the reader_ext is AACDHttp
+ * (it is closed by the reader's destroy()).
+ */
+extern AACDReader aacd_http_reader;
+
+
+/**
+ * Searches for a valid ADTS frame - the next frame header must follow
+ * (unless the buffer ends before it).
+ * Returns the offset of ADTS frame or -1 if not found.
+ */
+int aacd_adts_sync( unsigned char *buffer, int len );
+
+
+/**
+ * Searches for a valid MP3 frame - the next frame header must follow
+ * (unless the buffer ends before it).
+ * Returns the offset of the frame or -1 if not found.
+ */
+int aacd_mp3_sync( unsigned char *buffer, int len );
+
+
+/**
+ * Searches for a valid FLV tag - skips the FLV file header if present.
+ * Returns the offset of the tag or -1 if not found.
+ */
+int aacd_flv_sync( unsigned char *buffer, int len );
+
+
+/**
+ * Parses the ADTS header.
+ * @return the frame length or -1 if the header is not valid
+ */
+int aacd_adts_header( const unsigned char *buffer, int len );
+
+
+/**
+ * Parses the MP3 frame header.
+ * @return the frame length or -1 if the header is not valid
  */
-int aacd_adts_sync(unsigned char *buffer, int len);
+int aacd_mp3_header( const unsigned char *buffer, int len );
+
+
+/**
+ * Parses the FLV tag header.
+ * @return the length of the tag including the following PreviousTagSize field or -1 if the header is not valid
+ */
+int aacd_flv_header( const unsigned char *buffer, int len );
 
 
 /**
  * Prepares output buffer.
  */
-jshort* aacd_prepare_samples( AACDInfo *info, jint outLen );
+short* aacd_prepare_samples( AACDInfo *info, int outLen );
+
+
+/**
+ * Prepares input buffer by joining the rest of the old one and the new one.
+ * The caller must store exactly len bytes at the returned address.
+ */
+unsigned char* aacd_prepare_buffer( AACDInfo *info, unsigned long len );
+
+
+/**
+ * Saves the unconsumed input bytes of the direct buffer into the stitch area.
+ * Must be called before the current direct buffer is released by the reader.
+ */
+void aacd_direct_save( AACDInfo *info );
+
+
+/**
+ * Sets a new direct buffer - the data are not copied, but they must stay valid
+ * until the next call of aacd_direct_save().
+ */
+void aacd_direct_buffer( AACDInfo *info, unsigned char *data, unsigned long len );
+
+
+/**
+ * Returns the decoder by its name or NULL.
+ */
+AACDDecoder* aacd_decoder_get_by_name( const char *name );
+
+
+/**
+ * Starts the service - initializes resources, syncs the stream and
+ * calls the decoder's start() function.
+ * On failure the reader is destroyed as well.
+ * @return the new info struct or NULL on failure
+ */
+AACDInfo* aacd_start( AACDDecoder *decoder, AACDReader *reader, void *reader_ext );
+
+
+/**
+ * Decodes the stream - one round until the output buffer is (almost) filled.
+ * The pending first samples (decoded by start()) are returned first.
+ */
+void aacd_decode( AACDInfo *info, short *samples, int outLen );
+
+
+/**
+ * Decodes the stream like aacd_decode(), but never calls the reader.
+ * When the input is exhausted, it returns and the caller should call aacd_read()
+ * and then continue the same round by calling this function again with cont=1.
+ * This allows to decode into memory which cannot be held while the reader
+ * is called (e.g. a JNI critical array).
+ * @param samples the beginning of the output buffer - also when continuing
+ * @param outLen the length of the whole output buffer
+ * @param cont 0 = starts a new round, 1 = continues the interrupted round
+ * @return 1 if more input is needed, 0 if the round is finished
+ */
+int aacd_decode_noread( AACDInfo *info, short *samples, int outLen, int cont );
+
+
+/**
+ * Decodes the stream like aacd_decode(), but stores the samples in the output format.
+ * The samples are decoded into the internal buffer (see aacd_prepare_samples()) and converted.
+ * @param format see AACD_PCM_* constants
+ * @param out the output buffer - outLen samples of the format
+ */
+void aacd_decode_pcm( AACDInfo *info, int format, void *out, int outLen );
+
+
+/**
+ * Converts the 16-bit samples into the output format - see aac-pcm.c.
+ * @param format see AACD_PCM_* constants
+ */
+void aacd_pcm_convert( int format, const short *in, void *out, unsigned long len );
+
+
+/**
+ * Returns the size of one sample of the output format in bytes or 0 if the format is not known.
+ */
+int aacd_pcm_size( int format );
+
+
+/**
+ * Reads next input buffer by calling the reader.
+ * @return the number of bytes read or 0 (or negative value) if no more data are available
+ */
+long aacd_read( AACDInfo *info );
+
+
+/**
+ * Consumes the next bytes of the input - reads as much as needed, the bytes do not need
+ * to fit into the input buffer.
+ * @param dest the bytes are copied there if not NULL
+ * @return 0=OK, -1 if the end of stream was reached
+ */
+int aacd_read_bytes( AACDInfo *info, unsigned char *dest, unsigned long len );
+
+
+/**
+ * Repositions the reader and drops the buffered input - the next aacd_read() reads from the offset.
+ * @return 0=OK, otherwise error (the reader is not seekable)
+ */
+int aacd_seek_input( AACDInfo *info, unsigned long offset );
+
+
+/**
+ * Stops the service and frees resources.
+ */
+void aacd_stop( AACDInfo *info );
+
+
+/**
+ * Seeks to the frame containing the sample position (samples per channel).
+ * The container's index is used if the decoder has one (MP4) - see AACDDecoder.locate.
+ * Otherwise the indexed area is searched first, then the frame headers are walked
+ * (without decoding) - both are exact. Far beyond the indexed area
+ * the MP3 TOC is used if available - the position is then approximate.
+ * Requires a seekable reader and (without the container's index) the frame index.
+ * @return 0=OK (info->sample_pos is the new position), otherwise error
+ */
+int aacd_seek( AACDInfo *info, unsigned long sample );
+
+
+/**
+ * Switches the quality level - see AACD_QUALITY_* constants.
+ * Should be called between the decoding rounds - the next round then
+ * contains only the frames of the new level (its samplerate / channels).
+ * @return the level actually used
+ */
+int aacd_set_quality( AACDInfo *info, int level );
+
+
+/**
+ * Enables the frame index - must be called after aacd_start() and before the first decoding round.
+ */
+void aacd_index_enable( AACDInfo *info );
+
+
+/**
+ * Records the frame if it extends the indexed area.
+ */
+void aacd_index_frame( AACDInfo *info, unsigned long offset, unsigned long len, unsigned long sample );
+
+
+/**
+ * Returns the last seek point having the sample position lower or equal to the sample or NULL.
+ */
+AACDSeekPoint* aacd_index_find( AACDSeekPoint *points, unsigned long len, unsigned long sample );
+
+
+/**
+ * Frees the index and the TOC.
+ */
+void aacd_index_destroy( AACDInfo *info );
+
+
+/**
+ * Parses the Xing / VBRI tag of the first MP3 frame if present.
+ * Fills the TOC and the duration.
+ * @param offset the stream offset of the frame
+ */
+void aacd_toc_parse( AACDInfo *info, const unsigned char *frame, int len, unsigned long offset );
+
+
+/**
+ * Returns a pooled context of the decoder or a new one created by init().
+ */
+void* aacd_pool_get( AACDDecoder *decoder );
+
+
+/**
+ * Recycles the context and returns it to the pool.
+ * @return 1 if pooled, 0 if the caller must destroy the context
+ */
+int aacd_pool_put( AACDDecoder *decoder, void *ext );
+
+
+/**
+ * Creates a context in advance if there is none pooled - so the next
+ * aacd_start() of the decoder does not allocate and initialize the codec.
+ * @return 0=OK, otherwise error (the decoder does not support pooling)
+ */
+int aacd_pool_prewarm( AACDDecoder *decoder );
+
+
+/**
+ * Destroys all pooled contexts.
+ */
+void aacd_pool_clear();
+
+
+/**
+ * Maps the file.
+ * @return the mapping or NULL on error
+ */
+AACDMmap* aacd_mmap_open( const char *path );
+
+
+/**
+ * Hands over the next chunk of the mapping to the decoder - the data are decoded in place.
+ * @return the number of bytes appended; 0 means end-of-stream
+ */
+long aacd_mmap_read( AACDInfo *info, AACDMmap *m );
+
+
+/**
+ * Repositions the next chunk.
+ * @return 0=OK, otherwise error
+ */
+int aacd_mmap_seek( AACDMmap *m, unsigned long offset );
+
+
+/**
+ * Unmaps the file and frees the struct.
+ */
+void aacd_mmap_close( AACDMmap *m );
+
+
+/**
+ * Connects and receives the response headers (following the redirects).
+ * @param metadata if true, then the ICY metadata are requested (and stripped)
+ * @return the stream or NULL on error
+ */
+AACDHttp* aacd_http_open( const char *url, int metadata );
+
+
+/**
+ * Receives the next bytes directly into the decoder's buffer - the chunked transfer
+ * framing and the ICY metadata are stripped in place.
+ * @return the number of bytes appended; 0 means end-of-stream
+ */
+long aacd_http_read( AACDInfo *info, AACDHttp *h );
+
+
+/**
+ * Repositions the stream by a Range request - only if the server supports it.
+ * @return 0=OK, otherwise error
+ */
+int aacd_http_seek( AACDHttp *h, unsigned long offset );
+
+
+/**
+ * Returns true if the server accepts Range requests and the length is known.
+ */
+int aacd_http_seekable( AACDHttp *h );
+
+
+/**
+ * Returns the response headers - "name: value" lines separated by LF.
+ */
+const char* aacd_http_headers( AACDHttp *h );
+
+
+/**
+ * Copies the metadata string (e.g. "StreamTitle='...';") if it changed since the last call.
+ * Thread safe - it can be called while another thread reads the stream.
+ * @return the length of the string or -1 if not changed
+ */
+int aacd_http_metadata( AACDHttp *h, char *buf, int len );
+
+
+/**
+ * Closes the connection and frees the struct.
+ */
+void aacd_http_close( AACDHttp *h );
+
+
+#ifndef __ANDROID__
+/**
+ * Prints a log message to stderr.
+ * The format is checked by the compiler - the same messages are printed by 32 and 64-bit builds.
+ */
+void aacd_log_print( const char *prio, const char *tag, const char *fmt, ... )
+    __attribute__ (( format( printf, 3, 4 )));
+#endif
 
 
 #ifdef __cplusplus
@@ -22,9 +22,23 @@
 
 #include "aac-decoder.h"
 #include "aac-common.h"
+#include "aac-output.h"
+#include "aac-engine.h"
+#include "aac-post.h"
+#include "aac-metrics.h"
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+
+/**
+ * The native pointers are passed to Java as long - on both 32 and 64-bit ABIs.
+ */
+#define AACD_JNI_HANDLE( ptr )      ((jlong) (intptr_t) (ptr))
+#define AACD_JNI_PTR( type, h )     ((type*) (intptr_t) (h))
+
+
 /****************************************************************************************************
  * STRUCTS
  ****************************************************************************************************/
@@ -39,24 +53,74 @@ struct JavaDecoderInfo {
     jfieldID roundBytesConsumed;
     jfieldID roundSamples;
     jfieldID firstSamples;
+    jfieldID duration;
+    jfieldID startInitUs;
+    jfieldID startReadUs;
+    jfieldID startSyncUs;
+    jfieldID startDecodeUs;
 };
 
 struct JavaArrayBufferReader {
     jclass bufferClazz;
     jfieldID bufferData;
+    jfieldID bufferDirect;
     jfieldID bufferSize;
     jclass clazz;
     jmethodID next;
+    jmethodID seek;
 };
 
+/**
+ * The Java objects of one decoding session - stored as the reader_ext.
+ */
+typedef struct AACDJava {
+
+    /**
+     * The last known JNIEnv.
+     */
+    JNIEnv *env;
+
+    /**
+     * The VM - the native output thread is attached to it.
+     */
+    JavaVM *vm;
+
+    /**
+     * The input buffer reader object.
+     */
+    jobject reader;
+
+    /**
+     * The callback variable - Decoder.Info.
+     */
+    jobject aacInfo;
+
+    /**
+     * Flag if the last buffer was a direct ByteBuffer decoded in place.
+     */
+    int direct;
+
+    /**
+     * The memory mapped file - used instead of the reader.
+     */
+    AACDMmap *mmap;
+
+    /**
+     * The native HTTP stream - used instead of the reader.
+     */
+    AACDHttp *http;
+
+} AACDJava;
+
 static struct JavaArrayBufferReader javaABR;
 static struct JavaDecoderInfo javaDecoderInfo;
 
-extern AACDDecoder aacd_opencore_decoder;
-extern AACDDecoder aacd_opencoremp3_decoder;
+/**
+ * The VM - stored by JNI_OnLoad().
+ */
+static JavaVM *aacd_java_vm;
 
-#define AACD_DECODERS_COUNT 2
-static struct AACDDecoder* aacd_decoders[AACD_DECODERS_COUNT] = { &aacd_opencore_decoder, &aacd_opencoremp3_decoder };
+extern AACDDecoder aacd_opencore_decoder;
 
 
 /****************************************************************************************************
@@ -64,74 +128,150 @@ static struct AACDDecoder* aacd_decoders[AACD_DECODERS_COUNT] = { &aacd_opencore
  ****************************************************************************************************/
 
 /**
- * Searches for ADTS 0xfff header.
- * Returns the offset of ADTS frame.
+ * Finds the class and returns a global reference to it or NULL.
+ * The pending exception is cleared - the failure is reported by JNI_OnLoad().
  */
-int aacd_adts_sync(unsigned char *buffer, int len)
+static jclass aacd_java_class( JNIEnv *env, const char *name )
 {
-    int pos = 0;
-    len -= 3;
+    jclass clazz = (*env)->FindClass( env, name );
 
-    AACD_TRACE( "probe() start len=%d", len );
-
-    while (pos < len)
+    if (!clazz)
     {
-        if (*buffer != 0xff)
-        {
-            buffer++;
-            pos++;
-        }
-        else if ((*(++buffer) & 0xf6) == 0xf0)
-        {
-            AACD_TRACE( "probe() found ADTS start at offset %d", pos );
-            return pos;
-        }
-        else pos++;
+        (*env)->ExceptionClear( env );
+        AACD_ERROR( "cache() class not found: %s", name );
+
+        return NULL;
     }
 
-    AACD_WARN( "probe() could not find ADTS start" );
+    jclass ret = (jclass) (*env)->NewGlobalRef( env, clazz );
 
-    return -1;
+    (*env)->DeleteLocalRef( env, clazz );
+
+    return ret;
 }
 
 
 /**
- * Copies relevant information to Java object.
- * This is called in the start method.
+ * Returns the field ID or NULL - e.g. when the field was renamed or stripped by ProGuard.
+ * @param err set to 1 on error
+ */
+static jfieldID aacd_java_field( JNIEnv *env, jclass clazz, const char *name, const char *sig, int *err )
+{
+    jfieldID ret = (*env)->GetFieldID( env, clazz, name, sig );
+
+    if (!ret)
+    {
+        (*env)->ExceptionClear( env );
+        AACD_ERROR( "cache() field not found: %s %s", name, sig );
+        *err = 1;
+    }
+
+    return ret;
+}
+
+
+/**
+ * Returns the method ID or NULL - e.g. when the method was renamed or stripped by ProGuard.
+ * @param err set to 1 on error
  */
-static void aacd_start_info2java( AACDInfo *info )
+static jmethodID aacd_java_method( JNIEnv *env, jclass clazz, const char *name, const char *sig, int *err )
 {
-    JNIEnv *env = info->env;
-    jobject jinfo = info->aacInfo;
+    jmethodID ret = (*env)->GetMethodID( env, clazz, name, sig );
 
-    if (javaDecoderInfo.clazz == NULL)
+    if (!ret)
     {
-        AACD_TRACE( "aacd_start_info2java() - caching Java reflection" );
-        javaDecoderInfo.clazz = (jclass) (*env)->GetObjectClass( env, jinfo );
-        javaDecoderInfo.sampleRate = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "sampleRate", "I");
-        javaDecoderInfo.channels = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "channels", "I");
-        javaDecoderInfo.frameMaxBytesConsumed = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "frameMaxBytesConsumed", "I");
-        javaDecoderInfo.frameSamples = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "frameSamples", "I");
-        javaDecoderInfo.roundFrames = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "roundFrames", "I");
-        javaDecoderInfo.roundBytesConsumed = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "roundBytesConsumed", "I");
-        javaDecoderInfo.roundSamples = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "roundSamples", "I");
-        javaDecoderInfo.firstSamples = (jfieldID) (*env)->GetFieldID( env, javaDecoderInfo.clazz, "firstSamples", "[S");
+        (*env)->ExceptionClear( env );
+        AACD_ERROR( "cache() method not found: %s %s", name, sig );
+        *err = 1;
     }
 
-    AACD_TRACE( "aacd_start_info2java() - storing info sampleRate=%d, channels=%d",
+    return ret;
+}
+
+
+/**
+ * Caches the Java reflection - called once when the library is loaded,
+ * so the decoding sessions running in parallel only read the cached IDs.
+ * The classes are held by global references - the IDs stay valid.
+ * Every member must be found - otherwise the library is not loaded at all
+ * (see decoder/proguard.txt).
+ * @return 0=OK, otherwise error
+ */
+static int aacd_java_cache( JNIEnv *env )
+{
+    int err = 0;
+
+    javaDecoderInfo.clazz = aacd_java_class( env, "com/spoledge/aacdecoder/Decoder$Info" );
+    if (!javaDecoderInfo.clazz) return -1;
+
+    jclass clazz = javaDecoderInfo.clazz;
+
+    javaDecoderInfo.sampleRate = aacd_java_field( env, clazz, "sampleRate", "I", &err );
+    javaDecoderInfo.channels = aacd_java_field( env, clazz, "channels", "I", &err );
+    javaDecoderInfo.frameMaxBytesConsumed = aacd_java_field( env, clazz, "frameMaxBytesConsumed", "I", &err );
+    javaDecoderInfo.frameSamples = aacd_java_field( env, clazz, "frameSamples", "I", &err );
+    javaDecoderInfo.roundFrames = aacd_java_field( env, clazz, "roundFrames", "I", &err );
+    javaDecoderInfo.roundBytesConsumed = aacd_java_field( env, clazz, "roundBytesConsumed", "I", &err );
+    javaDecoderInfo.roundSamples = aacd_java_field( env, clazz, "roundSamples", "I", &err );
+    javaDecoderInfo.firstSamples = aacd_java_field( env, clazz, "firstSamples", "[S", &err );
+    javaDecoderInfo.duration = aacd_java_field( env, clazz, "duration", "I", &err );
+    javaDecoderInfo.startInitUs = aacd_java_field( env, clazz, "startInitUs", "I", &err );
+    javaDecoderInfo.startReadUs = aacd_java_field( env, clazz, "startReadUs", "I", &err );
+    javaDecoderInfo.startSyncUs = aacd_java_field( env, clazz, "startSyncUs", "I", &err );
+    javaDecoderInfo.startDecodeUs = aacd_java_field( env, clazz, "startDecodeUs", "I", &err );
+
+    javaABR.clazz = aacd_java_class( env, "com/spoledge/aacdecoder/BufferReader" );
+    if (!javaABR.clazz) return -1;
+
+    javaABR.next = aacd_java_method( env, javaABR.clazz, "next", "()Lcom/spoledge/aacdecoder/BufferReader$Buffer;", &err );
+    javaABR.seek = aacd_java_method( env, javaABR.clazz, "seek", "(J)Z", &err );
+
+    javaABR.bufferClazz = aacd_java_class( env, "com/spoledge/aacdecoder/BufferReader$Buffer" );
+    if (!javaABR.bufferClazz) return -1;
+
+    clazz = javaABR.bufferClazz;
+
+    javaABR.bufferData = aacd_java_field( env, clazz, "data", "[B", &err );
+    javaABR.bufferDirect = aacd_java_field( env, clazz, "direct", "Ljava/nio/ByteBuffer;", &err );
+    javaABR.bufferSize = aacd_java_field( env, clazz, "size", "I", &err );
+
+    return err ? -1 : 0;
+}
+
+
+/**
+ * Copies relevant information to Java object.
+ * This is called in the start method.
+ */
+static void aacd_start_info2java( AACDInfo *info, int firstSamples )
+{
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    JNIEnv *env = java->env;
+    jobject jinfo = java->aacInfo;
+
+    AACD_TRACE( "aacd_start_info2java() - storing info sampleRate=%lu, channels=%d",
             info->samplerate, info->channels );
 
     (*env)->SetIntField( env, jinfo, javaDecoderInfo.sampleRate, (jint) info->samplerate);
     (*env)->SetIntField( env, jinfo, javaDecoderInfo.channels, (jint) info->channels);
+    (*env)->SetIntField( env, jinfo, javaDecoderInfo.duration, (jint) info->duration);
+    (*env)->SetIntField( env, jinfo, javaDecoderInfo.startInitUs, (jint) info->start_times.init);
+    (*env)->SetIntField( env, jinfo, javaDecoderInfo.startReadUs, (jint) info->start_times.read);
+    (*env)->SetIntField( env, jinfo, javaDecoderInfo.startSyncUs, (jint) info->start_times.sync);
+    (*env)->SetIntField( env, jinfo, javaDecoderInfo.startDecodeUs, (jint) info->start_times.decode);
 
-    // store the first samples if any:
     if (info->samples && info->frame_samples) {
+        (*env)->SetIntField( env, jinfo, javaDecoderInfo.frameMaxBytesConsumed, (jint) info->frame_bytesconsumed);
+        (*env)->SetIntField( env, jinfo, javaDecoderInfo.frameSamples, (jint) info->frame_samples);
+    }
+
+    // store the first samples if any (otherwise they are returned by the first decoding round):
+    if (firstSamples && info->first_pending) {
         jshortArray outBuf = (*env)->NewShortArray( env, info->frame_samples );
         (*env)->SetShortArrayRegion( env, outBuf, 0, info->frame_samples, info->samples );
         (*env)->SetObjectField( env, jinfo, javaDecoderInfo.firstSamples, outBuf );
+        info->first_pending = 0;
 
-        (*env)->SetIntField( env, jinfo, javaDecoderInfo.frameMaxBytesConsumed, (jint) info->frame_bytesconsumed);
-        (*env)->SetIntField( env, jinfo, javaDecoderInfo.frameSamples, (jint) info->frame_samples);
         (*env)->SetIntField( env, jinfo, javaDecoderInfo.roundFrames, (jint) 1);
         (*env)->SetIntField( env, jinfo, javaDecoderInfo.roundBytesConsumed, (jint) info->frame_bytesconsumed);
         (*env)->SetIntField( env, jinfo, javaDecoderInfo.roundSamples, (jint) info->frame_samples);
@@ -147,12 +287,15 @@ static void aacd_start_info2java( AACDInfo *info )
  */
 static void aacd_decode_info2java( AACDInfo *info )
 {
-    AACD_TRACE( "aacd_decode_info2java() - storing info frameMaxBytesConsumed=%d, frameSamples=%d, roundFrames=%d, roundBytesConsumed=%d, roundSamples=%d",
+    AACD_TRACE( "aacd_decode_info2java() - storing info frameMaxBytesConsumed=%lu, frameSamples=%lu, roundFrames=%lu, roundBytesConsumed=%lu, roundSamples=%lu",
             info->frame_max_bytesconsumed, info->frame_samples,
             info->round_frames, info->round_bytesconsumed, info->round_samples );
 
-    JNIEnv *env = info->env;
-    jobject jinfo = info->aacInfo;
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    JNIEnv *env = java->env;
+    jobject jinfo = java->aacInfo;
+
+    unsigned long t0 = aacd_metrics_now();
 
     (*env)->SetIntField( env, jinfo, javaDecoderInfo.frameMaxBytesConsumed, (jint) info->frame_max_bytesconsumed);
     (*env)->SetIntField( env, jinfo, javaDecoderInfo.frameSamples, (jint) info->frame_samples);
@@ -160,327 +303,383 @@ static void aacd_decode_info2java( AACDInfo *info )
     (*env)->SetIntField( env, jinfo, javaDecoderInfo.roundBytesConsumed, (jint) info->round_bytesconsumed);
     (*env)->SetIntField( env, jinfo, javaDecoderInfo.roundSamples, (jint) info->round_samples);
 
+    aacd_metrics_since( AACD_HIST_JNI, t0 );
+
     AACD_TRACE( "aacd_decode_info2java() - finished" );
 }
 
 
 /****************************************************************************************************
- * FUNCTIONS - Buffers
+ * FUNCTIONS - Java reader
  ****************************************************************************************************/
 
+static const char* aacd_java_reader_name()
+{
+    return "BufferReader";
+}
+
+
 /**
- * Starts the service - initializes resource.
+ * Reads next buffer from BufferReader.
  */
-static AACDInfo* aacd_start( JNIEnv *env, AACDDecoder *decoder, jobject jreader, jobject aacInfo)
+static long aacd_java_reader_read( AACDInfo *info )
 {
-    AACD_INFO( "start() starting native decoder - %s", decoder->name());
-
-    AACDInfo *info = (AACDInfo*) calloc( 1, sizeof( struct AACDInfo ));
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    JNIEnv *env = java->env;
 
-    info->decoder = decoder;
+    if (java->mmap) return aacd_mmap_read( info, java->mmap );
+    if (java->http) return aacd_http_read( info, java->http );
 
-    info->ext = info->decoder->init();
+    // the output thread could not be attached:
+    if (!env) return 0;
 
-    info->reader = (*env)->NewGlobalRef( env, jreader );
-    info->aacInfo = (*env)->NewGlobalRef( env, aacInfo );
+    // the previous direct buffer is released by next() - save its rest:
+    if (java->direct) aacd_direct_save( info );
 
-    return info;
-}
+    jobject jbuffer = (*env)->CallObjectMethod( env, java->reader, javaABR.next );
 
+    if (!jbuffer) return 0;
 
-/**
- * Stops the service and frees resources.
- */
-static void aacd_stop( AACDInfo *info )
-{
-    AACD_INFO( "stop() stopping native decoder" );
+    jint size = (*env)->GetIntField( env, jbuffer, javaABR.bufferSize );
 
-    if (info == NULL) return;
+    if (size <= 0) return 0;
 
-    if (info->decoder) info->decoder->destroy( info );
+    jobject direct = (*env)->GetObjectField( env, jbuffer, javaABR.bufferDirect );
 
-    if (info->buffer_block != NULL)
+    if (direct)
     {
-        free( info->buffer_block );
-        info->buffer_block = NULL;
-        info->bbsize = 0;
-    }
+        java->direct = 1;
+        aacd_direct_buffer( info, (unsigned char*) (*env)->GetDirectBufferAddress( env, direct ), size );
 
-    if (info->buffer_block2 != NULL)
-    {
-        free( info->buffer_block2 );
-        info->buffer_block = NULL;
-        info->bbsize2 = 0;
+        return size;
     }
 
-    if (info->samples != NULL)
-    {
-        free( info->samples );
-        info->samplesLen = 0;
-    }
+    java->direct = 0;
+
+    jbyteArray data = (jbyteArray) (*env)->GetObjectField( env, jbuffer, javaABR.bufferData );
+
+    unsigned long t0 = aacd_metrics_now();
 
-    JNIEnv *env = info->env;
+    (*env)->GetByteArrayRegion( env, data, 0, size, (jbyte*) aacd_prepare_buffer( info, size ));
 
-    if (info->aacInfo) (*env)->DeleteGlobalRef( env, info->aacInfo );
-    if (info->reader) (*env)->DeleteGlobalRef( env, info->reader );
+    aacd_metrics_since( AACD_HIST_JNI, t0 );
 
-    free( info );
+    return size;
 }
 
 
 /**
- * Prepares input buffer by joining the rest of the old one and the new one.
+ * Releases the Java objects.
  */
-static unsigned char* aacd_prepare_buffer( AACDInfo *info, jbyteArray inBuf, jint inOff, jint inLen )
+static void aacd_java_reader_destroy( AACDInfo *info )
 {
-    int newlen = info->bytesleft + inLen;
+    AACDJava *java = (AACDJava*) info->reader_ext;
 
-    if (info->bbsize2 < newlen) 
-    {
-        if (info->buffer_block2 != NULL) free( info->buffer_block2 );
+    if ( !java ) return;
 
-        int realsize = newlen + 500; // avoid realocating by one or two bytes only
+    JNIEnv *env = java->env;
+
+    if (java->aacInfo) (*env)->DeleteGlobalRef( env, java->aacInfo );
+    if (java->reader) (*env)->DeleteGlobalRef( env, java->reader );
+    if (java->mmap) aacd_mmap_close( java->mmap );
+    if (java->http) aacd_http_close( java->http );
+
+    free( java );
+    info->reader_ext = NULL;
+}
+
+
+/**
+ * Repositions the BufferReader - the buffers read so far are dropped.
+ */
+static int aacd_java_reader_seek( AACDInfo *info, unsigned long offset )
+{
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    JNIEnv *env = java->env;
+
+    if (java->mmap) return aacd_mmap_seek( java->mmap, offset );
+    if (java->http) return aacd_http_seek( java->http, offset );
+
+    if (!env) return -1;
+
+    // the taken direct buffer is released - nothing to save:
+    java->direct = 0;
+
+    return (*env)->CallBooleanMethod( env, java->reader, javaABR.seek, (jlong) offset ) ? 0 : -1;
+}
+
+
+static AACDReader aacd_java_reader = {
+    aacd_java_reader_name,
+    aacd_java_reader_read,
+    aacd_java_reader_destroy,
+    aacd_java_reader_seek
+};
 
-        info->buffer_block2 = (unsigned char*) malloc( realsize );
-        info->bbsize2 = realsize;
-    }
 
-    if (info->bytesleft != 0) memcpy( info->buffer_block2, info->buffer, info->bytesleft );
+/****************************************************************************************************
+ * FUNCTIONS - Java output
+ ****************************************************************************************************/
 
-    JNIEnv *env = info->env;
-    (*env)->GetByteArrayRegion( env, inBuf, inOff, inLen, info->buffer_block2 + info->bytesleft );
+/**
+ * Decodes into the internal buffer and copies the samples to the Java array.
+ */
+static void aacd_java_decode_copy( JNIEnv *env, AACDInfo *info, jshortArray outBuf, jint outLen )
+{
+    // prepare internal output buffer :
+    jshort *jsamples = aacd_prepare_samples( info, outLen );
 
-    info->buffer = info->buffer_block;
-    info->buffer_block = info->buffer_block2;
-    info->buffer_block2 = info->buffer;
-    info->buffer = info->buffer_block;
+    aacd_decode( info, jsamples, outLen );
 
-    int tmp;
-    tmp = info->bbsize;
-    info->bbsize = info->bbsize2;
-    info->bbsize2 = tmp;
+    unsigned long t0 = aacd_metrics_now();
 
-    info->bytesleft += inLen;
+    // copy samples back to Java heap:
+    (*env)->SetShortArrayRegion( env, outBuf, 0, info->round_samples, jsamples );
 
-    return info->buffer;
+    aacd_metrics_since( AACD_HIST_JNI, t0 );
 }
 
 
 /**
- * Reads next buffer.
+ * Decodes directly into the Java array.
  */
-static unsigned char* aacd_read_buffer( AACDInfo *info )
+static void aacd_java_decode_critical( JNIEnv *env, AACDInfo *info, jshortArray outBuf, jint outLen )
 {
-    JNIEnv *env = info->env;
+    int cont = 0;
 
-    if (javaABR.clazz == NULL)
+    // nothing checks the writes into the pinned array - so they are kept inside of it:
+    jsize len = (*env)->GetArrayLength( env, outBuf );
+
+    if (outLen > len) outLen = (jint) len;
+
+    // no JNI calls are allowed inside of the critical region -
+    // so it must be released each time the reader is called:
+    for (;;)
     {
-        javaABR.clazz = (*env)->GetObjectClass( env, info->reader );
-        javaABR.next = (*env)->GetMethodID( env, javaABR.clazz, "next", "()Lcom/spoledge/aacdecoder/BufferReader$Buffer;");
+        unsigned long t0 = aacd_metrics_now();
 
-        javaABR.bufferClazz = (*env)->FindClass( env, "com/spoledge/aacdecoder/BufferReader$Buffer");
-        javaABR.bufferData = (jfieldID) (*env)->GetFieldID( env, javaABR.bufferClazz, "data", "[B");
-        javaABR.bufferSize = (jfieldID) (*env)->GetFieldID( env, javaABR.bufferClazz, "size", "I");
-    }
+        jshort *jsamples = (*env)->GetPrimitiveArrayCritical( env, outBuf, NULL );
 
-    jobject jbuffer = (*env)->CallObjectMethod( env, info->reader, javaABR.next );
-    
-    if (!jbuffer) return NULL;
+        aacd_metrics_since( AACD_HIST_JNI, t0 );
 
-    jbyteArray data = (jbyteArray) (*env)->GetObjectField( env, jbuffer, javaABR.bufferData );
-    jint size = (*env)->GetIntField( env, jbuffer, javaABR.bufferSize );
+        if (!jsamples)
+        {
+            AACD_ERROR( "decode() cannot access the Java array" );
+            break;
+        }
+
+        int more = aacd_decode_noread( info, jsamples, outLen, cont );
+
+        t0 = aacd_metrics_now();
+
+        (*env)->ReleasePrimitiveArrayCritical( env, outBuf, jsamples, 0 );
+
+        aacd_metrics_since( AACD_HIST_JNI, t0 );
 
-    return aacd_prepare_buffer( info, data, 0, size );
+        if (!more || aacd_read( info ) <= 0) break;
+
+        cont = 1;
+    }
 }
 
 
+/****************************************************************************************************
+ * FUNCTIONS - Native output
+ ****************************************************************************************************/
+
 /**
- * Prepares output buffer.
+ * Attaches the decoding thread to the VM - the BufferReader is called from it.
  */
-jshort* aacd_prepare_samples( AACDInfo *info, jint outLen )
+static void aacd_java_output_attach( AACDOutput *out )
 {
-    if (info->samplesLen < outLen)
+    AACDJava *java = (AACDJava*) out->info->reader_ext;
+    JNIEnv *env = NULL;
+
+    if ((*java->vm)->AttachCurrentThread( java->vm, &env, NULL ))
     {
-        if (info->samples) free( info->samples );
-        info->samples = malloc( sizeof( jshort ) * outLen );
-        info->samplesLen = outLen;
+        AACD_ERROR( "output_attach() cannot attach the decoding thread" );
+        env = NULL;
     }
 
-    return info->samples;
+    java->env = env;
+}
+
+
+static void aacd_java_output_detach( AACDOutput *out )
+{
+    AACDJava *java = (AACDJava*) out->info->reader_ext;
+
+    if (!java->env) return;
+
+    java->env = NULL;
+    (*java->vm)->DetachCurrentThread( java->vm );
 }
 
 
+/****************************************************************************************************
+ * FUNCTIONS - JNI
+ ****************************************************************************************************/
+
 /**
- * Decodes the stream - one round until the output buffer is (almost) filled.
+ * Stores the VM and caches the Java reflection.
  */
-static void aacd_decode( AACDInfo *info, jshort *samples, jint outLen )
+JNIEXPORT jint JNICALL JNI_OnLoad( JavaVM *vm, void *reserved )
 {
-    AACD_DEBUG( "decode() start" );
+    JNIEnv *env = NULL;
 
-    info->round_frames = 0;
-    info->round_bytesconsumed = 0;
-    info->round_samples = 0;
+    if ((*vm)->GetEnv( vm, (void**) &env, JNI_VERSION_1_4 ) != JNI_OK)
+    {
+        AACD_ERROR( "JNI_OnLoad() cannot get the JNIEnv" );
+        return JNI_ERR;
+    }
 
-    do
+    aacd_java_vm = vm;
+
+    if (aacd_java_cache( env ))
     {
-        // check if input buffer is filled:
-        if (info->bytesleft <= info->frame_max_bytesconsumed)
-        {
-            AACD_TRACE( "decode() reading input buffer" );
-            aacd_read_buffer( info );
-
-            if (info->bytesleft <= info->frame_max_bytesconsumed)
-            {
-                AACD_INFO( "decode() detected end-of-file" );
-                break;
-            }
-        }
+        AACD_ERROR( "JNI_OnLoad() cannot cache the Java classes" );
+        return JNI_ERR;
+    }
 
-        AACD_TRACE( "decode() frame - frames=%d, consumed=%d, samples=%d, bytesleft=%d, frame_maxconsumed=%d, frame_samples=%d, outLen=%d", info->round_frames, info->round_bytesconsumed, info->round_samples, info->bytesleft, info->frame_max_bytesconsumed, info->frame_samples, outLen);
+    return JNI_VERSION_1_4;
+}
 
-        int attempts = 10;
 
-        do
-        {
-            if (!info->decoder->decode( info, info->buffer, info->bytesleft, samples, outLen )) break;
-
-            AACD_WARN( "decode() failed to decode a frame" );
-            AACD_DEBUG( "decode() failed to decode a frame - frames=%d, consumed=%d, samples=%d, bytesleft=%d, frame_maxconsumed=%d, frame_samples=%d, outLen=%d", info->round_frames, info->round_bytesconsumed, info->round_samples, info->bytesleft, info->frame_max_bytesconsumed, info->frame_samples, outLen);
-
-            if (info->bytesleft <= info->frame_max_bytesconsumed)
-            {
-                aacd_read_buffer( info );
-
-                if (info->bytesleft <= info->frame_max_bytesconsumed)
-                {
-                    AACD_INFO( "decode() detected end-of-file after partial frame error" );
-                    attempts = 0;
-                    break;
-                }
-            }
-
-            int pos = info->decoder->sync( info, info->buffer+1, info->bytesleft-1 );
-
-            if (pos >= 0) {
-                info->buffer += pos+1;
-                info->bytesleft -= pos+1;
-            }
-            else {
-                int move = info->bytesleft < 2048 ? (info->bytesleft >> 1) : 1024;
-                info->buffer += move;
-                info->bytesleft -= move;
-            }
-        }
-        while (--attempts > 0);
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeStart
+ * Signature: (JLcom/spoledge/aacdecoder/BufferReader;Lcom/spoledge/aacdecoder/Decoder/Info;ZZ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStart
+  (JNIEnv *env, jobject thiz, jlong decoder, jobject jreader, jobject aacInfo, jboolean firstSamples, jboolean seekable)
+{
+    AACDDecoder *dec = decoder != 0 ? AACD_JNI_PTR( AACDDecoder, decoder ) : &aacd_opencore_decoder;
 
-        if ( !attempts )
-        {
-            AACD_WARN( "decode() failed after several attempts");
-            break;
-        }
+    AACDJava *java = (AACDJava*) calloc( 1, sizeof( struct AACDJava ));
+    java->env = env;
+    java->reader = (*env)->NewGlobalRef( env, jreader );
+    java->aacInfo = (*env)->NewGlobalRef( env, aacInfo );
 
-        info->round_frames++;
-        info->round_bytesconsumed += info->frame_bytesconsumed;
-        info->bytesleft -= info->frame_bytesconsumed;
-        info->buffer += info->frame_bytesconsumed;
+    AACDInfo *info = aacd_start( dec, &aacd_java_reader, java );
 
-        if (info->frame_bytesconsumed > info->frame_max_bytesconsumed)
-        {
-            info->frame_max_bytesconsumed_exact = info->frame_bytesconsumed;
-            info->frame_max_bytesconsumed = info->frame_bytesconsumed * 3 / 2;
-        }
+    if (!info) return 0;
 
-        samples += info->frame_samples;
-        outLen -= info->frame_samples;
-        info->round_samples += info->frame_samples;
-    } 
-    while (outLen >= info->frame_samples );
+    if (seekable) aacd_index_enable( info );
 
-    AACD_DEBUG( "decode() round - frames=%d, consumed=%d, samples=%d, bytesleft=%d, frame_maxconsumed=%d, frame_samples=%d, outLen=%d", info->round_frames, info->round_bytesconsumed, info->round_samples, info->bytesleft, info->frame_max_bytesconsumed, info->frame_samples, outLen);
-}
+    aacd_start_info2java( info, firstSamples );
 
+    java->env = NULL;
+
+    return AACD_JNI_HANDLE( info );
+}
 
-/****************************************************************************************************
- * FUNCTIONS - JNI
- ****************************************************************************************************/
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
- * Method:    nativeStart
- * Signature: (ILcom/spoledge/aacdecoder/BufferReader;Lcom/spoledge/aacdecoder/Decoder/Info;)I
+ * Method:    nativeStartFile
+ * Signature: (JLjava/lang/String;Lcom/spoledge/aacdecoder/Decoder/Info;Z)J
  */
-JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStart
-  (JNIEnv *env, jobject thiz, jint decoder, jobject jreader, jobject aacInfo)
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStartFile
+  (JNIEnv *env, jobject thiz, jlong decoder, jstring jpath, jobject aacInfo, jboolean firstSamples)
 {
-    AACDDecoder *dec = decoder != 0 ? ((AACDDecoder*)decoder) : &aacd_opencore_decoder;
-    AACDInfo *info = aacd_start( env, dec, jreader, aacInfo );
+    AACDDecoder *dec = decoder != 0 ? AACD_JNI_PTR( AACDDecoder, decoder ) : &aacd_opencore_decoder;
 
-    info->env = env;
+    const char *path = (*env)->GetStringUTFChars( env, jpath, NULL );
+    AACDMmap *mmap = aacd_mmap_open( path );
+    (*env)->ReleaseStringUTFChars( env, jpath, path );
 
-    unsigned char* buffer = aacd_read_buffer( info );
-    unsigned long buffer_size = info->bytesleft;
+    if (!mmap) return 0;
 
-    int pos = info->decoder->sync( info, buffer, buffer_size );
+    AACDJava *java = (AACDJava*) calloc( 1, sizeof( struct AACDJava ));
+    java->env = env;
+    java->mmap = mmap;
+    java->aacInfo = (*env)->NewGlobalRef( env, aacInfo );
 
-    if (pos < 0)
-    {
-        AACD_ERROR( "start() failed - SYNC word not found" );
-        aacd_stop( info );
+    AACDInfo *info = aacd_start( dec, &aacd_java_reader, java );
 
-        return 0;
-    }
+    if (!info) return 0;
 
-    AACD_DEBUG( "start() SYNC word found at offset=%d", pos );
+    // files are always seekable:
+    aacd_index_enable( info );
 
-    buffer += pos;
-    buffer_size -= pos;
+    aacd_start_info2java( info, firstSamples );
 
-    long err = info->decoder->start( info, buffer, buffer_size );
+    java->env = NULL;
 
-    if (err < 0)
-    {
-        AACD_ERROR( "start() failed err=%ld", err );
-        aacd_stop( info );
+    return AACD_JNI_HANDLE( info );
+}
 
-        return 0;
-    }
 
-    // remember pointers for first decode round:
-    info->buffer = buffer + err;
-    info->bytesleft = buffer_size - err;
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeStartHttp
+ * Signature: (JJLcom/spoledge/aacdecoder/Decoder/Info;Z)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStartHttp
+  (JNIEnv *env, jobject thiz, jlong decoder, jlong jhttp, jobject aacInfo, jboolean firstSamples)
+{
+    AACDDecoder *dec = decoder != 0 ? AACD_JNI_PTR( AACDDecoder, decoder ) : &aacd_opencore_decoder;
+    AACDHttp *http = AACD_JNI_PTR( AACDHttp, jhttp );
+
+    // the stream is owned by the decoder from now - it is closed by aacd_stop():
+    AACDJava *java = (AACDJava*) calloc( 1, sizeof( struct AACDJava ));
+    java->env = env;
+    java->http = http;
+    java->aacInfo = (*env)->NewGlobalRef( env, aacInfo );
+
+    AACDInfo *info = aacd_start( dec, &aacd_java_reader, java );
+
+    if (!info) return 0;
 
-    AACD_DEBUG( "start() bytesleft=%d", info->bytesleft );
+    if (aacd_http_seekable( http )) aacd_index_enable( info );
 
-    aacd_start_info2java( info );
+    aacd_start_info2java( info, firstSamples );
 
-    info->env = NULL;
+    java->env = NULL;
 
-    return (jint) info;
+    return AACD_JNI_HANDLE( info );
 }
 
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
  * Method:    nativeDecode
- * Signature: (I[SI)I
+ * Signature: (J[SI)I
  */
 JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecode
-  (JNIEnv *env, jobject thiz, jint jinfo, jshortArray outBuf, jint outLen)
+  (JNIEnv *env, jobject thiz, jlong jinfo, jshortArray outBuf, jint outLen)
 {
-    AACDInfo *info = (AACDInfo*) jinfo;
-    info->env = env;
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    java->env = env;
 
-    // prepare internal output buffer :
-    jshort *jsamples = aacd_prepare_samples( info, outLen );
+    aacd_java_decode_copy( env, info, outBuf, outLen );
 
-    aacd_decode( info, jsamples, outLen );
+    aacd_decode_info2java( info );
 
-    // copy samples back to Java heap:
-    (*env)->SetShortArrayRegion( env, outBuf, 0, info->round_samples, jsamples );
+    java->env = NULL;
+
+    return (jint) info->round_samples;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecodeCritical
+ * Signature: (J[SI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodeCritical
+  (JNIEnv *env, jobject thiz, jlong jinfo, jshortArray outBuf, jint outLen)
+{
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    java->env = env;
+
+    aacd_java_decode_critical( env, info, outBuf, outLen );
 
     aacd_decode_info2java( info );
 
-    info->env = NULL;
+    java->env = NULL;
 
     return (jint) info->round_samples;
 }
@@ -488,45 +687,748 @@ JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecode
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
- * Method:    nativeStop
- * Signature: (I)V
+ * Method:    nativeDecodeDirect
+ * Signature: (JLjava/nio/ShortBuffer;I)I
  */
-JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStop
-  (JNIEnv *env, jobject thiz, jint jinfo)
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodeDirect
+  (JNIEnv *env, jobject thiz, jlong jinfo, jobject outBuf, jint outLen)
 {
-    AACDInfo *info = (AACDInfo*) jinfo;
-    info->env = env;
-    aacd_stop( info );
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+
+    jshort *jsamples = (*env)->GetDirectBufferAddress( env, outBuf );
+    jlong capacity = (*env)->GetDirectBufferCapacity( env, outBuf );
+
+    if (!jsamples || capacity < 0)
+    {
+        AACD_ERROR( "decode() the output buffer is not direct" );
+        return -1;
+    }
+
+    if (outLen > capacity) outLen = (jint) capacity;
+
+    java->env = env;
+
+    aacd_decode( info, jsamples, outLen );
+
+    aacd_decode_info2java( info );
+
+    java->env = NULL;
+
+    return (jint) info->round_samples;
 }
 
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
- * Method:    nativeDecoderGetByName
- * Signature: (Ljava/lang/String;)I
+ * Method:    nativeDecodePCM
+ * Signature: (JLjava/lang/Object;II)I
  */
-JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecoderGetByName
-  (JNIEnv *env, jclass clazzDecoder, jstring jname)
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodePCM
+  (JNIEnv *env, jobject thiz, jlong jinfo, jobject outBuf, jint outLen, jint format)
 {
-    int i;
-    AACDDecoder *ret = NULL;
-    jboolean isCopy;
-    const char *name = (*env)->GetStringUTFChars( env, jname, &isCopy );
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    java->env = env;
+
+    // decoded into the internal buffer - the reader can be called meanwhile:
+    jshort *samples = aacd_prepare_samples( info, outLen );
+
+    aacd_decode( info, samples, outLen );
+
+    aacd_decode_info2java( info );
 
-    for (i=0; i < AACD_DECODERS_COUNT; i++)
+    java->env = NULL;
+
+    // the conversion writes directly into the Java array (float[] or int[]):
+    void *jsamples = (*env)->GetPrimitiveArrayCritical( env, (jarray) outBuf, NULL );
+
+    if (!jsamples)
     {
-        AACDDecoder *dec = aacd_decoders[i];
+        AACD_ERROR( "decode() cannot access the Java array" );
+        return -1;
+    }
 
-        if (!strcmp( name, dec->name()))
-        {
-            ret = dec;
-            break;
-        }
+    aacd_pcm_convert( format, samples, jsamples, info->round_samples );
+
+    (*env)->ReleasePrimitiveArrayCritical( env, (jarray) outBuf, jsamples, 0 );
+
+    return (jint) info->round_samples;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecodeFrames
+ * Signature: (J[SILjava/nio/ByteBuffer;Z)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodeFrames
+  (JNIEnv *env, jobject thiz, jlong jinfo, jshortArray outBuf, jint outLen, jobject statsBuf, jboolean critical)
+{
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+
+    AACDFrameStats *stats = (AACDFrameStats*) (*env)->GetDirectBufferAddress( env, statsBuf );
+    jlong capacity = (*env)->GetDirectBufferCapacity( env, statsBuf );
+
+    if (!stats || capacity < (jlong) sizeof( AACDFrameStats ))
+    {
+        AACD_ERROR( "decode() the stats buffer is not direct or too small" );
+        return -1;
     }
 
-    (*env)->ReleaseStringUTFChars( env, jname, name );
+    java->env = env;
 
-    return (jint) ret;
+    // the Info object is not updated - everything is stored in the stats block:
+    info->frame_stats = stats;
+    info->frame_stats_len = capacity / sizeof( AACDFrameStats );
+
+    if (critical) aacd_java_decode_critical( env, info, outBuf, outLen );
+    else aacd_java_decode_copy( env, info, outBuf, outLen );
+
+    info->frame_stats = NULL;
+    info->frame_stats_len = 0;
+
+    java->env = NULL;
+
+    return (jint) info->round_frames;
 }
 
 
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputStart
+ * Signature: (JLjava/lang/String;Ljava/lang/String;I)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputStart
+  (JNIEnv *env, jobject thiz, jlong jinfo, jstring jsink, jstring jparam, jint bufferMs)
+{
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+
+    const char *name = (*env)->GetStringUTFChars( env, jsink, NULL );
+    AACDSink *sink = aacd_sink_get_by_name( name );
+
+    if (!sink) AACD_ERROR( "output_start() unknown sink %s", name );
+
+    (*env)->ReleaseStringUTFChars( env, jsink, name );
+
+    if (!sink) return 0;
+
+    java->vm = aacd_java_vm;
+
+    const char *param = jparam ? (*env)->GetStringUTFChars( env, jparam, NULL ) : NULL;
+
+    AACDOutput *out = aacd_output_start( info, sink, param, bufferMs,
+                                         aacd_java_output_attach, aacd_java_output_detach );
+
+    if (param) (*env)->ReleaseStringUTFChars( env, jparam, param );
+
+    return AACD_JNI_HANDLE( out );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputWait
+ * Signature: (JI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputWait
+  (JNIEnv *env, jobject thiz, jlong jout, jint timeoutMs)
+{
+    return aacd_output_wait( AACD_JNI_PTR( AACDOutput, jout ), timeoutMs ) ? JNI_TRUE : JNI_FALSE;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputBuffered
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputBuffered
+  (JNIEnv *env, jobject thiz, jlong jout)
+{
+    return (jint) aacd_output_buffered( AACD_JNI_PTR( AACDOutput, jout ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputUnderruns
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputUnderruns
+  (JNIEnv *env, jobject thiz, jlong jout)
+{
+    return (jint) AACD_JNI_PTR( AACDOutput, jout )->underruns;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputStop
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputStop
+  (JNIEnv *env, jobject thiz, jlong jout)
+{
+    aacd_output_stop( AACD_JNI_PTR( AACDOutput, jout ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeSeek
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeSeek
+  (JNIEnv *env, jobject thiz, jlong jinfo, jlong sample)
+{
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    java->env = env;
+
+    int err = aacd_seek( info, (unsigned long) sample );
+
+    java->env = NULL;
+
+    return err ? (jlong) -1 : (jlong) info->sample_pos;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeSetQuality
+ * Signature: (JI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeSetQuality
+  (JNIEnv *env, jobject thiz, jlong jinfo, jint level)
+{
+    return (jint) aacd_set_quality( AACD_JNI_PTR( AACDInfo, jinfo ), level );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeSampleRate
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeSampleRate
+  (JNIEnv *env, jobject thiz, jlong jinfo)
+{
+    return (jint) AACD_JNI_PTR( AACDInfo, jinfo )->samplerate;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeChannels
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeChannels
+  (JNIEnv *env, jobject thiz, jlong jinfo)
+{
+    return (jint) AACD_JNI_PTR( AACDInfo, jinfo )->channels;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeStop
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStop
+  (JNIEnv *env, jobject thiz, jlong jinfo)
+{
+    AACDInfo *info = AACD_JNI_PTR( AACDInfo, jinfo );
+    AACDJava *java = (AACDJava*) info->reader_ext;
+    if (java) java->env = env;
+    aacd_stop( info );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativePrewarm
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_spoledge_aacdecoder_Decoder_nativePrewarm
+  (JNIEnv *env, jclass clazzDecoder, jlong decoder)
+{
+    AACDDecoder *dec = decoder != 0 ? AACD_JNI_PTR( AACDDecoder, decoder ) : &aacd_opencore_decoder;
+
+    return aacd_pool_prewarm( dec ) ? JNI_FALSE : JNI_TRUE;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativePoolClear
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativePoolClear
+  (JNIEnv *env, jclass clazzDecoder)
+{
+    aacd_pool_clear();
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecoderGetByName
+ * Signature: (Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecoderGetByName
+  (JNIEnv *env, jclass clazzDecoder, jstring jname)
+{
+    jboolean isCopy;
+    const char *name = (*env)->GetStringUTFChars( env, jname, &isCopy );
+
+    AACDDecoder *ret = aacd_decoder_get_by_name( name );
+
+    (*env)->ReleaseStringUTFChars( env, jname, name );
+
+    return AACD_JNI_HANDLE( ret );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - JNI DecoderEngine
+ ****************************************************************************************************/
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeCreate
+ * Signature: (I)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeCreate
+  (JNIEnv *env, jclass clazz, jint workers)
+{
+    return AACD_JNI_HANDLE( aacd_engine_create( workers ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeDestroy
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeDestroy
+  (JNIEnv *env, jclass clazz, jlong jengine)
+{
+    aacd_engine_destroy( AACD_JNI_PTR( AACDEngine, jengine ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeOpen
+ * Signature: (JJII)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeOpen
+  (JNIEnv *env, jclass clazz, jlong jengine, jlong decoder, jint inputCapacity, jint outputCapacity)
+{
+    AACDDecoder *dec = decoder != 0 ? AACD_JNI_PTR( AACDDecoder, decoder ) : &aacd_opencore_decoder;
+
+    return AACD_JNI_HANDLE( aacd_engine_open( AACD_JNI_PTR( AACDEngine, jengine ), dec, inputCapacity, outputCapacity ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeFeed
+ * Signature: (J[BII)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeFeed
+  (JNIEnv *env, jclass clazz, jlong jstream, jbyteArray data, jint off, jint len)
+{
+    // checked by Stream.feed() - the copy from the pinned array must never leave it:
+    if (off < 0 || len < 0 || off > (*env)->GetArrayLength( env, data ) - len) return 0;
+
+    // just a copy into the ring - the critical region is short:
+    jbyte *bytes = (*env)->GetPrimitiveArrayCritical( env, data, NULL );
+
+    if (!bytes) return 0;
+
+    unsigned long n = aacd_engine_feed( AACD_JNI_PTR( AACDStream, jstream ), (unsigned char*) bytes + off, len );
+
+    (*env)->ReleasePrimitiveArrayCritical( env, data, bytes, JNI_ABORT );
+
+    return (jint) n;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeEof
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeEof
+  (JNIEnv *env, jclass clazz, jlong jstream)
+{
+    aacd_engine_eof( AACD_JNI_PTR( AACDStream, jstream ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeRead
+ * Signature: (J[SI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeRead
+  (JNIEnv *env, jclass clazz, jlong jstream, jshortArray outBuf, jint outLen)
+{
+    jshort *jsamples = (*env)->GetPrimitiveArrayCritical( env, outBuf, NULL );
+
+    if (!jsamples) return 0;
+
+    unsigned long n = aacd_engine_pull( AACD_JNI_PTR( AACDStream, jstream ), jsamples, outLen );
+
+    (*env)->ReleasePrimitiveArrayCritical( env, outBuf, jsamples, 0 );
+
+    return (jint) n;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeState
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeState
+  (JNIEnv *env, jclass clazz, jlong jstream)
+{
+    return (jint) aacd_engine_state( AACD_JNI_PTR( AACDStream, jstream ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeSampleRate
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeSampleRate
+  (JNIEnv *env, jclass clazz, jlong jstream)
+{
+    AACDInfo *info = aacd_engine_info( AACD_JNI_PTR( AACDStream, jstream ));
+
+    return info ? (jint) info->samplerate : 0;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeChannels
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeChannels
+  (JNIEnv *env, jclass clazz, jlong jstream)
+{
+    AACDInfo *info = aacd_engine_info( AACD_JNI_PTR( AACDStream, jstream ));
+
+    return info ? (jint) info->channels : 0;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeClose
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeClose
+  (JNIEnv *env, jclass clazz, jlong jstream)
+{
+    aacd_engine_close( AACD_JNI_PTR( AACDStream, jstream ));
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - JNI NativeHttpStream
+ ****************************************************************************************************/
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeOpen
+ * Signature: (Ljava/lang/String;Z)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeOpen
+  (JNIEnv *env, jclass clazz, jstring jurl, jboolean metadata)
+{
+    const char *url = (*env)->GetStringUTFChars( env, jurl, NULL );
+    AACDHttp *http = aacd_http_open( url, metadata );
+    (*env)->ReleaseStringUTFChars( env, jurl, url );
+
+    return AACD_JNI_HANDLE( http );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeHeaders
+ * Signature: (J)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeHeaders
+  (JNIEnv *env, jclass clazz, jlong jhttp)
+{
+    // the raw bytes - the header values need not be valid (modified) UTF-8:
+    const char *headers = aacd_http_headers( AACD_JNI_PTR( AACDHttp, jhttp ));
+    jsize len = (jsize) strlen( headers );
+
+    jbyteArray ret = (*env)->NewByteArray( env, len );
+
+    if (ret) (*env)->SetByteArrayRegion( env, ret, 0, len, (const jbyte*) headers );
+
+    return ret;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeMetadata
+ * Signature: (J)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeMetadata
+  (JNIEnv *env, jclass clazz, jlong jhttp)
+{
+    // the ICY metadata block has 4080 bytes at most:
+    char buf[ 4081 ];
+    int len = aacd_http_metadata( AACD_JNI_PTR( AACDHttp, jhttp ), buf, sizeof( buf ));
+
+    if (len < 0) return NULL;
+
+    jbyteArray ret = (*env)->NewByteArray( env, len );
+
+    if (ret) (*env)->SetByteArrayRegion( env, ret, 0, len, (const jbyte*) buf );
+
+    return ret;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeClose
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeClose
+  (JNIEnv *env, jclass clazz, jlong jhttp)
+{
+    aacd_http_close( AACD_JNI_PTR( AACDHttp, jhttp ));
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - JNI Metrics
+ ****************************************************************************************************/
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeSnapshot
+ * Signature: ([J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeSnapshot
+  (JNIEnv *env, jclass clazz, jlongArray dest)
+{
+    jsize len = (*env)->GetArrayLength( env, dest );
+
+    if (len < AACD_METRICS_SNAPSHOT) return -1;
+
+    // jlong is 64-bit on all ABIs - the same layout as unsigned long long:
+    jlong *p = (*env)->GetPrimitiveArrayCritical( env, dest, NULL );
+
+    if (!p) return -1;
+
+    int ret = aacd_metrics_snapshot( (unsigned long long*) p, (int) len );
+
+    (*env)->ReleasePrimitiveArrayCritical( env, dest, p, 0 );
+
+    return (jint) ret;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeBackend
+ * Signature: (I)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeBackend
+  (JNIEnv *env, jclass clazz, jint index)
+{
+    const char *name = aacd_metrics_backend( index );
+
+    return name ? (*env)->NewStringUTF( env, name ) : NULL;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeCount
+ * Signature: (IJ)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeCount
+  (JNIEnv *env, jclass clazz, jint counter, jlong delta)
+{
+    if (counter >= 0 && counter < AACD_METRIC_COUNT && delta > 0) aacd_metrics_count( counter, (unsigned long long) delta );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeRecord
+ * Signature: (IJ)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeRecord
+  (JNIEnv *env, jclass clazz, jint hist, jlong value)
+{
+    if (hist >= 0 && hist < AACD_HIST_COUNT && value >= 0) aacd_metrics_record( hist, (unsigned long) value );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeReset
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeReset
+  (JNIEnv *env, jclass clazz)
+{
+    aacd_metrics_reset();
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeSetEnabled
+ * Signature: (Z)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeSetEnabled
+  (JNIEnv *env, jclass clazz, jboolean enabled)
+{
+    __atomic_store_n( &aacd_metrics_enabled, enabled ? 1 : 0, __ATOMIC_RELAXED );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - JNI PostProcessor
+ ****************************************************************************************************/
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeCreate
+ * Signature: (III)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeCreate
+  (JNIEnv *env, jclass clazz, jint channels, jint inRate, jint outRate)
+{
+    if (inRate <= 0 || outRate < 0) return 0;
+
+    return AACD_JNI_HANDLE( aacd_post_create( channels, (unsigned long) inRate, (unsigned long) outRate ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeDownmix
+ * Signature: (JFFFZ)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeDownmix
+  (JNIEnv *env, jclass clazz, jlong jpost, jfloat center, jfloat surround, jfloat lfe, jboolean normalize)
+{
+    aacd_post_downmix( AACD_JNI_PTR( AACDPost, jpost ), center, surround, lfe, normalize == JNI_TRUE );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeChannels
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeChannels
+  (JNIEnv *env, jclass clazz, jlong jpost)
+{
+    return (jint) aacd_post_channels( AACD_JNI_PTR( AACDPost, jpost ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeRate
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeRate
+  (JNIEnv *env, jclass clazz, jlong jpost)
+{
+    return (jint) aacd_post_rate( AACD_JNI_PTR( AACDPost, jpost ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeMaxOutput
+ * Signature: (JI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeMaxOutput
+  (JNIEnv *env, jclass clazz, jlong jpost, jint inLen)
+{
+    return (jint) aacd_post_max_out( AACD_JNI_PTR( AACDPost, jpost ), inLen );
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeProcess
+ * Signature: (J[SI[S)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeProcess
+  (JNIEnv *env, jclass clazz, jlong jpost, jshortArray inBuf, jint inLen, jshortArray outBuf)
+{
+    AACDPost *post = AACD_JNI_PTR( AACDPost, jpost );
+
+    if (inLen < 0 || inLen > (*env)->GetArrayLength( env, inBuf ))
+    {
+        AACD_ERROR( "process() input length out of the array" );
+        return 0;
+    }
+
+    if ((*env)->GetArrayLength( env, outBuf ) < (jsize) aacd_post_max_out( post, inLen ))
+    {
+        AACD_ERROR( "process() output buffer too small" );
+        return 0;
+    }
+
+    // no JNI calls until both arrays are released:
+    jshort *in = (*env)->GetPrimitiveArrayCritical( env, inBuf, NULL );
+    jshort *out = in ? (*env)->GetPrimitiveArrayCritical( env, outBuf, NULL ) : NULL;
+    unsigned long n = 0;
+
+    if (out) n = aacd_post_process( post, in, inLen, out );
+
+    if (out) (*env)->ReleasePrimitiveArrayCritical( env, outBuf, out, 0 );
+    if (in) (*env)->ReleasePrimitiveArrayCritical( env, inBuf, in, JNI_ABORT );
+
+    return (jint) n;
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeReset
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeReset
+  (JNIEnv *env, jclass clazz, jlong jpost)
+{
+    aacd_post_reset( AACD_JNI_PTR( AACDPost, jpost ));
+}
+
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeDestroy
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeDestroy
+  (JNIEnv *env, jclass clazz, jlong jpost)
+{
+    aacd_post_destroy( AACD_JNI_PTR( AACDPost, jpost ));
+}
+
@@ -31,35 +31,403 @@ extern "C" {
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
  * Method:    nativeStart
- * Signature: (ILcom/spoledge/aacdecoder/BufferReader;Lcom/spoledge/aacdecoder/Decoder/Info;)I
+ * Signature: (JLcom/spoledge/aacdecoder/BufferReader;Lcom/spoledge/aacdecoder/Decoder/Info;ZZ)J
  */
-JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStart
-  (JNIEnv *, jobject, jint, jobject, jobject);
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStart
+  (JNIEnv *, jobject, jlong, jobject, jobject, jboolean, jboolean);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeStartFile
+ * Signature: (JLjava/lang/String;Lcom/spoledge/aacdecoder/Decoder/Info;Z)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStartFile
+  (JNIEnv *, jobject, jlong, jstring, jobject, jboolean);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeStartHttp
+ * Signature: (JJLcom/spoledge/aacdecoder/Decoder/Info;Z)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStartHttp
+  (JNIEnv *, jobject, jlong, jlong, jobject, jboolean);
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
  * Method:    nativeDecode
- * Signature: (I[SI)I
+ * Signature: (J[SI)I
  */
 JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecode
-  (JNIEnv *, jobject, jint, jshortArray, jint);
+  (JNIEnv *, jobject, jlong, jshortArray, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecodeCritical
+ * Signature: (J[SI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodeCritical
+  (JNIEnv *, jobject, jlong, jshortArray, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecodeDirect
+ * Signature: (JLjava/nio/ShortBuffer;I)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodeDirect
+  (JNIEnv *, jobject, jlong, jobject, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecodePCM
+ * Signature: (JLjava/lang/Object;II)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodePCM
+  (JNIEnv *, jobject, jlong, jobject, jint, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeDecodeFrames
+ * Signature: (J[SILjava/nio/ByteBuffer;Z)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecodeFrames
+  (JNIEnv *, jobject, jlong, jshortArray, jint, jobject, jboolean);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputStart
+ * Signature: (JLjava/lang/String;Ljava/lang/String;I)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputStart
+  (JNIEnv *, jobject, jlong, jstring, jstring, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputWait
+ * Signature: (JI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputWait
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputBuffered
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputBuffered
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputUnderruns
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputUnderruns
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeOutputStop
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeOutputStop
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeSeek
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeSeek
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeSetQuality
+ * Signature: (JI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeSetQuality
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeSampleRate
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeSampleRate
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativeChannels
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeChannels
+  (JNIEnv *, jobject, jlong);
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
  * Method:    nativeStop
- * Signature: (I)V
+ * Signature: (J)V
  */
 JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeStop
-  (JNIEnv *, jobject, jint);
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativePrewarm
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_spoledge_aacdecoder_Decoder_nativePrewarm
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Decoder
+ * Method:    nativePoolClear
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Decoder_nativePoolClear
+  (JNIEnv *, jclass);
 
 /*
  * Class:     com_spoledge_aacdecoder_Decoder
  * Method:    nativeDecoderGetByName
- * Signature: (Ljava/lang/String;)I
+ * Signature: (Ljava/lang/String;)J
  */
-JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecoderGetByName
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_Decoder_nativeDecoderGetByName
   (JNIEnv *, jclass, jstring);
 
+/* Header for class com_spoledge_aacdecoder_DecoderEngine */
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeCreate
+ * Signature: (I)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeCreate
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeDestroy
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeDestroy
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeOpen
+ * Signature: (JJII)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeOpen
+  (JNIEnv *, jclass, jlong, jlong, jint, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeFeed
+ * Signature: (J[BII)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeFeed
+  (JNIEnv *, jclass, jlong, jbyteArray, jint, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeEof
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeEof
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeRead
+ * Signature: (J[SI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeRead
+  (JNIEnv *, jclass, jlong, jshortArray, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeState
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeState
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeSampleRate
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeSampleRate
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeChannels
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeChannels
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_DecoderEngine
+ * Method:    nativeClose
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_DecoderEngine_nativeClose
+  (JNIEnv *, jclass, jlong);
+
+/* Header for class com_spoledge_aacdecoder_NativeHttpStream */
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeOpen
+ * Signature: (Ljava/lang/String;Z)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeOpen
+  (JNIEnv *, jclass, jstring, jboolean);
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeHeaders
+ * Signature: (J)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeHeaders
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeMetadata
+ * Signature: (J)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeMetadata
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_NativeHttpStream
+ * Method:    nativeClose
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_NativeHttpStream_nativeClose
+  (JNIEnv *, jclass, jlong);
+
+/* Header for class com_spoledge_aacdecoder_Metrics */
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeSnapshot
+ * Signature: ([J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeSnapshot
+  (JNIEnv *, jclass, jlongArray);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeBackend
+ * Signature: (I)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeBackend
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeCount
+ * Signature: (IJ)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeCount
+  (JNIEnv *, jclass, jint, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeRecord
+ * Signature: (IJ)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeRecord
+  (JNIEnv *, jclass, jint, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeReset
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeReset
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     com_spoledge_aacdecoder_Metrics
+ * Method:    nativeSetEnabled
+ * Signature: (Z)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_Metrics_nativeSetEnabled
+  (JNIEnv *, jclass, jboolean);
+
+/* Header for class com_spoledge_aacdecoder_PostProcessor */
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeCreate
+ * Signature: (III)J
+ */
+JNIEXPORT jlong JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeCreate
+  (JNIEnv *, jclass, jint, jint, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeDownmix
+ * Signature: (JFFFZ)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeDownmix
+  (JNIEnv *, jclass, jlong, jfloat, jfloat, jfloat, jboolean);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeChannels
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeChannels
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeRate
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeRate
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeMaxOutput
+ * Signature: (JI)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeMaxOutput
+  (JNIEnv *, jclass, jlong, jint);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeProcess
+ * Signature: (J[SI[S)I
+ */
+JNIEXPORT jint JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeProcess
+  (JNIEnv *, jclass, jlong, jshortArray, jint, jshortArray);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeReset
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeReset
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_spoledge_aacdecoder_PostProcessor
+ * Method:    nativeDestroy
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_spoledge_aacdecoder_PostProcessor_nativeDestroy
+  (JNIEnv *, jclass, jlong);
+
 #ifdef __cplusplus
 }
 #endif
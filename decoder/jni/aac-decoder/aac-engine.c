@@ -0,0 +1,705 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Decoding engine - see aac-engine.h.
+ *
+ * Each stream has its own decoding session (AACDInfo), so the workers
+ * share nothing but the queues. The rings between the owner and the workers
+ * are lock-free (one writer, one reader); a stream is owned by one worker
+ * while it is being processed - guarded by the "sched" word:
+ *
+ *   IDLE -> SCHEDULED       - the stream was pushed to a queue (only one thread wins)
+ *   SCHEDULED -> NOTIFIED   - something changed while the stream is queued or processed
+ *   NOTIFIED -> SCHEDULED   - the worker checks the stream again
+ *   SCHEDULED -> IDLE       - the worker has nothing to do - it must not touch the stream anymore
+ *   any -> CLOSED           - the owner closed the stream; if it was IDLE, the owner pushes it
+ *
+ * The closed stream is freed by the worker which owns it - the owner does not touch it anymore.
+ */
+
+#define AACD_MODULE "Engine"
+
+#include "aac-engine.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The max samples (all channels) produced by one frame (AAC+ stereo).
+ */
+#define AACD_ENGINE_MAX_FRAME   4096
+
+/**
+ * The max frames decoded in one turn - then the worker takes the next stream.
+ */
+#define AACD_ENGINE_QUANTUM     8
+
+/**
+ * The max bytes passed from the input ring to the decoder by one read.
+ */
+#define AACD_ENGINE_CHUNK       16384
+
+/**
+ * The input buffered before the decoder is started (it needs a few frames to sync).
+ */
+#define AACD_ENGINE_START_BYTES 8192
+
+
+#define AACD_SCHED_IDLE         0
+#define AACD_SCHED_SCHEDULED    1
+#define AACD_SCHED_NOTIFIED     2
+#define AACD_SCHED_CLOSED       3
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+/**
+ * Lock-free byte ring - one writer, one reader.
+ * The positions wrap at 2*len, so the full and empty states differ.
+ */
+typedef struct AACDByteRing {
+    unsigned char *data;
+    unsigned long len;
+    unsigned long wpos;
+    unsigned long rpos;
+} AACDByteRing;
+
+
+typedef struct AACDQueue {
+    pthread_mutex_t mutex;
+    AACDStream *head;
+    AACDStream *tail;
+} AACDQueue;
+
+
+struct AACDStream {
+    AACDEngine *engine;
+    AACDDecoder *decoder;
+
+    // set by the worker - it is read by the owner after the state leaves STARTING:
+    AACDInfo *info;
+
+    // the index of the home queue:
+    int home;
+
+    AACDByteRing input;
+    AACDByteRing output;
+
+    // atomic:
+    int sched;
+    int state;
+    int eof;
+
+    // the last read found the input ring empty (worker only):
+    int starved;
+
+    // the queue links (guarded by the queue's mutex):
+    AACDStream *prev;
+    AACDStream *next;
+};
+
+
+struct AACDEngine {
+    int workers;
+    int threadsLen;
+    pthread_t *threads;
+    AACDQueue *queues;
+
+    // the idle workers wait for pending > 0:
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int pending;
+    int stopped;
+
+    // the next home queue (atomic):
+    unsigned long nexthome;
+};
+
+
+typedef struct AACDWorker {
+    AACDEngine *engine;
+    int index;
+} AACDWorker;
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Ring
+ ****************************************************************************************************/
+
+static unsigned long aacd_bring_filled( AACDByteRing *r, unsigned long w, unsigned long rp )
+{
+    return w >= rp ? w - rp : w + 2 * r->len - rp;
+}
+
+
+static unsigned long aacd_bring_advance( AACDByteRing *r, unsigned long pos, unsigned long n )
+{
+    pos += n;
+
+    return pos >= 2 * r->len ? pos - 2 * r->len : pos;
+}
+
+
+static unsigned long aacd_bring_offset( AACDByteRing *r, unsigned long pos )
+{
+    return pos >= r->len ? pos - r->len : pos;
+}
+
+
+/**
+ * Reader or writer: returns the number of bytes in the ring.
+ */
+static unsigned long aacd_bring_used( AACDByteRing *r )
+{
+    return aacd_bring_filled( r, __atomic_load_n( &r->wpos, __ATOMIC_ACQUIRE ),
+                                 __atomic_load_n( &r->rpos, __ATOMIC_ACQUIRE ));
+}
+
+
+/**
+ * Writer: appends up to len bytes.
+ * @return the number of bytes written
+ */
+static unsigned long aacd_bring_write( AACDByteRing *r, const unsigned char *data, unsigned long len )
+{
+    unsigned long w = r->wpos;
+    unsigned long free = r->len - aacd_bring_filled( r, w, __atomic_load_n( &r->rpos, __ATOMIC_ACQUIRE ));
+
+    if (len > free) len = free;
+    if (!len) return 0;
+
+    unsigned long off = aacd_bring_offset( r, w );
+    unsigned long n = r->len - off < len ? r->len - off : len;
+
+    memcpy( r->data + off, data, n );
+    if (n < len) memcpy( r->data, data + n, len - n );
+
+    __atomic_store_n( &r->wpos, aacd_bring_advance( r, w, len ), __ATOMIC_RELEASE );
+
+    return len;
+}
+
+
+/**
+ * Reader: takes up to len bytes.
+ * @return the number of bytes read
+ */
+static unsigned long aacd_bring_read( AACDByteRing *r, unsigned char *data, unsigned long len )
+{
+    unsigned long rp = r->rpos;
+    unsigned long used = aacd_bring_filled( r, __atomic_load_n( &r->wpos, __ATOMIC_ACQUIRE ), rp );
+
+    if (len > used) len = used;
+    if (!len) return 0;
+
+    unsigned long off = aacd_bring_offset( r, rp );
+    unsigned long n = r->len - off < len ? r->len - off : len;
+
+    memcpy( data, r->data + off, n );
+    if (n < len) memcpy( data + n, r->data, len - n );
+
+    __atomic_store_n( &r->rpos, aacd_bring_advance( r, rp, len ), __ATOMIC_RELEASE );
+
+    return len;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Reader
+ ****************************************************************************************************/
+
+static const char* aacd_engine_reader_name()
+{
+    return "Engine";
+}
+
+
+/**
+ * Passes the buffered input to the decoder - never blocks.
+ * @return the number of bytes appended; 0 if the input ring is empty
+ */
+static long aacd_engine_reader_read( AACDInfo *info )
+{
+    AACDStream *s = (AACDStream*) info->reader_ext;
+
+    unsigned long len = aacd_bring_used( &s->input );
+
+    if (len > AACD_ENGINE_CHUNK) len = AACD_ENGINE_CHUNK;
+
+    if (!len)
+    {
+        s->starved = 1;
+        return 0;
+    }
+
+    aacd_bring_read( &s->input, aacd_prepare_buffer( info, len ), len );
+
+    return (long) len;
+}
+
+
+static AACDReader aacd_engine_reader = {
+    aacd_engine_reader_name,
+    aacd_engine_reader_read,
+    NULL,
+    NULL
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Scheduling
+ ****************************************************************************************************/
+
+/**
+ * Pushes the stream to its home queue and wakes up a worker.
+ */
+static void aacd_engine_push( AACDStream *s )
+{
+    AACDEngine *engine = s->engine;
+    AACDQueue *q = engine->queues + s->home;
+
+    pthread_mutex_lock( &q->mutex );
+
+    s->next = NULL;
+    s->prev = q->tail;
+
+    if (q->tail) q->tail->next = s;
+    else q->head = s;
+
+    q->tail = s;
+
+    pthread_mutex_unlock( &q->mutex );
+
+    pthread_mutex_lock( &engine->mutex );
+    engine->pending++;
+    pthread_cond_signal( &engine->cond );
+    pthread_mutex_unlock( &engine->mutex );
+}
+
+
+/**
+ * Takes the stream from the head (own queue) or the tail (stealing).
+ */
+static AACDStream* aacd_engine_take( AACDEngine *engine, AACDQueue *q, int steal )
+{
+    pthread_mutex_lock( &q->mutex );
+
+    AACDStream *s = steal ? q->tail : q->head;
+
+    if (s)
+    {
+        if (s->prev) s->prev->next = s->next;
+        else q->head = s->next;
+
+        if (s->next) s->next->prev = s->prev;
+        else q->tail = s->prev;
+
+        s->prev = s->next = NULL;
+    }
+
+    pthread_mutex_unlock( &q->mutex );
+
+    if (s)
+    {
+        pthread_mutex_lock( &engine->mutex );
+        engine->pending--;
+        pthread_mutex_unlock( &engine->mutex );
+    }
+
+    return s;
+}
+
+
+/**
+ * Schedules the stream unless it is already queued or processed -
+ * then the worker is just notified to check the stream again.
+ */
+static void aacd_engine_schedule( AACDStream *s )
+{
+    int sched = __atomic_load_n( &s->sched, __ATOMIC_SEQ_CST );
+
+    for (;;)
+    {
+        if (sched == AACD_SCHED_NOTIFIED || sched == AACD_SCHED_CLOSED) return;
+
+        int next = sched == AACD_SCHED_IDLE ? AACD_SCHED_SCHEDULED : AACD_SCHED_NOTIFIED;
+
+        if (__atomic_compare_exchange_n( &s->sched, &sched, next, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+        {
+            if (next == AACD_SCHED_SCHEDULED) aacd_engine_push( s );
+            return;
+        }
+    }
+}
+
+
+/**
+ * Worker: returns true if the stream can make progress.
+ */
+static int aacd_engine_runnable( AACDStream *s )
+{
+    if (__atomic_load_n( &s->sched, __ATOMIC_ACQUIRE ) == AACD_SCHED_CLOSED) return 0;
+
+    int state = __atomic_load_n( &s->state, __ATOMIC_ACQUIRE );
+
+    if (state == AACD_STREAM_FINISHED || state == AACD_STREAM_ERROR) return 0;
+
+    unsigned long input = aacd_bring_used( &s->input );
+    int eof = __atomic_load_n( &s->eof, __ATOMIC_ACQUIRE );
+
+    if (state == AACD_STREAM_STARTING) return eof || input >= AACD_ENGINE_START_BYTES;
+
+    if (s->output.len - aacd_bring_used( &s->output ) < AACD_ENGINE_MAX_FRAME * sizeof( short )) return 0;
+
+    return !s->starved || input || eof;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Worker
+ ****************************************************************************************************/
+
+static void aacd_engine_free( AACDStream *s )
+{
+    if (s->info) aacd_stop( s->info );
+
+    free( s->input.data );
+    free( s->output.data );
+    free( s );
+}
+
+
+/**
+ * Worker: starts the decoder.
+ */
+static void aacd_engine_start( AACDStream *s )
+{
+    if (!aacd_bring_used( &s->input ))
+    {
+        AACD_WARN( "start() no input" );
+        __atomic_store_n( &s->state, AACD_STREAM_ERROR, __ATOMIC_RELEASE );
+        return;
+    }
+
+    // the container (MP4) is parsed by blocking reads - the reader never blocks:
+    if (s->decoder->open)
+    {
+        AACD_ERROR( "start() decoder %s not supported by the engine", s->decoder->name());
+        __atomic_store_n( &s->state, AACD_STREAM_ERROR, __ATOMIC_RELEASE );
+        return;
+    }
+
+    s->info = aacd_start( s->decoder, &aacd_engine_reader, s );
+
+    __atomic_store_n( &s->state, s->info ? AACD_STREAM_RUNNING : AACD_STREAM_ERROR, __ATOMIC_RELEASE );
+}
+
+
+/**
+ * Worker: decodes up to one quantum of frames.
+ */
+static void aacd_engine_decode( AACDStream *s, short *scratch )
+{
+    AACDInfo *info = s->info;
+
+    unsigned long space = (s->output.len - aacd_bring_used( &s->output )) / sizeof( short );
+    int outLen = space < AACD_ENGINE_QUANTUM * AACD_ENGINE_MAX_FRAME ? (int) space : AACD_ENGINE_QUANTUM * AACD_ENGINE_MAX_FRAME;
+
+    // the frames stored by start() must not be dropped:
+    if (info->first_pending && outLen < (int) info->frame_samples) return;
+
+    int cont = 0;
+    int more;
+
+    s->starved = 0;
+
+    while ((more = aacd_decode_noread( info, scratch, outLen, cont )))
+    {
+        if (aacd_read( info ) <= 0) break;
+
+        cont = 1;
+    }
+
+    if (info->round_samples) aacd_bring_write( &s->output, (unsigned char*) scratch, info->round_samples * sizeof( short ));
+
+    // EOF is checked before the input - the owner feeds first:
+    int eof = __atomic_load_n( &s->eof, __ATOMIC_ACQUIRE );
+
+    if ((more && eof && !aacd_bring_used( &s->input )) || (!more && !info->round_samples))
+    {
+        AACD_DEBUG( "decode() finished" );
+        __atomic_store_n( &s->state, AACD_STREAM_FINISHED, __ATOMIC_RELEASE );
+    }
+}
+
+
+/**
+ * Worker: processes the stream taken from a queue.
+ * @return 1 if the stream should be pushed back to the queue
+ */
+static int aacd_engine_process( AACDStream *s, short *scratch )
+{
+    for (;;)
+    {
+        int sched = AACD_SCHED_NOTIFIED;
+
+        // the notification is consumed - any change from now on notifies again:
+        if (!__atomic_compare_exchange_n( &s->sched, &sched, AACD_SCHED_SCHEDULED, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST )
+                && sched == AACD_SCHED_CLOSED)
+        {
+            aacd_engine_free( s );
+            return 0;
+        }
+
+        if (aacd_engine_runnable( s ))
+        {
+            if (!s->info) aacd_engine_start( s );
+            else aacd_engine_decode( s, scratch );
+
+            // let the other streams run:
+            if (aacd_engine_runnable( s )) return 1;
+        }
+
+        sched = AACD_SCHED_SCHEDULED;
+
+        // nothing to do - unless notified meanwhile:
+        if (__atomic_compare_exchange_n( &s->sched, &sched, AACD_SCHED_IDLE, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST )) return 0;
+    }
+}
+
+
+static void* aacd_engine_worker( void *data )
+{
+    AACDWorker *worker = (AACDWorker*) data;
+    AACDEngine *engine = worker->engine;
+    int index = worker->index;
+
+    free( worker );
+
+    short *scratch = (short*) malloc( AACD_ENGINE_QUANTUM * AACD_ENGINE_MAX_FRAME * sizeof( short ));
+
+    for (;;)
+    {
+        AACDStream *s = aacd_engine_take( engine, engine->queues + index, 0 );
+        int i;
+
+        for (i=1; !s && i < engine->workers; i++)
+        {
+            s = aacd_engine_take( engine, engine->queues + (index + i) % engine->workers, 1 );
+        }
+
+        if (s)
+        {
+            if (aacd_engine_process( s, scratch )) aacd_engine_push( s );
+            continue;
+        }
+
+        pthread_mutex_lock( &engine->mutex );
+
+        while (!engine->pending && !engine->stopped) pthread_cond_wait( &engine->cond, &engine->mutex );
+
+        int stop = !engine->pending && engine->stopped;
+
+        pthread_mutex_unlock( &engine->mutex );
+
+        if (stop) break;
+    }
+
+    free( scratch );
+
+    return NULL;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Engine
+ ****************************************************************************************************/
+
+/**
+ * Creates the engine and starts the workers.
+ * @return the engine or NULL on error
+ */
+AACDEngine* aacd_engine_create( int workers )
+{
+    if (workers < 1) workers = 1;
+
+    AACDEngine *engine = (AACDEngine*) calloc( 1, sizeof( struct AACDEngine ));
+
+    engine->threads = (pthread_t*) calloc( workers, sizeof( pthread_t ));
+    engine->queues = (AACDQueue*) calloc( workers, sizeof( AACDQueue ));
+
+    pthread_mutex_init( &engine->mutex, NULL );
+    pthread_cond_init( &engine->cond, NULL );
+
+    int i;
+
+    // the queues of the workers which failed to start are drained by stealing:
+    engine->workers = workers;
+
+    for (i=0; i < workers; i++) pthread_mutex_init( &engine->queues[i].mutex, NULL );
+
+    for (i=0; i < workers; i++)
+    {
+        AACDWorker *worker = (AACDWorker*) malloc( sizeof( AACDWorker ));
+        worker->engine = engine;
+        worker->index = i;
+
+        if (pthread_create( engine->threads + i, NULL, aacd_engine_worker, worker ))
+        {
+            AACD_ERROR( "create() cannot start worker %d", i );
+            free( worker );
+            break;
+        }
+    }
+
+    engine->threadsLen = i;
+
+    if (!i)
+    {
+        aacd_engine_destroy( engine );
+        return NULL;
+    }
+
+    AACD_DEBUG( "create() started %d workers", engine->threadsLen );
+
+    return engine;
+}
+
+
+/**
+ * Stops the workers and frees the engine.
+ * The workers free the streams closed meanwhile before they exit.
+ */
+void aacd_engine_destroy( AACDEngine *engine )
+{
+    int i;
+
+    pthread_mutex_lock( &engine->mutex );
+    engine->stopped = 1;
+    pthread_cond_broadcast( &engine->cond );
+    pthread_mutex_unlock( &engine->mutex );
+
+    for (i=0; i < engine->threadsLen; i++) pthread_join( engine->threads[i], NULL );
+    for (i=0; i < engine->workers; i++) pthread_mutex_destroy( &engine->queues[i].mutex );
+
+    pthread_cond_destroy( &engine->cond );
+    pthread_mutex_destroy( &engine->mutex );
+
+    free( engine->queues );
+    free( engine->threads );
+    free( engine );
+}
+
+
+/**
+ * Opens a new stream.
+ * @param inputCapacity the capacity of the input ring in bytes
+ * @param outputCapacity the capacity of the output ring in samples
+ */
+AACDStream* aacd_engine_open( AACDEngine *engine, AACDDecoder *decoder,
+                              unsigned long inputCapacity, unsigned long outputCapacity )
+{
+    // at least one chunk and a few frames:
+    if (inputCapacity < 2 * AACD_ENGINE_CHUNK) inputCapacity = 2 * AACD_ENGINE_CHUNK;
+    if (outputCapacity < 2 * AACD_ENGINE_MAX_FRAME) outputCapacity = 2 * AACD_ENGINE_MAX_FRAME;
+
+    AACDStream *s = (AACDStream*) calloc( 1, sizeof( struct AACDStream ));
+
+    s->engine = engine;
+    s->decoder = decoder;
+    s->home = (int) (__atomic_fetch_add( &engine->nexthome, 1, __ATOMIC_RELAXED ) % engine->workers);
+
+    s->input.len = inputCapacity;
+    s->input.data = (unsigned char*) malloc( s->input.len );
+
+    s->output.len = outputCapacity * sizeof( short );
+    s->output.data = (unsigned char*) malloc( s->output.len );
+
+    return s;
+}
+
+
+/**
+ * Appends the input data - never blocks.
+ * @return the number of bytes accepted
+ */
+unsigned long aacd_engine_feed( AACDStream *s, const unsigned char *data, unsigned long len )
+{
+    unsigned long n = aacd_bring_write( &s->input, data, len );
+
+    if (n) aacd_engine_schedule( s );
+
+    return n;
+}
+
+
+/**
+ * Marks the end of the input.
+ */
+void aacd_engine_eof( AACDStream *s )
+{
+    __atomic_store_n( &s->eof, 1, __ATOMIC_SEQ_CST );
+
+    aacd_engine_schedule( s );
+}
+
+
+/**
+ * Takes the decoded samples - never blocks.
+ * @return the number of samples copied
+ */
+unsigned long aacd_engine_pull( AACDStream *s, short *samples, unsigned long len )
+{
+    unsigned long n = aacd_bring_read( &s->output, (unsigned char*) samples, len * sizeof( short ));
+
+    if (n) aacd_engine_schedule( s );
+
+    return n / sizeof( short );
+}
+
+
+int aacd_engine_state( AACDStream *s )
+{
+    return __atomic_load_n( &s->state, __ATOMIC_ACQUIRE );
+}
+
+
+AACDInfo* aacd_engine_info( AACDStream *s )
+{
+    return aacd_engine_state( s ) == AACD_STREAM_STARTING ? NULL : s->info;
+}
+
+
+/**
+ * Closes the stream - it is freed by the worker.
+ */
+void aacd_engine_close( AACDStream *s )
+{
+    // queued or processed - the worker frees it:
+    if (__atomic_exchange_n( &s->sched, AACD_SCHED_CLOSED, __ATOMIC_SEQ_CST ) != AACD_SCHED_IDLE) return;
+
+    aacd_engine_push( s );
+}
+
@@ -0,0 +1,130 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAC_ENGINE_H
+#define AAC_ENGINE_H
+
+#include "aac-common.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Decoding engine - many streams decoded by a fixed pool of worker threads.
+ *
+ * The streams are not read by the engine - the owner pushes the input
+ * and pulls the decoded samples (both non-blocking):
+ *
+ *   owner:   aacd_engine_feed() -> input ring -> worker: aacd_decode_noread() -> output ring
+ *   owner:   aacd_engine_pull() <- output ring
+ *
+ * A stream is scheduled whenever it can make progress (new input, free output space).
+ * Each worker has its own queue - the streams stay on their home worker,
+ * but an idle worker steals them from the others.
+ * A stream is processed by at most one worker at a time.
+ */
+typedef struct AACDEngine AACDEngine;
+
+typedef struct AACDStream AACDStream;
+
+
+/**
+ * The states of a stream.
+ */
+#define AACD_STREAM_STARTING    0
+#define AACD_STREAM_RUNNING     1
+#define AACD_STREAM_FINISHED    2
+#define AACD_STREAM_ERROR       3
+
+
+/**
+ * Creates the engine and starts the workers.
+ * @param workers the number of worker threads
+ * @return the engine or NULL on error
+ */
+AACDEngine* aacd_engine_create( int workers );
+
+
+/**
+ * Stops the workers and frees the engine.
+ * All the streams must be closed before.
+ */
+void aacd_engine_destroy( AACDEngine *engine );
+
+
+/**
+ * Opens a new stream.
+ * The decoders parsing a container before the first frame (OpenCORE-MP4) are not supported -
+ * the stream fails to start.
+ * @param inputCapacity the capacity of the input ring in bytes
+ * @param outputCapacity the capacity of the output ring in samples
+ */
+AACDStream* aacd_engine_open( AACDEngine *engine, AACDDecoder *decoder,
+                              unsigned long inputCapacity, unsigned long outputCapacity );
+
+
+/**
+ * Appends the input data - never blocks.
+ * @return the number of bytes accepted (less than len if the input ring is full)
+ */
+unsigned long aacd_engine_feed( AACDStream *stream, const unsigned char *data, unsigned long len );
+
+
+/**
+ * Marks the end of the input.
+ */
+void aacd_engine_eof( AACDStream *stream );
+
+
+/**
+ * Takes the decoded samples - never blocks.
+ * @return the number of samples copied
+ */
+unsigned long aacd_engine_pull( AACDStream *stream, short *samples, unsigned long len );
+
+
+/**
+ * Returns the state - see AACD_STREAM_* constants.
+ * FINISHED means that all the input was decoded (but not necessarily pulled).
+ */
+int aacd_engine_state( AACDStream *stream );
+
+
+/**
+ * Returns the decoding session - only if the stream is not in the STARTING state.
+ * Only the stream properties (samplerate, channels) can be read.
+ */
+AACDInfo* aacd_engine_info( AACDStream *stream );
+
+
+/**
+ * Closes the stream - it is freed by the engine asynchronously.
+ * The stream cannot be used after this call.
+ */
+void aacd_engine_close( AACDStream *stream );
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
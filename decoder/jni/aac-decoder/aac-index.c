@@ -0,0 +1,275 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Frame index and the MP3 table of contents (Xing / VBRI).
+ *
+ * The index records the stream offset and the sample position of every
+ * AACD_INDEX_STEP-th frame. It is extended while decoding and while walking
+ * the frame headers when seeking forward, so it always covers a contiguous
+ * area from the first frame. The TOC gives only approximate positions,
+ * but it allows to jump far beyond the indexed area without reading the stream.
+ */
+
+#define AACD_MODULE "Index"
+
+#include "aac-common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Every n-th frame is recorded.
+ */
+#define AACD_INDEX_STEP     16
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Index
+ ****************************************************************************************************/
+
+/**
+ * Enables the frame index - must be called after aacd_start() and before the first decoding round.
+ */
+void aacd_index_enable( AACDInfo *info )
+{
+    if (info->index) return;
+
+    AACDIndex *idx = (AACDIndex*) calloc( 1, sizeof( struct AACDIndex ));
+
+    idx->sync = 1;
+    idx->next_offset = info->stream_pos - info->frame_bytesconsumed;
+    idx->next_sample = 0;
+
+    info->index = idx;
+
+    // the frame decoded by start():
+    aacd_index_frame( info, idx->next_offset, info->frame_bytesconsumed, 0 );
+}
+
+
+/**
+ * Records the frame if it extends the indexed area.
+ */
+void aacd_index_frame( AACDInfo *info, unsigned long offset, unsigned long len, unsigned long sample )
+{
+    AACDIndex *idx = info->index;
+
+    if (!idx || !idx->sync || offset < idx->next_offset) return;
+
+    if (idx->frames++ % AACD_INDEX_STEP == 0)
+    {
+        if (idx->len == idx->cap)
+        {
+            idx->cap = idx->cap ? idx->cap * 2 : 256;
+            idx->points = (AACDSeekPoint*) realloc( idx->points, sizeof( AACDSeekPoint ) * idx->cap );
+        }
+
+        idx->points[ idx->len ].offset = offset;
+        idx->points[ idx->len ].sample = sample;
+        idx->len++;
+    }
+
+    idx->next_offset = offset + len;
+    idx->next_sample = sample + info->frame_samples / info->channels;
+}
+
+
+/**
+ * Returns the last seek point having the sample position lower or equal to the sample.
+ */
+AACDSeekPoint* aacd_index_find( AACDSeekPoint *points, unsigned long len, unsigned long sample )
+{
+    if (!len || points[0].sample > sample) return NULL;
+
+    unsigned long lo = 0;
+    unsigned long hi = len;
+
+    while (hi - lo > 1)
+    {
+        unsigned long mid = (lo + hi) / 2;
+
+        if (points[ mid ].sample <= sample) lo = mid;
+        else hi = mid;
+    }
+
+    return points + lo;
+}
+
+
+/**
+ * Frees the index and the TOC.
+ */
+void aacd_index_destroy( AACDInfo *info )
+{
+    if (info->index)
+    {
+        if (info->index->points) free( info->index->points );
+
+        free( info->index );
+        info->index = NULL;
+    }
+
+    if (info->toc)
+    {
+        free( info->toc );
+        info->toc = NULL;
+        info->toclen = 0;
+    }
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - TOC
+ ****************************************************************************************************/
+
+static unsigned long aacd_be( const unsigned char *p, int len )
+{
+    unsigned long ret = 0;
+
+    while (len--) ret = (ret << 8) | *p++;
+
+    return ret;
+}
+
+
+/**
+ * Returns the number of samples per channel of the MP3 frame.
+ */
+static unsigned long aacd_mp3_frame_samples( const unsigned char *h )
+{
+    int lsf = ((h[1] >> 3) & 0x03) != 3;
+    int layer = (h[1] >> 1) & 0x03;
+
+    if (layer == 3) return 384;
+    if (layer == 1 && lsf) return 576;
+
+    return 1152;
+}
+
+
+/**
+ * Parses the Xing / Info tag.
+ * @return 1 if found
+ */
+static int aacd_toc_xing( AACDInfo *info, const unsigned char *frame, int len, unsigned long offset )
+{
+    int lsf = ((frame[1] >> 3) & 0x03) != 3;
+    int mono = (frame[3] >> 6) == 3;
+    int pos = 4 + (lsf ? (mono ? 9 : 17) : (mono ? 17 : 32));
+
+    if (pos + 8 > len || (memcmp( frame + pos, "Xing", 4 ) && memcmp( frame + pos, "Info", 4 ))) return 0;
+
+    unsigned long flags = aacd_be( frame + pos + 4, 4 );
+    unsigned long frames = 0;
+    unsigned long bytes = 0;
+
+    pos += 8;
+
+    if (flags & 0x01)
+    {
+        if (pos + 4 > len) return 0;
+        frames = aacd_be( frame + pos, 4 );
+        pos += 4;
+    }
+
+    if (flags & 0x02)
+    {
+        if (pos + 4 > len) return 0;
+        bytes = aacd_be( frame + pos, 4 );
+        pos += 4;
+    }
+
+    info->duration = frames * aacd_mp3_frame_samples( frame );
+
+    if (!(flags & 0x04) || !frames || !bytes || pos + 100 > len) return 1;
+
+    int i;
+
+    info->toc = (AACDSeekPoint*) malloc( sizeof( AACDSeekPoint ) * 100 );
+    info->toclen = 100;
+
+    for (i=0; i < 100; i++)
+    {
+        info->toc[i].sample = (unsigned long) ((unsigned long long) info->duration * i / 100);
+        info->toc[i].offset = offset + (unsigned long) ((unsigned long long) bytes * frame[ pos + i ] / 256);
+    }
+
+    AACD_DEBUG( "toc_xing() frames=%lu, bytes=%lu", frames, bytes );
+
+    return 1;
+}
+
+
+/**
+ * Parses the VBRI tag - always 32 bytes after the header.
+ * @return 1 if found
+ */
+static int aacd_toc_vbri( AACDInfo *info, const unsigned char *frame, int len, unsigned long offset )
+{
+    const unsigned char *p = frame + 36;
+
+    if (36 + 26 > len || memcmp( p, "VBRI", 4 )) return 0;
+
+    unsigned long frames = aacd_be( p + 14, 4 );
+    unsigned long entries = aacd_be( p + 18, 2 );
+    unsigned long scale = aacd_be( p + 20, 2 );
+    unsigned long entrySize = aacd_be( p + 22, 2 );
+    unsigned long framesPerEntry = aacd_be( p + 24, 2 );
+    unsigned long spf = aacd_mp3_frame_samples( frame );
+
+    info->duration = frames * spf;
+
+    if (!entries || entrySize < 1 || entrySize > 4 || 36 + 26 + entries * entrySize > (unsigned long) len) return 1;
+
+    info->toc = (AACDSeekPoint*) malloc( sizeof( AACDSeekPoint ) * (entries + 1));
+    info->toclen = entries + 1;
+
+    // the first entry starts after the VBRI frame:
+    unsigned long pos = offset + aacd_mp3_header( frame, len );
+    unsigned long i;
+
+    for (i=0; i <= entries; i++)
+    {
+        info->toc[i].sample = i * framesPerEntry * spf;
+        info->toc[i].offset = pos;
+
+        if (i < entries) pos += aacd_be( p + 26 + i * entrySize, entrySize ) * scale;
+    }
+
+    AACD_DEBUG( "toc_vbri() frames=%lu, entries=%lu", frames, entries );
+
+    return 1;
+}
+
+
+/**
+ * Parses the Xing / VBRI tag of the first MP3 frame if present.
+ * Fills the TOC and the duration.
+ * @param offset the stream offset of the frame
+ */
+void aacd_toc_parse( AACDInfo *info, const unsigned char *frame, int len, unsigned long offset )
+{
+    if (aacd_mp3_header( frame, len ) <= 0) return;
+
+    if (!aacd_toc_xing( info, frame, len, offset )) aacd_toc_vbri( info, frame, len, offset );
+}
+
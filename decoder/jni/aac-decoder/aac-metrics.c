@@ -0,0 +1,266 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define AACD_MODULE "Metrics"
+
+#include "aac-metrics.h"
+
+#include <string.h>
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+typedef struct AACDHistogram {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long buckets[ AACD_HIST_BUCKETS ];
+} AACDHistogram;
+
+
+typedef struct AACDMetrics {
+    unsigned long long counters[ AACD_METRIC_COUNT ];
+    AACDHistogram hists[ AACD_HIST_COUNT ];
+
+    // the backends are assigned to the slots by their first frame:
+    AACDDecoder *backends[ AACD_METRICS_BACKENDS ];
+    AACDHistogram frames[ AACD_METRICS_BACKENDS ];
+} AACDMetrics;
+
+
+int aacd_metrics_enabled = 1;
+
+static AACDMetrics aacd_metrics;
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Returns the bucket of the value - the exponent and the AACD_HIST_SUB_BITS
+ * most significant bits below the leading one.
+ */
+static int aacd_metrics_bucket( unsigned long value )
+{
+    unsigned int v = value > 0xffffffffUL ? 0xffffffffU : (unsigned int) value;
+
+    if (v < AACD_HIST_SUB) return (int) v;
+
+    int e = 31 - __builtin_clz( v );
+
+    return (e - AACD_HIST_SUB_BITS + 1) * AACD_HIST_SUB + (int) ((v >> (e - AACD_HIST_SUB_BITS)) & (AACD_HIST_SUB - 1));
+}
+
+
+static void aacd_metrics_hist( AACDHistogram *h, unsigned long value )
+{
+    __atomic_fetch_add( &h->buckets[ aacd_metrics_bucket( value ) ], 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &h->count, 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &h->sum, value, __ATOMIC_RELAXED );
+
+    unsigned long long max = __atomic_load_n( &h->max, __ATOMIC_RELAXED );
+
+    while (value > max && !__atomic_compare_exchange_n( &h->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ));
+}
+
+
+static unsigned long long* aacd_metrics_hist_copy( AACDHistogram *h, unsigned long long *dest )
+{
+    int i;
+
+    *dest++ = __atomic_load_n( &h->count, __ATOMIC_RELAXED );
+    *dest++ = __atomic_load_n( &h->sum, __ATOMIC_RELAXED );
+    *dest++ = __atomic_load_n( &h->max, __ATOMIC_RELAXED );
+
+    for (i=0; i < AACD_HIST_BUCKETS; i++) *dest++ = __atomic_load_n( &h->buckets[i], __ATOMIC_RELAXED );
+
+    return dest;
+}
+
+
+/**
+ * Adds to the counter.
+ */
+void aacd_metrics_count( int counter, unsigned long long delta )
+{
+    if (!__atomic_load_n( &aacd_metrics_enabled, __ATOMIC_RELAXED )) return;
+
+    __atomic_fetch_add( &aacd_metrics.counters[ counter ], delta, __ATOMIC_RELAXED );
+}
+
+
+/**
+ * Records the value into the histogram.
+ */
+void aacd_metrics_record( int hist, unsigned long value )
+{
+    if (!__atomic_load_n( &aacd_metrics_enabled, __ATOMIC_RELAXED )) return;
+
+    aacd_metrics_hist( &aacd_metrics.hists[ hist ], value );
+}
+
+
+/**
+ * Records the time elapsed since t0 into the histogram.
+ * @return the current time
+ */
+unsigned long aacd_metrics_since( int hist, unsigned long t0 )
+{
+    // the recording was disabled when t0 was taken:
+    if (!t0) return 0;
+
+    unsigned long now = aacd_metrics_now();
+
+    if (now) aacd_metrics_hist( &aacd_metrics.hists[ hist ], now - t0 );
+
+    return now;
+}
+
+
+/**
+ * Records the decoding time of one frame (since t0) into the histogram of the backend.
+ */
+void aacd_metrics_frame( AACDDecoder *decoder, unsigned long t0 )
+{
+    unsigned long now = t0 ? aacd_metrics_now() : 0;
+
+    if (!now) return;
+
+    unsigned long us = now - t0;
+    int i;
+
+    for (i=0; i < AACD_METRICS_BACKENDS; i++)
+    {
+        AACDDecoder *d = __atomic_load_n( &aacd_metrics.backends[i], __ATOMIC_ACQUIRE );
+
+        // a free slot - it can be taken by another thread meanwhile:
+        if (!d && __atomic_compare_exchange_n( &aacd_metrics.backends[i], &d, decoder, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )) d = decoder;
+
+        if (d == decoder)
+        {
+            aacd_metrics_hist( &aacd_metrics.frames[i], us );
+            return;
+        }
+    }
+}
+
+
+/**
+ * Copies the registry - see aac-metrics.h.
+ * @return the number of values stored or -1 if dest is too short
+ */
+int aacd_metrics_snapshot( unsigned long long *dest, int len )
+{
+    if (len < AACD_METRICS_SNAPSHOT) return -1;
+
+    unsigned long long *p = dest;
+    int i;
+
+    for (i=0; i < AACD_METRIC_COUNT; i++) *p++ = __atomic_load_n( &aacd_metrics.counters[i], __ATOMIC_RELAXED );
+
+    unsigned long long backends = 0;
+
+    while (backends < AACD_METRICS_BACKENDS && __atomic_load_n( &aacd_metrics.backends[ backends ], __ATOMIC_ACQUIRE )) backends++;
+
+    *p++ = backends;
+
+    for (i=0; i < AACD_HIST_COUNT; i++) p = aacd_metrics_hist_copy( &aacd_metrics.hists[i], p );
+    for (i=0; i < AACD_METRICS_BACKENDS; i++) p = aacd_metrics_hist_copy( &aacd_metrics.frames[i], p );
+
+    return (int) (p - dest);
+}
+
+
+/**
+ * Returns the name of the backend or NULL if not used.
+ */
+const char* aacd_metrics_backend( int index )
+{
+    if (index < 0 || index >= AACD_METRICS_BACKENDS) return NULL;
+
+    AACDDecoder *d = __atomic_load_n( &aacd_metrics.backends[ index ], __ATOMIC_ACQUIRE );
+
+    return d ? d->name() : NULL;
+}
+
+
+/**
+ * Returns the lowest value of the bucket.
+ */
+unsigned long long aacd_metrics_bucket_low( int bucket )
+{
+    if (bucket < AACD_HIST_SUB) return (unsigned long long) bucket;
+
+    int e = bucket / AACD_HIST_SUB + AACD_HIST_SUB_BITS - 1;
+
+    return (unsigned long long) (AACD_HIST_SUB + bucket % AACD_HIST_SUB) << (e - AACD_HIST_SUB_BITS);
+}
+
+
+/**
+ * Returns the value at the percentile - the middle of the bucket containing it.
+ */
+unsigned long long aacd_metrics_percentile( const unsigned long long *hist, double percentile )
+{
+    unsigned long long count = hist[0];
+
+    if (!count) return 0;
+
+    unsigned long long rank = (unsigned long long) (percentile * count / 100 + 0.5);
+    unsigned long long seen = 0;
+    int i;
+
+    if (rank < 1) rank = 1;
+
+    for (i=0; i < AACD_HIST_BUCKETS; i++)
+    {
+        seen += hist[ 3 + i ];
+
+        if (seen >= rank)
+        {
+            unsigned long long lo = aacd_metrics_bucket_low( i );
+            unsigned long long hi = i + 1 < AACD_HIST_BUCKETS ? aacd_metrics_bucket_low( i + 1 ) : lo;
+            unsigned long long mid = lo + (hi - lo) / 2;
+
+            // the max is exact:
+            return mid < hist[2] ? mid : hist[2];
+        }
+    }
+
+    return hist[2];
+}
+
+
+/**
+ * Clears the counters and the histograms - the backends keep their slots.
+ * The values recorded meanwhile by other threads may be partially lost.
+ */
+void aacd_metrics_reset()
+{
+    int i;
+
+    for (i=0; i < AACD_METRIC_COUNT; i++) __atomic_store_n( &aacd_metrics.counters[i], 0, __ATOMIC_RELAXED );
+
+    for (i=0; i < AACD_HIST_COUNT; i++) memset( &aacd_metrics.hists[i], 0, sizeof( AACDHistogram ));
+    for (i=0; i < AACD_METRICS_BACKENDS; i++) memset( &aacd_metrics.frames[i], 0, sizeof( AACDHistogram ));
+}
@@ -0,0 +1,181 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAC_METRICS_H
+#define AAC_METRICS_H
+
+#include "aac-common.h"
+
+#include <time.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Process-wide metrics registry - lock-free counters and log-linear (HDR style) histograms.
+ * All the decoding sessions and threads record into the same registry by relaxed atomic
+ * additions; nothing is allocated and no lock is taken on the hot path.
+ * The registry is read by aacd_metrics_snapshot() - the values of one snapshot
+ * are not mutually consistent, but each of them is exact.
+ *
+ * The histogram buckets have AACD_HIST_SUB_BITS significant bits - the relative error
+ * of the percentiles is at most 1/AACD_HIST_SUB (12.5 %) over the whole 32-bit range.
+ */
+
+
+/**
+ * Counters. The layout is shared with Java (Metrics).
+ */
+#define AACD_METRIC_FRAMES          0   // decoded frames
+#define AACD_METRIC_BYTES           1   // bytes consumed by the decoded frames
+#define AACD_METRIC_RESYNCS         2   // frames failed to decode - the stream was resynced
+#define AACD_METRIC_SKIPPED         3   // bytes skipped when searching for the sync word
+#define AACD_METRIC_READS           4   // reader calls
+#define AACD_METRIC_STARVED         5   // reader calls blocked for AACD_METRICS_STARVED_US at least
+#define AACD_METRIC_OUT_UNDERRUNS   6   // native output pulls not satisfied
+#define AACD_METRIC_AT_UNDERRUNS    7   // AudioTrack ran dry - recorded by Java (PCMFeed)
+#define AACD_METRIC_IN_UNDERRUNS    8   // jitter buffer underruns - recorded by Java (BufferReader)
+
+#define AACD_METRIC_COUNT           9
+
+
+/**
+ * Histograms. The layout is shared with Java (Metrics).
+ * The per-frame decoding times of each backend follow them - see aacd_metrics_frame().
+ */
+#define AACD_HIST_READ              0   // time blocked in the reader (us)
+#define AACD_HIST_JNI               1   // time of the JNI transfers - arrays, fields (us)
+#define AACD_HIST_ROUND             2   // time of a decoding round (us)
+#define AACD_HIST_PCM_QUEUE         3   // PCM buffers queued to the AudioTrack - recorded by Java
+
+#define AACD_HIST_COUNT             4
+
+/**
+ * The max number of the backends (decoders) with their own frame histogram.
+ */
+#define AACD_METRICS_BACKENDS       8
+
+#define AACD_HIST_SUB_BITS          3
+#define AACD_HIST_SUB               (1 << AACD_HIST_SUB_BITS)
+#define AACD_HIST_BUCKETS           ((32 - AACD_HIST_SUB_BITS + 1) * AACD_HIST_SUB)
+
+/**
+ * The size of one histogram in the snapshot: count, sum, max and the buckets.
+ */
+#define AACD_HIST_SNAPSHOT          (3 + AACD_HIST_BUCKETS)
+
+/**
+ * The size of the whole snapshot.
+ */
+#define AACD_METRICS_SNAPSHOT       (AACD_METRIC_COUNT + 1 + (AACD_HIST_COUNT + AACD_METRICS_BACKENDS) * AACD_HIST_SNAPSHOT)
+
+/**
+ * The reader call blocking at least this long is counted as starved.
+ */
+#define AACD_METRICS_STARVED_US     10000
+
+
+/**
+ * Recording is enabled (by default) - disabling it makes all the calls no-ops.
+ */
+extern int aacd_metrics_enabled;
+
+
+/**
+ * Returns the current time in microseconds or 0 if the recording is disabled.
+ */
+static inline unsigned long aacd_metrics_now()
+{
+    if (!__atomic_load_n( &aacd_metrics_enabled, __ATOMIC_RELAXED )) return 0;
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (unsigned long) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+
+/**
+ * Adds to the counter.
+ */
+void aacd_metrics_count( int counter, unsigned long long delta );
+
+
+/**
+ * Records the value into the histogram.
+ */
+void aacd_metrics_record( int hist, unsigned long value );
+
+
+/**
+ * Records the time elapsed since t0 (returned by aacd_metrics_now()) into the histogram.
+ * @return the current time (can be passed as t0 of the next call)
+ */
+unsigned long aacd_metrics_since( int hist, unsigned long t0 );
+
+
+/**
+ * Records the decoding time of one frame (since t0) into the histogram of the backend.
+ */
+void aacd_metrics_frame( AACDDecoder *decoder, unsigned long t0 );
+
+
+/**
+ * Copies the registry: the counters, the number of the backends, the histograms
+ * and the backend histograms (AACD_METRICS_BACKENDS of them - the unused are empty).
+ * Each histogram is stored as count, sum, max and AACD_HIST_BUCKETS buckets.
+ * @param len the length of dest - at least AACD_METRICS_SNAPSHOT
+ * @return the number of values stored or -1 if dest is too short
+ */
+int aacd_metrics_snapshot( unsigned long long *dest, int len );
+
+
+/**
+ * Returns the name of the backend or NULL if not used.
+ */
+const char* aacd_metrics_backend( int index );
+
+
+/**
+ * Returns the lowest value of the bucket.
+ */
+unsigned long long aacd_metrics_bucket_low( int bucket );
+
+
+/**
+ * Returns the value at the percentile (0-100) of a histogram stored by aacd_metrics_snapshot()
+ * - the middle of the bucket containing it.
+ */
+unsigned long long aacd_metrics_percentile( const unsigned long long *hist, double percentile );
+
+
+/**
+ * Clears the counters and the histograms.
+ */
+void aacd_metrics_reset();
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,786 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * MP4 / M4A demuxer - the sample index of the first AAC track.
+ *
+ * Only the top-level boxes are read from the input: the 'moov' box is copied
+ * into memory, parsed and freed - only the compact index is kept. Other boxes
+ * are skipped; if the 'moov' box is at the end of the file, then the reader
+ * jumps over the 'mdat' box and back to the first sample - so only the first
+ * input buffer, the 'moov' box and the media data are read.
+ */
+
+#define AACD_MODULE "MP4"
+
+#include "aac-mp4.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The max size of the 'moov' box - a sanity limit (an hour of AAC has about 1 MB).
+ */
+#define AACD_MP4_MOOV_MAX   (64L * 1024 * 1024)
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+/**
+ * The sample tables of the track - pointing into the 'moov' box.
+ */
+typedef struct AACDMp4Tables {
+    const unsigned char *stsz;
+    unsigned long stszlen;
+    int compact;    // stz2
+
+    const unsigned char *stco;
+    unsigned long stcolen;
+    int large;      // co64
+
+    const unsigned char *stsc;
+    unsigned long stsclen;
+
+    const unsigned char *stts;
+    unsigned long sttslen;
+} AACDMp4Tables;
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Boxes
+ ****************************************************************************************************/
+
+static unsigned long aacd_mp4_u16( const unsigned char *p )
+{
+    return (p[0] << 8) | p[1];
+}
+
+
+static unsigned long aacd_mp4_u32( const unsigned char *p )
+{
+    return ((unsigned long) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+static unsigned long long aacd_mp4_u64( const unsigned char *p )
+{
+    return ((unsigned long long) aacd_mp4_u32( p ) << 32) | aacd_mp4_u32( p + 4 );
+}
+
+
+/**
+ * Finds the child box of the type.
+ * @param data the payload of the parent box
+ * @param boxlen the length of the payload of the child is stored there
+ * @return the payload of the child or NULL if not found
+ */
+static const unsigned char* aacd_mp4_child( const unsigned char *data, unsigned long len, const char *type, unsigned long *boxlen )
+{
+    while (len >= 8)
+    {
+        unsigned long long size = aacd_mp4_u32( data );
+        unsigned long hdrlen = 8;
+
+        if (size == 1)
+        {
+            if (len < 16) return NULL;
+
+            size = aacd_mp4_u64( data + 8 );
+            hdrlen = 16;
+        }
+        else if (size == 0) size = len;
+
+        if (size < hdrlen || size > len) return NULL;
+
+        if (!memcmp( data + 4, type, 4 ))
+        {
+            *boxlen = (unsigned long) size - hdrlen;
+            return data + hdrlen;
+        }
+
+        data += size;
+        len -= (unsigned long) size;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Finds the child box by the path of the types - e.g. "mdia/minf/stbl".
+ */
+static const unsigned char* aacd_mp4_path( const unsigned char *data, unsigned long len, const char *path, unsigned long *boxlen )
+{
+    for (;;)
+    {
+        data = aacd_mp4_child( data, len, path, &len );
+
+        if (!data || !path[4]) break;
+
+        path += 5;
+    }
+
+    *boxlen = len;
+
+    return data;
+}
+
+
+/**
+ * Parses the header of the descriptor - the tag and the size (7 bits per byte).
+ * @return the payload of the descriptor or NULL if not valid
+ */
+static const unsigned char* aacd_mp4_descr( const unsigned char *p, const unsigned char *end, int *tag, unsigned long *len )
+{
+    if (end - p < 2) return NULL;
+
+    *tag = *p++;
+    *len = 0;
+
+    int i;
+
+    for (i=0; i < 4 && p < end; i++)
+    {
+        unsigned char b = *p++;
+        *len = (*len << 7) | (b & 0x7f);
+
+        if (!(b & 0x80)) return *len <= (unsigned long) (end - p) ? p : NULL;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Extracts the AudioSpecificConfig from the esds box:
+ * ES_Descriptor (3) / DecoderConfigDescriptor (4) / DecoderSpecificInfo (5).
+ * @return 0=OK, otherwise error
+ */
+static int aacd_mp4_esds( AACDMp4 *mp4, const unsigned char *esds, unsigned long len )
+{
+    const unsigned char *end = esds + len;
+    const unsigned char *p = esds + 4;
+    unsigned long dlen;
+    int tag;
+
+    if (len < 4 || !(p = aacd_mp4_descr( p, end, &tag, &dlen ))) return -1;
+
+    if (tag == 3)
+    {
+        end = p + dlen;
+
+        if (dlen < 3) return -1;
+
+        int flags = p[2];
+        p += 3;
+
+        if (flags & 0x80) p += 2;                   // the stream dependence
+        if ((flags & 0x40) && p < end) p += 1 + *p; // the URL
+        if (flags & 0x20) p += 2;                   // the OCR stream
+
+        if (p > end || !(p = aacd_mp4_descr( p, end, &tag, &dlen ))) return -1;
+    }
+
+    // the object type 0x40 = MPEG-4 audio, 0x66-0x68 = MPEG-2 AAC:
+    if (tag != 4 || dlen < 13 || (p[0] != 0x40 && (p[0] < 0x66 || p[0] > 0x68)))
+    {
+        AACD_ERROR( "open() not an AAC track" );
+        return -1;
+    }
+
+    end = p + dlen;
+
+    if (!(p = aacd_mp4_descr( p + 13, end, &tag, &dlen )) || tag != 5 || dlen < 2 || dlen > sizeof( mp4->asc )) return -1;
+
+    memcpy( mp4->asc, p, dlen );
+    mp4->asclen = (int) dlen;
+
+    return 0;
+}
+
+
+/**
+ * Parses the sample description - the first entry must be 'mp4a' having the esds box.
+ */
+static int aacd_mp4_stsd( AACDMp4 *mp4, const unsigned char *stsd, unsigned long len )
+{
+    if (len < 8 + 36 || memcmp( stsd + 12, "mp4a", 4 )) return -1;
+
+    unsigned long entrylen = aacd_mp4_u32( stsd + 8 );
+
+    if (entrylen < 36 || entrylen > len - 8) return -1;
+
+    const unsigned char *entry = stsd + 8;
+
+    // the QuickTime sound description version 1 / 2 is longer:
+    unsigned long version = aacd_mp4_u16( entry + 16 );
+    unsigned long children = version == 1 ? 52 : version == 2 ? 72 : 36;
+
+    if (children > entrylen) return -1;
+
+    unsigned long esdslen;
+    const unsigned char *esds = aacd_mp4_child( entry + children, entrylen - children, "esds", &esdslen );
+
+    // QuickTime stores it in the 'wave' box:
+    if (!esds) esds = aacd_mp4_path( entry + children, entrylen - children, "wave/esds", &esdslen );
+
+    return esds ? aacd_mp4_esds( mp4, esds, esdslen ) : -1;
+}
+
+
+/**
+ * Parses the media header - the timescale and the duration.
+ */
+static int aacd_mp4_mdhd( AACDMp4 *mp4, const unsigned char *mdhd, unsigned long len )
+{
+    if (len >= 32 && mdhd[0] == 1)
+    {
+        mp4->timescale = aacd_mp4_u32( mdhd + 20 );
+        mp4->duration = aacd_mp4_u64( mdhd + 24 );
+    }
+    else if (len >= 20)
+    {
+        mp4->timescale = aacd_mp4_u32( mdhd + 12 );
+        mp4->duration = aacd_mp4_u32( mdhd + 16 );
+    }
+
+    return mp4->timescale ? 0 : -1;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Index
+ ****************************************************************************************************/
+
+/**
+ * Builds the sample sizes from stsz / stz2.
+ */
+static int aacd_mp4_sizes( AACDMp4 *mp4, AACDMp4Tables *t )
+{
+    const unsigned char *p = t->stsz;
+
+    if (t->stszlen < 12) return -1;
+
+    int bits = t->compact ? p[7] : 32;
+    unsigned long size = t->compact ? 0 : aacd_mp4_u32( p + 4 );
+    unsigned long n = aacd_mp4_u32( p + 8 );
+
+    if (!n) return -1;
+
+    mp4->samples = n;
+
+    if (size)
+    {
+        mp4->size = size;
+        return size <= USHRT_MAX ? 0 : -1;
+    }
+
+    if ((bits != 4 && bits != 8 && bits != 16 && bits != 32)
+        || (unsigned long long) n * bits > (unsigned long long) (t->stszlen - 12) * 8) return -1;
+
+    mp4->sizes = (unsigned short*) malloc( sizeof( unsigned short ) * n );
+
+    p += 12;
+
+    unsigned long i;
+
+    for (i=0; i < n; i++)
+    {
+        unsigned long s;
+
+        switch (bits)
+        {
+            case 4: s = (i & 1) ? (p[i/2] & 0x0f) : (p[i/2] >> 4); break;
+            case 8: s = p[i]; break;
+            case 16: s = aacd_mp4_u16( p + 2*i ); break;
+            default: s = aacd_mp4_u32( p + 4*i ); break;
+        }
+
+        // the AAC frames are much shorter:
+        if (s > USHRT_MAX)
+        {
+            AACD_ERROR( "open() sample %lu too long - %lu bytes", i, s );
+            return -1;
+        }
+
+        mp4->sizes[i] = (unsigned short) s;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Builds the chunks from stco / co64 and stsc.
+ */
+static int aacd_mp4_chunks( AACDMp4 *mp4, AACDMp4Tables *t )
+{
+    if (t->stcolen < 8 || t->stsclen < 8) return -1;
+
+    int width = t->large ? 8 : 4;
+    unsigned long n = aacd_mp4_u32( t->stco + 4 );
+    unsigned long entries = aacd_mp4_u32( t->stsc + 4 );
+
+    if (!n || !entries || (unsigned long long) n * width > t->stcolen - 8
+        || (unsigned long long) entries * 12 > t->stsclen - 8) return -1;
+
+    mp4->chunks = n;
+    mp4->chunk_offsets = (unsigned long*) malloc( sizeof( unsigned long ) * n );
+    mp4->chunk_samples = (unsigned long*) malloc( sizeof( unsigned long ) * n );
+
+    unsigned long i;
+
+    for (i=0; i < n; i++)
+    {
+        const unsigned char *p = t->stco + 8 + i * width;
+        unsigned long long offset = t->large ? aacd_mp4_u64( p ) : aacd_mp4_u32( p );
+
+        if (offset > ULONG_MAX || (i && offset < mp4->chunk_offsets[i-1]))
+        {
+            AACD_ERROR( "open() chunk %lu not supported - offset %llu", i, offset );
+            return -1;
+        }
+
+        mp4->chunk_offsets[i] = (unsigned long) offset;
+    }
+
+    // the runs of the chunks having the same number of samples (the first chunk is 1):
+    const unsigned char *p = t->stsc + 8;
+    unsigned long sample = 0;
+    unsigned long chunk = 0;
+
+    for (i=0; i < entries && chunk < n; i++, p += 12)
+    {
+        unsigned long last = i + 1 < entries ? aacd_mp4_u32( p + 12 ) - 1 : n;
+        unsigned long spc = aacd_mp4_u32( p + 4 );
+
+        if (last > n) last = n;
+
+        for (; chunk < last; chunk++)
+        {
+            mp4->chunk_samples[ chunk ] = sample;
+            sample = sample + spc < mp4->samples ? sample + spc : mp4->samples;
+        }
+    }
+
+    // the chunks not described hold no samples:
+    for (; chunk < n; chunk++) mp4->chunk_samples[ chunk ] = sample;
+
+    return 0;
+}
+
+
+/**
+ * Builds the time-to-sample runs from stts.
+ */
+static int aacd_mp4_runs( AACDMp4 *mp4, AACDMp4Tables *t )
+{
+    if (t->sttslen < 8) return -1;
+
+    unsigned long n = aacd_mp4_u32( t->stts + 4 );
+
+    if (!n || (unsigned long long) n * 8 > t->sttslen - 8) return -1;
+
+    mp4->runs = (AACDMp4Run*) malloc( sizeof( AACDMp4Run ) * n );
+
+    const unsigned char *p = t->stts + 8;
+    unsigned long sample = 0;
+    unsigned long long time = 0;
+    unsigned long i;
+
+    for (i=0; i < n; i++, p += 8)
+    {
+        unsigned long count = aacd_mp4_u32( p );
+
+        if (!count) continue;
+
+        AACDMp4Run *r = mp4->runs + mp4->nruns++;
+
+        r->sample = sample;
+        r->time = time;
+        r->delta = aacd_mp4_u32( p + 4 );
+
+        sample += count;
+        time += (unsigned long long) count * r->delta;
+    }
+
+    return mp4->nruns ? 0 : -1;
+}
+
+
+/**
+ * Finds the first AAC track of the 'moov' box and builds its index.
+ */
+static AACDMp4* aacd_mp4_parse( const unsigned char *moov, unsigned long len )
+{
+    AACDMp4 *mp4 = (AACDMp4*) calloc( 1, sizeof( struct AACDMp4 ));
+
+    const unsigned char *trak;
+    unsigned long traklen;
+
+    while ((trak = aacd_mp4_child( moov, len, "trak", &traklen )))
+    {
+        // the next box:
+        len -= trak + traklen - moov;
+        moov = trak + traklen;
+
+        unsigned long boxlen;
+        const unsigned char *box = aacd_mp4_path( trak, traklen, "mdia/hdlr", &boxlen );
+
+        if (!box || boxlen < 12 || memcmp( box + 8, "soun", 4 )) continue;
+
+        const unsigned char *stbl;
+        unsigned long stbllen;
+
+        if (!(box = aacd_mp4_path( trak, traklen, "mdia/mdhd", &boxlen )) || aacd_mp4_mdhd( mp4, box, boxlen )) continue;
+        if (!(stbl = aacd_mp4_path( trak, traklen, "mdia/minf/stbl", &stbllen ))) continue;
+        if (!(box = aacd_mp4_child( stbl, stbllen, "stsd", &boxlen )) || aacd_mp4_stsd( mp4, box, boxlen )) continue;
+
+        AACDMp4Tables t;
+        memset( &t, 0, sizeof( t ));
+
+        if (!(t.stsz = aacd_mp4_child( stbl, stbllen, "stsz", &t.stszlen )))
+        {
+            t.stsz = aacd_mp4_child( stbl, stbllen, "stz2", &t.stszlen );
+            t.compact = 1;
+        }
+
+        if (!(t.stco = aacd_mp4_child( stbl, stbllen, "stco", &t.stcolen )))
+        {
+            t.stco = aacd_mp4_child( stbl, stbllen, "co64", &t.stcolen );
+            t.large = 1;
+        }
+
+        t.stsc = aacd_mp4_child( stbl, stbllen, "stsc", &t.stsclen );
+        t.stts = aacd_mp4_child( stbl, stbllen, "stts", &t.sttslen );
+
+        if (!t.stsz || !t.stco || !t.stsc || !t.stts
+            || aacd_mp4_sizes( mp4, &t ) || aacd_mp4_chunks( mp4, &t ) || aacd_mp4_runs( mp4, &t ))
+        {
+            AACD_ERROR( "open() invalid sample tables" );
+            break;
+        }
+
+        AACD_INFO( "open() AAC track - samples=%lu, chunks=%lu, timescale=%lu, duration=%llu",
+                    mp4->samples, mp4->chunks, mp4->timescale, mp4->duration );
+
+        return mp4;
+    }
+
+    if (!trak) AACD_ERROR( "open() no AAC track found" );
+
+    aacd_mp4_close( mp4 );
+
+    return NULL;
+}
+
+
+/**
+ * Moves the input to the offset - the bytes are skipped or the reader jumps there.
+ */
+static int aacd_mp4_skip( AACDInfo *info, unsigned long offset )
+{
+    unsigned long len = offset - info->stream_pos;
+
+    if (offset >= info->stream_pos && (len <= info->bytesleft || !info->reader->seek))
+    {
+        return aacd_read_bytes( info, NULL, len );
+    }
+
+    if (!info->reader->seek) return -1;
+
+    return aacd_seek_input( info, offset );
+}
+
+
+/**
+ * Parses the container up to the 'moov' box and positions the input at the first sample.
+ */
+AACDMp4* aacd_mp4_open( AACDInfo *info )
+{
+    AACDMp4 *mp4 = NULL;
+    unsigned char hdr[16];
+
+    while (!mp4)
+    {
+        unsigned long start = info->stream_pos;
+
+        if (aacd_read_bytes( info, hdr, 8 ))
+        {
+            AACD_ERROR( "open() no 'moov' box found" );
+            return NULL;
+        }
+
+        unsigned long long size = aacd_mp4_u32( hdr );
+        unsigned long hdrlen = 8;
+
+        if (size == 1)
+        {
+            if (aacd_read_bytes( info, hdr + 8, 8 )) return NULL;
+
+            size = aacd_mp4_u64( hdr + 8 );
+            hdrlen = 16;
+        }
+
+        AACD_DEBUG( "open() box '%.4s' offset=%lu, size=%llu", hdr + 4, start, size );
+
+        // the last box up to the end of the stream:
+        if (size == 0 && memcmp( hdr + 4, "moov", 4 ))
+        {
+            AACD_ERROR( "open() no 'moov' box found before the last box '%.4s'", hdr + 4 );
+            return NULL;
+        }
+
+        if ((size && size < hdrlen) || start + size > ULONG_MAX)
+        {
+            AACD_ERROR( "open() invalid box '%.4s' size=%llu", hdr + 4, size );
+            return NULL;
+        }
+
+        if (!memcmp( hdr + 4, "moof", 4 ))
+        {
+            AACD_ERROR( "open() fragmented files not supported" );
+            return NULL;
+        }
+
+        if (memcmp( hdr + 4, "moov", 4 ))
+        {
+            if (aacd_mp4_skip( info, (unsigned long) (start + size) ))
+            {
+                AACD_ERROR( "open() cannot skip the box '%.4s' - the 'moov' box must precede the media data in a stream", hdr + 4 );
+                return NULL;
+            }
+
+            continue;
+        }
+
+        if (!size || size - hdrlen > AACD_MP4_MOOV_MAX)
+        {
+            AACD_ERROR( "open() unsupported 'moov' box size=%llu", size );
+            return NULL;
+        }
+
+        unsigned long len = (unsigned long) (size - hdrlen);
+        unsigned char *moov = (unsigned char*) malloc( len );
+
+        if (aacd_read_bytes( info, moov, len ))
+        {
+            AACD_ERROR( "open() truncated 'moov' box" );
+            free( moov );
+            return NULL;
+        }
+
+        mp4 = aacd_mp4_parse( moov, len );
+        free( moov );
+
+        if (!mp4) return NULL;
+    }
+
+    aacd_mp4_set( mp4, 0 );
+
+    if (aacd_mp4_skip( info, mp4->next_offset ))
+    {
+        AACD_ERROR( "open() cannot jump back to the first sample at offset=%lu", mp4->next_offset );
+        aacd_mp4_close( mp4 );
+        return NULL;
+    }
+
+    return mp4;
+}
+
+
+/**
+ * Frees the index.
+ */
+void aacd_mp4_close( AACDMp4 *mp4 )
+{
+    if (!mp4) return;
+
+    free( mp4->sizes );
+    free( mp4->chunk_offsets );
+    free( mp4->chunk_samples );
+    free( mp4->runs );
+    free( mp4 );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Cursor
+ ****************************************************************************************************/
+
+static unsigned long aacd_mp4_size( AACDMp4 *mp4, unsigned long sample )
+{
+    return mp4->sizes ? mp4->sizes[ sample ] : mp4->size;
+}
+
+
+/**
+ * Returns the last chunk having the first sample lower or equal to the sample.
+ */
+static unsigned long aacd_mp4_chunk( AACDMp4 *mp4, unsigned long sample )
+{
+    unsigned long lo = 0;
+    unsigned long hi = mp4->chunks;
+
+    while (hi - lo > 1)
+    {
+        unsigned long mid = (lo + hi) / 2;
+
+        if (mp4->chunk_samples[ mid ] <= sample) lo = mid;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+
+/**
+ * Moves the cursor to the sample.
+ */
+void aacd_mp4_set( AACDMp4 *mp4, unsigned long sample )
+{
+    if (sample >= mp4->samples)
+    {
+        mp4->next = mp4->samples;
+        mp4->next_size = 0;
+        return;
+    }
+
+    unsigned long chunk = aacd_mp4_chunk( mp4, sample );
+    unsigned long offset = mp4->chunk_offsets[ chunk ];
+    unsigned long i = mp4->chunk_samples[ chunk ];
+
+    if (mp4->sizes) for (; i < sample; i++) offset += mp4->sizes[i];
+    else offset += (sample - i) * mp4->size;
+
+    mp4->next = sample;
+    mp4->next_chunk = chunk;
+    mp4->next_offset = offset;
+    mp4->next_size = aacd_mp4_size( mp4, sample );
+}
+
+
+/**
+ * Moves the cursor to the next sample.
+ */
+void aacd_mp4_advance( AACDMp4 *mp4 )
+{
+    if (mp4->next >= mp4->samples) return;
+
+    mp4->next_offset += mp4->next_size;
+
+    if (++mp4->next == mp4->samples)
+    {
+        mp4->next_size = 0;
+        return;
+    }
+
+    // the next chunk (skipping the empty ones):
+    while (mp4->next_chunk + 1 < mp4->chunks && mp4->chunk_samples[ mp4->next_chunk + 1 ] <= mp4->next)
+    {
+        mp4->next_offset = mp4->chunk_offsets[ ++mp4->next_chunk ];
+    }
+
+    mp4->next_size = aacd_mp4_size( mp4, mp4->next );
+}
+
+
+/**
+ * Moves the cursor to the first sample starting at the stream offset or after it.
+ */
+void aacd_mp4_find_offset( AACDMp4 *mp4, unsigned long offset )
+{
+    unsigned long lo = 0;
+    unsigned long hi = mp4->chunks;
+
+    while (hi - lo > 1)
+    {
+        unsigned long mid = (lo + hi) / 2;
+
+        if (mp4->chunk_offsets[ mid ] <= offset) lo = mid;
+        else hi = mid;
+    }
+
+    aacd_mp4_set( mp4, mp4->chunk_samples[ lo ] );
+
+    while (mp4->next < mp4->samples && mp4->next_offset < offset) aacd_mp4_advance( mp4 );
+}
+
+
+/**
+ * Returns the last run having the first sample lower or equal to the sample.
+ */
+static AACDMp4Run* aacd_mp4_run( AACDMp4 *mp4, unsigned long sample )
+{
+    unsigned long lo = 0;
+    unsigned long hi = mp4->nruns;
+
+    while (hi - lo > 1)
+    {
+        unsigned long mid = (lo + hi) / 2;
+
+        if (mp4->runs[ mid ].sample <= sample) lo = mid;
+        else hi = mid;
+    }
+
+    return mp4->runs + lo;
+}
+
+
+/**
+ * Returns the sample containing the time.
+ */
+unsigned long aacd_mp4_find_time( AACDMp4 *mp4, unsigned long long time )
+{
+    unsigned long lo = 0;
+    unsigned long hi = mp4->nruns;
+
+    while (hi - lo > 1)
+    {
+        unsigned long mid = (lo + hi) / 2;
+
+        if (mp4->runs[ mid ].time <= time) lo = mid;
+        else hi = mid;
+    }
+
+    AACDMp4Run *r = mp4->runs + lo;
+    unsigned long end = lo + 1 < mp4->nruns ? r[1].sample : mp4->samples;
+
+    if (time < r->time || !r->delta) return r->sample;
+
+    unsigned long long n = (time - r->time) / r->delta;
+
+    return n < end - r->sample ? r->sample + (unsigned long) n : end - 1;
+}
+
+
+/**
+ * Returns the time of the sample.
+ */
+unsigned long long aacd_mp4_time( AACDMp4 *mp4, unsigned long sample )
+{
+    AACDMp4Run *r = aacd_mp4_run( mp4, sample );
+
+    return r->time + (unsigned long long) (sample - r->sample) * r->delta;
+}
@@ -0,0 +1,134 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAC_MP4_H
+#define AAC_MP4_H
+
+#include "aac-common.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Time-to-sample run - the samples (AAC frames) having the same duration.
+ */
+typedef struct AACDMp4Run {
+    unsigned long sample;       // the first sample of the run
+    unsigned long long time;    // its time (in the timescale units)
+    unsigned long delta;        // the duration of each sample of the run
+} AACDMp4Run;
+
+
+/**
+ * MP4 / M4A container - the sample index of the first AAC track.
+ *
+ * The index is built from the sample tables (stsz, stsc, stco / co64, stts) of the 'moov' box
+ * and it is compact - 2 bytes per sample, 2 longs per chunk and one run per stts entry.
+ * The samples are located by the cursor: sequentially in O(1) and by the offset / time in O(log n).
+ * The chunk offsets of the track are expected to grow.
+ *
+ * Fragmented files ('moof') are not supported.
+ */
+typedef struct AACDMp4 {
+
+    // the sample sizes - or the constant size of all samples (then sizes is NULL):
+    unsigned short *sizes;
+    unsigned long size;
+    unsigned long samples;
+
+    // the chunks - the stream offset and the first sample of each:
+    unsigned long *chunk_offsets;
+    unsigned long *chunk_samples;
+    unsigned long chunks;
+
+    // the time-to-sample runs:
+    AACDMp4Run *runs;
+    unsigned long nruns;
+
+    // the media header - the duration is in the timescale units:
+    unsigned long timescale;
+    unsigned long long duration;
+
+    // the AudioSpecificConfig of the esds box:
+    unsigned char asc[ 64 ];
+    int asclen;
+
+    // the cursor - the next sample to be decoded (== samples at the end of the track):
+    unsigned long next;
+    unsigned long next_chunk;
+    unsigned long next_offset;
+    unsigned long next_size;
+
+} AACDMp4;
+
+
+/**
+ * Parses the container from the current input position up to the 'moov' box
+ * and positions the input at the first sample of the track.
+ * If the 'moov' box follows the 'mdat' box, then the reader must be seekable -
+ * the 'mdat' box is not read, the reader jumps over it.
+ * @return the index or NULL on error
+ */
+AACDMp4* aacd_mp4_open( AACDInfo *info );
+
+
+/**
+ * Frees the index.
+ */
+void aacd_mp4_close( AACDMp4 *mp4 );
+
+
+/**
+ * Moves the cursor to the sample.
+ */
+void aacd_mp4_set( AACDMp4 *mp4, unsigned long sample );
+
+
+/**
+ * Moves the cursor to the next sample.
+ */
+void aacd_mp4_advance( AACDMp4 *mp4 );
+
+
+/**
+ * Moves the cursor to the first sample starting at the stream offset or after it.
+ */
+void aacd_mp4_find_offset( AACDMp4 *mp4, unsigned long offset );
+
+
+/**
+ * Returns the sample containing the time (in the timescale units).
+ */
+unsigned long aacd_mp4_find_time( AACDMp4 *mp4, unsigned long long time );
+
+
+/**
+ * Returns the time of the sample (in the timescale units).
+ */
+unsigned long long aacd_mp4_time( AACDMp4 *mp4, unsigned long sample );
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
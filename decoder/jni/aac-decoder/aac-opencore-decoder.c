@@ -21,16 +21,63 @@
 #define AACD_MODULE "Decoder[OpenCORE]"
 
 #include "aac-common.h"
+#include "aac-mp4.h"
 
 #include "pvmp4audiodecoder_api.h"
 #include "e_tmp4audioobjecttype.h"
 
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
+/**
+ * The FLV audio tag - the sound format (the upper 4 bits of the first byte) and the AAC packet types.
+ */
+#define AACD_FLV_SOUND_AAC      10
+#define AACD_FLV_AAC_CONFIG     0
+#define AACD_FLV_AAC_RAW        1
+
+/**
+ * The max length of the audio tag - the AAC frame has max 6144 bits per channel (8 channels).
+ */
+#define AACD_FLV_AAC_TAG_MAX    (AACD_FLV_TAG_HEADER + 2 + 6144 + 4)
+
+/**
+ * The max length of the AudioSpecificConfig stored.
+ */
+#define AACD_OPENCORE_ASC_MAX   64
+
+/**
+ * The library was initialized again - see AACDOpenCore.reconfig.
+ */
+#define AACD_OPENCORE_RECONFIG_SBR  1   // to enable SBR
+#define AACD_OPENCORE_RECONFIG_ASC  2   // a new AudioSpecificConfig
+
+
 typedef struct AACDOpenCore {
     tPVMP4AudioDecoderExternal *pExt;
     void *pMem;
     unsigned long frameSamplesFactor;
+
+    // the stream type detected by start() - AAC, AACPLUS or ENH_AACPLUS (or -1):
+    int streamType;
+
+    // the quality level - SBR switched off / stereo downmixed into mono:
+    int sbrDisabled;
+    int mono;
+
+    // the library was initialized again - the format is taken from the next frame:
+    int reconfig;
+
+    // the AudioSpecificConfig of the FLV stream (raw AAC frames):
+    unsigned char asc[ AACD_OPENCORE_ASC_MAX ];
+    int asclen;
+
+    // the bytes of the FLV tag without audio still to be skipped:
+    unsigned long skip;
+
+    // the sample index of the MP4 container:
+    AACDMp4 *mp4;
 } AACDOpenCore;
 
 
@@ -41,27 +88,64 @@ static const char* aacd_opencore_name()
 }
 
 
-static void* aacd_opencore_init()
+/**
+ * Initializes the library - also when a pooled struct is reused.
+ */
+static int aacd_opencore_init_library( AACDOpenCore *oc )
 {
-    AACDOpenCore *oc = (AACDOpenCore*) calloc( 1, sizeof(struct AACDOpenCore));
-
-    oc->pExt = calloc( 1, sizeof( tPVMP4AudioDecoderExternal ));
-    oc->pMem = malloc( PVMP4AudioDecoderGetMemRequirements());
-
     tPVMP4AudioDecoderExternal *pExt = oc->pExt;
 
+    memset( pExt, 0, sizeof( tPVMP4AudioDecoderExternal ));
+
     pExt->desiredChannels           = 2;
     pExt->outputFormat              = OUTPUTFORMAT_16PCM_INTERLEAVED;
     pExt->repositionFlag            = TRUE;
     pExt->aacPlusEnabled            = TRUE;
 
+    oc->frameSamplesFactor = 0;
+    oc->sbrDisabled = 0;
+    oc->mono = 0;
+    oc->reconfig = 0;
+
     Int err = PVMP4AudioDecoderInitLibrary(pExt, oc->pMem);
 
-    if (err)
-    {
-        AACD_ERROR( "PVMP4AudioDecoderInitLibrary failed err=%d", err );
+    if (err) AACD_ERROR( "PVMP4AudioDecoderInitLibrary failed err=%d", err );
+
+    return err;
+}
+
+
+/**
+ * Configures the library by the stored AudioSpecificConfig - the raw AAC frames follow.
+ */
+static int aacd_opencore_config( AACDOpenCore *oc )
+{
+    tPVMP4AudioDecoderExternal *pExt = oc->pExt;
+
+    pExt->pInputBuffer              = oc->asc;
+    pExt->inputBufferMaxLength      = oc->asclen;
+    pExt->inputBufferCurrentLength  = oc->asclen;
+    pExt->inputBufferUsedLength     = 0;
+    pExt->remainderBits             = 0;
+
+    Int err = PVMP4AudioDecoderConfig(pExt, oc->pMem);
+
+    if (err != MP4AUDEC_SUCCESS) AACD_ERROR( "PVMP4AudioDecoderConfig failed err=%d", err );
+
+    return err;
+}
+
+
+static void* aacd_opencore_init()
+{
+    AACDOpenCore *oc = (AACDOpenCore*) calloc( 1, sizeof(struct AACDOpenCore));
 
-        free( pExt );
+    oc->pExt = calloc( 1, sizeof( tPVMP4AudioDecoderExternal ));
+    oc->pMem = malloc( PVMP4AudioDecoderGetMemRequirements());
+
+    if (aacd_opencore_init_library( oc ))
+    {
+        free( oc->pExt );
         free( oc->pMem );
         free( oc );
 
@@ -78,6 +162,8 @@ static void aacd_opencore_destroy( AACDInfo *info )
 
     if ( !oc ) return;
 
+    aacd_mp4_close( oc->mp4 );
+
     if (oc->pMem != NULL) free( oc->pMem );
     if (oc->pExt != NULL) free( oc->pExt );
 
@@ -85,9 +171,71 @@ static void aacd_opencore_destroy( AACDInfo *info )
 }
 
 
+/**
+ * Decodes one frame - the input is consumed by the library.
+ */
+static int32_t aacd_opencore_frame( AACDOpenCore *oc, unsigned char *buffer, unsigned long buffer_size, short *jsamples )
+{
+    tPVMP4AudioDecoderExternal *pExt = oc->pExt;
+
+    pExt->pInputBuffer              = buffer;
+    pExt->inputBufferMaxLength      = buffer_size;
+    pExt->inputBufferCurrentLength  = buffer_size;
+    pExt->inputBufferUsedLength     = 0;
+
+    pExt->pOutputBuffer = jsamples;
+    pExt->pOutputBuffer_plus = jsamples+2048;
+
+    return PVMP4AudioDecodeFrame( pExt, oc->pMem );
+}
+
+
+/**
+ * Fills the stream info after the first frame was decoded.
+ */
+static void aacd_opencore_stream_info( AACDInfo *info, AACDOpenCore *oc )
+{
+    tPVMP4AudioDecoderExternal *pExt = oc->pExt;
+
+    int streamType  = -1;
+
+    if ((pExt->extendedAudioObjectType == MP4AUDIO_AAC_LC) ||
+            (pExt->extendedAudioObjectType == MP4AUDIO_LTP))
+    {
+        streamType = AAC;
+    }
+    else if (pExt->extendedAudioObjectType == MP4AUDIO_SBR)
+    {
+        streamType = AACPLUS;
+    }
+    else if (pExt->extendedAudioObjectType == MP4AUDIO_PS)
+    {
+        streamType = ENH_AACPLUS;
+    }
+
+    AACD_DEBUG( "start() streamType=%d", streamType );
+
+    oc->streamType = streamType;
+
+    if ((AAC == streamType) && (2 == pExt->aacPlusUpsamplingFactor))
+    {
+        AACD_INFO( "start() DisableAacPlus" );
+        PVMP4AudioDecoderDisableAacPlus(pExt, oc->pMem);
+    }
+
+    info->samplerate = pExt->samplingRate;
+    info->channels = pExt->desiredChannels;
+
+    oc->frameSamplesFactor = pExt->desiredChannels;
+    if (2 == pExt->aacPlusUpsamplingFactor) oc->frameSamplesFactor *= 2;
+
+    info->frame_samples = pExt->frameLength * oc->frameSamplesFactor;
+}
+
+
 static long aacd_opencore_start( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size)
 {
-    AACD_TRACE( "start() buffer=%x size=%d", (*(unsigned long*)buffer), buffer_size );
+    AACD_TRACE( "start() buffer=%02x%02x%02x%02x size=%lu", buffer[0], buffer[1], buffer[2], buffer[3], buffer_size );
 
     AACDOpenCore *oc = (AACDOpenCore*) info->ext;
     tPVMP4AudioDecoderExternal *pExt = oc->pExt;
@@ -150,75 +298,617 @@ static long aacd_opencore_start( AACDInfo *info, unsigned char *buffer, unsigned
 
     AACD_DEBUG( "start() bytesconsumed=%d", pExt->inputBufferUsedLength );
 
-    int streamType  = -1;
+    aacd_opencore_stream_info( info, oc );
 
-    if ((pExt->extendedAudioObjectType == MP4AUDIO_AAC_LC) ||
-            (pExt->extendedAudioObjectType == MP4AUDIO_LTP))
+    info->frame_bytesconsumed = pExt->inputBufferUsedLength;
+
+    return pExt->inputBufferUsedLength;
+}
+
+
+/**
+ * Fills the frame info after a frame was decoded.
+ */
+static void aacd_opencore_output( AACDInfo *info, AACDOpenCore *oc, short *jsamples )
+{
+    tPVMP4AudioDecoderExternal *pExt = oc->pExt;
+
+    // the first frame of a new AudioSpecificConfig - like in start();
+    // the positions are kept in the sampling rate of the new stream:
+    if (oc->reconfig == AACD_OPENCORE_RECONFIG_ASC)
     {
-        streamType = AAC;
+        aacd_opencore_stream_info( info, oc );
+
+        info->full_samplerate = info->samplerate;
+        oc->reconfig = 0;
     }
-    else if (pExt->extendedAudioObjectType == MP4AUDIO_SBR)
+
+    // the first frame after the library was initialized again to enable SBR:
+    if (oc->reconfig)
     {
-        streamType = AACPLUS;
+        info->samplerate = pExt->samplingRate;
+
+        oc->frameSamplesFactor = pExt->desiredChannels;
+        if (2 == pExt->aacPlusUpsamplingFactor) oc->frameSamplesFactor *= 2;
+
+        oc->reconfig = 0;
     }
-    else if (pExt->extendedAudioObjectType == MP4AUDIO_PS)
+
+    info->frame_samples = pExt->frameLength * oc->frameSamplesFactor;
+
+    // the mono downmix - in place (the output index never exceeds the input one):
+    if (oc->mono)
     {
-        streamType = ENH_AACPLUS;
+        unsigned long n = info->frame_samples / 2;
+        unsigned long i;
+
+        for (i=0; i < n; i++) jsamples[i] = (short) (((int) jsamples[2*i] + jsamples[2*i+1]) >> 1);
+
+        info->frame_samples = n;
     }
+}
 
-    AACD_DEBUG( "start() streamType=%d", streamType );
 
-    if ((AAC == streamType) && (2 == pExt->aacPlusUpsamplingFactor))
+static int aacd_opencore_decode( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size, short *jsamples, int outLen )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+
+    int32_t status = aacd_opencore_frame( oc, buffer, buffer_size, jsamples );
+
+    if (status != MP4AUDEC_SUCCESS && status != SUCCESS)
     {
-        AACD_INFO( "start() DisableAacPlus" );
-        PVMP4AudioDecoderDisableAacPlus(pExt, oc->pMem);
+        AACD_ERROR( "decode() bytesleft=%lu, status=%d", buffer_size, status );
+        return -1;
     }
 
-    info->samplerate = pExt->samplingRate;
-    info->channels = pExt->desiredChannels;
+    info->frame_bytesconsumed = oc->pExt->inputBufferUsedLength;
 
-    oc->frameSamplesFactor = pExt->desiredChannels;
-    if (2 == pExt->aacPlusUpsamplingFactor) oc->frameSamplesFactor *= 2;
+    aacd_opencore_output( info, oc, jsamples );
 
-    info->frame_bytesconsumed = pExt->inputBufferUsedLength;
-    info->frame_samples = pExt->frameLength * oc->frameSamplesFactor;
+    return 0;
+}
 
-    return pExt->inputBufferUsedLength;
+
+static int aacd_opencore_sync( AACDInfo *info, unsigned char *buffer, int buffer_size )
+{
+    return aacd_adts_sync( buffer, buffer_size );
 }
 
 
 
-static int aacd_opencore_decode( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size, jshort *jsamples, jint outLen )
+/**
+ * Clears the decoder's state after the stream was repositioned.
+ */
+static void aacd_opencore_reset( AACDInfo *info )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+
+    PVMP4AudioDecoderResetBuffer( oc->pMem );
+}
+
+
+/**
+ * Switches the quality level in the middle of the stream.
+ * The library cannot skip the parametric stereo alone - the SBR level means the full quality.
+ * The SBR decoder can be switched off at any time (the output rate is halved), but not on:
+ * the library is initialized again instead and configured by the next ADTS header.
+ */
+static int aacd_opencore_quality( AACDInfo *info, int level )
 {
     AACDOpenCore *oc = (AACDOpenCore*) info->ext;
     tPVMP4AudioDecoderExternal *pExt = oc->pExt;
 
-    pExt->pInputBuffer              = buffer;
-    pExt->inputBufferMaxLength      = buffer_size;
-    pExt->inputBufferCurrentLength  = buffer_size;
-    pExt->inputBufferUsedLength     = 0;
+    if (level == AACD_QUALITY_SBR) level = AACD_QUALITY_FULL;
 
-    pExt->pOutputBuffer = jsamples;
-    pExt->pOutputBuffer_plus = jsamples+2048;
+    // only the HE-AAC streams have the SBR layer:
+    int sbr = oc->streamType == AACPLUS || oc->streamType == ENH_AACPLUS;
+    int core = level >= AACD_QUALITY_CORE;
+
+    if (sbr && core && !oc->sbrDisabled)
+    {
+        AACD_INFO( "quality() DisableAacPlus" );
+        PVMP4AudioDecoderDisableAacPlus( pExt, oc->pMem );
+
+        if (oc->frameSamplesFactor > pExt->desiredChannels)
+        {
+            oc->frameSamplesFactor = pExt->desiredChannels;
+            info->samplerate = info->full_samplerate / 2;
+        }
+
+        oc->sbrDisabled = 1;
+    }
+    else if (sbr && !core && oc->sbrDisabled)
+    {
+        AACD_INFO( "quality() initializing the library again to enable AacPlus" );
+
+        if (aacd_opencore_init_library( oc ))
+        {
+            AACD_ERROR( "quality() cannot enable AacPlus" );
+            return info->quality;
+        }
+
+        // the raw frames of FLV need the AudioSpecificConfig again:
+        if (oc->asclen && aacd_opencore_config( oc ))
+        {
+            AACD_ERROR( "quality() cannot configure the library again" );
+            return info->quality;
+        }
+
+        // the max of the next frame - the real values are set after it is decoded:
+        oc->frameSamplesFactor = pExt->desiredChannels * 2;
+        oc->reconfig = AACD_OPENCORE_RECONFIG_SBR;
+        info->samplerate = info->full_samplerate;
+    }
+
+    oc->mono = level >= AACD_QUALITY_MONO && pExt->desiredChannels == 2;
+    info->channels = oc->mono ? 1 : pExt->desiredChannels;
+
+    unsigned long frameLength = pExt->frameLength ? pExt->frameLength : 1024;
+    info->frame_samples = frameLength * oc->frameSamplesFactor / (oc->mono ? 2 : 1);
+
+    AACD_DEBUG( "quality() level=%d, samplerate=%lu, channels=%d", level, info->samplerate, info->channels );
 
-    int32_t status = PVMP4AudioDecodeFrame( pExt, oc->pMem );
+    return level;
+}
+
+
+/**
+ * Prepares the struct for a new stream - the memory is not allocated again.
+ */
+static int aacd_opencore_recycle( void *ext )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) ext;
+
+    oc->asclen = 0;
+    oc->skip = 0;
+
+    aacd_mp4_close( oc->mp4 );
+    oc->mp4 = NULL;
+
+    return aacd_opencore_init_library( oc );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - FLV
+ ****************************************************************************************************/
+
+/*
+ * The FLV stream carries the raw AAC frames (without ADTS headers) - each in its own audio tag.
+ * The AudioSpecificConfig is sent in an audio tag before the first frame (and usually repeated
+ * by live streams). The video and script data tags are skipped.
+ */
+
+static const char* aacd_opencore_flv_name()
+{
+    return "OpenCORE-FLV";
+}
+
+
+/**
+ * Stores the AudioSpecificConfig and configures the library.
+ * A different config in the middle of the stream initializes the library again.
+ * @return 0=OK, otherwise error
+ */
+static int aacd_opencore_flv_asc( AACDInfo *info, AACDOpenCore *oc, const unsigned char *asc, int len )
+{
+    // repeated by live streams:
+    if (len == oc->asclen && !memcmp( asc, oc->asc, len )) return 0;
+
+    if (len < 2 || len > AACD_OPENCORE_ASC_MAX)
+    {
+        AACD_ERROR( "flv() invalid AudioSpecificConfig length=%d", len );
+        return -1;
+    }
+
+    if (oc->asclen)
+    {
+        AACD_INFO( "flv() new AudioSpecificConfig - initializing the library again" );
+
+        if (aacd_opencore_init_library( oc )) return -1;
+
+        // the full quality - the max of the next frame; the real values are set after it is decoded:
+        oc->frameSamplesFactor = oc->pExt->desiredChannels * 2;
+        oc->reconfig = AACD_OPENCORE_RECONFIG_ASC;
+
+        info->quality = AACD_QUALITY_FULL;
+        info->channels = oc->pExt->desiredChannels;
+        info->frame_samples = 1024 * oc->frameSamplesFactor;
+    }
+
+    memcpy( oc->asc, asc, len );
+    oc->asclen = len;
+
+    return aacd_opencore_config( oc );
+}
+
+
+/**
+ * Parses the audio tag of a complete FLV tag.
+ * @param data the payload of the AAC frame (if any)
+ * @return the AAC packet type or -1 if the tag does not contain AAC
+ */
+static int aacd_opencore_flv_audio( const unsigned char *tag, int taglen, const unsigned char **data, int *datalen )
+{
+    int len = taglen - AACD_FLV_TAG_HEADER - 4;
+    const unsigned char *p = tag + AACD_FLV_TAG_HEADER;
+
+    if (tag[0] != AACD_FLV_AUDIO || len < 2 || (p[0] >> 4) != AACD_FLV_SOUND_AAC) return -1;
+
+    *data = p + 2;
+    *datalen = len - 2;
+
+    return p[1];
+}
+
+
+/**
+ * Walks the tags up to the first AAC frame - the AudioSpecificConfig must precede it.
+ * All the tags must be in the buffer.
+ */
+static long aacd_opencore_flv_start( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+    unsigned long pos = 0;
+
+    for (;;)
+    {
+        unsigned long left = buffer_size - pos;
+        int len = aacd_flv_header( buffer + pos, left > INT_MAX ? INT_MAX : (int) left );
+
+        if (len < 0 || (unsigned long) len > left)
+        {
+            AACD_ERROR( "start() no AAC frame found, offset=%lu", pos );
+            return -1;
+        }
+
+        unsigned char *tag = buffer + pos;
+        const unsigned char *data;
+        int datalen;
+
+        pos += len;
+
+        switch (aacd_opencore_flv_audio( tag, len, &data, &datalen ))
+        {
+            case AACD_FLV_AAC_CONFIG:
+                if (aacd_opencore_flv_asc( info, oc, data, datalen )) return -1;
+                continue;
+
+            case AACD_FLV_AAC_RAW:
+                if (datalen && oc->asclen) break;
+                if (datalen) AACD_WARN( "start() skipping AAC frame without AudioSpecificConfig" );
+                continue;
+
+            default:
+                AACD_DEBUG( "start() skipping tag type=%d, length=%d", tag[0], len );
+                continue;
+        }
+
+        oc->pExt->remainderBits = 0;
+
+        int32_t status = aacd_opencore_frame( oc, (unsigned char*) data, datalen, aacd_prepare_samples( info, 4096 ));
+
+        if (status != MP4AUDEC_SUCCESS)
+        {
+            AACD_ERROR( "start() init failed status=%d", status );
+            return -1;
+        }
+
+        aacd_opencore_stream_info( info, oc );
+
+        info->frame_bytesconsumed = len;
+
+        return (long) pos;
+    }
+}
+
+
+/**
+ * Decodes the next FLV tag - the tags without audio are skipped (they do not need to fit into the buffer).
+ */
+static int aacd_opencore_flv_decode( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size, short *jsamples, int outLen )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+
+    // the rest of a long tag without audio:
+    if (oc->skip)
+    {
+        info->frame_bytesconsumed = oc->skip < buffer_size ? oc->skip : buffer_size;
+        info->frame_skipped = 1;
+        oc->skip -= info->frame_bytesconsumed;
+
+        return 0;
+    }
+
+    // more input is needed:
+    if (buffer_size < AACD_FLV_TAG_HEADER)
+    {
+        info->frame_bytesconsumed = 0;
+        info->frame_skipped = 1;
+
+        return 0;
+    }
+
+    int len = aacd_flv_header( buffer, buffer_size > INT_MAX ? INT_MAX : (int) buffer_size );
+
+    if (len < 0)
+    {
+        AACD_ERROR( "decode() not a FLV tag, bytesleft=%lu", buffer_size );
+        return -1;
+    }
+
+    if (buffer[0] != AACD_FLV_AUDIO)
+    {
+        info->frame_bytesconsumed = (unsigned long) len < buffer_size ? (unsigned long) len : buffer_size;
+        info->frame_skipped = 1;
+        oc->skip = len - info->frame_bytesconsumed;
+
+        return 0;
+    }
+
+    if (len > AACD_FLV_AAC_TAG_MAX)
+    {
+        AACD_ERROR( "decode() audio tag too long length=%d", len );
+        return -1;
+    }
+
+    // more input is needed:
+    if ((unsigned long) len > buffer_size)
+    {
+        AACD_TRACE( "decode() incomplete audio tag length=%d, bytesleft=%lu", len, buffer_size );
+
+        info->frame_bytesconsumed = 0;
+        info->frame_skipped = 1;
+
+        return 0;
+    }
+
+    // the PreviousTagSize must match:
+    const unsigned char *prev = buffer + len - 4;
+
+    if ((((unsigned long) prev[0] << 24) | (prev[1] << 16) | (prev[2] << 8) | prev[3]) != (unsigned long) len - 4)
+    {
+        AACD_ERROR( "decode() invalid audio tag length=%d", len );
+        return -1;
+    }
+
+    const unsigned char *data;
+    int datalen;
+
+    info->frame_bytesconsumed = len;
+
+    switch (aacd_opencore_flv_audio( buffer, len, &data, &datalen ))
+    {
+        case AACD_FLV_AAC_CONFIG:
+            if (aacd_opencore_flv_asc( info, oc, data, datalen )) return -1;
+            info->frame_skipped = 1;
+            return 0;
+
+        case AACD_FLV_AAC_RAW:
+            if (datalen) break;
+            // no break
+
+        default:
+            info->frame_skipped = 1;
+            return 0;
+    }
+
+    oc->pExt->remainderBits = 0;
+
+    int32_t status = aacd_opencore_frame( oc, (unsigned char*) data, datalen, jsamples );
 
     if (status != MP4AUDEC_SUCCESS && status != SUCCESS)
     {
-        AACD_ERROR( "decode() bytesleft=%lu, status=%d", buffer_size, status );
+        AACD_ERROR( "decode() tag length=%d, status=%d", len, status );
         return -1;
     }
 
-    info->frame_bytesconsumed = pExt->inputBufferUsedLength;
-    info->frame_samples = pExt->frameLength * oc->frameSamplesFactor;
+    aacd_opencore_output( info, oc, jsamples );
 
     return 0;
 }
 
 
-static int aacd_opencore_sync( AACDInfo *info, unsigned char *buffer, int buffer_size )
+static int aacd_opencore_flv_sync( AACDInfo *info, unsigned char *buffer, int buffer_size )
 {
-    return aacd_adts_sync( buffer, buffer_size );
+    return aacd_flv_sync( buffer, buffer_size );
+}
+
+
+/**
+ * Drops the rest of the skipped tag - the stream was repositioned.
+ */
+static void aacd_opencore_flv_reset( AACDInfo *info )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+
+    oc->skip = 0;
+
+    PVMP4AudioDecoderResetBuffer( oc->pMem );
+}
+
+
+
+/****************************************************************************************************
+ * FUNCTIONS - MP4
+ ****************************************************************************************************/
+
+/*
+ * The MP4 / M4A file carries the raw AAC frames (samples) in the 'mdat' box - located by the sample
+ * index built from the 'moov' box by open(). The AudioSpecificConfig comes from the esds box.
+ * The bytes between the samples (other tracks, boxes) are skipped.
+ */
+
+static const char* aacd_opencore_mp4_name()
+{
+    return "OpenCORE-MP4";
+}
+
+
+/**
+ * Returns the stream offset of the buffer position.
+ */
+static unsigned long aacd_opencore_mp4_offset( AACDInfo *info, unsigned char *buffer )
+{
+    return info->stream_pos + (unsigned long) (buffer - info->buffer);
+}
+
+
+/**
+ * Builds the sample index and configures the library by the AudioSpecificConfig.
+ */
+static int aacd_opencore_mp4_open( AACDInfo *info )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+
+    if (!(oc->mp4 = aacd_mp4_open( info ))) return -1;
+
+    // the whole first sample is needed by start():
+    while (info->bytesleft < oc->mp4->next_size && aacd_read( info ) > 0);
+
+    memcpy( oc->asc, oc->mp4->asc, oc->mp4->asclen );
+    oc->asclen = oc->mp4->asclen;
+
+    return aacd_opencore_config( oc );
+}
+
+
+/**
+ * Decodes the first sample - the buffer starts by it (positioned by open() or by sync()).
+ */
+static long aacd_opencore_mp4_start( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+    AACDMp4 *mp4 = oc->mp4;
+
+    if (mp4->next >= mp4->samples || mp4->next_offset != aacd_opencore_mp4_offset( info, buffer )
+            || mp4->next_size > buffer_size)
+    {
+        AACD_ERROR( "start() first sample not in the buffer, bytesleft=%lu", buffer_size );
+        return -1;
+    }
+
+    oc->pExt->remainderBits = 0;
+
+    int32_t status = aacd_opencore_frame( oc, buffer, mp4->next_size, aacd_prepare_samples( info, 4096 ));
+
+    if (status != MP4AUDEC_SUCCESS)
+    {
+        AACD_ERROR( "start() init failed status=%d", status );
+        return -1;
+    }
+
+    aacd_opencore_stream_info( info, oc );
+
+    info->frame_bytesconsumed = mp4->next_size;
+    info->duration = (unsigned long) (mp4->duration * info->samplerate / mp4->timescale);
+
+    aacd_mp4_advance( mp4 );
+
+    return (long) info->frame_bytesconsumed;
+}
+
+
+/**
+ * Decodes the next sample - the bytes before it are skipped (they do not need to fit into the buffer).
+ */
+static int aacd_opencore_mp4_decode( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size, short *jsamples, int outLen )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+    AACDMp4 *mp4 = oc->mp4;
+    unsigned long offset = aacd_opencore_mp4_offset( info, buffer );
+
+    // the stream was repositioned after the cursor:
+    if (mp4->next < mp4->samples && mp4->next_offset < offset) aacd_mp4_find_offset( mp4, offset );
+
+    // the end of the track - the rest of the stream is skipped:
+    if (mp4->next >= mp4->samples)
+    {
+        info->frame_bytesconsumed = buffer_size;
+        info->frame_skipped = 1;
+
+        return 0;
+    }
+
+    if (mp4->next_offset > offset)
+    {
+        unsigned long gap = mp4->next_offset - offset;
+
+        info->frame_bytesconsumed = gap < buffer_size ? gap : buffer_size;
+        info->frame_skipped = 1;
+
+        return 0;
+    }
+
+    // more input is needed:
+    if (mp4->next_size > buffer_size)
+    {
+        AACD_TRACE( "decode() incomplete sample %lu size=%lu, bytesleft=%lu", mp4->next, mp4->next_size, buffer_size );
+
+        info->frame_bytesconsumed = 0;
+        info->frame_skipped = 1;
+
+        return 0;
+    }
+
+    oc->pExt->remainderBits = 0;
+
+    int32_t status = aacd_opencore_frame( oc, buffer, mp4->next_size, jsamples );
+
+    if (status != MP4AUDEC_SUCCESS && status != SUCCESS)
+    {
+        AACD_ERROR( "decode() sample %lu size=%lu, status=%d", mp4->next, mp4->next_size, status );
+        return -1;
+    }
+
+    aacd_opencore_output( info, oc, jsamples );
+
+    info->frame_bytesconsumed = mp4->next_size;
+
+    aacd_mp4_advance( mp4 );
+
+    return 0;
+}
+
+
+/**
+ * Finds the next sample by the index - not by the content.
+ */
+static int aacd_opencore_mp4_sync( AACDInfo *info, unsigned char *buffer, int buffer_size )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+    AACDMp4 *mp4 = oc->mp4;
+    unsigned long offset = aacd_opencore_mp4_offset( info, buffer );
+
+    aacd_mp4_find_offset( mp4, offset );
+
+    if (mp4->next >= mp4->samples || mp4->next_offset - offset >= (unsigned long) buffer_size) return -1;
+
+    return (int) (mp4->next_offset - offset);
+}
+
+
+/**
+ * Finds the sample by the time-to-sample table and moves the cursor there.
+ */
+static int aacd_opencore_mp4_locate( AACDInfo *info, unsigned long sample, AACDSeekPoint *point )
+{
+    AACDOpenCore *oc = (AACDOpenCore*) info->ext;
+    AACDMp4 *mp4 = oc->mp4;
+    unsigned long samplerate = info->full_samplerate ? info->full_samplerate : info->samplerate;
+
+    if (!samplerate) return -1;
+
+    unsigned long n = aacd_mp4_find_time( mp4, (unsigned long long) sample * mp4->timescale / samplerate );
+
+    aacd_mp4_set( mp4, n );
+
+    if (mp4->next >= mp4->samples) return -1;
+
+    point->offset = mp4->next_offset;
+    point->sample = (unsigned long) (aacd_mp4_time( mp4, n ) * samplerate / mp4->timescale);
+
+    return 0;
 }
 
 
@@ -228,6 +918,49 @@ AACDDecoder aacd_opencore_decoder = {
     aacd_opencore_start,
     aacd_opencore_decode,
     aacd_opencore_destroy,
-    aacd_opencore_sync
+    aacd_opencore_sync,
+    aacd_adts_header,
+    aacd_opencore_reset,
+    aacd_opencore_recycle,
+    aacd_opencore_quality,
+    NULL,
+    NULL
+};
+
+
+/**
+ * The FLV stream - the tags are not walked when seeking (they are not only the audio frames).
+ */
+AACDDecoder aacd_opencore_flv_decoder = {
+    aacd_opencore_flv_name,
+    aacd_opencore_init,
+    aacd_opencore_flv_start,
+    aacd_opencore_flv_decode,
+    aacd_opencore_destroy,
+    aacd_opencore_flv_sync,
+    NULL,
+    aacd_opencore_flv_reset,
+    aacd_opencore_recycle,
+    aacd_opencore_quality,
+    NULL,
+    NULL
 };
 
+
+/**
+ * The MP4 / M4A file - seeking uses the sample index (the frames are not walked).
+ */
+AACDDecoder aacd_opencore_mp4_decoder = {
+    aacd_opencore_mp4_name,
+    aacd_opencore_init,
+    aacd_opencore_mp4_start,
+    aacd_opencore_mp4_decode,
+    aacd_opencore_destroy,
+    aacd_opencore_mp4_sync,
+    NULL,
+    aacd_opencore_reset,
+    aacd_opencore_recycle,
+    aacd_opencore_quality,
+    aacd_opencore_mp4_open,
+    aacd_opencore_mp4_locate
+};
@@ -0,0 +1,457 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Native output - the decoding thread and the PCM ring drained by the sink.
+ * The ring is lock-free (one writer, one reader), so the sink can pull
+ * the samples from a realtime audio callback. The decoding thread fills
+ * the whole ring and then sleeps until the sink drains it below the low mark.
+ */
+
+#define AACD_MODULE "Output"
+
+#include "aac-output.h"
+#include "aac-metrics.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/**
+ * The max samples per channel produced by one frame (AAC+).
+ */
+#define AACD_OUTPUT_MAX_FRAME   2048
+
+/**
+ * The max part of the ring filled by one decoding round -
+ * the samples are passed to the sink after each round.
+ */
+#define AACD_OUTPUT_ROUND_DIV   4
+
+
+extern AACDSink aacd_null_sink;
+extern AACDSink aacd_wav_sink;
+
+#ifdef __ANDROID__
+extern AACDSink aacd_opensl_sink;
+#endif
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+static AACDSink *aacd_sinks[] = {
+#ifdef __ANDROID__
+    &aacd_opensl_sink,
+#endif
+    &aacd_null_sink,
+    &aacd_wav_sink
+};
+
+#define AACD_SINKS_COUNT (sizeof( aacd_sinks ) / sizeof( AACDSink* ))
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Ring
+ ****************************************************************************************************/
+
+/**
+ * Returns the number of samples between the positions.
+ * The positions wrap at 2*ringlen, so the full and empty states differ.
+ */
+static unsigned long aacd_ring_filled( AACDOutput *out, unsigned long w, unsigned long r )
+{
+    return w >= r ? w - r : w + 2 * out->ringlen - r;
+}
+
+
+static unsigned long aacd_ring_advance( AACDOutput *out, unsigned long pos, unsigned long n )
+{
+    pos += n;
+
+    return pos >= 2 * out->ringlen ? pos - 2 * out->ringlen : pos;
+}
+
+
+static unsigned long aacd_ring_offset( AACDOutput *out, unsigned long pos )
+{
+    return pos >= out->ringlen ? pos - out->ringlen : pos;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Decoding thread
+ ****************************************************************************************************/
+
+/**
+ * Starts the sink - once.
+ */
+static void aacd_output_start_sink( AACDOutput *out )
+{
+    if (out->started) return;
+
+    out->started = 1;
+
+    AACD_DEBUG( "start_sink() buffered=%lu", aacd_output_buffered( out ));
+
+    if (out->sink->start( out ))
+    {
+        AACD_ERROR( "start_sink() cannot start sink %s", out->sink->name());
+
+        __atomic_store_n( &out->stopped, 1, __ATOMIC_SEQ_CST );
+        aacd_output_finish( out );
+    }
+}
+
+
+/**
+ * Waits until the sink drains the ring below the low mark.
+ * @return 0 if stopped
+ */
+static int aacd_output_wait_space( AACDOutput *out )
+{
+    for (;;)
+    {
+        if (__atomic_load_n( &out->stopped, __ATOMIC_ACQUIRE )) return 0;
+
+        __atomic_store_n( &out->waiting, 1, __ATOMIC_SEQ_CST );
+
+        // check again - the sink could drain the ring before the flag was set:
+        if (aacd_ring_filled( out, out->wpos, __atomic_load_n( &out->rpos, __ATOMIC_SEQ_CST )) <= out->lowmark)
+        {
+            // if the sink has just cleared the flag, then its post must be consumed:
+            if (!__atomic_exchange_n( &out->waiting, 0, __ATOMIC_SEQ_CST )) sem_wait( &out->space );
+
+            return !__atomic_load_n( &out->stopped, __ATOMIC_ACQUIRE );
+        }
+
+        while (sem_wait( &out->space ) && errno == EINTR);
+    }
+}
+
+
+/**
+ * The decoding thread.
+ */
+static void* aacd_output_run( void *arg )
+{
+    AACDOutput *out = (AACDOutput*) arg;
+    AACDInfo *info = out->info;
+
+    if (out->thread_attach) out->thread_attach( out );
+
+    AACD_DEBUG( "run() started" );
+
+    unsigned long maxround = out->ringlen / AACD_OUTPUT_ROUND_DIV;
+
+    if (maxround < out->scratchlen) maxround = out->scratchlen;
+
+    while (!__atomic_load_n( &out->stopped, __ATOMIC_ACQUIRE ))
+    {
+        unsigned long w = out->wpos;
+        unsigned long filled = aacd_ring_filled( out, w, __atomic_load_n( &out->rpos, __ATOMIC_ACQUIRE ));
+        unsigned long space = out->ringlen - filled;
+
+        if (space < out->scratchlen)
+        {
+            // the ring is full - the sink must be running now:
+            aacd_output_start_sink( out );
+
+            if (!aacd_output_wait_space( out )) break;
+
+            continue;
+        }
+
+        unsigned long off = aacd_ring_offset( out, w );
+        unsigned long contiguous = out->ringlen - off;
+
+        if (contiguous > space) contiguous = space;
+        if (contiguous > maxround) contiguous = maxround;
+
+        if (contiguous >= out->scratchlen)
+        {
+            aacd_decode( info, out->ring + off, contiguous );
+        }
+        else
+        {
+            // the frame would cross the end of the ring:
+            aacd_decode( info, out->scratch, out->scratchlen );
+
+            unsigned long n = info->round_samples;
+            unsigned long n1 = n < contiguous ? n : contiguous;
+
+            memcpy( out->ring + off, out->scratch, n1 * sizeof( short ));
+            memcpy( out->ring, out->scratch + n1, (n - n1) * sizeof( short ));
+        }
+
+        if (!info->round_frames) break;
+
+        __atomic_store_n( &out->wpos, aacd_ring_advance( out, w, info->round_samples ), __ATOMIC_RELEASE );
+
+        if (filled + info->round_samples >= out->prebuffer) aacd_output_start_sink( out );
+    }
+
+    AACD_DEBUG( "run() finished decoding" );
+
+    __atomic_store_n( &out->eof, 1, __ATOMIC_RELEASE );
+
+    // a short stream - the sink plays what was decoded:
+    if (!__atomic_load_n( &out->stopped, __ATOMIC_ACQUIRE )) aacd_output_start_sink( out );
+
+    if (out->thread_detach) out->thread_detach( out );
+
+    return NULL;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Sink
+ ****************************************************************************************************/
+
+/**
+ * Sink: copies the decoded samples from the ring. Never blocks.
+ * If there are not enough samples (underrun), then the rest is filled by silence,
+ * unless the stream is at the end.
+ * @return the number of decoded samples copied (silence not included)
+ */
+int aacd_output_pull( AACDOutput *out, short *samples, int len )
+{
+    // the eof flag is set after the last write:
+    int eof = __atomic_load_n( &out->eof, __ATOMIC_ACQUIRE );
+    unsigned long r = out->rpos;
+    unsigned long avail = aacd_ring_filled( out, __atomic_load_n( &out->wpos, __ATOMIC_ACQUIRE ), r );
+    unsigned long n = avail < (unsigned long) len ? avail : (unsigned long) len;
+
+    unsigned long off = aacd_ring_offset( out, r );
+    unsigned long n1 = out->ringlen - off;
+
+    if (n1 > n) n1 = n;
+
+    memcpy( samples, out->ring + off, n1 * sizeof( short ));
+    memcpy( samples + n1, out->ring, (n - n1) * sizeof( short ));
+
+    __atomic_store_n( &out->rpos, aacd_ring_advance( out, r, n ), __ATOMIC_SEQ_CST );
+
+    out->played += n;
+
+    if (n < (unsigned long) len)
+    {
+        memset( samples + n, 0, (len - n) * sizeof( short ));
+
+        if (!eof)
+        {
+            out->underruns++;
+            aacd_metrics_count( AACD_METRIC_OUT_UNDERRUNS, 1 );
+        }
+    }
+
+    // wake up the decoding thread - only once:
+    if (avail - n <= out->lowmark && __atomic_load_n( &out->waiting, __ATOMIC_SEQ_CST )
+        && __atomic_exchange_n( &out->waiting, 0, __ATOMIC_SEQ_CST ))
+    {
+        sem_post( &out->space );
+    }
+
+    return (int) n;
+}
+
+
+/**
+ * Sink: returns true if the decoding finished and all samples were pulled.
+ */
+int aacd_output_drained( AACDOutput *out )
+{
+    return __atomic_load_n( &out->eof, __ATOMIC_ACQUIRE )
+        && __atomic_load_n( &out->wpos, __ATOMIC_ACQUIRE ) == out->rpos;
+}
+
+
+/**
+ * Sink: notifies that all the samples were played.
+ */
+void aacd_output_finish( AACDOutput *out )
+{
+    if (!__atomic_exchange_n( &out->finished, 1, __ATOMIC_SEQ_CST ))
+    {
+        AACD_DEBUG( "finish() played=%llu, underruns=%lu", out->played, out->underruns );
+        sem_post( &out->done );
+    }
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Returns the sink by its name or NULL.
+ */
+AACDSink* aacd_sink_get_by_name( const char *name )
+{
+    int i;
+
+    for (i=0; i < AACD_SINKS_COUNT; i++)
+    {
+        AACDSink *sink = aacd_sinks[i];
+
+        if (!strcmp( name, sink->name())) return sink;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Starts the output - opens the sink and starts the decoding thread.
+ */
+AACDOutput* aacd_output_start( AACDInfo *info, AACDSink *sink, const char *param, unsigned long bufferMs,
+                               void (*thread_attach)( AACDOutput* ), void (*thread_detach)( AACDOutput* ))
+{
+    if (!info->samplerate || !info->channels)
+    {
+        AACD_ERROR( "output_start() unknown stream format" );
+        return NULL;
+    }
+
+    AACDOutput *out = (AACDOutput*) calloc( 1, sizeof( struct AACDOutput ));
+
+    out->info = info;
+    out->sink = sink;
+    out->sink_param = param ? strdup( param ) : NULL;
+    out->thread_attach = thread_attach;
+    out->thread_detach = thread_detach;
+
+    out->scratchlen = AACD_OUTPUT_MAX_FRAME * info->channels;
+    if (out->scratchlen < info->frame_samples) out->scratchlen = info->frame_samples;
+
+    out->ringlen = info->samplerate * info->channels * bufferMs / 1000;
+
+    // at least the prebuffer + one frame:
+    if (out->ringlen < 4 * out->scratchlen) out->ringlen = 4 * out->scratchlen;
+
+    out->prebuffer = out->ringlen / 2;
+    out->lowmark = out->ringlen / 2;
+
+    out->ring = (short*) malloc( sizeof( short ) * out->ringlen );
+    out->scratch = (short*) malloc( sizeof( short ) * out->scratchlen );
+
+    sem_init( &out->space, 0, 0 );
+    sem_init( &out->done, 0, 0 );
+
+    AACD_DEBUG( "output_start() sink=%s, ringlen=%lu, prebuffer=%lu",
+            sink->name(), out->ringlen, out->prebuffer );
+
+    if (sink->open( out ))
+    {
+        AACD_ERROR( "output_start() cannot open sink %s", sink->name());
+        out->sink = NULL;
+        aacd_output_stop( out );
+
+        return NULL;
+    }
+
+    if (pthread_create( &out->thread, NULL, aacd_output_run, out ))
+    {
+        AACD_ERROR( "output_start() cannot create the decoding thread" );
+        aacd_output_stop( out );
+
+        return NULL;
+    }
+
+    out->running = 1;
+
+    return out;
+}
+
+
+/**
+ * Waits until all the samples are played.
+ * @param timeoutMs the max time to wait; negative = forever
+ * @return 1 if finished, 0 on timeout
+ */
+int aacd_output_wait( AACDOutput *out, long timeoutMs )
+{
+    if (__atomic_load_n( &out->finished, __ATOMIC_ACQUIRE )) return 1;
+
+    if (timeoutMs < 0)
+    {
+        while (sem_wait( &out->done ) && errno == EINTR);
+    }
+    else
+    {
+        struct timespec ts;
+        clock_gettime( CLOCK_REALTIME, &ts );
+
+        ts.tv_sec += timeoutMs / 1000;
+        ts.tv_nsec += (timeoutMs % 1000) * 1000000L;
+
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        while (sem_timedwait( &out->done, &ts ) && errno == EINTR);
+    }
+
+    return __atomic_load_n( &out->finished, __ATOMIC_ACQUIRE );
+}
+
+
+/**
+ * Stops the output immediately - stops the decoding thread and closes the sink.
+ */
+void aacd_output_stop( AACDOutput *out )
+{
+    __atomic_store_n( &out->stopped, 1, __ATOMIC_SEQ_CST );
+
+    if (out->running)
+    {
+        sem_post( &out->space );
+        pthread_join( out->thread, NULL );
+    }
+
+    AACD_DEBUG( "output_stop() played=%llu, underruns=%lu", out->played, out->underruns );
+
+    if (out->sink) out->sink->close( out );
+
+    sem_destroy( &out->space );
+    sem_destroy( &out->done );
+
+    if (out->ring) free( out->ring );
+    if (out->scratch) free( out->scratch );
+    if (out->sink_param) free( out->sink_param );
+
+    free( out );
+}
+
+
+/**
+ * Returns the number of samples decoded and not passed to the sink yet.
+ */
+unsigned long aacd_output_buffered( AACDOutput *out )
+{
+    return aacd_ring_filled( out, __atomic_load_n( &out->wpos, __ATOMIC_ACQUIRE ),
+                                  __atomic_load_n( &out->rpos, __ATOMIC_ACQUIRE ));
+}
+
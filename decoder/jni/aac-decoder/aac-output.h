@@ -0,0 +1,203 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAC_OUTPUT_H
+#define AAC_OUTPUT_H
+
+#include "aac-common.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Native audio output.
+ * The samples are decoded by a native thread into a lock-free PCM ring
+ * which is drained by the sink (e.g. from the audio callback) - no PCM data
+ * pass through Java.
+ *
+ *   decoding thread: aacd_decode() -> ring  (sleeps while the ring is filled)
+ *   sink:            ring -> aacd_output_pull() -> audio device / file
+ */
+typedef struct AACDOutput {
+
+    /**
+     * The decoding session.
+     */
+    AACDInfo *info;
+
+    /**
+     * The sink.
+     */
+    struct AACDSink *sink;
+
+    /**
+     * Sink's own data.
+     */
+    void *sink_ext;
+
+    /**
+     * Sink's parameter - e.g. the file name; can be NULL.
+     */
+    char *sink_param;
+
+    // the PCM ring - the positions wrap at 2*ringlen:
+    short *ring;
+    unsigned long ringlen;
+    unsigned long wpos;         // written only by the decoding thread
+    unsigned long rpos;         // written only by the sink
+
+    // the decoding thread is woken up when the ring is drained below this level:
+    unsigned long lowmark;
+
+    // the sink is started when this level is reached (or at the end of the stream):
+    unsigned long prebuffer;
+
+    // frame that does not fit into the contiguous free space is decoded here:
+    short *scratch;
+    unsigned long scratchlen;
+
+    pthread_t thread;
+    int running;                // the decoding thread was created
+    sem_t space;                // posted by the sink when the decoding thread waits
+    sem_t done;                 // posted when the sink played everything
+
+    int waiting;                // the decoding thread is waiting for space
+    int started;                // the sink was started
+    int stopped;                // stop requested
+    int eof;                    // no more samples will be written
+    int finished;               // the sink played everything
+
+    // statistics:
+    unsigned long underruns;    // number of pulls not satisfied
+    unsigned long long played;  // samples passed to the sink
+
+    /**
+     * Called by the decoding thread when it starts / ends - can be NULL.
+     * Allows to attach the thread to the Java VM (the reader may be a Java object).
+     */
+    void (*thread_attach)( struct AACDOutput* );
+    void (*thread_detach)( struct AACDOutput* );
+
+} AACDOutput;
+
+
+/**
+ * Output sink definition.
+ */
+typedef struct AACDSink {
+    /**
+     * Returns the name of the sink.
+     */
+    const char* (*name)();
+
+    /**
+     * Opens the sink for the stream format (info->samplerate and info->channels).
+     * Called before the decoding thread starts.
+     * @return 0=OK, otherwise error.
+     */
+    int (*open)( AACDOutput* );
+
+    /**
+     * Starts draining the ring by aacd_output_pull().
+     * Called by the decoding thread when the prebuffer is filled.
+     * When the pull returns 0 and the output is at the end (eof),
+     * the sink should call aacd_output_finish() once all the samples are played.
+     * @return 0=OK, otherwise error.
+     */
+    int (*start)( AACDOutput* );
+
+    /**
+     * Stops the sink and frees all resources - sink_ext.
+     * After this call the ring must not be accessed.
+     */
+    void (*close)( AACDOutput* );
+
+} AACDSink;
+
+
+/**
+ * Returns the sink by its name or NULL.
+ */
+AACDSink* aacd_sink_get_by_name( const char *name );
+
+
+/**
+ * Starts the output - opens the sink and starts the decoding thread.
+ * The info must not be used by the caller until aacd_output_stop() is called.
+ * @param param the sink's parameter (e.g. the file name) or NULL
+ * @param bufferMs the capacity of the PCM ring in milliseconds
+ * @return the new output or NULL on failure
+ */
+AACDOutput* aacd_output_start( AACDInfo *info, AACDSink *sink, const char *param, unsigned long bufferMs,
+                               void (*thread_attach)( AACDOutput* ), void (*thread_detach)( AACDOutput* ));
+
+
+/**
+ * Waits until all the samples are played.
+ * @param timeoutMs the max time to wait; negative = forever
+ * @return 1 if finished, 0 on timeout
+ */
+int aacd_output_wait( AACDOutput *out, long timeoutMs );
+
+
+/**
+ * Stops the output immediately - stops the decoding thread and closes the sink.
+ * The info can be used (stopped) by the caller again.
+ */
+void aacd_output_stop( AACDOutput *out );
+
+
+/**
+ * Returns the number of samples decoded and not passed to the sink yet.
+ */
+unsigned long aacd_output_buffered( AACDOutput *out );
+
+
+/**
+ * Sink: copies the decoded samples from the ring. Never blocks.
+ * If there are not enough samples (underrun), then the rest is filled by silence,
+ * unless the stream is at the end.
+ * @return the number of decoded samples copied (silence not included)
+ */
+int aacd_output_pull( AACDOutput *out, short *samples, int len );
+
+
+/**
+ * Sink: returns true if the decoding finished and all samples were pulled.
+ */
+int aacd_output_drained( AACDOutput *out );
+
+
+/**
+ * Sink: notifies that all the samples were played.
+ */
+void aacd_output_finish( AACDOutput *out );
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
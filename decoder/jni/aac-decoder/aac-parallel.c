@@ -0,0 +1,363 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Offline decoding of one file by several threads - see aac-parallel.h.
+ *
+ * The frames are found by walking their headers (like seeking does),
+ * so the segments begin at validated frame boundaries. Each segment
+ * is decoded by its own session from the preroll frames on; the decoded frames
+ * are attributed by their byte offsets - not by counting them - so a frame
+ * the decoder skips during the preroll (e.g. missing MP3 bit reservoir)
+ * does not shift the join.
+ */
+
+#define AACD_MODULE "Parallel"
+
+#include "aac-parallel.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The max samples (all channels) produced by one frame (AAC+ stereo).
+ */
+#define AACD_PARALLEL_MAX_FRAME 4096
+
+/**
+ * The number of bytes handed over to the decoder by one read.
+ */
+#define AACD_PARALLEL_CHUNK     65536
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+typedef struct AACDSegment {
+    AACDDecoder *decoder;
+    pthread_t thread;
+    int started;
+
+    // the input of the session (including the preroll) and the read position:
+    unsigned char *data;
+    unsigned long size;
+    unsigned long pos;
+
+    // the frames beginning in [begin, end) are kept (offsets in data):
+    unsigned long begin;
+    unsigned long end;
+
+    // the longest frame decoded by the serial decoding before this session starts:
+    unsigned long maxframe;
+
+    short *samples;
+    unsigned long len;
+    unsigned long cap;
+
+    unsigned long samplerate;
+    unsigned char channels;
+    int err;
+} AACDSegment;
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Reader
+ ****************************************************************************************************/
+
+static const char* aacd_segment_reader_name()
+{
+    return "Segment";
+}
+
+
+/**
+ * Hands over the next chunk of the segment - decoded in place.
+ */
+static long aacd_segment_reader_read( AACDInfo *info )
+{
+    AACDSegment *seg = (AACDSegment*) info->reader_ext;
+
+    unsigned long len = seg->size - seg->pos;
+
+    if (len > AACD_PARALLEL_CHUNK) len = AACD_PARALLEL_CHUNK;
+    if (!len) return 0;
+
+    unsigned char *data = seg->data + seg->pos;
+
+    // the leftover is right before the chunk:
+    if (info->bytesleft && !info->direct && info->buffer + info->bytesleft == data) info->bytesleft += len;
+    else aacd_direct_buffer( info, data, len );
+
+    seg->pos += len;
+
+    return (long) len;
+}
+
+
+static AACDReader aacd_segment_reader = {
+    aacd_segment_reader_name,
+    aacd_segment_reader_read,
+    NULL,
+    NULL
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Finds the offsets of all frames by walking their headers.
+ * @return the offsets (must be freed) or NULL if no frame was found
+ */
+static unsigned long* aacd_parallel_frames( AACDDecoder *decoder, unsigned char *data, unsigned long size, unsigned long *count )
+{
+    // the sync functions do not need the session:
+    AACDInfo probe;
+    memset( &probe, 0, sizeof( probe ));
+    probe.decoder = decoder;
+
+    int limit = size > INT_MAX ? INT_MAX : (int) size;
+    int first = decoder->sync( &probe, data, limit );
+
+    unsigned long *frames = NULL;
+    unsigned long n = 0;
+    unsigned long cap = 0;
+
+    if (first < 0) return NULL;
+
+    unsigned long pos = (unsigned long) first;
+
+    // the longest header (ADTS) is 7 bytes:
+    while (pos + 8 <= size)
+    {
+        limit = size - pos > INT_MAX ? INT_MAX : (int) (size - pos);
+
+        int len = decoder->header( data + pos, limit );
+
+        if (len > 0)
+        {
+            // the truncated last frame:
+            if (pos + len > size) break;
+
+            if (n == cap)
+            {
+                cap = cap ? cap * 2 : 4096;
+                frames = (unsigned long*) realloc( frames, sizeof( unsigned long ) * cap );
+            }
+
+            frames[ n++ ] = pos;
+            pos += len;
+
+            continue;
+        }
+
+        int skip = decoder->sync( &probe, data + pos + 1, limit - 1 );
+
+        if (skip < 0) break;
+
+        pos += skip + 1;
+    }
+
+    *count = n;
+
+    return frames;
+}
+
+
+static void aacd_segment_append( AACDSegment *seg, short *samples, unsigned long len )
+{
+    if (seg->len + len > seg->cap)
+    {
+        seg->cap = seg->cap ? seg->cap * 2 : 65536;
+        if (seg->cap < seg->len + len) seg->cap = seg->len + len;
+
+        seg->samples = (short*) realloc( seg->samples, sizeof( short ) * seg->cap );
+    }
+
+    memcpy( seg->samples + seg->len, samples, sizeof( short ) * len );
+    seg->len += len;
+}
+
+
+/**
+ * Decodes one segment - one frame per round.
+ */
+static void* aacd_segment_run( void *data )
+{
+    AACDSegment *seg = (AACDSegment*) data;
+
+    AACDInfo *info = aacd_start( seg->decoder, &aacd_segment_reader, seg );
+
+    if (!info)
+    {
+        seg->err = -1;
+        return NULL;
+    }
+
+    seg->samplerate = info->samplerate;
+    seg->channels = info->channels;
+
+    // continue the statistics of the serial decoding - so the end of the stream is detected at the same frame:
+    if (seg->maxframe > info->frame_max_bytesconsumed_exact)
+    {
+        info->frame_max_bytesconsumed_exact = seg->maxframe;
+        info->frame_max_bytesconsumed = seg->maxframe * 3 / 2;
+    }
+
+    short *samples = (short*) malloc( sizeof( short ) * AACD_PARALLEL_MAX_FRAME );
+
+    for (;;)
+    {
+        int outLen = info->frame_samples && info->frame_samples < AACD_PARALLEL_MAX_FRAME ? info->frame_samples : AACD_PARALLEL_MAX_FRAME;
+
+        aacd_decode( info, samples, outLen );
+
+        if (!info->round_frames) break;
+
+        // the preroll frames are dropped:
+        if (info->stream_pos - info->round_bytesconsumed >= seg->begin) aacd_segment_append( seg, samples, info->round_samples );
+
+        if (info->stream_pos >= seg->end) break;
+    }
+
+    free( samples );
+    aacd_stop( info );
+
+    return NULL;
+}
+
+
+/**
+ * Decodes a whole file in memory by several threads at once.
+ * @return 0=OK, otherwise error
+ */
+int aacd_parallel_decode( AACDDecoder *decoder, unsigned char *data, unsigned long size,
+                          int threads, int preroll, AACDParallelResult *result )
+{
+    memset( result, 0, sizeof( AACDParallelResult ));
+
+    if (threads < 1) threads = 1;
+    if (preroll < 0) preroll = 0;
+
+    if (!decoder->header)
+    {
+        AACD_ERROR( "decode() the decoder cannot walk the frames" );
+        return -1;
+    }
+
+    unsigned long n = 0;
+    unsigned long *frames = aacd_parallel_frames( decoder, data, size, &n );
+
+    if (!frames)
+    {
+        AACD_ERROR( "decode() no frame found" );
+        return -1;
+    }
+
+    if ((unsigned long) threads > n) threads = (int) n;
+
+    unsigned long maxlen = 0;
+    unsigned long i;
+
+    for (i=0; i+1 < n; i++)
+    {
+        if (frames[i+1] - frames[i] > maxlen) maxlen = frames[i+1] - frames[i];
+    }
+
+    if (size - frames[ n-1 ] > maxlen) maxlen = size - frames[ n-1 ];
+
+    AACDSegment *segs = (AACDSegment*) calloc( threads, sizeof( AACDSegment ));
+    unsigned long prefixmax = 0;
+    unsigned long k = 1;
+    int t;
+
+    for (t=0; t < threads; t++)
+    {
+        AACDSegment *seg = segs + t;
+
+        unsigned long s = n * t / threads;
+        unsigned long e = n * (t+1) / threads;
+        unsigned long b = s > (unsigned long) preroll ? s - preroll : 0;
+
+        // the first segment starts like the serial decoding - with the sync:
+        unsigned long base = b ? frames[b] : 0;
+        unsigned long last = t == threads-1 ? size : frames[e] + 2 * maxlen;
+
+        // the frames 1..b are decoded by the serial decoding's loop before (the frame 0 by start()):
+        for (; k <= b && k+1 < n; k++)
+        {
+            if (frames[k+1] - frames[k] > prefixmax) prefixmax = frames[k+1] - frames[k];
+        }
+
+        seg->decoder = decoder;
+        seg->data = data + base;
+        seg->size = (last < size ? last : size) - base;
+        seg->begin = frames[s] - base;
+        seg->end = t == threads-1 ? ULONG_MAX : frames[e] - base;
+        seg->maxframe = b ? prefixmax : 0;
+
+        seg->started = !pthread_create( &seg->thread, NULL, aacd_segment_run, seg );
+
+        if (!seg->started)
+        {
+            AACD_WARN( "decode() cannot start a thread - decoding segment %d serially", t );
+            aacd_segment_run( seg );
+        }
+    }
+
+    int err = 0;
+    unsigned long len = 0;
+
+    for (t=0; t < threads; t++)
+    {
+        if (segs[t].started) pthread_join( segs[t].thread, NULL );
+        if (segs[t].err) err = -1;
+
+        len += segs[t].len;
+    }
+
+    if (!err)
+    {
+        result->samples = (short*) malloc( sizeof( short ) * (len ? len : 1));
+        result->samplerate = segs[0].samplerate;
+        result->channels = segs[0].channels;
+        result->frames = n;
+
+        for (t=0; t < threads; t++)
+        {
+            if (segs[t].len) memcpy( result->samples + result->len, segs[t].samples, sizeof( short ) * segs[t].len );
+            result->len += segs[t].len;
+        }
+    }
+    else AACD_ERROR( "decode() a segment cannot be decoded" );
+
+    for (t=0; t < threads; t++) free( segs[t].samples );
+
+    free( segs );
+    free( frames );
+
+    return err;
+}
+
@@ -0,0 +1,84 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAC_PARALLEL_H
+#define AAC_PARALLEL_H
+
+#include "aac-common.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * The default number of frames decoded and dropped before each segment -
+ * enough to settle the MDCT overlap, the SBR state and the MP3 bit reservoir.
+ */
+#define AACD_PARALLEL_PREROLL   8
+
+
+/**
+ * The result of the offline decoding.
+ */
+typedef struct AACDParallelResult {
+
+    /**
+     * The decoded samples (all channels interleaved) - must be freed by the caller.
+     */
+    short *samples;
+
+    /**
+     * The number of samples (all channels).
+     */
+    unsigned long len;
+
+    unsigned long samplerate;
+    unsigned char channels;
+
+    /**
+     * The number of frames found in the input (by their headers).
+     */
+    unsigned long frames;
+
+} AACDParallelResult;
+
+
+/**
+ * Decodes a whole ADTS AAC / MP3 file in memory by several threads at once (offline).
+ * The file is split into segments at frame boundaries; each segment is decoded
+ * by its own decoder instance. The preroll frames before each segment are decoded
+ * and dropped, so the decoder's state is settled when the segment begins.
+ * The segments are joined at the same frames as the serial decoding produces them.
+ *
+ * @param data the whole file - it is not modified
+ * @param threads the number of segments (and threads)
+ * @param preroll the number of frames decoded before each segment - see AACD_PARALLEL_PREROLL
+ * @return 0=OK, otherwise error
+ */
+int aacd_parallel_decode( AACDDecoder *decoder, unsigned char *data, unsigned long size,
+                          int threads, int preroll, AACDParallelResult *result );
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
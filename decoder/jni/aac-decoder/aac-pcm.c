@@ -0,0 +1,152 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * PCM output formats - the 16-bit samples of the decoders are widened
+ * to 32-bit integers or floats 8 samples at once (SSE2 / NEON, scalar fallback).
+ * Both conversions are exact.
+ */
+
+#define AACD_MODULE "PCM"
+
+#include "aac-common.h"
+
+#include <string.h>
+
+#if !defined(AACD_PCM_NO_SIMD) && defined(__SSE2__)
+#define AACD_PCM_SSE2
+#include <emmintrin.h>
+#elif !defined(AACD_PCM_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define AACD_PCM_NEON
+#include <arm_neon.h>
+#endif
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+static void aacd_pcm_to_32( const short *in, int *out, unsigned long len )
+{
+    unsigned long i = 0;
+
+#if defined(AACD_PCM_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i*) (in + i) );
+
+        // the sample becomes the upper half - the lower half is zero:
+        _mm_storeu_si128( (__m128i*) (out + i), _mm_unpacklo_epi16( zero, s ));
+        _mm_storeu_si128( (__m128i*) (out + i + 4), _mm_unpackhi_epi16( zero, s ));
+    }
+#elif defined(AACD_PCM_NEON)
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t s = vld1q_s16( in + i );
+
+        vst1q_s32( out + i, vshll_n_s16( vget_low_s16( s ), 16 ));
+        vst1q_s32( out + i + 4, vshll_n_s16( vget_high_s16( s ), 16 ));
+    }
+#endif
+
+    for (; i < len; i++) out[i] = (int) in[i] * 65536;
+}
+
+
+static void aacd_pcm_to_float( const short *in, float *out, unsigned long len )
+{
+    const float scale = 1.0f / 32768.0f;
+    unsigned long i = 0;
+
+#if defined(AACD_PCM_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 k = _mm_set1_ps( scale );
+
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i*) (in + i) );
+
+        // sign extension: the sample is moved to the upper half and shifted back:
+        __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( zero, s ), 16 );
+        __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( zero, s ), 16 );
+
+        _mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( lo ), k ));
+        _mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( hi ), k ));
+    }
+#elif defined(AACD_PCM_NEON)
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t s = vld1q_s16( in + i );
+
+        vst1q_f32( out + i, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( s ))), scale ));
+        vst1q_f32( out + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( s ))), scale ));
+    }
+#endif
+
+    for (; i < len; i++) out[i] = in[i] * scale;
+}
+
+
+/**
+ * Returns the size of one sample in bytes or 0 if the format is not known.
+ */
+int aacd_pcm_size( int format )
+{
+    switch (format)
+    {
+        case AACD_PCM_16: return sizeof( short );
+        case AACD_PCM_32: return sizeof( int );
+        case AACD_PCM_FLOAT: return sizeof( float );
+    }
+
+    return 0;
+}
+
+
+/**
+ * Converts the 16-bit samples into the output format.
+ */
+void aacd_pcm_convert( int format, const short *in, void *out, unsigned long len )
+{
+    switch (format)
+    {
+        case AACD_PCM_16: if ((const void*) in != out) memcpy( out, in, sizeof( short ) * len ); break;
+        case AACD_PCM_32: aacd_pcm_to_32( in, (int*) out, len ); break;
+        case AACD_PCM_FLOAT: aacd_pcm_to_float( in, (float*) out, len ); break;
+        default: AACD_ERROR( "convert() unknown format %d", format );
+    }
+}
+
+
+/**
+ * Decodes the stream like aacd_decode() and stores the samples in the output format.
+ */
+void aacd_decode_pcm( AACDInfo *info, int format, void *out, int outLen )
+{
+    // the pending first samples are already stored in the internal buffer:
+    short *samples = aacd_prepare_samples( info, outLen );
+
+    aacd_decode( info, samples, outLen );
+
+    aacd_pcm_convert( format, samples, out, info->round_samples );
+}
+
@@ -0,0 +1,228 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Pool of the decoders' contexts (the structs returned by AACDDecoder.init()).
+ * A stopped stream returns its context to the pool and the next stream
+ * of the same decoder takes it - so switching streams does not allocate
+ * and initialize the codec's memory again. Only the decoders supporting
+ * recycle() are pooled.
+ */
+
+#define AACD_MODULE "Pool"
+
+#include "aac-common.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The max number of the decoders pooled.
+ */
+#define AACD_POOL_DECODERS  4
+
+/**
+ * The max number of the contexts pooled per decoder.
+ */
+#define AACD_POOL_SIZE      2
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+typedef struct AACDPoolEntry {
+    AACDDecoder *decoder;
+    void *exts[ AACD_POOL_SIZE ];
+    int len;
+} AACDPoolEntry;
+
+
+static AACDPoolEntry aacd_pool[ AACD_POOL_DECODERS ];
+
+static pthread_mutex_t aacd_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Returns the entry of the decoder - must be called with the mutex locked.
+ * @param create if true, then a free entry is assigned to the decoder
+ */
+static AACDPoolEntry* aacd_pool_entry( AACDDecoder *decoder, int create )
+{
+    int i;
+
+    for (i=0; i < AACD_POOL_DECODERS; i++)
+    {
+        if (aacd_pool[i].decoder == decoder) return aacd_pool + i;
+    }
+
+    if (!create) return NULL;
+
+    for (i=0; i < AACD_POOL_DECODERS; i++)
+    {
+        if (!aacd_pool[i].decoder)
+        {
+            aacd_pool[i].decoder = decoder;
+            return aacd_pool + i;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Destroys the context - the decoders' destroy() functions need just the ext field.
+ */
+static void aacd_pool_destroy( AACDDecoder *decoder, void *ext )
+{
+    AACDInfo info;
+    memset( &info, 0, sizeof( info ));
+    info.ext = ext;
+
+    decoder->destroy( &info );
+}
+
+
+/**
+ * Returns a pooled context of the decoder or a new one created by init().
+ */
+void* aacd_pool_get( AACDDecoder *decoder )
+{
+    void *ext = NULL;
+
+    if (decoder->recycle)
+    {
+        pthread_mutex_lock( &aacd_pool_mutex );
+
+        AACDPoolEntry *e = aacd_pool_entry( decoder, 0 );
+        if (e && e->len) ext = e->exts[ --e->len ];
+
+        pthread_mutex_unlock( &aacd_pool_mutex );
+    }
+
+    if (ext)
+    {
+        AACD_DEBUG( "get() reusing the context of %s", decoder->name());
+        return ext;
+    }
+
+    return decoder->init();
+}
+
+
+/**
+ * Recycles the context and returns it to the pool.
+ * @return 1 if pooled, 0 if the caller must destroy the context
+ */
+int aacd_pool_put( AACDDecoder *decoder, void *ext )
+{
+    if (!ext || !decoder->recycle) return 0;
+
+    // the expensive part is done outside of the lock:
+    if (decoder->recycle( ext ))
+    {
+        AACD_WARN( "put() cannot recycle the context of %s", decoder->name());
+        return 0;
+    }
+
+    pthread_mutex_lock( &aacd_pool_mutex );
+
+    AACDPoolEntry *e = aacd_pool_entry( decoder, 1 );
+    int pooled = e && e->len < AACD_POOL_SIZE;
+
+    if (pooled) e->exts[ e->len++ ] = ext;
+
+    pthread_mutex_unlock( &aacd_pool_mutex );
+
+    return pooled;
+}
+
+
+/**
+ * Creates a context in advance if there is none pooled - so the next
+ * aacd_start() of the decoder does not allocate and initialize the codec.
+ * @return 0=OK, otherwise error (the decoder does not support pooling)
+ */
+int aacd_pool_prewarm( AACDDecoder *decoder )
+{
+    if (!decoder->recycle) return -1;
+
+    pthread_mutex_lock( &aacd_pool_mutex );
+
+    AACDPoolEntry *e = aacd_pool_entry( decoder, 0 );
+    int empty = !e || !e->len;
+
+    pthread_mutex_unlock( &aacd_pool_mutex );
+
+    if (!empty) return 0;
+
+    void *ext = decoder->init();
+
+    if (!ext) return -1;
+
+    // a fresh context is put without recycling:
+    pthread_mutex_lock( &aacd_pool_mutex );
+
+    e = aacd_pool_entry( decoder, 1 );
+    int pooled = e && e->len < AACD_POOL_SIZE;
+
+    if (pooled) e->exts[ e->len++ ] = ext;
+
+    pthread_mutex_unlock( &aacd_pool_mutex );
+
+    if (!pooled) aacd_pool_destroy( decoder, ext );
+
+    AACD_DEBUG( "prewarm() %s", decoder->name());
+
+    return 0;
+}
+
+
+/**
+ * Destroys all pooled contexts.
+ */
+void aacd_pool_clear()
+{
+    int i;
+
+    for (i=0; i < AACD_POOL_DECODERS; i++)
+    {
+        pthread_mutex_lock( &aacd_pool_mutex );
+
+        AACDDecoder *decoder = aacd_pool[i].decoder;
+        int len = aacd_pool[i].len;
+        void *exts[ AACD_POOL_SIZE ];
+
+        memcpy( exts, aacd_pool[i].exts, sizeof( exts ));
+        aacd_pool[i].len = 0;
+
+        pthread_mutex_unlock( &aacd_pool_mutex );
+
+        while (len--) aacd_pool_destroy( decoder, exts[ len ] );
+    }
+}
+
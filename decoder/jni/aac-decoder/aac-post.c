@@ -0,0 +1,567 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Downmix and resampler - see aac-post.h.
+ *
+ * The resampler is a rational (up/down) polyphase FIR: a Kaiser windowed sinc
+ * of AACD_POST_TAPS * up taps is split into up branches of AACD_POST_TAPS taps
+ * (Q15, each branch normalized to the unity DC gain). Every output sample is
+ * one dot product of a branch and the last AACD_POST_TAPS input samples -
+ * 8 taps at once by SSE2 (pmaddwd) / NEON (vmlal).
+ * The channels are kept deinterleaved in the history buffers, so the input
+ * of the dot products is contiguous.
+ */
+
+#define AACD_MODULE "Post"
+
+#include "aac-post.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(AACD_POST_NO_SIMD) && defined(__SSE2__)
+#define AACD_POST_SSE2
+#include <emmintrin.h>
+#elif !defined(AACD_POST_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define AACD_POST_NEON
+#include <arm_neon.h>
+#endif
+
+
+/**
+ * The max number of the polyphase branches (e.g. 22050 -> 48000 needs 320).
+ */
+#define AACD_POST_MAX_UP    1024
+
+/**
+ * The Kaiser window beta - about 80 dB stopband attenuation.
+ */
+#define AACD_POST_BETA      8.0
+
+/**
+ * The passband edge relative to the lower Nyquist frequency.
+ */
+#define AACD_POST_CUTOFF    0.91
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+/**
+ * The channel roles of the downmix.
+ */
+enum {
+    AACD_POST_FRONT_L,
+    AACD_POST_FRONT_R,
+    AACD_POST_CENTER,
+    AACD_POST_SURROUND_L,
+    AACD_POST_SURROUND_R,
+    AACD_POST_SURROUND_C,
+    AACD_POST_LFE
+};
+
+
+struct AACDPost {
+    int channels;
+    int outChannels;
+
+    unsigned long inRate;
+    unsigned long outRate;
+
+    // the downmix - the roles of the input channels and the Q15 gains [output][input]:
+    const signed char *roles;
+    int matrix[2][8];
+
+    // the resampler - 0 if not resampling:
+    unsigned int up;
+    unsigned int down;
+
+    // the branches (AACD_POST_TAPS each) and their fixed-point shift:
+    short *coefs;
+    int shift;
+
+    // the state - the branch and the first tap of the next output sample:
+    unsigned int phase;
+    unsigned long pos;
+
+    // the deinterleaved input (the history + the new samples):
+    short *hist[2];
+    unsigned long histLen;
+    unsigned long histCap;
+};
+
+
+/**
+ * The roles of the channels by the AAC channel configurations (by the number of channels).
+ */
+static const signed char aacd_post_roles3[] = { AACD_POST_CENTER, AACD_POST_FRONT_L, AACD_POST_FRONT_R };
+static const signed char aacd_post_roles4[] = { AACD_POST_CENTER, AACD_POST_FRONT_L, AACD_POST_FRONT_R, AACD_POST_SURROUND_C };
+static const signed char aacd_post_roles5[] = { AACD_POST_CENTER, AACD_POST_FRONT_L, AACD_POST_FRONT_R, AACD_POST_SURROUND_L, AACD_POST_SURROUND_R };
+static const signed char aacd_post_roles6[] = { AACD_POST_CENTER, AACD_POST_FRONT_L, AACD_POST_FRONT_R, AACD_POST_SURROUND_L, AACD_POST_SURROUND_R, AACD_POST_LFE };
+static const signed char aacd_post_roles8[] = { AACD_POST_CENTER, AACD_POST_FRONT_L, AACD_POST_FRONT_R, AACD_POST_FRONT_L, AACD_POST_FRONT_R,
+                                                AACD_POST_SURROUND_L, AACD_POST_SURROUND_R, AACD_POST_LFE };
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Filter design
+ ****************************************************************************************************/
+
+static unsigned long aacd_post_gcd( unsigned long a, unsigned long b )
+{
+    while (b)
+    {
+        unsigned long t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+
+/**
+ * The modified Bessel function of the first kind, order 0.
+ */
+static double aacd_post_i0( double x )
+{
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+
+    for (k=1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+
+        if (term < sum * 1e-12) break;
+    }
+
+    return sum;
+}
+
+
+/**
+ * Designs the polyphase branches.
+ * The branch p holds h[ p + (taps-1-k) * up ] at k - so the dot product runs over the input
+ * in the ascending order.
+ * @return 0=OK, otherwise error
+ */
+static int aacd_post_design( AACDPost *post )
+{
+    unsigned int up = post->up;
+    unsigned int len = AACD_POST_TAPS * up;
+
+    double *h = (double*) malloc( sizeof( double ) * len );
+    post->coefs = (short*) malloc( sizeof( short ) * len );
+
+    if (!h || !post->coefs)
+    {
+        free( h );
+        return -1;
+    }
+
+    // the cutoff in cycles per sample of the upsampled signal:
+    unsigned long minRate = post->inRate < post->outRate ? post->inRate : post->outRate;
+    double fc = AACD_POST_CUTOFF * minRate / 2.0 / ((double) post->inRate * up);
+    double center = (len - 1) / 2.0;
+    double i0beta = aacd_post_i0( AACD_POST_BETA );
+    unsigned int i;
+
+    for (i=0; i < len; i++)
+    {
+        double t = i - center;
+        double x = 2.0 * fc * t;
+        double sinc = fabs( x ) < 1e-9 ? 1.0 : sin( M_PI * x ) / (M_PI * x);
+        double r = t / center;
+        double w = aacd_post_i0( AACD_POST_BETA * sqrt( r < 1.0 ? 1.0 - r * r : 0.0 )) / i0beta;
+
+        h[i] = sinc * w;
+    }
+
+    // the branches are normalized to the unity DC gain - the largest sum of magnitudes
+    // determines the shift, so the 32-bit accumulators cannot overflow:
+    double maxabs = 0;
+    unsigned int p;
+    int k;
+
+    for (p=0; p < up; p++)
+    {
+        double sum = 0;
+        double abssum = 0;
+
+        for (k=0; k < AACD_POST_TAPS; k++) sum += h[ p + k * up ];
+        for (k=0; k < AACD_POST_TAPS; k++) abssum += fabs( h[ p + k * up ] / sum );
+
+        if (abssum > maxabs) maxabs = abssum;
+    }
+
+    post->shift = 15;
+
+    while (post->shift > 8 && maxabs * (1 << post->shift) >= 65535.0) post->shift--;
+
+    for (p=0; p < up; p++)
+    {
+        double sum = 0;
+        short *branch = post->coefs + p * AACD_POST_TAPS;
+
+        for (k=0; k < AACD_POST_TAPS; k++) sum += h[ p + k * up ];
+
+        for (k=0; k < AACD_POST_TAPS; k++)
+        {
+            branch[k] = (short) lrint( h[ p + (AACD_POST_TAPS - 1 - k) * up ] / sum * (1 << post->shift));
+        }
+    }
+
+    free( h );
+
+    return 0;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Kernels
+ ****************************************************************************************************/
+
+/**
+ * The dot product of AACD_POST_TAPS samples and a branch.
+ */
+static inline int aacd_post_dot( const short *x, const short *c )
+{
+    int k;
+
+#if defined(AACD_POST_SSE2)
+    __m128i acc = _mm_setzero_si128();
+
+    for (k=0; k < AACD_POST_TAPS; k += 8)
+    {
+        acc = _mm_add_epi32( acc, _mm_madd_epi16( _mm_loadu_si128( (const __m128i*) (x + k) ),
+                                                  _mm_loadu_si128( (const __m128i*) (c + k) )));
+    }
+
+    acc = _mm_add_epi32( acc, _mm_shuffle_epi32( acc, _MM_SHUFFLE( 1, 0, 3, 2 )));
+    acc = _mm_add_epi32( acc, _mm_shuffle_epi32( acc, _MM_SHUFFLE( 2, 3, 0, 1 )));
+
+    return _mm_cvtsi128_si32( acc );
+#elif defined(AACD_POST_NEON)
+    int32x4_t acc = vdupq_n_s32( 0 );
+
+    for (k=0; k < AACD_POST_TAPS; k += 8)
+    {
+        int16x8_t a = vld1q_s16( x + k );
+        int16x8_t b = vld1q_s16( c + k );
+
+        acc = vmlal_s16( acc, vget_low_s16( a ), vget_low_s16( b ));
+        acc = vmlal_s16( acc, vget_high_s16( a ), vget_high_s16( b ));
+    }
+
+    int32x2_t s = vadd_s32( vget_low_s32( acc ), vget_high_s32( acc ));
+
+    return vget_lane_s32( vpadd_s32( s, s ), 0 );
+#else
+    int acc = 0;
+
+    for (k=0; k < AACD_POST_TAPS; k++) acc += x[k] * c[k];
+
+    return acc;
+#endif
+}
+
+
+static inline short aacd_post_clip( long long v )
+{
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : (short) v;
+}
+
+
+/**
+ * Downmixes (or just deinterleaves) the input into the history buffers.
+ */
+static void aacd_post_deinterleave( AACDPost *post, const short *in, unsigned long frames, short **dst )
+{
+    unsigned long i;
+    int c;
+
+    if (post->channels <= 2)
+    {
+        for (c=0; c < post->channels; c++)
+        {
+            short *d = dst[c];
+            const short *s = in + c;
+
+            for (i=0; i < frames; i++, s += post->channels) d[i] = *s;
+        }
+
+        return;
+    }
+
+    for (i=0; i < frames; i++, in += post->channels)
+    {
+        long long l = 0;
+        long long r = 0;
+
+        for (c=0; c < post->channels; c++)
+        {
+            l += (long long) post->matrix[0][c] * in[c];
+            r += (long long) post->matrix[1][c] * in[c];
+        }
+
+        dst[0][i] = aacd_post_clip( (l + 16384) >> 15 );
+        dst[1][i] = aacd_post_clip( (r + 16384) >> 15 );
+    }
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+AACDPost* aacd_post_create( int channels, unsigned long inRate, unsigned long outRate )
+{
+    const signed char *roles = NULL;
+
+    switch (channels)
+    {
+        case 1: case 2: break;
+        case 3: roles = aacd_post_roles3; break;
+        case 4: roles = aacd_post_roles4; break;
+        case 5: roles = aacd_post_roles5; break;
+        case 6: roles = aacd_post_roles6; break;
+        case 8: roles = aacd_post_roles8; break;
+        default:
+            AACD_ERROR( "create() unsupported channels: %d", channels );
+            return NULL;
+    }
+
+    if (!inRate)
+    {
+        AACD_ERROR( "create() unknown input rate" );
+        return NULL;
+    }
+
+    if (!outRate) outRate = inRate;
+
+    unsigned long gcd = aacd_post_gcd( inRate, outRate );
+    unsigned long up = outRate / gcd;
+    unsigned long down = inRate / gcd;
+
+    // the resampler advances by at most AACD_POST_TAPS input samples per output sample:
+    if (inRate != outRate && (up > AACD_POST_MAX_UP || down > 8 * up))
+    {
+        AACD_ERROR( "create() unsupported rates: %lu -> %lu", inRate, outRate );
+        return NULL;
+    }
+
+    AACDPost *post = (AACDPost*) calloc( 1, sizeof( struct AACDPost ));
+
+    post->channels = channels;
+    post->outChannels = channels > 2 ? 2 : channels;
+    post->inRate = inRate;
+    post->outRate = outRate;
+    post->roles = roles;
+
+    if (roles) aacd_post_downmix( post, 0.7071f, 0.7071f, 0.0f, 1 );
+
+    if (inRate != outRate)
+    {
+        post->up = (unsigned int) up;
+        post->down = (unsigned int) down;
+
+        if (aacd_post_design( post ))
+        {
+            aacd_post_destroy( post );
+            return NULL;
+        }
+
+        aacd_post_reset( post );
+    }
+
+    AACD_DEBUG( "create() %d ch %lu Hz -> %d ch %lu Hz, up=%u, down=%u, shift=%d",
+                channels, inRate, post->outChannels, outRate, post->up, post->down, post->shift );
+
+    return post;
+}
+
+
+void aacd_post_downmix( AACDPost *post, float center, float surround, float lfe, int normalize )
+{
+    if (!post->roles) return;
+
+    float m[2][8];
+    int c, o;
+
+    memset( m, 0, sizeof( m ));
+
+    for (c=0; c < post->channels; c++)
+    {
+        switch (post->roles[c])
+        {
+            case AACD_POST_FRONT_L: m[0][c] = 1.0f; break;
+            case AACD_POST_FRONT_R: m[1][c] = 1.0f; break;
+            case AACD_POST_CENTER: m[0][c] = m[1][c] = center; break;
+            case AACD_POST_SURROUND_L: m[0][c] = surround; break;
+            case AACD_POST_SURROUND_R: m[1][c] = surround; break;
+            case AACD_POST_SURROUND_C: m[0][c] = m[1][c] = surround * 0.7071f; break;
+            case AACD_POST_LFE: m[0][c] = m[1][c] = lfe; break;
+        }
+    }
+
+    for (o=0; o < 2; o++)
+    {
+        float sum = 0;
+
+        for (c=0; c < post->channels; c++) sum += fabsf( m[o][c] );
+
+        float scale = normalize && sum > 1.0f ? 1.0f / sum : 1.0f;
+
+        for (c=0; c < post->channels; c++) post->matrix[o][c] = (int) lrintf( m[o][c] * scale * 32768.0f );
+    }
+}
+
+
+int aacd_post_channels( AACDPost *post )
+{
+    return post->outChannels;
+}
+
+
+unsigned long aacd_post_rate( AACDPost *post )
+{
+    return post->outRate;
+}
+
+
+unsigned long aacd_post_max_out( AACDPost *post, unsigned long inLen )
+{
+    unsigned long frames = inLen / post->channels;
+
+    if (post->up) frames = (frames + AACD_POST_TAPS) * post->up / post->down + 1;
+
+    return frames * post->outChannels;
+}
+
+
+unsigned long aacd_post_process( AACDPost *post, const short *in, unsigned long inLen, short *out )
+{
+    unsigned long frames = inLen / post->channels;
+    int oc = post->outChannels;
+    int c;
+
+    if (!post->up)
+    {
+        // no resampling - just the downmix:
+        if (post->channels <= 2)
+        {
+            if (in != out) memmove( out, in, sizeof( short ) * frames * oc );
+            return frames * oc;
+        }
+
+        unsigned long i;
+        short *d[2];
+
+        for (i=0; i < frames; i++, in += post->channels)
+        {
+            d[0] = out + 2 * i;
+            d[1] = out + 2 * i + 1;
+            aacd_post_deinterleave( post, in, 1, d );
+        }
+
+        return frames * 2;
+    }
+
+    if (post->histLen + frames > post->histCap)
+    {
+        post->histCap = post->histLen + frames;
+
+        for (c=0; c < oc; c++) post->hist[c] = (short*) realloc( post->hist[c], sizeof( short ) * post->histCap );
+    }
+
+    short *dst[2] = { post->hist[0] + post->histLen, oc > 1 ? post->hist[1] + post->histLen : NULL };
+
+    aacd_post_deinterleave( post, in, frames, dst );
+    post->histLen += frames;
+
+    unsigned int phase = post->phase;
+    unsigned long pos = post->pos;
+    unsigned long n = 0;
+    const long long round = 1LL << (post->shift - 1);
+
+    while (pos + AACD_POST_TAPS <= post->histLen)
+    {
+        const short *branch = post->coefs + phase * AACD_POST_TAPS;
+
+        for (c=0; c < oc; c++)
+        {
+            out[ n++ ] = aacd_post_clip( ((long long) aacd_post_dot( post->hist[c] + pos, branch ) + round) >> post->shift );
+        }
+
+        phase += post->down;
+        pos += phase / post->up;
+        phase %= post->up;
+    }
+
+    // keep the history needed by the next output samples:
+    if (pos > post->histLen) pos = post->histLen;
+
+    for (c=0; c < oc; c++) memmove( post->hist[c], post->hist[c] + pos, sizeof( short ) * (post->histLen - pos));
+
+    post->histLen -= pos;
+    post->pos = 0;
+    post->phase = phase;
+
+    return n;
+}
+
+
+void aacd_post_reset( AACDPost *post )
+{
+    int c;
+
+    post->phase = 0;
+    post->pos = 0;
+
+    if (!post->up) return;
+
+    // the history is primed by silence - the first output sample is aligned to the first input sample:
+    if (post->histCap < AACD_POST_TAPS)
+    {
+        post->histCap = 4096;
+
+        for (c=0; c < post->outChannels; c++) post->hist[c] = (short*) realloc( post->hist[c], sizeof( short ) * post->histCap );
+    }
+
+    for (c=0; c < post->outChannels; c++) memset( post->hist[c], 0, sizeof( short ) * (AACD_POST_TAPS - 1));
+
+    post->histLen = AACD_POST_TAPS - 1;
+}
+
+
+void aacd_post_destroy( AACDPost *post )
+{
+    if (!post) return;
+
+    free( post->coefs );
+    free( post->hist[0] );
+    free( post->hist[1] );
+    free( post );
+}
+
@@ -0,0 +1,114 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAC_POST_H
+#define AAC_POST_H
+
+#include "aac-common.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Post-decode stage - applied to the decoded 16-bit interleaved samples:
+ *
+ *   aacd_decode() -> downmix (3-8 channels -> stereo) -> polyphase resampler -> output
+ *
+ * The multichannel input is expected in the AAC channel configuration order:
+ *   3: C L R,  4: C L R Cs,  5: C L R Ls Rs,  6: C L R Ls Rs LFE,  8: C Lc Rc L R Ls Rs LFE
+ *
+ * The resampler is streaming - the samples can be passed in chunks of any length
+ * (whole frames of all channels). Its latency is AACD_POST_TAPS/2 input frames.
+ * Both stages are fixed-point - the SSE2 / NEON versions produce the same output
+ * as the scalar ones.
+ */
+typedef struct AACDPost AACDPost;
+
+
+/**
+ * The number of filter taps per output sample (per polyphase branch).
+ */
+#define AACD_POST_TAPS  32
+
+
+/**
+ * Creates the post-decode stage.
+ * @param channels the number of channels of the input; more than 2 are downmixed into stereo
+ * @param inRate the sampling rate of the input
+ * @param outRate the sampling rate of the output - or 0 / inRate for no resampling
+ * @return the stage or NULL if the channels or the rates are not supported
+ */
+AACDPost* aacd_post_create( int channels, unsigned long inRate, unsigned long outRate );
+
+
+/**
+ * Sets the downmix gains - relative to the front channels.
+ * The defaults are center=0.7071, surround=0.7071, lfe=0 and normalize=1.
+ * @param normalize if non-zero, the gains are scaled down so the output cannot clip
+ */
+void aacd_post_downmix( AACDPost *post, float center, float surround, float lfe, int normalize );
+
+
+/**
+ * Returns the number of the output channels.
+ */
+int aacd_post_channels( AACDPost *post );
+
+
+/**
+ * Returns the sampling rate of the output.
+ */
+unsigned long aacd_post_rate( AACDPost *post );
+
+
+/**
+ * Returns the max number of the output samples (all channels) produced from inLen input samples.
+ */
+unsigned long aacd_post_max_out( AACDPost *post, unsigned long inLen );
+
+
+/**
+ * Processes the next input samples.
+ * @param inLen the number of the input samples (all channels) - whole frames
+ * @param out the output buffer - see aacd_post_max_out()
+ * @return the number of the output samples (all channels)
+ */
+unsigned long aacd_post_process( AACDPost *post, const short *in, unsigned long inLen, short *out );
+
+
+/**
+ * Drops the history - e.g. after seeking.
+ */
+void aacd_post_reset( AACDPost *post );
+
+
+/**
+ * Frees the stage.
+ */
+void aacd_post_destroy( AACDPost *post );
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,922 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * HTTP / Icecast / SHOUTcast stream reader.
+ * The socket is read directly into the decoder's input buffer by the decoding
+ * thread - no reading thread and no Java buffers. The chunked transfer framing
+ * and the ICY metadata blocks are stripped in place (the audio bytes are only
+ * moved down over them), so the decoder sees the plain audio stream.
+ *
+ * The metadata string is kept only if it differs from the previous one -
+ * the Java side polls it (aacd_http_metadata()) and gets it only when it changes.
+ *
+ * A dropped connection is re-established transparently (a few times): a finite
+ * body is resumed by a Range request, a live stream just continues (the decoder
+ * syncs again). Seeking is supported by Range requests - the kept-alive connection
+ * is reused if the previous response was read completely.
+ */
+
+#define AACD_MODULE "Http"
+
+#include "aac-common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/**
+ * The max number of bytes received by one read.
+ */
+#define AACD_HTTP_CHUNK         16384
+
+/**
+ * The max length of the response headers.
+ */
+#define AACD_HTTP_HEADER_MAX    16384
+
+/**
+ * The timeout of connecting and of each receive.
+ */
+#define AACD_HTTP_TIMEOUT_MS    10000
+
+/**
+ * How many times a dropped connection is re-established within the window (in seconds)
+ * and the delay before each next attempt.
+ */
+#define AACD_HTTP_RECONNECTS    3
+#define AACD_HTTP_WINDOW_S      60
+#define AACD_HTTP_RETRY_MS      250
+
+/**
+ * The max number of redirects followed.
+ */
+#define AACD_HTTP_REDIRECTS     5
+
+/**
+ * The max length of the metadata block - the length byte is multiplied by 16.
+ */
+#define AACD_HTTP_META_MAX      (255 * 16)
+
+
+#define AACD_CHUNK_SIZE         0   // the hex size
+#define AACD_CHUNK_EXT          1   // the extension up to LF
+#define AACD_CHUNK_DATA         2
+#define AACD_CHUNK_DATA_END     3   // CRLF after the data
+#define AACD_CHUNK_DONE         4   // the last chunk
+
+#define AACD_ICY_AUDIO          0
+#define AACD_ICY_LENGTH         1
+#define AACD_ICY_META           2
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+struct AACDHttp {
+    // the URL (the last one after redirects):
+    char host[ 256 ];
+    char port[ 8 ];
+    char path[ 2048 ];
+
+    int fd;
+    int metadata;
+
+    // the response:
+    int keepalive;
+    int ranges;
+    int live;               // an ICY stream of unknown length - it is reconnected from the live position
+    long long length;       // the content length of the whole stream or -1 if not known
+    long long bodyleft;     // the bytes of the body not received yet or -1 if not known
+    char *headers;          // "name: value\n" lines
+
+    // the bytes received together with the headers - not passed to the decoder yet:
+    unsigned char hdr[ AACD_HTTP_HEADER_MAX ];
+    unsigned long pending;
+    unsigned long pendinglen;
+
+    // the chunked transfer:
+    int chunked;
+    int chunkstate;
+    unsigned long chunkleft;
+
+    // the ICY metadata:
+    unsigned long metaint;
+    unsigned long metaleft;
+    int metastate;
+    unsigned char meta[ AACD_HTTP_META_MAX + 1 ];
+    unsigned long metapos;
+
+    // the last metadata string - changed if not polled yet:
+    pthread_mutex_t lock;
+    char *title;
+    int changed;
+
+    // the stream offset of the next audio byte:
+    unsigned long pos;
+
+    // the reconnection attempts of the current window:
+    int reconnects;
+    time_t window;
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Connection
+ ****************************************************************************************************/
+
+/**
+ * Parses the URL - "http://host[:port][/path]" ("icy://" is the same).
+ * @return 0=OK, otherwise error
+ */
+static int aacd_http_url( AACDHttp *h, const char *url )
+{
+    const char *p = strstr( url, "://" );
+
+    if (p)
+    {
+        if (strncasecmp( url, "http://", 7 ) && strncasecmp( url, "icy://", 6 ))
+        {
+            AACD_ERROR( "open() unsupported URL '%s'", url );
+            return -1;
+        }
+
+        p += 3;
+    }
+    else if (url[0] == '/') p = NULL;
+    else p = url;
+
+    // a redirect to a path of the same host:
+    if (!p)
+    {
+        if (strlen( url ) >= sizeof( h->path )) return -1;
+
+        strcpy( h->path, url );
+        return 0;
+    }
+
+    const char *end = p + strcspn( p, "/?" );
+    const char *colon = memchr( p, ':', end - p );
+    const char *hostend = colon ? colon : end;
+
+    if (hostend == p || hostend - p >= (long) sizeof( h->host )) return -1;
+
+    memcpy( h->host, p, hostend - p );
+    h->host[ hostend - p ] = 0;
+
+    if (colon && end - colon - 1 > 0 && end - colon - 1 < (long) sizeof( h->port ))
+    {
+        memcpy( h->port, colon + 1, end - colon - 1 );
+        h->port[ end - colon - 1 ] = 0;
+    }
+    else strcpy( h->port, "80" );
+
+    if (strlen( end ) + 2 >= sizeof( h->path )) return -1;
+
+    if (*end == '/') strcpy( h->path, end );
+    else snprintf( h->path, sizeof( h->path ), "/%s", end );
+
+    return 0;
+}
+
+
+/**
+ * Connects the socket - with the timeout.
+ * @return 0=OK, otherwise error
+ */
+static int aacd_http_connect( AACDHttp *h )
+{
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    struct addrinfo *ai;
+
+    memset( &hints, 0, sizeof( hints ));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int err = getaddrinfo( h->host, h->port, &hints, &res );
+
+    if (err)
+    {
+        AACD_ERROR( "connect() cannot resolve '%s' - %s", h->host, gai_strerror( err ));
+        return -1;
+    }
+
+    for (ai = res; ai; ai = ai->ai_next)
+    {
+        int fd = socket( ai->ai_family, ai->ai_socktype, ai->ai_protocol );
+
+        if (fd < 0) continue;
+
+        int flags = fcntl( fd, F_GETFL, 0 );
+        fcntl( fd, F_SETFL, flags | O_NONBLOCK );
+
+        int ok = !connect( fd, ai->ai_addr, ai->ai_addrlen );
+
+        if (!ok && errno == EINPROGRESS)
+        {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            int soerr = 0;
+            socklen_t len = sizeof( soerr );
+
+            ok = poll( &pfd, 1, AACD_HTTP_TIMEOUT_MS ) == 1
+                && !getsockopt( fd, SOL_SOCKET, SO_ERROR, &soerr, &len ) && !soerr;
+        }
+
+        if (ok)
+        {
+            struct timeval tv = { AACD_HTTP_TIMEOUT_MS / 1000, (AACD_HTTP_TIMEOUT_MS % 1000) * 1000 };
+
+            fcntl( fd, F_SETFL, flags );
+            setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ));
+            setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( tv ));
+
+            h->fd = fd;
+            freeaddrinfo( res );
+
+            return 0;
+        }
+
+        close( fd );
+    }
+
+    freeaddrinfo( res );
+
+    AACD_ERROR( "connect() cannot connect to %s:%s", h->host, h->port );
+
+    return -1;
+}
+
+
+static void aacd_http_disconnect( AACDHttp *h )
+{
+    if (h->fd >= 0) close( h->fd );
+
+    h->fd = -1;
+}
+
+
+/**
+ * Returns 1 if the whole body of the response was received.
+ */
+static int aacd_http_body_done( AACDHttp *h )
+{
+    return h->chunked ? h->chunkstate == AACD_CHUNK_DONE : !h->bodyleft;
+}
+
+
+/**
+ * Returns the value of the header line if the name matches (case insensitive).
+ */
+static const char* aacd_http_header( const char *line, const char *name )
+{
+    size_t len = strlen( name );
+
+    if (strncasecmp( line, name, len ) || line[ len ] != ':') return NULL;
+
+    line += len + 1;
+
+    while (*line == ' ' || *line == '\t') line++;
+
+    return line;
+}
+
+
+/**
+ * Parses the response headers - they are in h->hdr terminated by an empty line.
+ * @param location the value of the Location header is stored there (or NULL)
+ * @return the status code or -1 on error
+ */
+static int aacd_http_parse( AACDHttp *h, unsigned long hdrlen, const char **location )
+{
+    char *p = (char*) h->hdr;
+    char *end = p + hdrlen;
+    int status = -1;
+    int http11 = 0;
+
+    *location = NULL;
+
+    h->keepalive = 0;
+    h->ranges = 0;
+    h->live = 0;
+    h->chunked = 0;
+    h->bodyleft = -1;
+    h->metaint = 0;
+
+    free( h->headers );
+    h->headers = (char*) malloc( hdrlen + 1 );
+
+    char *out = h->headers;
+
+    while (p < end)
+    {
+        char *eol = memchr( p, '\n', end - p );
+
+        if (!eol) break;
+
+        *eol = 0;
+
+        if (eol > p && eol[-1] == '\r') eol[-1] = 0;
+
+        // the status line - "HTTP/1.1 200 OK" or "ICY 200 OK":
+        if (status < 0)
+        {
+            char *sp = strchr( p, ' ' );
+
+            if (!sp || (strncmp( p, "HTTP/", 5 ) && strncmp( p, "ICY", 3 ))) return -1;
+
+            http11 = !strncmp( p, "HTTP/1.1", 8 );
+            h->live = !strncmp( p, "ICY", 3 );
+            h->keepalive = http11;
+            status = atoi( sp + 1 );
+        }
+        else if (*p)
+        {
+            const char *v;
+
+            if ((v = aacd_http_header( p, "content-length" ))) h->bodyleft = atoll( v );
+            else if ((v = aacd_http_header( p, "transfer-encoding" ))) h->chunked = !!strstr( v, "chunked" );
+            else if ((v = aacd_http_header( p, "connection" ))) h->keepalive = http11 && strncasecmp( v, "close", 5 );
+            else if ((v = aacd_http_header( p, "accept-ranges" ))) h->ranges = !strncasecmp( v, "bytes", 5 );
+            else if ((v = aacd_http_header( p, "location" ))) *location = v;
+            else if ((v = aacd_http_header( p, "icy-metaint" )) && h->metadata) h->metaint = strtoul( v, NULL, 10 );
+
+            if (!strncasecmp( p, "icy-", 4 )) h->live = 1;
+
+            out += sprintf( out, "%s\n", p );
+        }
+
+        p = eol + 1;
+    }
+
+    *out = 0;
+
+    // a new chunked body / metadata period:
+    h->chunkstate = AACD_CHUNK_SIZE;
+    h->chunkleft = 0;
+    h->metastate = AACD_ICY_AUDIO;
+    h->metaleft = h->metaint;
+
+    // the body ends by closing the connection:
+    if (!h->chunked && h->bodyleft < 0) h->keepalive = 0;
+
+    return status;
+}
+
+
+/**
+ * Sends the request and receives the response headers - following the redirects.
+ * The kept-alive connection is reused if the previous body was received completely.
+ * @param offset the stream offset requested by the Range header (if > 0)
+ * @return 0=OK, otherwise error
+ */
+static int aacd_http_request( AACDHttp *h, unsigned long offset )
+{
+    int redirects = 0;
+
+    if (h->fd >= 0 && !(h->keepalive && !h->pendinglen && aacd_http_body_done( h ))) aacd_http_disconnect( h );
+
+    for (;;)
+    {
+        if (h->fd < 0 && aacd_http_connect( h )) return -1;
+
+        char req[ 3072 ];
+        char range[ 64 ] = "";
+
+        if (offset) snprintf( range, sizeof( range ), "Range: bytes=%lu-\r\n", offset );
+
+        int len = snprintf( req, sizeof( req ),
+                    "GET %s HTTP/1.1\r\n"
+                    "Host: %s%s%s\r\n"
+                    "User-Agent: AACDecoder\r\n"
+                    "Accept: */*\r\n"
+                    "%s"
+                    "%s"
+                    "Connection: keep-alive\r\n"
+                    "\r\n",
+                    h->path, h->host, strcmp( h->port, "80" ) ? ":" : "", strcmp( h->port, "80" ) ? h->port : "",
+                    h->metadata ? "Icy-MetaData: 1\r\n" : "",
+                    range );
+
+        unsigned long hdrlen = 0;
+        unsigned long received = 0;
+
+        if (send( h->fd, req, len, MSG_NOSIGNAL ) != len)
+        {
+            AACD_ERROR( "request() cannot send the request" );
+            aacd_http_disconnect( h );
+            return -1;
+        }
+
+        // receive up to the empty line:
+        while (!hdrlen)
+        {
+            ssize_t n = received < sizeof( h->hdr ) ? recv( h->fd, h->hdr + received, sizeof( h->hdr ) - received, 0 ) : -1;
+
+            if (n <= 0)
+            {
+                AACD_ERROR( "request() no response headers, received=%lu", received );
+                aacd_http_disconnect( h );
+                return -1;
+            }
+
+            unsigned long i = received > 2 ? received - 2 : 0;
+
+            received += n;
+
+            // LF LF or LF CR LF (the ICY servers may not send CR):
+            for (; i < received && !hdrlen; i++)
+            {
+                if (h->hdr[i] != '\n') continue;
+
+                if (i + 1 < received && h->hdr[i+1] == '\n') hdrlen = i + 2;
+                else if (i + 2 < received && h->hdr[i+1] == '\r' && h->hdr[i+2] == '\n') hdrlen = i + 3;
+            }
+        }
+
+        const char *location;
+        int status = aacd_http_parse( h, hdrlen, &location );
+
+        h->pending = hdrlen;
+        h->pendinglen = received - hdrlen;
+
+        AACD_DEBUG( "request() %s:%s%s status=%d, length=%lld, chunked=%d, metaint=%lu",
+                    h->host, h->port, h->path, status, h->bodyleft, h->chunked, h->metaint );
+
+        if (status >= 200 && status < 300)
+        {
+            if (offset && status != 206)
+            {
+                AACD_ERROR( "request() range not satisfied - status=%d", status );
+                aacd_http_disconnect( h );
+                return -1;
+            }
+
+            if (!offset) h->length = h->chunked ? -1 : h->bodyleft;
+
+            h->live = h->live && h->length < 0;
+
+            h->pos = offset;
+
+            return 0;
+        }
+
+        // the redirect is followed by a new connection:
+        if (status >= 300 && status < 400 && location && redirects++ < AACD_HTTP_REDIRECTS)
+        {
+            AACD_INFO( "request() redirected to '%s'", location );
+
+            char url[ sizeof( h->path ) ];
+            snprintf( url, sizeof( url ), "%s", location );
+
+            aacd_http_disconnect( h );
+
+            if (aacd_http_url( h, url )) return -1;
+
+            continue;
+        }
+
+        AACD_ERROR( "request() %s:%s%s failed - status=%d", h->host, h->port, h->path, status );
+        aacd_http_disconnect( h );
+
+        return -1;
+    }
+}
+
+
+/**
+ * Re-establishes the dropped connection.
+ * A finite body is resumed by a Range request, a live stream continues from the current position.
+ * @return 0=OK, otherwise error (or the stream cannot be resumed)
+ */
+static int aacd_http_reconnect( AACDHttp *h )
+{
+    if (!h->live && !(h->ranges && h->length > 0)) return -1;
+
+    time_t now = time( NULL );
+
+    if (now - h->window > AACD_HTTP_WINDOW_S)
+    {
+        h->window = now;
+        h->reconnects = 0;
+    }
+
+    while (h->reconnects < AACD_HTTP_RECONNECTS)
+    {
+        if (h->reconnects++) usleep( AACD_HTTP_RETRY_MS * 1000 * h->reconnects );
+
+        AACD_WARN( "reconnect() attempt %d, offset=%lu", h->reconnects, h->pos );
+
+        aacd_http_disconnect( h );
+
+        unsigned long pos = h->pos;
+
+        if (!aacd_http_request( h, h->live ? 0 : pos ))
+        {
+            h->pos = pos;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Stripping
+ ****************************************************************************************************/
+
+/**
+ * Stores the metadata block - only if it differs from the previous one.
+ */
+static void aacd_http_meta( AACDHttp *h )
+{
+    unsigned long len = h->metapos;
+
+    while (len && !h->meta[ len - 1 ]) len--;
+
+    h->meta[ len ] = 0;
+
+    pthread_mutex_lock( &h->lock );
+
+    if (!h->title || strcmp( h->title, (char*) h->meta ))
+    {
+        AACD_DEBUG( "meta() %s", h->meta );
+
+        free( h->title );
+        h->title = strdup( (char*) h->meta );
+        h->changed = 1;
+    }
+
+    pthread_mutex_unlock( &h->lock );
+}
+
+
+/**
+ * Moves the audio bytes of the body to the output - the metadata blocks are removed.
+ * @return the new output position
+ */
+static unsigned char* aacd_http_icy( AACDHttp *h, unsigned char *out, const unsigned char *p, unsigned long len )
+{
+    if (!h->metaint)
+    {
+        memmove( out, p, len );
+        return out + len;
+    }
+
+    while (len)
+    {
+        unsigned long n;
+
+        switch (h->metastate)
+        {
+            case AACD_ICY_AUDIO:
+                n = len < h->metaleft ? len : h->metaleft;
+                memmove( out, p, n );
+                out += n;
+                h->metaleft -= n;
+
+                if (!h->metaleft) h->metastate = AACD_ICY_LENGTH;
+                break;
+
+            case AACD_ICY_LENGTH:
+                n = 1;
+                h->metapos = *p * 16;
+
+                if (h->metapos)
+                {
+                    h->metaleft = h->metapos;
+                    h->metapos = 0;
+                    h->metastate = AACD_ICY_META;
+                }
+                else
+                {
+                    h->metaleft = h->metaint;
+                    h->metastate = AACD_ICY_AUDIO;
+                }
+                break;
+
+            default:
+                n = len < h->metaleft ? len : h->metaleft;
+                memcpy( h->meta + h->metapos, p, n );
+                h->metapos += n;
+                h->metaleft -= n;
+
+                if (!h->metaleft)
+                {
+                    aacd_http_meta( h );
+
+                    h->metaleft = h->metaint;
+                    h->metastate = AACD_ICY_AUDIO;
+                }
+                break;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return out;
+}
+
+
+/**
+ * Strips the chunked transfer framing and the ICY metadata in place.
+ * @return the number of audio bytes left at the beginning of the buffer
+ */
+static unsigned long aacd_http_strip( AACDHttp *h, unsigned char *buf, unsigned long len )
+{
+    if (h->bodyleft > 0) h->bodyleft -= len;
+
+    if (!h->chunked) return aacd_http_icy( h, buf, buf, len ) - buf;
+
+    unsigned char *out = buf;
+    const unsigned char *p = buf;
+    const unsigned char *end = buf + len;
+
+    while (p < end && h->chunkstate != AACD_CHUNK_DONE)
+    {
+        unsigned char c = *p;
+
+        switch (h->chunkstate)
+        {
+            case AACD_CHUNK_SIZE:
+                p++;
+
+                if (c >= '0' && c <= '9') h->chunkleft = h->chunkleft * 16 + c - '0';
+                else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') h->chunkleft = h->chunkleft * 16 + (c | 0x20) - 'a' + 10;
+                else if (c == '\n') h->chunkstate = h->chunkleft ? AACD_CHUNK_DATA : AACD_CHUNK_DONE;
+                else h->chunkstate = AACD_CHUNK_EXT;
+                break;
+
+            case AACD_CHUNK_EXT:
+                p++;
+
+                if (c == '\n') h->chunkstate = h->chunkleft ? AACD_CHUNK_DATA : AACD_CHUNK_DONE;
+                break;
+
+            case AACD_CHUNK_DATA:
+            {
+                unsigned long n = (unsigned long) (end - p) < h->chunkleft ? (unsigned long) (end - p) : h->chunkleft;
+
+                out = aacd_http_icy( h, out, p, n );
+                p += n;
+                h->chunkleft -= n;
+
+                if (!h->chunkleft) h->chunkstate = AACD_CHUNK_DATA_END;
+                break;
+            }
+
+            default:
+                p++;
+
+                if (c == '\n') h->chunkstate = AACD_CHUNK_SIZE;
+                break;
+        }
+    }
+
+    // the trailer of the last chunk is not parsed - the connection is not reused then:
+    if (p < end) h->keepalive = 0;
+
+    return out - buf;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Connects and receives the response headers (following the redirects).
+ * @param metadata if true, then the ICY metadata are requested
+ * @return the stream or NULL on error
+ */
+AACDHttp* aacd_http_open( const char *url, int metadata )
+{
+    AACDHttp *h = (AACDHttp*) calloc( 1, sizeof( struct AACDHttp ));
+
+    h->fd = -1;
+    h->metadata = metadata;
+    h->length = -1;
+
+    pthread_mutex_init( &h->lock, NULL );
+
+    if (aacd_http_url( h, url ) || aacd_http_request( h, 0 ))
+    {
+        aacd_http_close( h );
+        return NULL;
+    }
+
+    AACD_INFO( "open() '%s' length=%lld, ranges=%d, metaint=%lu", url, h->length, h->ranges, h->metaint );
+
+    return h;
+}
+
+
+/**
+ * Receives the next bytes directly into the decoder's buffer and strips them there.
+ * @return the number of bytes appended; 0 means end-of-stream
+ */
+long aacd_http_read( AACDInfo *info, AACDHttp *h )
+{
+    for (;;)
+    {
+        // the whole body was received - the connection can stay open:
+        if (!h->pendinglen && aacd_http_body_done( h )) return 0;
+
+        unsigned char *dest = aacd_prepare_buffer( info, AACD_HTTP_CHUNK );
+        long n;
+
+        if (h->pendinglen)
+        {
+            n = h->pendinglen < AACD_HTTP_CHUNK ? (long) h->pendinglen : AACD_HTTP_CHUNK;
+            memcpy( dest, h->hdr + h->pending, n );
+
+            h->pending += n;
+            h->pendinglen -= n;
+        }
+        else
+        {
+            unsigned long want = h->bodyleft > 0 && h->bodyleft < AACD_HTTP_CHUNK ? (unsigned long) h->bodyleft : AACD_HTTP_CHUNK;
+
+            n = h->fd >= 0 ? (long) recv( h->fd, dest, want, 0 ) : -1;
+        }
+
+        if (n <= 0)
+        {
+            info->bytesleft -= AACD_HTTP_CHUNK;
+
+            // the body of unknown length ended by closing the connection:
+            if (!n && !h->live && h->length < 0 && !h->chunked) return 0;
+
+            AACD_WARN( "read() connection dropped - %s", n ? strerror( errno ) : "closed" );
+
+            if (aacd_http_reconnect( h )) return 0;
+
+            continue;
+        }
+
+        unsigned long len = aacd_http_strip( h, dest, (unsigned long) n );
+
+        info->bytesleft -= AACD_HTTP_CHUNK - len;
+
+        if (!len) continue;
+
+        h->pos += len;
+
+        return (long) len;
+    }
+}
+
+
+/**
+ * Repositions the stream by a Range request - only if the server supports it.
+ * @return 0=OK, otherwise error
+ */
+int aacd_http_seek( AACDHttp *h, unsigned long offset )
+{
+    if (!aacd_http_seekable( h ) || (long long) offset > h->length)
+    {
+        AACD_ERROR( "seek() not supported by the server" );
+        return -1;
+    }
+
+    h->pendinglen = 0;
+
+    if (offset == h->length)
+    {
+        // nothing more to read:
+        aacd_http_disconnect( h );
+        h->chunked = 0;
+        h->bodyleft = 0;
+        h->pos = offset;
+
+        return 0;
+    }
+
+    return aacd_http_request( h, offset );
+}
+
+
+/**
+ * Returns true if the stream can be repositioned - see aacd_http_seek().
+ */
+int aacd_http_seekable( AACDHttp *h )
+{
+    return h->ranges && h->length >= 0;
+}
+
+
+/**
+ * Returns the response headers - "name: value" lines separated by LF.
+ */
+const char* aacd_http_headers( AACDHttp *h )
+{
+    return h->headers ? h->headers : "";
+}
+
+
+/**
+ * Copies the metadata string if it changed since the last call. Thread safe.
+ * @return the length of the string or -1 if not changed
+ */
+int aacd_http_metadata( AACDHttp *h, char *buf, int len )
+{
+    int ret = -1;
+
+    pthread_mutex_lock( &h->lock );
+
+    if (h->changed && len > 0)
+    {
+        snprintf( buf, len, "%s", h->title );
+
+        ret = (int) strlen( buf );
+        h->changed = 0;
+    }
+
+    pthread_mutex_unlock( &h->lock );
+
+    return ret;
+}
+
+
+/**
+ * Closes the connection and frees the struct.
+ */
+void aacd_http_close( AACDHttp *h )
+{
+    aacd_http_disconnect( h );
+
+    pthread_mutex_destroy( &h->lock );
+
+    free( h->headers );
+    free( h->title );
+    free( h );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Reader
+ ****************************************************************************************************/
+
+static const char* aacd_http_reader_name()
+{
+    return "Http";
+}
+
+
+static long aacd_http_reader_read( AACDInfo *info )
+{
+    return aacd_http_read( info, (AACDHttp*) info->reader_ext );
+}
+
+
+static void aacd_http_reader_destroy( AACDInfo *info )
+{
+    if (info->reader_ext) aacd_http_close( (AACDHttp*) info->reader_ext );
+
+    info->reader_ext = NULL;
+}
+
+
+static int aacd_http_reader_seek( AACDInfo *info, unsigned long offset )
+{
+    return aacd_http_seek( (AACDHttp*) info->reader_ext, offset );
+}
+
+
+AACDReader aacd_http_reader = {
+    aacd_http_reader_name,
+    aacd_http_reader_read,
+    aacd_http_reader_destroy,
+    aacd_http_reader_seek
+};
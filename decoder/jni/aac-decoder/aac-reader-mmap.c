@@ -0,0 +1,233 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Memory mapped file reader.
+ * The whole file is mapped and the decoder reads the frames in place -
+ * no reading thread and no copying. The chunks handed over to the decoder
+ * are adjacent in the mapping, so the leftover of the previous chunk
+ * is just extended (no stitching).
+ *
+ * The kernel is told to read ahead (MADV_SEQUENTIAL, MADV_WILLNEED) and
+ * the pages already decoded are released (MADV_DONTNEED) - so the resident
+ * memory does not grow with the file.
+ */
+
+#define AACD_MODULE "Mmap"
+
+#include "aac-common.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * The number of bytes handed over to the decoder by one read.
+ */
+#define AACD_MMAP_CHUNK     65536
+
+/**
+ * How far behind the decoder the pages are released.
+ */
+#define AACD_MMAP_BEHIND    (4 * AACD_MMAP_CHUNK)
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+struct AACDMmap {
+    int fd;
+    unsigned char *data;
+    unsigned long size;
+
+    // the offset of the next chunk:
+    unsigned long pos;
+
+    // the pages below are released:
+    unsigned long released;
+
+    unsigned long pagesize;
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Maps the file.
+ * @return the mapping or NULL on error
+ */
+AACDMmap* aacd_mmap_open( const char *path )
+{
+    int fd = open( path, O_RDONLY );
+
+    if (fd < 0)
+    {
+        AACD_ERROR( "open() cannot open file '%s'", path );
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (fstat( fd, &st ) || st.st_size <= 0)
+    {
+        AACD_ERROR( "open() empty or invalid file '%s'", path );
+        close( fd );
+        return NULL;
+    }
+
+    void *data = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+    if (data == MAP_FAILED)
+    {
+        AACD_ERROR( "open() cannot map file '%s'", path );
+        close( fd );
+        return NULL;
+    }
+
+    madvise( data, (size_t) st.st_size, MADV_SEQUENTIAL );
+
+    AACDMmap *m = (AACDMmap*) calloc( 1, sizeof( struct AACDMmap ));
+    m->fd = fd;
+    m->data = (unsigned char*) data;
+    m->size = (unsigned long) st.st_size;
+    m->pagesize = (unsigned long) sysconf( _SC_PAGESIZE );
+
+    AACD_DEBUG( "open() mapped %lu bytes of '%s'", m->size, path );
+
+    return m;
+}
+
+
+/**
+ * Hands over the next chunk of the mapping to the decoder.
+ * @return the number of bytes appended; 0 means end-of-stream
+ */
+long aacd_mmap_read( AACDInfo *info, AACDMmap *m )
+{
+    unsigned long len = m->size - m->pos;
+
+    if (len > AACD_MMAP_CHUNK) len = AACD_MMAP_CHUNK;
+    if (!len) return 0;
+
+    unsigned char *data = m->data + m->pos;
+
+    // the leftover is right before the chunk in the mapping:
+    if (info->bytesleft && !info->direct && info->buffer + info->bytesleft == data) info->bytesleft += len;
+    else aacd_direct_buffer( info, data, len );
+
+    m->pos += len;
+
+    // read ahead the next chunk:
+    if (m->pos < m->size)
+    {
+        unsigned long ahead = m->pos & ~(m->pagesize - 1);
+        unsigned long end = m->pos + AACD_MMAP_CHUNK < m->size ? m->pos + AACD_MMAP_CHUNK : m->size;
+
+        madvise( m->data + ahead, end - ahead, MADV_WILLNEED );
+    }
+
+    // release the decoded pages:
+    if (m->pos > m->released + AACD_MMAP_BEHIND + AACD_MMAP_CHUNK)
+    {
+        unsigned long end = (m->pos - AACD_MMAP_BEHIND - AACD_MMAP_CHUNK) & ~(m->pagesize - 1);
+
+        if (end > m->released)
+        {
+            madvise( m->data + m->released, end - m->released, MADV_DONTNEED );
+            m->released = end;
+        }
+    }
+
+    return (long) len;
+}
+
+
+/**
+ * Repositions the next chunk.
+ * @return 0=OK, otherwise error
+ */
+int aacd_mmap_seek( AACDMmap *m, unsigned long offset )
+{
+    if (offset > m->size) return -1;
+
+    m->pos = offset;
+
+    // the released pages are just faulted in again:
+    if (m->released > offset) m->released = offset & ~(m->pagesize - 1);
+
+    return 0;
+}
+
+
+/**
+ * Unmaps the file and frees the struct.
+ */
+void aacd_mmap_close( AACDMmap *m )
+{
+    munmap( m->data, (size_t) m->size );
+    close( m->fd );
+
+    free( m );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Reader
+ ****************************************************************************************************/
+
+static const char* aacd_mmap_reader_name()
+{
+    return "Mmap";
+}
+
+
+static long aacd_mmap_reader_read( AACDInfo *info )
+{
+    return aacd_mmap_read( info, (AACDMmap*) info->reader_ext );
+}
+
+
+static void aacd_mmap_reader_destroy( AACDInfo *info )
+{
+    if (info->reader_ext) aacd_mmap_close( (AACDMmap*) info->reader_ext );
+
+    info->reader_ext = NULL;
+}
+
+
+static int aacd_mmap_reader_seek( AACDInfo *info, unsigned long offset )
+{
+    return aacd_mmap_seek( (AACDMmap*) info->reader_ext, offset );
+}
+
+
+AACDReader aacd_mmap_reader = {
+    aacd_mmap_reader_name,
+    aacd_mmap_reader_read,
+    aacd_mmap_reader_destroy,
+    aacd_mmap_reader_seek
+};
+
@@ -0,0 +1,294 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * OpenSL ES sink (Android 2.3+).
+ * The buffer queue callback pulls the samples from the PCM ring.
+ *
+ * The library is linked against the android-3 platform, so libOpenSLES.so
+ * is loaded at runtime - the sink just fails to open on older devices.
+ */
+
+#define AACD_MODULE "OpenSLES"
+
+#include "aac-output.h"
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+
+/**
+ * The number of buffers in the queue.
+ */
+#define AACD_OPENSL_BUFFERS     3
+
+/**
+ * The length of one buffer in ms.
+ */
+#define AACD_OPENSL_BUFFER_MS   20
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+/**
+ * The OpenSL ES symbols loaded at runtime.
+ */
+static struct {
+    void *lib;
+    SLresult SLAPIENTRY (*slCreateEngine)( SLObjectItf*, SLuint32, const SLEngineOption*,
+                                           SLuint32, const SLInterfaceID*, const SLboolean* );
+    SLInterfaceID iidEngine;
+    SLInterfaceID iidPlay;
+    SLInterfaceID iidBufferQueue;
+} aacd_opensl;
+
+
+typedef struct AACDOpenSL {
+    SLObjectItf engineObj;
+    SLEngineItf engine;
+    SLObjectItf mixObj;
+    SLObjectItf playerObj;
+    SLPlayItf play;
+    SLAndroidSimpleBufferQueueItf queue;
+
+    short *buffers[ AACD_OPENSL_BUFFERS ];
+    unsigned long bufferLen;
+    int next;
+
+    // accessed only by the callback (after start):
+    int queued;
+} AACDOpenSL;
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Loads the library - once.
+ * @return 0=OK
+ */
+static int aacd_opensl_load()
+{
+    if (aacd_opensl.lib) return 0;
+
+    void *lib = dlopen( "libOpenSLES.so", RTLD_NOW );
+
+    if (!lib)
+    {
+        AACD_ERROR( "load() OpenSL ES not available" );
+        return -1;
+    }
+
+    SLInterfaceID *engine = (SLInterfaceID*) dlsym( lib, "SL_IID_ENGINE" );
+    SLInterfaceID *play = (SLInterfaceID*) dlsym( lib, "SL_IID_PLAY" );
+    SLInterfaceID *queue = (SLInterfaceID*) dlsym( lib, "SL_IID_ANDROIDSIMPLEBUFFERQUEUE" );
+
+    aacd_opensl.slCreateEngine = dlsym( lib, "slCreateEngine" );
+
+    if (!engine || !play || !queue || !aacd_opensl.slCreateEngine)
+    {
+        AACD_ERROR( "load() OpenSL ES symbols not found" );
+        dlclose( lib );
+        return -1;
+    }
+
+    aacd_opensl.iidEngine = *engine;
+    aacd_opensl.iidPlay = *play;
+    aacd_opensl.iidBufferQueue = *queue;
+    aacd_opensl.lib = lib;
+
+    return 0;
+}
+
+
+/**
+ * Enqueues the next buffer.
+ * At the end of the stream only the decoded samples are enqueued (no silence).
+ */
+static void aacd_opensl_enqueue( AACDOutput *out, AACDOpenSL *sl )
+{
+    if (aacd_output_drained( out )) return;
+
+    short *buffer = sl->buffers[ sl->next ];
+    unsigned long len = aacd_output_pull( out, buffer, sl->bufferLen );
+
+    if (!aacd_output_drained( out )) len = sl->bufferLen;
+    else if (!len) return;
+
+    if ((*sl->queue)->Enqueue( sl->queue, buffer, len * sizeof( short )) != SL_RESULT_SUCCESS)
+    {
+        AACD_WARN( "enqueue() failed" );
+        return;
+    }
+
+    sl->next = (sl->next + 1) % AACD_OPENSL_BUFFERS;
+    sl->queued++;
+}
+
+
+/**
+ * The buffer queue callback - one buffer was played.
+ */
+static void aacd_opensl_callback( SLAndroidSimpleBufferQueueItf queue, void *context )
+{
+    AACDOutput *out = (AACDOutput*) context;
+    AACDOpenSL *sl = (AACDOpenSL*) out->sink_ext;
+
+    sl->queued--;
+
+    aacd_opensl_enqueue( out, sl );
+
+    if (!sl->queued) aacd_output_finish( out );
+}
+
+
+static const char* aacd_opensl_name()
+{
+    return "OpenSLES";
+}
+
+
+static int aacd_opensl_open( AACDOutput *out )
+{
+    AACDInfo *info = out->info;
+
+    if (aacd_opensl_load()) return -1;
+
+    if (info->channels > 2)
+    {
+        AACD_ERROR( "open() too many channels: %d", info->channels );
+        return -1;
+    }
+
+    AACDOpenSL *sl = (AACDOpenSL*) calloc( 1, sizeof( struct AACDOpenSL ));
+    out->sink_ext = sl;
+
+    SLresult res = aacd_opensl.slCreateEngine( &sl->engineObj, 0, NULL, 0, NULL, NULL );
+
+    if (res == SL_RESULT_SUCCESS) res = (*sl->engineObj)->Realize( sl->engineObj, SL_BOOLEAN_FALSE );
+    if (res == SL_RESULT_SUCCESS) res = (*sl->engineObj)->GetInterface( sl->engineObj, aacd_opensl.iidEngine, &sl->engine );
+    if (res == SL_RESULT_SUCCESS) res = (*sl->engine)->CreateOutputMix( sl->engine, &sl->mixObj, 0, NULL, NULL );
+    if (res == SL_RESULT_SUCCESS) res = (*sl->mixObj)->Realize( sl->mixObj, SL_BOOLEAN_FALSE );
+
+    if (res == SL_RESULT_SUCCESS)
+    {
+        SLDataLocator_AndroidSimpleBufferQueue locQueue = {
+            SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, AACD_OPENSL_BUFFERS
+        };
+
+        SLDataFormat_PCM format = {
+            SL_DATAFORMAT_PCM,
+            info->channels,
+            info->samplerate * 1000,
+            SL_PCMSAMPLEFORMAT_FIXED_16,
+            SL_PCMSAMPLEFORMAT_FIXED_16,
+            info->channels == 2 ? (SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT) : SL_SPEAKER_FRONT_CENTER,
+            SL_BYTEORDER_LITTLEENDIAN
+        };
+
+        SLDataSource source = { &locQueue, &format };
+
+        SLDataLocator_OutputMix locMix = { SL_DATALOCATOR_OUTPUTMIX, sl->mixObj };
+        SLDataSink sink = { &locMix, NULL };
+
+        const SLInterfaceID ids[] = { aacd_opensl.iidBufferQueue };
+        const SLboolean req[] = { SL_BOOLEAN_TRUE };
+
+        res = (*sl->engine)->CreateAudioPlayer( sl->engine, &sl->playerObj, &source, &sink, 1, ids, req );
+    }
+
+    if (res == SL_RESULT_SUCCESS) res = (*sl->playerObj)->Realize( sl->playerObj, SL_BOOLEAN_FALSE );
+    if (res == SL_RESULT_SUCCESS) res = (*sl->playerObj)->GetInterface( sl->playerObj, aacd_opensl.iidPlay, &sl->play );
+    if (res == SL_RESULT_SUCCESS) res = (*sl->playerObj)->GetInterface( sl->playerObj, aacd_opensl.iidBufferQueue, &sl->queue );
+    if (res == SL_RESULT_SUCCESS) res = (*sl->queue)->RegisterCallback( sl->queue, aacd_opensl_callback, out );
+
+    if (res != SL_RESULT_SUCCESS)
+    {
+        AACD_ERROR( "open() cannot create the audio player: %d", (int) res );
+        out->sink->close( out );
+
+        return -1;
+    }
+
+    sl->bufferLen = info->samplerate * AACD_OPENSL_BUFFER_MS / 1000 * info->channels;
+
+    int i;
+    for (i=0; i < AACD_OPENSL_BUFFERS; i++)
+    {
+        sl->buffers[i] = (short*) malloc( sizeof( short ) * sl->bufferLen );
+    }
+
+    return 0;
+}
+
+
+static int aacd_opensl_start( AACDOutput *out )
+{
+    AACDOpenSL *sl = (AACDOpenSL*) out->sink_ext;
+    int i;
+
+    // the callbacks are not called before the player is started:
+    for (i=0; i < AACD_OPENSL_BUFFERS; i++) aacd_opensl_enqueue( out, sl );
+
+    if (!sl->queued)
+    {
+        aacd_output_finish( out );
+        return 0;
+    }
+
+    return (*sl->play)->SetPlayState( sl->play, SL_PLAYSTATE_PLAYING ) == SL_RESULT_SUCCESS ? 0 : -1;
+}
+
+
+static void aacd_opensl_close( AACDOutput *out )
+{
+    AACDOpenSL *sl = (AACDOpenSL*) out->sink_ext;
+
+    if (!sl) return;
+
+    // destroying the player waits for the running callback:
+    if (sl->playerObj) (*sl->playerObj)->Destroy( sl->playerObj );
+    if (sl->mixObj) (*sl->mixObj)->Destroy( sl->mixObj );
+    if (sl->engineObj) (*sl->engineObj)->Destroy( sl->engineObj );
+
+    int i;
+    for (i=0; i < AACD_OPENSL_BUFFERS; i++)
+    {
+        if (sl->buffers[i]) free( sl->buffers[i] );
+    }
+
+    free( sl );
+    out->sink_ext = NULL;
+}
+
+
+AACDSink aacd_opensl_sink = {
+    aacd_opensl_name,
+    aacd_opensl_open,
+    aacd_opensl_start,
+    aacd_opensl_close
+};
+
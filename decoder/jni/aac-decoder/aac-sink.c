@@ -0,0 +1,356 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Portable sinks which do not need any audio device:
+ *
+ *   Null - pulls the samples in real time (like an audio device) and drops them
+ *   WAV  - writes the samples into a WAV file (sink_param) as fast as possible
+ */
+
+#define AACD_MODULE "Sink"
+
+#include "aac-output.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/**
+ * The period of the null sink in ms.
+ */
+#define AACD_NULL_PERIOD_MS     10
+
+/**
+ * The max samples written by the WAV sink at once.
+ */
+#define AACD_WAV_CHUNK          16384
+
+/**
+ * How long the WAV sink waits for the decoding thread in ms.
+ */
+#define AACD_WAV_WAIT_MS        2
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+/**
+ * The common part of the thread-based sinks.
+ */
+typedef struct AACDThreadSink {
+    pthread_t thread;
+    int running;
+    int stopped;
+
+    short *samples;
+    unsigned long samplesLen;
+
+    // WAV only:
+    FILE *file;
+    unsigned long bytes;
+} AACDThreadSink;
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Common
+ ****************************************************************************************************/
+
+static void aacd_sink_sleep( long ms )
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+
+    nanosleep( &ts, NULL );
+}
+
+
+/**
+ * Sleeps until the monotonic time - clock_nanosleep() is not available on older Androids.
+ */
+static void aacd_sink_sleep_until( struct timespec *until )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    long long ns = (until->tv_sec - now.tv_sec) * 1000000000LL + until->tv_nsec - now.tv_nsec;
+
+    if (ns <= 0) return;
+
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+
+    nanosleep( &ts, NULL );
+}
+
+
+static int aacd_thread_sink_open( AACDOutput *out, unsigned long samplesLen )
+{
+    AACDThreadSink *ts = (AACDThreadSink*) calloc( 1, sizeof( struct AACDThreadSink ));
+
+    ts->samplesLen = samplesLen;
+    ts->samples = (short*) malloc( sizeof( short ) * samplesLen );
+
+    out->sink_ext = ts;
+
+    return 0;
+}
+
+
+static int aacd_thread_sink_start( AACDOutput *out, void* (*run)( void* ))
+{
+    AACDThreadSink *ts = (AACDThreadSink*) out->sink_ext;
+
+    if (pthread_create( &ts->thread, NULL, run, out )) return -1;
+
+    ts->running = 1;
+
+    return 0;
+}
+
+
+static void aacd_thread_sink_close( AACDOutput *out )
+{
+    AACDThreadSink *ts = (AACDThreadSink*) out->sink_ext;
+
+    if (!ts) return;
+
+    __atomic_store_n( &ts->stopped, 1, __ATOMIC_RELEASE );
+
+    if (ts->running) pthread_join( ts->thread, NULL );
+
+    free( ts->samples );
+    free( ts );
+
+    out->sink_ext = NULL;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Null sink
+ ****************************************************************************************************/
+
+static const char* aacd_null_name()
+{
+    return "Null";
+}
+
+
+static int aacd_null_open( AACDOutput *out )
+{
+    AACDInfo *info = out->info;
+
+    return aacd_thread_sink_open( out, info->samplerate * AACD_NULL_PERIOD_MS / 1000 * info->channels );
+}
+
+
+/**
+ * The "audio device" thread - one period per AACD_NULL_PERIOD_MS.
+ */
+static void* aacd_null_run( void *arg )
+{
+    AACDOutput *out = (AACDOutput*) arg;
+    AACDThreadSink *ts = (AACDThreadSink*) out->sink_ext;
+
+    struct timespec next;
+    clock_gettime( CLOCK_MONOTONIC, &next );
+
+    while (!__atomic_load_n( &ts->stopped, __ATOMIC_ACQUIRE ))
+    {
+        aacd_output_pull( out, ts->samples, ts->samplesLen );
+
+        if (aacd_output_drained( out )) break;
+
+        next.tv_nsec += AACD_NULL_PERIOD_MS * 1000000L;
+
+        if (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+
+        aacd_sink_sleep_until( &next );
+    }
+
+    aacd_output_finish( out );
+
+    return NULL;
+}
+
+
+static int aacd_null_start( AACDOutput *out )
+{
+    return aacd_thread_sink_start( out, aacd_null_run );
+}
+
+
+AACDSink aacd_null_sink = {
+    aacd_null_name,
+    aacd_null_open,
+    aacd_null_start,
+    aacd_thread_sink_close
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS - WAV sink
+ ****************************************************************************************************/
+
+static void aacd_wav_put( unsigned char *p, unsigned long val, int len )
+{
+    int i;
+
+    for (i=0; i < len; i++, val >>= 8) p[i] = (unsigned char) val;
+}
+
+
+/**
+ * Writes the WAV header - the sizes are set when closing.
+ */
+static void aacd_wav_header( FILE *file, AACDInfo *info, unsigned long bytes )
+{
+    unsigned char h[44];
+
+    memcpy( h, "RIFF", 4 );
+    aacd_wav_put( h + 4, 36 + bytes, 4 );
+    memcpy( h + 8, "WAVEfmt ", 8 );
+    aacd_wav_put( h + 16, 16, 4 );
+    aacd_wav_put( h + 20, 1, 2 );
+    aacd_wav_put( h + 22, info->channels, 2 );
+    aacd_wav_put( h + 24, info->samplerate, 4 );
+    aacd_wav_put( h + 28, info->samplerate * info->channels * 2, 4 );
+    aacd_wav_put( h + 32, info->channels * 2, 2 );
+    aacd_wav_put( h + 34, 16, 2 );
+    memcpy( h + 36, "data", 4 );
+    aacd_wav_put( h + 40, bytes, 4 );
+
+    fseek( file, 0, SEEK_SET );
+    fwrite( h, 1, sizeof( h ), file );
+}
+
+
+static const char* aacd_wav_name()
+{
+    return "WAV";
+}
+
+
+static int aacd_wav_open( AACDOutput *out )
+{
+    if (!out->sink_param)
+    {
+        AACD_ERROR( "wav_open() no file name" );
+        return -1;
+    }
+
+    FILE *file = fopen( out->sink_param, "wb" );
+
+    if (!file)
+    {
+        AACD_ERROR( "wav_open() cannot open file '%s'", out->sink_param );
+        return -1;
+    }
+
+    aacd_thread_sink_open( out, AACD_WAV_CHUNK );
+
+    AACDThreadSink *ts = (AACDThreadSink*) out->sink_ext;
+    ts->file = file;
+
+    aacd_wav_header( file, out->info, 0 );
+
+    return 0;
+}
+
+
+/**
+ * Writes the samples as soon as they are decoded - no silence is inserted.
+ */
+static void* aacd_wav_run( void *arg )
+{
+    AACDOutput *out = (AACDOutput*) arg;
+    AACDThreadSink *ts = (AACDThreadSink*) out->sink_ext;
+
+    while (!__atomic_load_n( &ts->stopped, __ATOMIC_ACQUIRE ))
+    {
+        unsigned long n = aacd_output_buffered( out );
+
+        if (!n)
+        {
+            if (aacd_output_drained( out )) break;
+
+            aacd_sink_sleep( AACD_WAV_WAIT_MS );
+            continue;
+        }
+
+        if (n > ts->samplesLen) n = ts->samplesLen;
+
+        aacd_output_pull( out, ts->samples, n );
+
+        // the WAV data are little endian:
+        unsigned long i;
+        unsigned char *p = (unsigned char*) ts->samples;
+
+        for (i=0; i < n; i++, p += 2) aacd_wav_put( p, (unsigned short) ts->samples[i], 2 );
+
+        ts->bytes += fwrite( ts->samples, 1, n * sizeof( short ), ts->file );
+    }
+
+    aacd_output_finish( out );
+
+    return NULL;
+}
+
+
+static int aacd_wav_start( AACDOutput *out )
+{
+    return aacd_thread_sink_start( out, aacd_wav_run );
+}
+
+
+static void aacd_wav_close( AACDOutput *out )
+{
+    AACDThreadSink *ts = (AACDThreadSink*) out->sink_ext;
+
+    if (!ts) return;
+
+    FILE *file = ts->file;
+    unsigned long bytes = ts->bytes;
+
+    aacd_thread_sink_close( out );
+
+    // the header is rewritten with the real sizes:
+    aacd_wav_header( file, out->info, bytes );
+
+    fclose( file );
+}
+
+
+AACDSink aacd_wav_sink = {
+    aacd_wav_name,
+    aacd_wav_open,
+    aacd_wav_start,
+    aacd_wav_close
+};
+
@@ -0,0 +1,336 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Sync word scanner for ADTS and MP3 streams.
+ * The candidates are searched 16 bytes at once (SSE2 / NEON, scalar fallback)
+ * and each candidate is validated by parsing the frame header and checking
+ * that the next frame header follows at the computed frame length.
+ *
+ * The FLV tags have no sync word - they are validated by the trailing PreviousTagSize.
+ */
+
+#define AACD_MODULE "Sync"
+
+#include "aac-common.h"
+
+#if !defined(AACD_SYNC_NO_SIMD) && defined(__SSE2__)
+#define AACD_SYNC_SSE2
+#include <emmintrin.h>
+#elif !defined(AACD_SYNC_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define AACD_SYNC_NEON
+#include <arm_neon.h>
+#endif
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+/**
+ * MP3 bitrates in kbit/s - [lsf][layer I, II, III][index].
+ */
+static const short aacd_mp3_bitrates[2][3][16] = {
+    {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 }
+    },
+    {
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 }
+    }
+};
+
+
+/**
+ * MP3 sampling rates - [version: 2.5, reserved, 2, 1][index].
+ */
+static const unsigned short aacd_mp3_samplerates[4][3] = {
+    { 11025, 12000, 8000 },
+    { 0, 0, 0 },
+    { 22050, 24000, 16000 },
+    { 44100, 48000, 32000 }
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+/**
+ * Finds the first sync word candidate: 0xff followed by a byte having all the mask bits set.
+ * @return the offset or -1 if not found
+ */
+static int aacd_sync_scan( const unsigned char *buffer, int len, unsigned char mask )
+{
+    int pos = 0;
+
+#if defined(AACD_SYNC_SSE2)
+    const __m128i ff = _mm_set1_epi8( (char) 0xff );
+    const __m128i m = _mm_set1_epi8( (char) mask );
+
+    for (; pos + 17 <= len; pos += 16)
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i*) (buffer + pos) );
+        __m128i b = _mm_loadu_si128( (const __m128i*) (buffer + pos + 1) );
+        __m128i c = _mm_and_si128( _mm_cmpeq_epi8( a, ff ), _mm_cmpeq_epi8( _mm_and_si128( b, m ), m ));
+
+        int bits = _mm_movemask_epi8( c );
+
+        if (bits) return pos + __builtin_ctz( bits );
+    }
+#elif defined(AACD_SYNC_NEON)
+    const uint8x16_t ff = vdupq_n_u8( 0xff );
+    const uint8x16_t m = vdupq_n_u8( mask );
+
+    for (; pos + 17 <= len; pos += 16)
+    {
+        uint8x16_t a = vld1q_u8( buffer + pos );
+        uint8x16_t b = vld1q_u8( buffer + pos + 1 );
+        uint64x2_t c = vreinterpretq_u64_u8( vandq_u8( vceqq_u8( a, ff ), vceqq_u8( vandq_u8( b, m ), m )));
+
+        // the exact offset is found by the scalar loop below:
+        if (vgetq_lane_u64( c, 0 ) | vgetq_lane_u64( c, 1 )) break;
+    }
+#endif
+
+    for (; pos + 1 < len; pos++)
+    {
+        if (buffer[pos] == 0xff && (buffer[pos+1] & mask) == mask) return pos;
+    }
+
+    return -1;
+}
+
+
+/**
+ * Parses the ADTS header.
+ * @return the frame length or -1 if the header is not valid
+ */
+int aacd_adts_header( const unsigned char *buffer, int len )
+{
+    if (len < 7) return -1;
+
+    // syncword + layer 00:
+    if (buffer[0] != 0xff || (buffer[1] & 0xf6) != 0xf0) return -1;
+
+    // sampling frequency index 12-15 is reserved:
+    if (((buffer[2] >> 2) & 0x0f) >= 12) return -1;
+
+    int framelen = ((buffer[3] & 0x03) << 11) | (buffer[4] << 3) | (buffer[5] >> 5);
+
+    // the header itself + optional CRC:
+    if (framelen < ((buffer[1] & 0x01) ? 7 : 9)) return -1;
+
+    return framelen;
+}
+
+
+/**
+ * Parses the MP3 frame header.
+ * The free format bitrate is not supported.
+ * @return the frame length or -1 if the header is not valid
+ */
+int aacd_mp3_header( const unsigned char *buffer, int len )
+{
+    if (len < 4) return -1;
+
+    if (buffer[0] != 0xff || (buffer[1] & 0xe0) != 0xe0) return -1;
+
+    int version = (buffer[1] >> 3) & 0x03;
+    int layer = (buffer[1] >> 1) & 0x03;
+    int bitrateIndex = buffer[2] >> 4;
+    int samplerateIndex = (buffer[2] >> 2) & 0x03;
+    int padding = (buffer[2] >> 1) & 0x01;
+
+    if (version == 1 || layer == 0 || bitrateIndex == 0 || bitrateIndex == 15
+        || samplerateIndex == 3 || (buffer[3] & 0x03) == 2) return -1;
+
+    int lsf = version != 3;
+    long bitrate = aacd_mp3_bitrates[ lsf ][ 3 - layer ][ bitrateIndex ] * 1000L;
+    long samplerate = aacd_mp3_samplerates[ version ][ samplerateIndex ];
+
+    // layer I:
+    if (layer == 3) return (int) (12 * bitrate / samplerate + padding) * 4;
+
+    // layer III of MPEG 2 / 2.5:
+    if (layer == 1 && lsf) return (int) (72 * bitrate / samplerate + padding);
+
+    return (int) (144 * bitrate / samplerate + padding);
+}
+
+
+/**
+ * Parses the FLV tag header.
+ * The "frame" of the FLV stream is the tag followed by its PreviousTagSize field.
+ * @return the length of the tag including the PreviousTagSize or -1 if the header is not valid
+ */
+int aacd_flv_header( const unsigned char *buffer, int len )
+{
+    if (len < AACD_FLV_TAG_HEADER) return -1;
+
+    // the encrypted tags (the filter bit) are not supported:
+    if (buffer[0] != AACD_FLV_AUDIO && buffer[0] != AACD_FLV_VIDEO && buffer[0] != AACD_FLV_SCRIPT) return -1;
+
+    // the stream id is always 0:
+    if (buffer[8] || buffer[9] || buffer[10]) return -1;
+
+    int datalen = (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+
+    return AACD_FLV_TAG_HEADER + datalen + 4;
+}
+
+
+/**
+ * Searches for a valid ADTS frame.
+ * The candidate is accepted when the next frame header follows
+ * or when the buffer ends before the next header.
+ * Returns the offset of ADTS frame.
+ */
+int aacd_adts_sync( unsigned char *buffer, int len )
+{
+    int pos = 0;
+
+    AACD_TRACE( "probe() start len=%d", len );
+
+    for (;;)
+    {
+        int n = aacd_sync_scan( buffer + pos, len - pos, 0xf0 );
+
+        if (n < 0) break;
+
+        pos += n;
+
+        int framelen = aacd_adts_header( buffer + pos, len - pos );
+
+        if (framelen > 0)
+        {
+            unsigned char *next = buffer + pos + framelen;
+
+            // the fixed header must be the same (ID, layer, profile, sampling frequency):
+            if (pos + framelen + 3 > len
+                || (next[0] == 0xff && next[1] == buffer[pos+1] && (next[2] & 0xfc) == (buffer[pos+2] & 0xfc)))
+            {
+                AACD_TRACE( "probe() found ADTS start at offset %d", pos );
+                return pos;
+            }
+        }
+
+        pos++;
+    }
+
+    AACD_WARN( "probe() could not find ADTS start" );
+
+    return -1;
+}
+
+
+/**
+ * Searches for a valid MP3 frame.
+ * The candidate is accepted when the next frame header follows
+ * or when the buffer ends before the next header.
+ * Returns the offset of the frame.
+ */
+int aacd_mp3_sync( unsigned char *buffer, int len )
+{
+    int pos = 0;
+
+    AACD_TRACE( "probe() start len=%d", len );
+
+    for (;;)
+    {
+        int n = aacd_sync_scan( buffer + pos, len - pos, 0xe0 );
+
+        if (n < 0) break;
+
+        pos += n;
+
+        int framelen = aacd_mp3_header( buffer + pos, len - pos );
+
+        if (framelen > 0)
+        {
+            unsigned char *next = buffer + pos + framelen;
+
+            // the version, layer and sampling rate must be the same:
+            if (pos + framelen + 4 > len
+                || (next[0] == 0xff && (next[1] & 0xfe) == (buffer[pos+1] & 0xfe)
+                    && (next[2] & 0x0c) == (buffer[pos+2] & 0x0c) && aacd_mp3_header( next, 4 ) > 0))
+            {
+                AACD_TRACE( "probe() found MP3 frame at offset %d", pos );
+                return pos;
+            }
+        }
+
+        pos++;
+    }
+
+    AACD_WARN( "probe() could not find MP3 frame" );
+
+    return -1;
+}
+
+
+/**
+ * Searches for a valid FLV tag.
+ * The FLV file header is skipped - the first tag follows it (and the PreviousTagSize0).
+ * The candidate is accepted when its PreviousTagSize matches
+ * or when the buffer ends before it.
+ * Returns the offset of the tag.
+ */
+int aacd_flv_sync( unsigned char *buffer, int len )
+{
+    int pos = 0;
+
+    AACD_TRACE( "probe() start len=%d", len );
+
+    // the file header - "FLV", version 1, flags and the header size:
+    if (len >= 9 && buffer[0] == 'F' && buffer[1] == 'L' && buffer[2] == 'V' && buffer[3] == 1)
+    {
+        unsigned long hdrlen = ((unsigned long) buffer[5] << 24) | (buffer[6] << 16) | (buffer[7] << 8) | buffer[8];
+
+        if (hdrlen >= 9 && hdrlen + 4 <= (unsigned long) len)
+        {
+            AACD_TRACE( "probe() found FLV header, first tag at offset %lu", hdrlen + 4 );
+            return (int) hdrlen + 4;
+        }
+    }
+
+    for (; pos + AACD_FLV_TAG_HEADER <= len; pos++)
+    {
+        int taglen = aacd_flv_header( buffer + pos, len - pos );
+
+        if (taglen < 0) continue;
+
+        const unsigned char *prev = buffer + pos + taglen - 4;
+
+        if (taglen > len - pos
+            || (((unsigned long) prev[0] << 24) | (prev[1] << 16) | (prev[2] << 8) | prev[3]) == (unsigned long) taglen - 4)
+        {
+            AACD_TRACE( "probe() found FLV tag at offset %d", pos );
+            return pos;
+        }
+    }
+
+    AACD_WARN( "probe() could not find FLV tag" );
+
+    return -1;
+}
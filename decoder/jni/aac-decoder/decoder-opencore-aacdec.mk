@@ -11,7 +11,7 @@ LOCAL_C_INCLUDES 		:= $(OPENCORE_DIR)/include \
 
 LOCAL_C_INCLUDES 		:= $(OPENCORE_DIR)/include $(LOCAL_PATH)/../opencore-aacdec/oscl
 
-LOCAL_CFLAGS 			:= $(cflags_loglevels)
+LOCAL_CFLAGS 			:= $(cflags_loglevels) $(ABI_CFLAGS)
 
 include $(BUILD_STATIC_LIBRARY)
 
@@ -26,6 +26,7 @@
 #include "pvmp3_dec_defs.h"
 #include "pvmp3decoder_api.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 typedef struct AACDOpenCoreMP3 {
@@ -69,7 +70,7 @@ static void aacd_opencoremp3_destroy( AACDInfo *info )
 
 static long aacd_opencoremp3_start( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size)
 {
-    AACD_TRACE( "start() buffer=%x size=%d", (*(unsigned long*)buffer), buffer_size );
+    AACD_TRACE( "start() buffer=%02x%02x%02x%02x size=%lu", buffer[0], buffer[1], buffer[2], buffer[3], buffer_size );
 
     AACDOpenCoreMP3 *oc = (AACDOpenCoreMP3*) info->ext;
     tPVMP3DecoderExternal *pExt = oc->pExt;
@@ -88,60 +89,47 @@ static long aacd_opencoremp3_start( AACDInfo *info, unsigned char *buffer, unsig
     pExt->equalizerType             = flat;
     pvmp3_InitDecoder( oc->pExt, oc->pMem );
 
-    int32_t status;
+    int32_t status = NO_DECODING_ERROR;
     int frameDecoded = 0;
     int attempts = 16;
-    int totalConsumed = 0;
+    unsigned long offset = 0;
     pExt->outputFrameSize           = 0;
 
-    /* pre-init search adts sync */
+    /* pre-init search sync */
     while (!frameDecoded && attempts--) {
-        pExt->pInputBuffer              = buffer;
-        pExt->inputBufferMaxLength      = buffer_size;
-        pExt->inputBufferCurrentLength  = buffer_size;
+        pExt->pInputBuffer              = buffer + offset;
+        pExt->inputBufferMaxLength      = buffer_size - offset;
+        pExt->inputBufferCurrentLength  = buffer_size - offset;
         pExt->inputBufferUsedLength     = 0;
         pExt->outputFrameSize           = 4096;
 
         status = pvmp3_framedecoder(pExt, oc->pMem);
         AACD_DEBUG( "start() Status[0]: %d - consumed %d bytes", status, pExt->inputBufferUsedLength );
 
-        totalConsumed += pExt->inputBufferUsedLength;
-
         if (status != NO_DECODING_ERROR) {
             AACD_ERROR( "start() frame decode error=%d", status );
 
-            if (!pExt->inputBufferUsedLength) {
-                AACD_ERROR( "start() first frame cannot be decoded - trying to sync again" );
-
-                int move = buffer_size < 2048 ? (buffer_size >> 1) : 1024;
-                buffer += move;
-                buffer_size -= move;
-                totalConsumed += move;
-
-                pExt->pInputBuffer              = buffer;
-                pExt->inputBufferMaxLength      = buffer_size;
-                pExt->inputBufferCurrentLength  = buffer_size;
-
-                ERROR_CODE err = pvmp3_frame_synch( oc->pExt, oc->pMem );
-
-                if (err == SYNCH_LOST_ERROR) {
-                    AACD_ERROR( "start() cannot re-sync the stream after next %d bytes, status=%d", move, err );
-                }
-                else if (err != NO_DECODING_ERROR) {
-                    AACD_ERROR( "start() cannot sync the stream status=%d", err );
-                    break;
-                }
-                else {
-                    totalConsumed += pExt->inputBufferUsedLength;
-                    AACD_INFO( "start() sync was successful - used bytes=%d", totalConsumed );
-                }
+            // skip the bad frame (at least one byte) and find next valid frame header:
+            unsigned long skip = pExt->inputBufferUsedLength > 0 ? pExt->inputBufferUsedLength : 1;
+
+            if (offset + skip >= buffer_size) break;
+
+            int pos = aacd_mp3_sync( buffer + offset + skip, buffer_size - offset - skip );
+
+            if (pos < 0) {
+                AACD_ERROR( "start() cannot re-sync the stream" );
+                break;
             }
-            buffer -= pExt->inputBufferUsedLength;
-            buffer_size -= pExt->inputBufferUsedLength;
+
+            offset += skip + pos;
+            AACD_INFO( "start() sync was successful - skipped bytes=%lu", offset );
+        }
+        else {
+            offset += pExt->inputBufferUsedLength;
+            frameDecoded = 1;
         }
-        else frameDecoded = 1;
 
-        if (buffer_size <= 64) break;
+        if (buffer_size - offset <= 64) break;
     }
 
     //free(pExt->pOutputBuffer);
@@ -153,7 +141,7 @@ static long aacd_opencoremp3_start( AACDInfo *info, unsigned char *buffer, unsig
         return -1;
     }
 
-    AACD_DEBUG( "start() bytesconsumed=%d", totalConsumed );
+    AACD_DEBUG( "start() bytesconsumed=%lu", offset );
 
     info->samplerate = pExt->samplingRate;
     info->channels = pExt->num_channels;
@@ -161,11 +149,11 @@ static long aacd_opencoremp3_start( AACDInfo *info, unsigned char *buffer, unsig
     info->frame_bytesconsumed = pExt->inputBufferUsedLength;
     info->frame_samples = pExt->outputFrameSize;
 
-    return totalConsumed;
+    return offset;
 }
 
 
-static int aacd_opencoremp3_decode( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size, jshort *jsamples, jint outLen )
+static int aacd_opencoremp3_decode( AACDInfo *info, unsigned char *buffer, unsigned long buffer_size, short *jsamples, int outLen )
 {
     AACDOpenCoreMP3 *oc = (AACDOpenCoreMP3*) info->ext;
     tPVMP3DecoderExternal *pExt = oc->pExt;
@@ -194,16 +182,28 @@ static int aacd_opencoremp3_decode( AACDInfo *info, unsigned char *buffer, unsig
 
 
 static int aacd_opencoremp3_sync( AACDInfo *info, unsigned char *buffer, int buffer_size )
+{
+    return aacd_mp3_sync( buffer, buffer_size );
+}
+
+
+
+/**
+ * Clears the decoder's state after the stream was repositioned.
+ */
+static void aacd_opencoremp3_reset( AACDInfo *info )
 {
     AACDOpenCoreMP3 *oc = (AACDOpenCoreMP3*) info->ext;
 
-    if (oc->pExt->pOutputBuffer)
-    {
-        ERROR_CODE err = pvmp3_frame_synch( oc->pExt, oc->pMem );
+    pvmp3_resetDecoder( oc->pMem );
+}
 
-        return err != NO_DECODING_ERROR ? -1 : oc->pExt->inputBufferUsedLength;
-    }
 
+/**
+ * Prepares the struct for a new stream - start() initializes the decoder anyway.
+ */
+static int aacd_opencoremp3_recycle( void *ext )
+{
     return 0;
 }
 
@@ -214,6 +214,12 @@ AACDDecoder aacd_opencoremp3_decoder = {
     aacd_opencoremp3_start,
     aacd_opencoremp3_decode,
     aacd_opencoremp3_destroy,
-    aacd_opencoremp3_sync
+    aacd_opencoremp3_sync,
+    aacd_mp3_header,
+    aacd_opencoremp3_reset,
+    aacd_opencoremp3_recycle,
+    NULL,
+    NULL,
+    NULL
 };
 
@@ -0,0 +1,1203 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host benchmark of the native decoders.
+ * Decodes ADTS AAC / MP3 / FLV / MP4 files and reports the decoding throughput
+ * and the per-frame latency percentiles.
+ *
+ * The whole file is loaded into memory first and then handed over to the decoder
+ * in chunks (like BufferReader does), so the I/O is not measured.
+ *
+ * The scan mode (-s) measures the throughput of the sync scanner instead:
+ * it searches for every frame starting one byte after the previous one,
+ * so the whole payload is scanned for false sync words.
+ *
+ * The file input modes measure the input path too - the file is read
+ * by read() and copied into the decoder's buffer (-r, like BufferReader does)
+ * or it is memory mapped and decoded in place (-m).
+ *
+ * The seek mode (-S) measures the seeking latency: it jumps to evenly spread
+ * positions in a shuffled order and decodes one frame after each jump.
+ *
+ * The engine mode (-e) decodes the file as many streams at once (-n)
+ * by the decoding engine - it is fed and drained in chunks by the main thread
+ * and the PCM checksums of all the streams are compared to the serial decoding.
+ *
+ * The parallel mode (-p) decodes the file split into segments by 1..N threads
+ * (offline decoding) and compares the joined output to the serial decoding.
+ *
+ * The output format (-f) selects the 32-bit or float samples - the time includes
+ * the conversion and the checksum must be the same as of the 16-bit output.
+ *
+ * The quality level (-q) is switched after the first frame - in the middle
+ * of the stream like the player does it.
+ *
+ * The resample mode (-R) passes the decoded PCM through the post-decode stage
+ * (downmix + polyphase resampler) and through a linear interpolating resampler
+ * like the platform's default one (AudioResampler order 1). It reports the throughput
+ * of both and their SNR measured on pure tones. The checksum of the polyphase output
+ * must be the same for the SIMD and the scalar (SIMD=0) builds.
+ */
+
+#define AACD_MODULE "Bench"
+
+#include "aac-common.h"
+#include "aac-engine.h"
+#include "aac-parallel.h"
+#include "aac-post.h"
+
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+typedef struct BenchInput {
+    unsigned char *data;
+    unsigned long size;
+    unsigned long pos;
+    unsigned long chunk;
+    int direct;
+} BenchInput;
+
+
+typedef struct BenchStream {
+    AACDStream *stream;
+    unsigned long pos;
+    unsigned long samples;
+    unsigned long checksum;
+    int done;
+} BenchStream;
+
+
+typedef struct BenchResult {
+    unsigned long frames;
+    unsigned long samples;
+    unsigned long long ns;
+
+    // per-frame decoding time:
+    unsigned long long *latencies;
+    unsigned long latenciesLen;
+
+    unsigned long samplerate;
+    unsigned char channels;
+
+    // checksum of the decoded PCM data (always of the 16-bit samples):
+    unsigned long checksum;
+
+    // the output format - see AACD_PCM_*:
+    int format;
+
+    // the requested quality level and the one used by the decoder - see AACD_QUALITY_*:
+    int quality;
+    int qualityUsed;
+
+    // the duration in samples per channel (at the full quality sampling rate):
+    unsigned long long duration;
+
+    // the start times - the first start and the sum of the next ones (pooled decoders):
+    AACDStartTimes firstStart;
+    AACDStartTimes nextStarts;
+    unsigned long starts;
+} BenchResult;
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Memory reader
+ ****************************************************************************************************/
+
+static const char* bench_reader_name()
+{
+    return "Memory";
+}
+
+
+static long bench_reader_read( AACDInfo *info )
+{
+    BenchInput *in = (BenchInput*) info->reader_ext;
+    unsigned long len = in->size - in->pos;
+
+    if (len > in->chunk) len = in->chunk;
+
+    // zero-copy: the previous chunk is considered released
+    if (in->direct) aacd_direct_save( info );
+
+    if (!len) return 0;
+
+    if (in->direct) aacd_direct_buffer( info, in->data + in->pos, len );
+    else memcpy( aacd_prepare_buffer( info, len ), in->data + in->pos, len );
+
+    in->pos += len;
+
+    return len;
+}
+
+
+static int bench_reader_seek( AACDInfo *info, unsigned long offset )
+{
+    BenchInput *in = (BenchInput*) info->reader_ext;
+
+    if (offset > in->size) return -1;
+
+    in->pos = offset;
+
+    return 0;
+}
+
+
+static AACDReader bench_reader = {
+    bench_reader_name,
+    bench_reader_read,
+    NULL,
+    bench_reader_seek
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS - File reader
+ ****************************************************************************************************/
+
+static const char* bench_file_reader_name()
+{
+    return "File";
+}
+
+
+/**
+ * Reads the chunk and copies it - like the BufferReader path.
+ */
+static long bench_file_reader_read( AACDInfo *info )
+{
+    FILE *f = (FILE*) info->reader_ext;
+    unsigned char buf[ 8192 ];
+
+    size_t n = fread( buf, 1, sizeof( buf ), f );
+
+    if (n) memcpy( aacd_prepare_buffer( info, n ), buf, n );
+
+    return (long) n;
+}
+
+
+static void bench_file_reader_destroy( AACDInfo *info )
+{
+    if (info->reader_ext) fclose( (FILE*) info->reader_ext );
+
+    info->reader_ext = NULL;
+}
+
+
+static AACDReader bench_file_reader = {
+    bench_file_reader_name,
+    bench_file_reader_read,
+    bench_file_reader_destroy
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+static unsigned long long bench_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static int bench_cmp( const void *a, const void *b )
+{
+    unsigned long long x = *(const unsigned long long*) a;
+    unsigned long long y = *(const unsigned long long*) b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+
+/**
+ * Returns the 16-bit sample restored from the output format.
+ */
+static unsigned short bench_sample( int format, const void *out, unsigned long i )
+{
+    switch (format)
+    {
+        case AACD_PCM_32: return (unsigned short) (((const int*) out)[i] >> 16);
+        case AACD_PCM_FLOAT: return (unsigned short) (short) lrintf( ((const float*) out)[i] * 32768.0f );
+    }
+
+    return (unsigned short) ((const short*) out)[i];
+}
+
+
+static unsigned char* bench_load( const char *file, unsigned long *size )
+{
+    FILE *f = fopen( file, "rb" );
+
+    if (!f) return NULL;
+
+    fseek( f, 0, SEEK_END );
+    *size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+
+    unsigned char *data = (unsigned char*) malloc( *size );
+
+    if (fread( data, 1, *size, f ) != *size)
+    {
+        free( data );
+        data = NULL;
+    }
+
+    fclose( f );
+
+    return data;
+}
+
+
+/**
+ * Decodes the whole input - one frame per round.
+ */
+static int bench_decode( AACDDecoder *decoder, AACDReader *reader, void *reader_ext, BenchResult *res )
+{
+    if (!reader_ext) return -1;
+
+    AACDInfo *info = aacd_start( decoder, reader, reader_ext );
+
+    if (!info) return -1;
+
+    res->samplerate = info->samplerate;
+    res->channels = info->channels;
+
+    AACDStartTimes *st = &info->start_times;
+
+    if (!res->starts++) res->firstStart = *st;
+    else
+    {
+        res->nextStarts.init += st->init;
+        res->nextStarts.read += st->read;
+        res->nextStarts.sync += st->sync;
+        res->nextStarts.decode += st->decode;
+    }
+
+    // the max frame size: 2048 samples per channel (AAC+)
+    int outLen = 2048 * (info->channels > 2 ? info->channels : 2);
+    void *samples = malloc( aacd_pcm_size( res->format ) * outLen );
+
+    int switched = 0;
+
+    for (;;)
+    {
+        // one frame per round = the minimal output buffer:
+        int len = info->frame_samples ? info->frame_samples : outLen;
+
+        unsigned long long t0 = bench_now();
+
+        if (res->format == AACD_PCM_16) aacd_decode( info, (short*) samples, len );
+        else aacd_decode_pcm( info, res->format, samples, len );
+
+        unsigned long long t = bench_now() - t0;
+
+        if (!info->round_frames) break;
+
+        if (res->quality && !switched++) res->qualityUsed = aacd_set_quality( info, res->quality );
+
+        res->ns += t;
+        res->samples += info->round_samples;
+
+        unsigned long j;
+        for (j=0; j < info->round_samples; j++)
+        {
+            res->checksum = res->checksum * 31 + bench_sample( res->format, samples, j );
+        }
+
+        unsigned long i;
+        for (i=0; i < info->round_frames; i++)
+        {
+            if (res->frames == res->latenciesLen)
+            {
+                res->latenciesLen = res->latenciesLen ? res->latenciesLen * 2 : 4096;
+                res->latencies = realloc( res->latencies, sizeof( unsigned long long ) * res->latenciesLen );
+            }
+
+            res->latencies[ res->frames++ ] = t / info->round_frames;
+        }
+    }
+
+    res->duration += info->sample_pos;
+
+    free( samples );
+    aacd_stop( info );
+
+    return 0;
+}
+
+
+/**
+ * Scans the whole input for the sync words.
+ */
+static void bench_scan( const char *file, const char *decoder, BenchInput *in, int repeat )
+{
+    int (*sync)( unsigned char*, int ) = strcmp( decoder, "OpenCORE-MP3" ) ? aacd_adts_sync : aacd_mp3_sync;
+    unsigned long frames = 0;
+    unsigned long long ns = 0;
+    int i;
+
+    for (i=0; i < repeat; i++)
+    {
+        unsigned long pos = 0;
+        frames = 0;
+
+        unsigned long long t0 = bench_now();
+
+        while (pos < in->size)
+        {
+            int n = sync( in->data + pos, (int) (in->size - pos) );
+
+            if (n < 0) break;
+
+            frames++;
+            pos += n + 1;
+        }
+
+        ns += bench_now() - t0;
+    }
+
+    if (!ns) ns = 1;
+
+    printf( "%s [%s]: scan\n", file, decoder );
+    printf( "  frames=%lu, bytes=%lu, time=%.3f ms\n", frames, in->size, ns / 1e6 / repeat );
+    printf( "  throughput=%.2f GB/s\n", (double) in->size * repeat / ns );
+}
+
+
+/**
+ * Seeks to evenly spread positions in a shuffled order.
+ */
+static void bench_seek( const char *file, const char *decoder, BenchInput *in, int seeks )
+{
+    AACDInfo *info = aacd_start( aacd_decoder_get_by_name( decoder ), &bench_reader, in );
+
+    if (!info) return;
+
+    aacd_index_enable( info );
+
+    unsigned long fs = info->frame_samples / info->channels;
+
+    // the duration is estimated from the first frame if there is no Xing / VBRI tag:
+    unsigned long duration = info->duration;
+    if (!duration) duration = (unsigned long) ((unsigned long long) in->size * fs / info->frame_bytesconsumed);
+
+    int outLen = 2048 * (info->channels > 2 ? info->channels : 2);
+    short *samples = (short*) malloc( sizeof( short ) * outLen );
+
+    unsigned long long ns = 0;
+    unsigned long long maxns = 0;
+    int misses = 0;
+    int i;
+
+    for (i=0; i < seeks; i++)
+    {
+        // 7919 is a prime - so all the positions are visited:
+        unsigned long target = (unsigned long) ((unsigned long long) duration * ((i * 7919UL) % seeks) / seeks);
+
+        unsigned long long t0 = bench_now();
+
+        int err = aacd_seek( info, target );
+        unsigned long pos = info->sample_pos;
+
+        if (!err) aacd_decode( info, samples, info->frame_samples );
+
+        unsigned long long t = bench_now() - t0;
+
+        ns += t;
+        if (maxns < t) maxns = t;
+
+        // the TOC positions are approximate (the MP4 sample index is exact):
+        if (err || ((info->index->sync || info->decoder->locate) && (pos > target || pos + fs <= target) && info->round_frames)) misses++;
+    }
+
+    if (!seeks) seeks = 1;
+
+    printf( "%s [%s]: seek\n", file, decoder );
+    printf( "  seeks=%d, misses=%d, indexed=%.2f s, toc=%lu\n", seeks, misses,
+            (double) info->index->next_sample / info->samplerate, info->toclen );
+    printf( "  seek+decode latency (ms): avg=%.3f, max=%.3f\n", ns / 1e6 / seeks, maxns / 1e6 );
+
+    free( samples );
+    aacd_stop( info );
+}
+
+
+/**
+ * Decodes the file as many concurrent streams by the engine.
+ */
+static void bench_engine( const char *file, const char *decoder, BenchInput *in, int streams, int workers )
+{
+    AACDDecoder *dec = aacd_decoder_get_by_name( decoder );
+
+    if (dec->open)
+    {
+        fprintf( stderr, "The engine does not support the decoder %s - skipping '%s'\n", decoder, file );
+        return;
+    }
+
+    // the serial reference:
+    BenchResult ref;
+    memset( &ref, 0, sizeof( ref ));
+
+    in->pos = 0;
+    if (bench_decode( dec, &bench_reader, in, &ref ))
+    {
+        fprintf( stderr, "Cannot start decoding '%s'\n", file );
+        return;
+    }
+
+    free( ref.latencies );
+
+    AACDEngine *engine = aacd_engine_create( workers );
+
+    if (!engine) return;
+
+    BenchStream *bs = (BenchStream*) calloc( streams, sizeof( BenchStream ));
+    short *samples = (short*) malloc( sizeof( short ) * 8192 );
+    int active = streams;
+    int errors = 0;
+    int i;
+
+    for (i=0; i < streams; i++) bs[i].stream = aacd_engine_open( engine, dec, 4 * in->chunk, 32768 );
+
+    unsigned long long t0 = bench_now();
+
+    while (active)
+    {
+        int progress = 0;
+
+        for (i=0; i < streams; i++)
+        {
+            BenchStream *b = bs + i;
+
+            if (b->done) continue;
+
+            if (b->pos < in->size)
+            {
+                unsigned long len = in->size - b->pos < in->chunk ? in->size - b->pos : in->chunk;
+                unsigned long n = aacd_engine_feed( b->stream, in->data + b->pos, len );
+
+                b->pos += n;
+                if (b->pos == in->size) aacd_engine_eof( b->stream );
+                if (n) progress = 1;
+            }
+
+            // the state first - the samples are stored before the stream finishes:
+            int state = aacd_engine_state( b->stream );
+            unsigned long n;
+
+            while ((n = aacd_engine_pull( b->stream, samples, 8192 )))
+            {
+                unsigned long j;
+                for (j=0; j < n; j++) b->checksum = b->checksum * 31 + (unsigned short) samples[j];
+
+                b->samples += n;
+                progress = 1;
+            }
+
+            if (state == AACD_STREAM_FINISHED || state == AACD_STREAM_ERROR)
+            {
+                if (state == AACD_STREAM_ERROR) errors++;
+
+                aacd_engine_close( b->stream );
+                b->done = 1;
+                active--;
+            }
+        }
+
+        if (!progress) sched_yield();
+    }
+
+    unsigned long long ns = bench_now() - t0;
+
+    aacd_engine_destroy( engine );
+
+    int mismatches = 0;
+    for (i=0; i < streams; i++)
+    {
+        if (bs[i].checksum != ref.checksum || bs[i].samples != ref.samples) mismatches++;
+    }
+
+    if (!ns) ns = 1;
+
+    double audioSecs = (double) ref.samples * streams / ref.channels / ref.samplerate;
+
+    printf( "%s [%s]: engine\n", file, decoder );
+    printf( "  streams=%d, workers=%d, errors=%d, checksum mismatches=%d\n", streams, workers, errors, mismatches );
+    printf( "  audio=%.2f s, wall=%.3f s, realtime factor=%.1fx, serial decoding=%.3f s\n",
+            audioSecs, ns / 1e9, audioSecs * 1e9 / ns, ref.ns * streams / 1e9 );
+
+    free( samples );
+    free( bs );
+}
+
+
+/**
+ * Decodes the whole input serially into one buffer.
+ * @param res if not NULL, then the sampling rate and the channels are stored there
+ * @return the samples (must be freed) or NULL
+ */
+static short* bench_decode_all( AACDDecoder *decoder, BenchInput *in, unsigned long *len, BenchResult *res )
+{
+    in->pos = 0;
+
+    AACDInfo *info = aacd_start( decoder, &bench_reader, in );
+
+    if (!info) return NULL;
+
+    if (res)
+    {
+        res->samplerate = info->samplerate;
+        res->channels = info->channels;
+    }
+
+    unsigned long cap = 1 << 20;
+    short *samples = (short*) malloc( sizeof( short ) * cap );
+
+    *len = 0;
+
+    for (;;)
+    {
+        if (cap - *len < 65536)
+        {
+            cap *= 2;
+            samples = (short*) realloc( samples, sizeof( short ) * cap );
+        }
+
+        aacd_decode( info, samples + *len, (int) (cap - *len) );
+
+        if (!info->round_frames) break;
+
+        *len += info->round_samples;
+    }
+
+    aacd_stop( info );
+
+    return samples;
+}
+
+
+/**
+ * Decodes the file split into segments by 1..threads threads and compares the output to the serial decoding.
+ * @param tolerance the maximal allowed difference of a sample (0 = exact)
+ * @return 0 if all the outputs match the serial decoding, 1 otherwise
+ */
+static int bench_parallel( const char *file, const char *decoder, BenchInput *in, int threads, int preroll, int repeat, int tolerance )
+{
+    AACDDecoder *dec = aacd_decoder_get_by_name( decoder );
+    unsigned long len = 0;
+    unsigned long long ns = 0;
+    int i;
+
+    // e.g. FLV - the frames can be found only by decoding the container serially:
+    if (!dec->header)
+    {
+        printf( "%s [%s]: parallel decoding not supported - skipped\n", file, decoder );
+        return 0;
+    }
+
+    short *ref = NULL;
+
+    for (i=0; i < repeat; i++)
+    {
+        free( ref );
+
+        unsigned long long t0 = bench_now();
+        ref = bench_decode_all( dec, in, &len, NULL );
+        ns += bench_now() - t0;
+    }
+
+    if (!ref)
+    {
+        fprintf( stderr, "Cannot start decoding '%s'\n", file );
+        return 1;
+    }
+
+    unsigned long long serial = ns / repeat;
+    int failed = 0;
+
+    printf( "%s [%s]: parallel, preroll=%d frames, tolerance=%d\n", file, decoder, preroll, tolerance );
+    printf( "  serial: samples=%lu, time=%.3f ms\n", len, serial / 1e6 );
+
+    int t;
+    for (t=1; t <= threads; t++)
+    {
+        AACDParallelResult res;
+        memset( &res, 0, sizeof( res ));
+        ns = 0;
+
+        for (i=0; i < repeat; i++)
+        {
+            free( res.samples );
+
+            unsigned long long t0 = bench_now();
+            int err = aacd_parallel_decode( dec, in->data, in->size, t, preroll, &res );
+            ns += bench_now() - t0;
+
+            if (err) break;
+        }
+
+        if (!res.samples)
+        {
+            printf( "  threads=%d: FAILED - cannot decode\n", t );
+            failed = 1;
+            continue;
+        }
+
+        ns /= repeat;
+        if (!ns) ns = 1;
+
+        // the differences are expected only right after the joins (if the preroll is too short):
+        unsigned long n = res.len < len ? res.len : len;
+        unsigned long diffs = 0;
+        int maxdiff = 0;
+        unsigned long j;
+
+        for (j=0; j < n; j++)
+        {
+            int d = abs( (int) res.samples[j] - (int) ref[j] );
+
+            if (d)
+            {
+                diffs++;
+                if (d > maxdiff) maxdiff = d;
+            }
+        }
+
+        // the segments must be stitched sample-exactly - any length difference is an error:
+        const char *verdict = res.len != len ? "FAILED - length differs"
+                            : maxdiff > tolerance ? "FAILED - tolerance exceeded"
+                            : diffs ? "OK" : "OK (exact)";
+
+        if (res.len != len || maxdiff > tolerance) failed = 1;
+
+        printf( "  threads=%d: samples=%lu, time=%.3f ms, speedup=%.2fx, diff samples=%lu, max diff=%d - %s\n",
+                t, res.len, ns / 1e6, (double) serial / ns, diffs, maxdiff, verdict );
+
+        free( res.samples );
+    }
+
+    free( ref );
+
+    return failed;
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Resampling
+ ****************************************************************************************************/
+
+/**
+ * The linear interpolating resampler - the baseline (like AudioResamplerOrder1).
+ * The position is 32.32 fixed-point, the interpolation is Q15.
+ */
+typedef struct BenchLinear {
+    int channels;
+    unsigned long long step;
+    unsigned long long pos;
+    short last[2];
+} BenchLinear;
+
+
+static void bench_linear_init( BenchLinear *lin, int channels, unsigned long inRate, unsigned long outRate )
+{
+    memset( lin, 0, sizeof( BenchLinear ));
+
+    lin->channels = channels;
+    lin->step = ((unsigned long long) inRate << 32) / outRate;
+}
+
+
+/**
+ * Resamples the next frames - the previous frame is kept between the calls.
+ * @return the number of the output samples (all channels)
+ */
+static unsigned long bench_linear_process( BenchLinear *lin, const short *in, unsigned long frames, short *out )
+{
+    int ch = lin->channels;
+    unsigned long n = 0;
+    int c;
+
+    // the position 0 is the last frame of the previous call:
+    while ((lin->pos >> 32) < frames)
+    {
+        unsigned long i = (unsigned long) (lin->pos >> 32);
+        int frac = (int) ((lin->pos >> 17) & 0x7fff);
+
+        for (c=0; c < ch; c++)
+        {
+            int a = i ? in[ (i-1) * ch + c ] : lin->last[c];
+            int b = in[ i * ch + c ];
+
+            out[ n++ ] = (short) (a + (((b - a) * frac) >> 15));
+        }
+
+        lin->pos += lin->step;
+    }
+
+    if (frames)
+    {
+        for (c=0; c < ch; c++) lin->last[c] = in[ (frames-1) * ch + c ];
+
+        lin->pos -= (unsigned long long) frames << 32;
+    }
+
+    return n;
+}
+
+
+/**
+ * Returns the SNR in dB of the tone by the least squares fit of the sine
+ * (and the DC) - the first and the last 10 % of the samples are skipped.
+ */
+static double bench_tone_snr( const short *samples, unsigned long frames, int channels, double freq, unsigned long rate )
+{
+    double m[3][4];
+    unsigned long b = frames / 10;
+    unsigned long e = frames - b;
+    unsigned long i;
+    int j, k;
+
+    memset( m, 0, sizeof( m ));
+
+    for (i=b; i < e; i++)
+    {
+        double w = 2 * M_PI * freq * i / rate;
+        double v[3] = { sin( w ), cos( w ), 1.0 };
+        double y = samples[ i * channels ];
+
+        for (j=0; j < 3; j++)
+        {
+            for (k=0; k < 3; k++) m[j][k] += v[j] * v[k];
+            m[j][3] += v[j] * y;
+        }
+    }
+
+    // Gauss elimination of the 3x3 normal equations:
+    for (j=0; j < 3; j++)
+    {
+        for (k=j+1; k < 3; k++)
+        {
+            double f = m[k][j] / m[j][j];
+            int l;
+
+            for (l=j; l < 4; l++) m[k][l] -= f * m[j][l];
+        }
+    }
+
+    double x[3];
+
+    for (j=2; j >= 0; j--)
+    {
+        x[j] = m[j][3];
+
+        for (k=j+1; k < 3; k++) x[j] -= m[j][k] * x[k];
+
+        x[j] /= m[j][j];
+    }
+
+    double sig = 0;
+    double noise = 0;
+
+    for (i=b; i < e; i++)
+    {
+        double w = 2 * M_PI * freq * i / rate;
+        double fit = x[0] * sin( w ) + x[1] * cos( w );
+        double d = samples[ i * channels ] - fit - x[2];
+
+        sig += fit * fit;
+        noise += d * d;
+    }
+
+    return noise > 0 ? 10 * log10( sig / noise ) : 200;
+}
+
+
+/**
+ * Resamples the tone (one second, -6 dB) by both resamplers and prints their SNR.
+ */
+static void bench_resample_tone( double freq, unsigned long inRate, unsigned long outRate )
+{
+    unsigned long frames = inRate;
+    short *in = (short*) malloc( sizeof( short ) * frames );
+    unsigned long i;
+
+    for (i=0; i < frames; i++) in[i] = (short) lrint( 16384 * sin( 2 * M_PI * freq * i / inRate ));
+
+    AACDPost *post = aacd_post_create( 1, inRate, outRate );
+    short *out = (short*) malloc( sizeof( short ) * aacd_post_max_out( post, frames ));
+
+    unsigned long n = aacd_post_process( post, in, frames, out );
+    double poly = bench_tone_snr( out, n, 1, freq, outRate );
+
+    BenchLinear lin;
+    bench_linear_init( &lin, 1, inRate, outRate );
+
+    n = bench_linear_process( &lin, in, frames, out );
+    double linear = bench_tone_snr( out, n, 1, freq, outRate );
+
+    printf( "  tone %.0f Hz: SNR polyphase=%.1f dB, linear=%.1f dB\n", freq, poly, linear );
+
+    aacd_post_destroy( post );
+    free( out );
+    free( in );
+}
+
+
+/**
+ * Resamples the decoded file by the post-decode stage and by the linear resampler.
+ */
+static void bench_resample( const char *file, const char *decoder, BenchInput *in, unsigned long outRate, int repeat )
+{
+    AACDDecoder *dec = aacd_decoder_get_by_name( decoder );
+    BenchResult info;
+    unsigned long len = 0;
+
+    memset( &info, 0, sizeof( info ));
+
+    short *pcm = bench_decode_all( dec, in, &len, &info );
+
+    if (!pcm || !info.channels)
+    {
+        fprintf( stderr, "Cannot start decoding '%s'\n", file );
+        free( pcm );
+        return;
+    }
+
+    AACDPost *post = aacd_post_create( info.channels, info.samplerate, outRate );
+
+    if (!post)
+    {
+        fprintf( stderr, "Cannot resample '%s': %d ch, %lu -> %lu Hz\n", file, info.channels, info.samplerate, outRate );
+        free( pcm );
+        return;
+    }
+
+    // the stream is processed in chunks like the decoding rounds:
+    unsigned long chunk = 2048 * info.channels;
+    unsigned long cap = aacd_post_max_out( post, len ) + aacd_post_max_out( post, chunk );
+    short *out = (short*) malloc( sizeof( short ) * cap );
+    int oc = aacd_post_channels( post );
+    unsigned long n = 0;
+    unsigned long long ns = 0;
+    unsigned long i;
+    int r;
+
+    for (r=0; r < repeat; r++)
+    {
+        aacd_post_reset( post );
+        n = 0;
+
+        unsigned long long t0 = bench_now();
+
+        for (i=0; i < len; i += chunk) n += aacd_post_process( post, pcm + i, i + chunk < len ? chunk : len - i, out + n );
+
+        ns += bench_now() - t0;
+    }
+
+    unsigned long checksum = 0;
+
+    for (i=0; i < n; i++) checksum = checksum * 31 + (unsigned short) out[i];
+
+    // the baseline resamples the downmixed samples (the platform cannot downmix):
+    AACDPost *down = aacd_post_create( info.channels, info.samplerate, 0 );
+    short *mixed = (short*) malloc( sizeof( short ) * aacd_post_max_out( down, len ));
+    unsigned long mixedLen = aacd_post_process( down, pcm, len, mixed );
+    unsigned long long linearNs = 0;
+    unsigned long linearLen = 0;
+
+    aacd_post_destroy( down );
+
+    for (r=0; r < repeat; r++)
+    {
+        BenchLinear lin;
+        bench_linear_init( &lin, oc, info.samplerate, outRate );
+        linearLen = 0;
+
+        unsigned long long t0 = bench_now();
+        unsigned long mchunk = 2048 * oc;
+
+        for (i=0; i < mixedLen; i += mchunk)
+        {
+            unsigned long m = i + mchunk < mixedLen ? mchunk : mixedLen - i;
+            linearLen += bench_linear_process( &lin, mixed + i, m / oc, out + linearLen );
+        }
+
+        linearNs += bench_now() - t0;
+    }
+
+    double audioSecs = (double) len / info.channels / info.samplerate;
+
+    ns /= repeat;
+    linearNs /= repeat;
+    if (!ns) ns = 1;
+    if (!linearNs) linearNs = 1;
+
+    printf( "%s [%s]: resample %d ch %lu Hz -> %d ch %lu Hz, taps=%d\n",
+            file, decoder, info.channels, info.samplerate, oc, outRate, AACD_POST_TAPS );
+    printf( "  polyphase: samples=%lu, time=%.3f ms, realtime factor=%.1fx\n", n, ns / 1e6, audioSecs * 1e9 / ns );
+    printf( "  linear: samples=%lu, time=%.3f ms, realtime factor=%.1fx\n", linearLen, linearNs / 1e6, audioSecs * 1e9 / linearNs );
+
+    bench_resample_tone( 1000, info.samplerate, outRate );
+    bench_resample_tone( 0.4 * (info.samplerate < outRate ? info.samplerate : outRate), info.samplerate, outRate );
+
+    printf( "  PCM checksum=%08lx\n", checksum & 0xffffffffUL );
+
+    aacd_post_destroy( post );
+    free( mixed );
+    free( out );
+    free( pcm );
+}
+
+
+static void bench_report( const char *file, const char *decoder, BenchResult *res )
+{
+    if (!res->frames || !res->ns)
+    {
+        printf( "%s: no frames decoded\n", file );
+        return;
+    }
+
+    qsort( res->latencies, res->frames, sizeof( unsigned long long ), bench_cmp );
+
+    double secs = res->ns / 1e9;
+    double audioSecs = (double) res->duration / res->samplerate;
+
+    printf( "%s [%s, %d-bit]: %lu Hz, %d ch\n", file, decoder, (int) sizeof( void* ) * 8, res->samplerate, res->channels );
+    printf( "  frames=%lu, audio=%.2f s, decoding=%.3f s\n", res->frames, audioSecs, secs );
+    printf( "  frames/sec=%.1f, realtime factor=%.1fx\n", res->frames / secs, audioSecs / secs );
+    printf( "  frame latency (us): p50=%.1f, p90=%.1f, p99=%.1f, max=%.1f\n",
+            res->latencies[ res->frames * 50 / 100 ] / 1e3,
+            res->latencies[ res->frames * 90 / 100 ] / 1e3,
+            res->latencies[ res->frames * 99 / 100 ] / 1e3,
+            res->latencies[ res->frames - 1 ] / 1e3 );
+    printf( "  first start (us): init=%lu, read=%lu, sync=%lu, decode=%lu\n",
+            res->firstStart.init, res->firstStart.read, res->firstStart.sync, res->firstStart.decode );
+
+    if (res->starts > 1)
+    {
+        unsigned long n = res->starts - 1;
+
+        printf( "  next starts (us): init=%lu, read=%lu, sync=%lu, decode=%lu\n",
+                res->nextStarts.init / n, res->nextStarts.read / n, res->nextStarts.sync / n, res->nextStarts.decode / n );
+    }
+
+    if (res->quality) printf( "  quality=%d (requested %d)\n", res->qualityUsed, res->quality );
+
+    if (res->format != AACD_PCM_16) printf( "  output format=%s\n", res->format == AACD_PCM_32 ? "32-bit" : "float" );
+
+    printf( "  PCM checksum=%08lx\n", res->checksum & 0xffffffffUL );
+}
+
+
+static void usage( const char *prog )
+{
+    fprintf( stderr, "Usage: %s [-d decoder] [-c chunk] [-n repeat] [-z] [-r | -m] [-s] [-S seeks] [-e workers] [-p threads [-P preroll] [-T tolerance]] [-f format] [-q quality] [-R rate] file...\n", prog );
+    fprintf( stderr, "  -d decoder  the decoder name: OpenCORE, OpenCORE-MP3, OpenCORE-FLV or OpenCORE-MP4\n" );
+    fprintf( stderr, "              (default: by the file suffix)\n" );
+    fprintf( stderr, "  -c chunk    the input chunk size in bytes (default: 8192)\n" );
+    fprintf( stderr, "  -n repeat   how many times each file is decoded (default: 1)\n" );
+    fprintf( stderr, "  -z          zero-copy input - chunks are decoded in place\n" );
+    fprintf( stderr, "  -r          file input - read() and copied (like BufferReader)\n" );
+    fprintf( stderr, "  -m          file input - memory mapped and decoded in place\n" );
+    fprintf( stderr, "  -s          scan mode - measures the sync scanner only\n" );
+    fprintf( stderr, "  -S seeks    seek mode - measures the latency of the seeks\n" );
+    fprintf( stderr, "  -e workers  engine mode - decodes 'repeat' streams at once by the workers\n" );
+    fprintf( stderr, "  -p threads  parallel mode - decodes each file split by 1..threads threads\n" );
+    fprintf( stderr, "  -P preroll  the frames decoded before each segment (default: %d)\n", AACD_PARALLEL_PREROLL );
+    fprintf( stderr, "  -T tolerance the maximal difference of a sample from the serial decoding (default: 0 = exact);\n" );
+    fprintf( stderr, "              the exit code is 1 if exceeded or if the number of samples differs\n" );
+    fprintf( stderr, "  -f format   the output format: 16, 32 or float (default: 16);\n" );
+    fprintf( stderr, "              the checksum is computed from the 16-bit samples restored\n" );
+    fprintf( stderr, "  -q quality  the quality level switched after the first frame: 0=full, 1=no PS,\n" );
+    fprintf( stderr, "              2=no SBR (core AAC), 3=no SBR + mono (default: 0)\n" );
+    fprintf( stderr, "  -R rate     resample mode - downmixes and resamples the decoded PCM to the rate\n" );
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *decoderName = NULL;
+    unsigned long chunk = 8192;
+    int repeat = 1;
+    int direct = 0;
+    int scan = 0;
+    int seeks = 0;
+    int workers = 0;
+    int threads = 0;
+    int preroll = AACD_PARALLEL_PREROLL;
+    int tolerance = 0;
+    int format = AACD_PCM_16;
+    unsigned long resampleRate = 0;
+    int quality = AACD_QUALITY_FULL;
+    char input = 0;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt( argc, argv, "d:c:n:zrmsS:e:p:P:T:f:q:R:h" )) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': decoderName = optarg; break;
+            case 'c': chunk = strtoul( optarg, NULL, 10 ); break;
+            case 'n': repeat = atoi( optarg ); break;
+            case 'z': direct = 1; break;
+            case 'r': input = 'r'; break;
+            case 'm': input = 'm'; break;
+            case 's': scan = 1; break;
+            case 'S': seeks = atoi( optarg ); break;
+            case 'e': workers = atoi( optarg ); break;
+            case 'p': threads = atoi( optarg ); break;
+            case 'P': preroll = atoi( optarg ); break;
+            case 'T': tolerance = atoi( optarg ); break;
+            case 'f': format = !strcmp( optarg, "float" ) ? AACD_PCM_FLOAT : !strcmp( optarg, "32" ) ? AACD_PCM_32 : !strcmp( optarg, "16" ) ? AACD_PCM_16 : -1; break;
+            case 'q': quality = atoi( optarg ); break;
+            case 'R': resampleRate = strtoul( optarg, NULL, 10 ); break;
+            default: usage( argv[0] ); return 1;
+        }
+    }
+
+    if (optind >= argc || !chunk || repeat < 1 || tolerance < 0 || format < 0 || quality < AACD_QUALITY_FULL || quality > AACD_QUALITY_MONO)
+    {
+        usage( argv[0] );
+        return 1;
+    }
+
+    for (; optind < argc; optind++)
+    {
+        const char *file = argv[ optind ];
+        const char *name = decoderName;
+
+        if (!name)
+        {
+            const char *ext = strrchr( file, '.' );
+            name = ext && !strcasecmp( ext, ".mp3" ) ? "OpenCORE-MP3"
+                    : ext && !strcasecmp( ext, ".flv" ) ? "OpenCORE-FLV"
+                    : ext && (!strcasecmp( ext, ".m4a" ) || !strcasecmp( ext, ".mp4" ) || !strcasecmp( ext, ".m4b" )) ? "OpenCORE-MP4"
+                    : "OpenCORE";
+        }
+
+        AACDDecoder *decoder = aacd_decoder_get_by_name( name );
+
+        if (!decoder)
+        {
+            fprintf( stderr, "Unknown decoder '%s'\n", name );
+            return 1;
+        }
+
+        BenchInput in;
+        memset( &in, 0, sizeof( in ));
+        in.chunk = chunk;
+        in.direct = direct;
+        in.data = bench_load( file, &in.size );
+
+        if (!in.data)
+        {
+            fprintf( stderr, "Cannot read file '%s'\n", file );
+            ret = 1;
+            continue;
+        }
+
+        if (scan)
+        {
+            bench_scan( file, name, &in, repeat );
+            free( in.data );
+            continue;
+        }
+
+        if (seeks > 0)
+        {
+            bench_seek( file, name, &in, seeks );
+            free( in.data );
+            continue;
+        }
+
+        if (threads > 0)
+        {
+            if (bench_parallel( file, name, &in, threads, preroll, repeat, tolerance )) ret = 1;
+            free( in.data );
+            continue;
+        }
+
+        if (resampleRate > 0)
+        {
+            bench_resample( file, name, &in, resampleRate, repeat );
+            free( in.data );
+            continue;
+        }
+
+        if (workers > 0)
+        {
+            bench_engine( file, name, &in, repeat, workers );
+            free( in.data );
+            continue;
+        }
+
+        BenchResult res;
+        memset( &res, 0, sizeof( res ));
+        res.format = format;
+        res.quality = quality;
+
+        int i;
+        for (i=0; i < repeat; i++)
+        {
+            in.pos = 0;
+
+            int err;
+
+            if (input == 'r') err = bench_decode( decoder, &bench_file_reader, fopen( file, "rb" ), &res );
+            else if (input == 'm') err = bench_decode( decoder, &aacd_mmap_reader, aacd_mmap_open( file ), &res );
+            else err = bench_decode( decoder, &bench_reader, &in, &res );
+
+            if (err)
+            {
+                fprintf( stderr, "Cannot start decoding '%s'\n", file );
+                ret = 1;
+                break;
+            }
+        }
+
+        bench_report( file, name, &res );
+
+        free( res.latencies );
+        free( in.data );
+    }
+
+    aacd_pool_clear();
+
+    return ret;
+}
+
@@ -0,0 +1,708 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Test of the native HTTP / ICY reader.
+ * A recorded ADTS AAC / MP3 stream is replayed by a built-in server on the loopback
+ * interface in several profiles and decoded through the native HTTP reader:
+ *
+ *   plain      HTTP/1.1 with Content-Length
+ *   icy        the chunked transfer with the ICY metadata - the metadata interval and
+ *              the chunk sizes are odd, so the metadata blocks cross the chunk boundaries
+ *   redirect   a chain of redirects (an absolute and a relative Location) to the plain body
+ *   drop       the connection is closed in the middle of the body twice - the reader
+ *              must resume it by Range requests
+ *
+ * The server sends the bytes in small pieces of varying sizes with pauses in between,
+ * so the reader gets short reads splitting the chunk headers and the metadata blocks.
+ * The PCM checksum of each profile must be the same as of the local file decoding -
+ * any mismatch makes the exit code 1:
+ *
+ *   aacd-httptest stream.aac stream.mp3
+ *   aacd-httptest -t icy,drop stream.aac
+ */
+
+#define AACD_MODULE "HttpTest"
+
+#include "aac-common.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/**
+ * The ICY metadata interval - not aligned with the chunks nor the frames.
+ */
+#define HTTPTEST_METAINT        997
+
+/**
+ * The number of connections dropped in the "drop" profile - the native reader
+ * re-establishes at most AACD_HTTP_RECONNECTS of them.
+ */
+#define HTTPTEST_DROPS          2
+
+/**
+ * The pause between the pieces sent - so the reader gets them by separate reads.
+ */
+#define HTTPTEST_PAUSE_US       200
+
+/**
+ * The max time of one poll in ms - the stop flag is checked in between.
+ */
+#define HTTPTEST_SLICE_MS       20
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+typedef struct HttpTestServer {
+    int fd;
+    int port;
+    pthread_t thread;
+    int stopped;
+
+    const unsigned char *data;
+    unsigned long len;
+    const char *contentType;
+
+    // the statistics of the current profile - reset before each:
+    int connections;
+    int redirects;
+    int ranges;
+    int drops;
+    char title[ 64 ];           // the last title sent
+} HttpTestServer;
+
+
+/**
+ * The local file - the reference decoding.
+ */
+typedef struct HttpTestMemory {
+    const unsigned char *data;
+    unsigned long len;
+    unsigned long pos;
+} HttpTestMemory;
+
+
+typedef struct HttpTestResult {
+    unsigned long samples;
+    unsigned long checksum;
+} HttpTestResult;
+
+
+/**
+ * The sizes of the pieces sent - they cycle through the body.
+ */
+static const unsigned long httptest_pieces[] = { 1, 2, 7, 61, 509, 1021, 4093, 3, 16411 };
+
+/**
+ * The sizes of the chunks of the "icy" profile.
+ */
+static const unsigned long httptest_chunks[] = { 1000, 17, 4096, 333, 1, 2500, 65536 };
+
+static const char *httptest_profiles[] = { "plain", "icy", "redirect", "drop", NULL };
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Server
+ ****************************************************************************************************/
+
+/**
+ * Sends the bytes in the pieces of httptest_pieces[].
+ * @return 0=OK, -1 if the connection failed
+ */
+static int httptest_send( int fd, const unsigned char *buf, unsigned long len )
+{
+    int i = 0;
+
+    while (len)
+    {
+        unsigned long n = httptest_pieces[ i++ % (sizeof( httptest_pieces ) / sizeof( httptest_pieces[0] )) ];
+
+        if (n > len) n = len;
+
+        if (send( fd, buf, n, MSG_NOSIGNAL ) != (ssize_t) n) return -1;
+
+        buf += n;
+        len -= n;
+
+        usleep( HTTPTEST_PAUSE_US );
+    }
+
+    return 0;
+}
+
+
+static int httptest_send_str( int fd, const char *s )
+{
+    return httptest_send( fd, (const unsigned char*) s, strlen( s ));
+}
+
+
+/**
+ * Reads the request head - returns its length or -1.
+ */
+static int httptest_request( HttpTestServer *srv, int fd, char *buf, int len )
+{
+    int n = 0;
+
+    while (n < len - 1)
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+
+        if (__atomic_load_n( &srv->stopped, __ATOMIC_ACQUIRE )) return -1;
+        if (poll( &pfd, 1, HTTPTEST_SLICE_MS ) != 1) continue;
+
+        int r = recv( fd, buf + n, len - 1 - n, 0 );
+
+        if (r <= 0) return -1;
+
+        n += r;
+        buf[n] = 0;
+
+        if (strstr( buf, "\r\n\r\n" )) break;
+    }
+
+    int i;
+
+    // the header names are matched in lower case:
+    for (i=0; i < n; i++) buf[i] = tolower( (unsigned char) buf[i] );
+
+    return n;
+}
+
+
+/**
+ * Builds the body of the "icy" profile - the audio interleaved with the metadata blocks
+ * and framed by the chunked transfer encoding.
+ * @return the body (to be freed)
+ */
+static unsigned char* httptest_icy_body( HttpTestServer *srv, unsigned long *len )
+{
+    unsigned long maxIcy = srv->len + (srv->len / HTTPTEST_METAINT + 1) * (1 + 64);
+    unsigned char *icy = (unsigned char*) malloc( maxIcy );
+    unsigned long icyLen = 0;
+    unsigned long pos = 0;
+    unsigned long blocks = 0;
+
+    while (pos < srv->len)
+    {
+        unsigned long n = srv->len - pos < HTTPTEST_METAINT ? srv->len - pos : HTTPTEST_METAINT;
+
+        memcpy( icy + icyLen, srv->data + pos, n );
+        icyLen += n;
+        pos += n;
+
+        if (n < HTTPTEST_METAINT) break;
+
+        // every other block is empty - the title changes in the others:
+        unsigned char *meta = icy + icyLen;
+
+        memset( meta, 0, 1 + 64 );
+
+        if (blocks++ & 1) icyLen++;
+        else
+        {
+            int tlen = snprintf( srv->title, sizeof( srv->title ), "StreamTitle='httptest %lu';", blocks );
+
+            memcpy( meta + 1, srv->title, tlen );
+            meta[0] = (unsigned char) ((tlen + 15) / 16);
+            icyLen += 1 + meta[0] * 16;
+        }
+    }
+
+    // the chunk header and CRLF take at most 32 bytes - the smallest chunk has 1 byte:
+    unsigned char *body = (unsigned char*) malloc( icyLen * 33 + 16 );
+    unsigned long bodyLen = 0;
+    int i = 0;
+
+    pos = 0;
+
+    while (pos < icyLen)
+    {
+        unsigned long n = httptest_chunks[ i++ % (sizeof( httptest_chunks ) / sizeof( httptest_chunks[0] )) ];
+
+        if (n > icyLen - pos) n = icyLen - pos;
+
+        // some of the chunks have an extension:
+        bodyLen += sprintf( (char*) body + bodyLen, i % 3 ? "%lx\r\n" : "%lX;ext=%d\r\n", n, i );
+
+        memcpy( body + bodyLen, icy + pos, n );
+        bodyLen += n;
+        pos += n;
+
+        body[ bodyLen++ ] = '\r';
+        body[ bodyLen++ ] = '\n';
+    }
+
+    bodyLen += sprintf( (char*) body + bodyLen, "0\r\n\r\n" );
+
+    free( icy );
+
+    *len = bodyLen;
+
+    return body;
+}
+
+
+static void httptest_connection( HttpTestServer *srv, int fd )
+{
+    char req[ 4096 ];
+    char head[ 512 ];
+
+    if (httptest_request( srv, fd, req, sizeof( req )) < 0) return;
+
+    const char *range = strstr( req, "\r\nrange: bytes=" );
+    unsigned long offset = range ? strtoul( range + 15, NULL, 10 ) : 0;
+    int metadata = strstr( req, "\r\nicy-metadata: 1" ) != NULL;
+
+    if (range) srv->ranges++;
+
+    // "get /path http/1.1":
+    char *path = strchr( req, ' ' );
+
+    if (!path) return;
+
+    path++;
+    path[ strcspn( path, " \r\n" ) ] = 0;
+
+    if (!strcmp( path, "/redirect" ) || !strcmp( path, "/redirect/1" ))
+    {
+        srv->redirects++;
+
+        // the first is absolute, the second relative:
+        if (!strcmp( path, "/redirect" )) snprintf( head, sizeof( head ), "http://127.0.0.1:%d/redirect/1", srv->port );
+        else strcpy( head, "/plain" );
+
+        char buf[ 1024 ];
+
+        snprintf( buf, sizeof( buf ),
+                    "HTTP/1.1 %s\r\n"
+                    "Location: %s\r\n"
+                    "Content-Length: 0\r\n"
+                    "Connection: close\r\n"
+                    "\r\n",
+                    strcmp( path, "/redirect" ) ? "301 Moved Permanently" : "302 Found", head );
+
+        httptest_send_str( fd, buf );
+        return;
+    }
+
+    if (!strcmp( path, "/icy" ))
+    {
+        unsigned long len;
+        unsigned char *body = httptest_icy_body( srv, &len );
+
+        snprintf( head, sizeof( head ),
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: %s\r\n"
+                    "Transfer-Encoding: chunked\r\n"
+                    "icy-name: aacd-httptest\r\n"
+                    "icy-metaint: %d\r\n"
+                    "Connection: close\r\n"
+                    "\r\n",
+                    srv->contentType, metadata ? HTTPTEST_METAINT : 0 );
+
+        if (!httptest_send_str( fd, head )) httptest_send( fd, body, len );
+
+        free( body );
+        return;
+    }
+
+    if (strcmp( path, "/plain" ) && strcmp( path, "/drop" ))
+    {
+        httptest_send_str( fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n" );
+        return;
+    }
+
+    if (offset > srv->len) offset = srv->len;
+
+    snprintf( head, sizeof( head ),
+                "HTTP/1.1 %s\r\n"
+                "Content-Type: %s\r\n"
+                "Content-Length: %lu\r\n"
+                "Accept-Ranges: bytes\r\n"
+                "Connection: close\r\n"
+                "\r\n",
+                offset ? "206 Partial Content" : "200 OK",
+                srv->contentType, srv->len - offset );
+
+    unsigned long end = srv->len;
+
+    // the drops are in the middle of the frames - at 1/3 and 2/3 of the body:
+    if (!strcmp( path, "/drop" ) && srv->drops < HTTPTEST_DROPS)
+    {
+        end = srv->len * (srv->drops + 1) / (HTTPTEST_DROPS + 1) + 7;
+
+        if (end > offset) srv->drops++;
+        else end = srv->len;
+    }
+
+    if (!httptest_send_str( fd, head )) httptest_send( fd, srv->data + offset, end - offset );
+}
+
+
+static void* httptest_server_run( void *arg )
+{
+    HttpTestServer *srv = (HttpTestServer*) arg;
+
+    while (!__atomic_load_n( &srv->stopped, __ATOMIC_ACQUIRE ))
+    {
+        struct pollfd pfd = { srv->fd, POLLIN, 0 };
+
+        if (poll( &pfd, 1, HTTPTEST_SLICE_MS ) != 1) continue;
+
+        int fd = accept( srv->fd, NULL, NULL );
+
+        if (fd < 0) continue;
+
+        int one = 1;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ));
+
+        srv->connections++;
+
+        // one connection at a time - the reader never opens two:
+        httptest_connection( srv, fd );
+
+        close( fd );
+    }
+
+    return NULL;
+}
+
+
+static int httptest_server_start( HttpTestServer *srv )
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof( addr );
+
+    memset( &addr, 0, sizeof( addr ));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    srv->fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    if (srv->fd < 0
+        || bind( srv->fd, (struct sockaddr*) &addr, sizeof( addr ))
+        || listen( srv->fd, 4 )
+        || getsockname( srv->fd, (struct sockaddr*) &addr, &alen ))
+    {
+        if (srv->fd >= 0) close( srv->fd );
+        return -1;
+    }
+
+    srv->port = ntohs( addr.sin_port );
+
+    if (pthread_create( &srv->thread, NULL, httptest_server_run, srv ))
+    {
+        close( srv->fd );
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void httptest_server_stop( HttpTestServer *srv )
+{
+    __atomic_store_n( &srv->stopped, 1, __ATOMIC_RELEASE );
+
+    pthread_join( srv->thread, NULL );
+    close( srv->fd );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Memory reader
+ ****************************************************************************************************/
+
+static const char* httptest_memory_name()
+{
+    return "Memory";
+}
+
+
+static long httptest_memory_read( AACDInfo *info )
+{
+    HttpTestMemory *m = (HttpTestMemory*) info->reader_ext;
+    unsigned long n = m->len - m->pos < 8192 ? m->len - m->pos : 8192;
+
+    if (n) memcpy( aacd_prepare_buffer( info, n ), m->data + m->pos, n );
+
+    m->pos += n;
+
+    return (long) n;
+}
+
+
+static void httptest_memory_destroy( AACDInfo *info )
+{
+    info->reader_ext = NULL;
+}
+
+
+static AACDReader httptest_memory_reader = {
+    httptest_memory_name,
+    httptest_memory_read,
+    httptest_memory_destroy
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+static unsigned char* httptest_load( const char *file, unsigned long *len )
+{
+    FILE *f = fopen( file, "rb" );
+
+    if (!f) return NULL;
+
+    fseek( f, 0, SEEK_END );
+    long size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+
+    unsigned char *data = size > 0 ? (unsigned char*) malloc( size ) : NULL;
+
+    if (data && fread( data, 1, size, f ) != (size_t) size)
+    {
+        free( data );
+        data = NULL;
+    }
+
+    fclose( f );
+
+    *len = (unsigned long) size;
+
+    return data;
+}
+
+
+/**
+ * Decodes the whole stream and computes the checksum of the PCM samples.
+ * @param http the HTTP stream - its last metadata are stored to title (or NULL)
+ * @return 0=OK, -1 if the decoding cannot start
+ */
+static int httptest_decode( AACDDecoder *decoder, AACDReader *reader, void *reader_ext, AACDHttp *http,
+                            HttpTestResult *res, char *title, int titleLen )
+{
+    memset( res, 0, sizeof( HttpTestResult ));
+
+    AACDInfo *info = aacd_start( decoder, reader, reader_ext );
+
+    if (!info) return -1;
+
+    int outLen = 2048 * (info->channels > 2 ? info->channels : 2);
+    short *samples = (short*) malloc( sizeof( short ) * outLen );
+
+    for (;;)
+    {
+        aacd_decode( info, samples, outLen );
+
+        if (!info->round_frames) break;
+
+        unsigned long i;
+
+        for (i=0; i < info->round_samples; i++) res->checksum = res->checksum * 31 + (unsigned short) samples[i];
+
+        res->samples += info->round_samples;
+    }
+
+    // the stream is closed by aacd_stop():
+    if (http && aacd_http_metadata( http, title, titleLen ) < 0) *title = 0;
+
+    aacd_stop( info );
+    free( samples );
+
+    return 0;
+}
+
+
+/**
+ * Plays the file by the profile and compares the result to the local decoding.
+ * @return 0=OK, 1 on mismatch
+ */
+static int httptest_profile( HttpTestServer *srv, AACDDecoder *decoder, const char *profile, HttpTestResult *ref )
+{
+    char url[ 64 ];
+    char title[ 64 ] = "";
+    HttpTestResult res;
+
+    srv->connections = 0;
+    srv->redirects = 0;
+    srv->ranges = 0;
+    srv->drops = 0;
+    srv->title[0] = 0;
+
+    snprintf( url, sizeof( url ), "http://127.0.0.1:%d/%s", srv->port, profile );
+
+    int icy = !strcmp( profile, "icy" );
+    AACDHttp *http = aacd_http_open( url, icy );
+
+    // the stream is closed by the decoder even if it cannot start:
+    if (!http || httptest_decode( decoder, &aacd_http_reader, http, http, &res, title, sizeof( title )))
+    {
+        printf( "  %-8s FAILED - cannot start decoding '%s'\n", profile, url );
+        return 1;
+    }
+
+    const char *error = NULL;
+
+    if (res.samples != ref->samples) error = "the number of samples differs";
+    else if (res.checksum != ref->checksum) error = "the checksum differs";
+    else if (icy && strcmp( title, srv->title )) error = "the last title differs";
+    else if (!strcmp( profile, "redirect" ) && srv->redirects != 2) error = "the redirects not followed";
+    else if (!strcmp( profile, "drop" ) && (srv->drops != HTTPTEST_DROPS || srv->ranges != HTTPTEST_DROPS)) error = "not resumed by ranges";
+
+    printf( "  %-8s samples=%lu, PCM checksum=%08lx, connections=%d", profile, res.samples, res.checksum & 0xffffffffUL, srv->connections );
+
+    if (icy) printf( ", title=\"%s\"", title );
+    if (srv->redirects) printf( ", redirects=%d", srv->redirects );
+    if (srv->ranges) printf( ", ranges=%d", srv->ranges );
+
+    printf( " - %s%s\n", error ? "FAILED - " : "OK", error ? error : "" );
+
+    return error ? 1 : 0;
+}
+
+
+static int httptest_file( const char *file, const char *decoderName, const char *profiles )
+{
+    const char *ext = strrchr( file, '.' );
+    int isMp3 = ext && !strcasecmp( ext, ".mp3" );
+
+    if (!decoderName) decoderName = isMp3 ? "OpenCORE-MP3" : "OpenCORE";
+
+    AACDDecoder *decoder = aacd_decoder_get_by_name( decoderName );
+
+    if (!decoder)
+    {
+        fprintf( stderr, "Unknown decoder '%s'\n", decoderName );
+        return 1;
+    }
+
+    HttpTestServer srv;
+    HttpTestMemory mem;
+    HttpTestResult ref;
+
+    memset( &srv, 0, sizeof( srv ));
+    memset( &mem, 0, sizeof( mem ));
+
+    srv.data = mem.data = httptest_load( file, &srv.len );
+    srv.contentType = isMp3 ? "audio/mpeg" : "audio/aacp";
+    mem.len = srv.len;
+
+    if (!srv.data)
+    {
+        fprintf( stderr, "Cannot read file '%s'\n", file );
+        return 1;
+    }
+
+    if (httptest_decode( decoder, &httptest_memory_reader, &mem, NULL, &ref, NULL, 0 ))
+    {
+        fprintf( stderr, "Cannot start decoding '%s'\n", file );
+        free( (void*) srv.data );
+        return 1;
+    }
+
+    if (httptest_server_start( &srv ))
+    {
+        fprintf( stderr, "Cannot start the server\n" );
+        free( (void*) srv.data );
+        return 1;
+    }
+
+    printf( "%s [%s]: local samples=%lu, PCM checksum=%08lx\n", file, decoderName, ref.samples, ref.checksum & 0xffffffffUL );
+
+    int failed = 0;
+    int i;
+
+    for (i=0; httptest_profiles[i]; i++)
+    {
+        const char *p = strstr( profiles, httptest_profiles[i] );
+        size_t len = strlen( httptest_profiles[i] );
+
+        // a whole item of the comma separated list:
+        if (!p || (p != profiles && p[-1] != ',') || (p[len] && p[len] != ',')) continue;
+
+        failed |= httptest_profile( &srv, decoder, httptest_profiles[i], &ref );
+    }
+
+    httptest_server_stop( &srv );
+    free( (void*) srv.data );
+
+    return failed;
+}
+
+
+static void usage( const char *prog )
+{
+    fprintf( stderr, "Usage: %s [-d decoder] [-t profiles] file...\n", prog );
+    fprintf( stderr, "  -d decoder  the decoder name: OpenCORE or OpenCORE-MP3 (default: by the file suffix)\n" );
+    fprintf( stderr, "  -t profiles the comma separated profiles (default: plain,icy,redirect,drop):\n" );
+    fprintf( stderr, "                plain    HTTP/1.1 with Content-Length\n" );
+    fprintf( stderr, "                icy      chunked transfer with the ICY metadata\n" );
+    fprintf( stderr, "                redirect redirects to the plain body\n" );
+    fprintf( stderr, "                drop     connections dropped - resumed by Range requests\n" );
+    fprintf( stderr, "The exit code is 1 if any PCM checksum differs from the local file decoding.\n" );
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *decoderName = NULL;
+    const char *profiles = "plain,icy,redirect,drop";
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt( argc, argv, "d:t:h" )) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': decoderName = optarg; break;
+            case 't': profiles = optarg; break;
+            default: usage( argv[0] ); return 1;
+        }
+    }
+
+    if (optind == argc)
+    {
+        usage( argv[0] );
+        return 1;
+    }
+
+    for (; optind < argc; optind++)
+    {
+        if (httptest_file( argv[ optind ], decoderName, profiles )) ret = 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,1056 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Deterministic network-impairment harness of the streaming pipeline.
+ *
+ * A recorded AAC / MP3 stream is served by a built-in HTTP / ICY server on the loopback
+ * interface under a scripted bandwidth profile - with the connection latency and the stalls.
+ * It is played by the same code path as Decoder.startOutput() with a NativeHttpStream on Android:
+ * the native HTTP reader, the decoder and the PCM ring drained by a fake AudioTrack sink.
+ * The harness reports the time to the first audio, the underruns (count and the duration
+ * of the silence) and the occupancy of the input and PCM buffers over time:
+ *
+ *   aacd-netsim -p 3g stream.aac
+ *   aacd-netsim -p "256:10,0:4,64:10,256" -l 300 -x 10 -q stream.mp3
+ *
+ * The profile is a list of steps "kbit/s[:seconds]" - 0 kbit/s is a stall and the last step
+ * lasts forever. The server paces the bytes (including the ICY metadata) by the profile
+ * in chunks (-c) - larger chunks model bursty links. The profile timeline is global,
+ * so the reconnections of the reader do not restart it.
+ *
+ * The clock can be simulated (-x N): the profile, the latency and the sink run N times faster,
+ * all the reported times are in the simulated seconds. The reader's receive timeout
+ * is not scaled - long stalls should be tested in real time (-x 1).
+ *
+ * The live ICY stream cannot be sent ahead of its source: the server has the recording
+ * "produced" at its own bitrate (-r, by default computed from the frame headers)
+ * and sends the burst (-B) of the most recent data to each new connection - like Icecast.
+ * The audio produced during a reconnection is lost. The plain HTTP file (-P) is sent
+ * as fast as the profile allows. The live stream ends when the whole recording was sent and played.
+ *
+ * The pacing does not depend on the scheduling (each chunk has its scripted time),
+ * so the runs are reproducible - only the thread wake-ups add a jitter of a few ms.
+ */
+
+#define AACD_MODULE "NetSim"
+
+#include "aac-output.h"
+#include "aac-metrics.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/**
+ * The max number of the profile steps.
+ */
+#define NETSIM_MAX_STEPS        64
+
+/**
+ * The period of the fake AudioTrack in ms (simulated).
+ */
+#define NETSIM_PERIOD_MS        10
+
+/**
+ * The default number of bytes sent at once.
+ */
+#define NETSIM_CHUNK            1400
+
+/**
+ * The default burst of the live stream sent to a new connection (the Icecast default).
+ */
+#define NETSIM_BURST            65536
+
+/**
+ * The ICY metadata interval (bytes) - a new title is sent every NETSIM_TITLE_EVERY blocks.
+ */
+#define NETSIM_METAINT          16000
+#define NETSIM_TITLE_EVERY      8
+
+/**
+ * The undecoded rest of the live stream considered as its end - less than one frame.
+ */
+#define NETSIM_TAIL             2048
+
+/**
+ * The max time of one real sleep in ms - the stop flags are checked in between.
+ */
+#define NETSIM_SLICE_MS         20
+
+
+/****************************************************************************************************
+ * STRUCTS
+ ****************************************************************************************************/
+
+typedef struct NetSimStep {
+    unsigned long kbps;         // 0 = stall
+    double secs;                // <= 0 = forever (the last step)
+} NetSimStep;
+
+
+typedef struct NetSimProfile {
+    NetSimStep steps[ NETSIM_MAX_STEPS ];
+    int count;
+} NetSimProfile;
+
+
+typedef struct NetSimServer {
+    int fd;
+    int port;
+    pthread_t thread;
+    int stopped;
+
+    const unsigned char *data;
+    unsigned long len;
+    const char *contentType;
+
+    NetSimProfile *profile;
+    long latencyMs;
+    unsigned long chunk;
+    int icy;                    // a live ICY stream - otherwise a plain HTTP file with ranges
+    double sourceBps;           // the live stream is produced by this rate (bytes/s)
+    unsigned long burst;        // the bytes sent to a new connection at once
+
+    // the live position - the next connection of the ICY stream continues here:
+    unsigned long pos;
+    int connections;
+} NetSimServer;
+
+
+/**
+ * The statistics of the fake AudioTrack - written by the sink thread.
+ */
+typedef struct NetSimTrack {
+    pthread_t thread;
+    int running;
+    int stopped;
+
+    short *samples;
+    unsigned long samplesLen;
+
+    unsigned long long firstAudioUs;    // simulated; 0 = no audio yet
+    unsigned long underruns;            // the episodes of silence
+    unsigned long long silence;         // the samples of silence
+    int starving;
+} NetSimTrack;
+
+
+static const struct {
+    const char *name;
+    const char *spec;
+} netsim_presets[] = {
+    { "wifi",   "4000" },
+    { "3g",     "384:20,128:10,384" },
+    { "edge",   "200:15,0:2,200:15,40:5,200" },
+    { "tunnel", "512:15,0:8,512" },
+    { "flaky",  "256:5,0:1,256:5,0:3,256:5,0:1,32:5,256" },
+    { "slow",   "64" },
+    { NULL,     NULL }
+};
+
+
+static double netsim_scale = 1;
+
+static struct timespec netsim_t0;
+
+static NetSimTrack netsim_track_stats;
+
+// audio bytes sent by the server and received by the reader:
+static unsigned long long netsim_sent;
+static unsigned long long netsim_received;
+
+// the live stream was sent completely - the next underrun is the end of the stream:
+static int netsim_sent_all;
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Clock
+ ****************************************************************************************************/
+
+static double netsim_real()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (ts.tv_sec - netsim_t0.tv_sec) + (ts.tv_nsec - netsim_t0.tv_nsec) / 1e9;
+}
+
+
+/**
+ * Returns the simulated time in seconds since the start.
+ */
+static double netsim_now()
+{
+    return netsim_real() * netsim_scale;
+}
+
+
+/**
+ * Sleeps until the simulated time - in slices, so the stop flag is noticed.
+ * @return 0 if the time was reached, -1 if stopped
+ */
+static int netsim_sleep_until( double t, int *stopped )
+{
+    for (;;)
+    {
+        if (stopped && __atomic_load_n( stopped, __ATOMIC_ACQUIRE )) return -1;
+
+        double left = (t - netsim_now()) / netsim_scale;
+
+        if (left <= 0) return 0;
+
+        if (stopped && left > NETSIM_SLICE_MS / 1000.0) left = NETSIM_SLICE_MS / 1000.0;
+
+        struct timespec ts;
+        ts.tv_sec = (time_t) left;
+        ts.tv_nsec = (long) ((left - ts.tv_sec) * 1e9);
+
+        nanosleep( &ts, NULL );
+    }
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Profile
+ ****************************************************************************************************/
+
+/**
+ * Parses the profile - a preset name or the steps "kbit/s[:seconds],...".
+ * @return 0=OK, -1 on syntax error
+ */
+static int netsim_profile_parse( NetSimProfile *profile, const char *spec )
+{
+    int i;
+
+    for (i=0; netsim_presets[i].name; i++)
+    {
+        if (!strcasecmp( spec, netsim_presets[i].name )) spec = netsim_presets[i].spec;
+    }
+
+    profile->count = 0;
+
+    const char *p = spec;
+
+    while (*p)
+    {
+        if (profile->count == NETSIM_MAX_STEPS) return -1;
+
+        NetSimStep *step = &profile->steps[ profile->count++ ];
+        char *end;
+
+        step->kbps = strtoul( p, &end, 10 );
+        step->secs = 0;
+
+        if (end == p) return -1;
+
+        if (*end == ':')
+        {
+            p = end + 1;
+            step->secs = strtod( p, &end );
+
+            if (end == p || step->secs <= 0) return -1;
+        }
+
+        if (*end == ',') end++;
+        else if (*end) return -1;
+
+        p = end;
+    }
+
+    return profile->count ? 0 : -1;
+}
+
+
+/**
+ * Returns the rate (kbit/s) at the time and the end of its step (or -1 if the step lasts forever).
+ */
+static unsigned long netsim_profile_rate( NetSimProfile *profile, double t, double *until )
+{
+    double start = 0;
+    int i;
+
+    for (i=0; i < profile->count; i++)
+    {
+        NetSimStep *step = &profile->steps[i];
+
+        if (step->secs <= 0 || i + 1 == profile->count || t < start + step->secs)
+        {
+            *until = step->secs > 0 && i + 1 < profile->count ? start + step->secs : -1;
+
+            return step->kbps;
+        }
+
+        start += step->secs;
+    }
+
+    *until = -1;
+
+    return 0;
+}
+
+
+static void netsim_profile_print( NetSimProfile *profile )
+{
+    int i;
+
+    for (i=0; i < profile->count; i++)
+    {
+        NetSimStep *step = &profile->steps[i];
+
+        if (step->secs > 0 && i + 1 < profile->count) printf( "%s%lu:%g", i ? "," : "", step->kbps, step->secs );
+        else printf( "%s%lu", i ? "," : "", step->kbps );
+    }
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Server
+ ****************************************************************************************************/
+
+/**
+ * Sends the bytes paced by the profile - each chunk at its scripted time.
+ * @param cursor the simulated time when the next chunk may be sent
+ * @return 0=OK, -1 if the connection failed or the server stopped
+ */
+static int netsim_server_send( NetSimServer *srv, int fd, const unsigned char *buf, unsigned long len, double *cursor )
+{
+    while (len)
+    {
+        double now = netsim_now();
+        double t = *cursor > now ? *cursor : now;
+        double until;
+
+        unsigned long kbps = netsim_profile_rate( srv->profile, t, &until );
+
+        if (!kbps)
+        {
+            // a stall - nothing is sent until the step ends:
+            if (until < 0) return -1;
+
+            *cursor = until;
+            if (netsim_sleep_until( until, &srv->stopped )) return -1;
+            continue;
+        }
+
+        if (netsim_sleep_until( t, &srv->stopped )) return -1;
+
+        unsigned long n = len < srv->chunk ? len : srv->chunk;
+
+        if (send( fd, buf, n, MSG_NOSIGNAL ) != (ssize_t) n) return -1;
+
+        buf += n;
+        len -= n;
+
+        *cursor = t + n * 8.0 / (kbps * 1000.0);
+    }
+
+    return 0;
+}
+
+
+/**
+ * Reads the request head - returns its length or -1.
+ */
+static int netsim_server_request( NetSimServer *srv, int fd, char *buf, int len )
+{
+    int n = 0;
+
+    while (n < len - 1)
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+
+        if (__atomic_load_n( &srv->stopped, __ATOMIC_ACQUIRE )) return -1;
+        if (poll( &pfd, 1, NETSIM_SLICE_MS ) != 1) continue;
+
+        int r = recv( fd, buf + n, len - 1 - n, 0 );
+
+        if (r <= 0) return -1;
+
+        n += r;
+        buf[n] = 0;
+
+        if (strstr( buf, "\r\n\r\n" )) break;
+    }
+
+    int i;
+
+    // the header names are matched in lower case:
+    for (i=0; i < n; i++) buf[i] = tolower( (unsigned char) buf[i] );
+
+    return n;
+}
+
+
+static void netsim_server_connection( NetSimServer *srv, int fd )
+{
+    char req[ 4096 ];
+
+    if (netsim_server_request( srv, fd, req, sizeof( req )) < 0) return;
+
+    const char *range = strstr( req, "\r\nrange: bytes=" );
+    unsigned long offset = range ? strtoul( range + 15, NULL, 10 ) : 0;
+    int metadata = srv->icy && strstr( req, "\r\nicy-metadata: 1" );
+
+    double cursor = netsim_now() + srv->latencyMs / 1000.0;
+
+    if (netsim_sleep_until( cursor, &srv->stopped )) return;
+
+    char head[ 512 ];
+    int hlen;
+
+    if (srv->icy)
+    {
+        // the client gets the burst of the most recent data - the older are lost:
+        double live = srv->burst + netsim_now() * srv->sourceBps;
+
+        if (live > srv->len) live = srv->len;
+        if (srv->pos + srv->burst < live) srv->pos = (unsigned long) live - srv->burst;
+
+        offset = srv->pos;
+
+        hlen = snprintf( head, sizeof( head ),
+                    "ICY 200 OK\r\n"
+                    "icy-name: aacd-netsim\r\n"
+                    "content-type: %s\r\n"
+                    "icy-metaint: %d\r\n"
+                    "\r\n",
+                    srv->contentType, metadata ? NETSIM_METAINT : 0 );
+    }
+    else
+    {
+        if (offset > srv->len) offset = srv->len;
+
+        hlen = snprintf( head, sizeof( head ),
+                    "HTTP/1.1 %s\r\n"
+                    "Content-Type: %s\r\n"
+                    "Content-Length: %lu\r\n"
+                    "Accept-Ranges: bytes\r\n"
+                    "Connection: close\r\n"
+                    "\r\n",
+                    offset ? "206 Partial Content" : "200 OK",
+                    srv->contentType, srv->len - offset );
+    }
+
+    if (netsim_server_send( srv, fd, (unsigned char*) head, hlen, &cursor )) return;
+
+    unsigned long pos = offset;
+    unsigned long metaLeft = NETSIM_METAINT;
+    unsigned long blocks = 0;
+
+    while (pos < srv->len)
+    {
+        unsigned long n = srv->len - pos;
+
+        if (n > srv->chunk) n = srv->chunk;
+        if (metadata && n > metaLeft) n = metaLeft;
+
+        // the live data cannot be sent before they are produced:
+        if (srv->icy)
+        {
+            double produced = (pos + n - (double) srv->burst) / srv->sourceBps;
+
+            if (produced > cursor) cursor = produced;
+        }
+
+        if (netsim_server_send( srv, fd, srv->data + pos, n, &cursor )) break;
+
+        pos += n;
+        if (srv->icy) srv->pos = pos;
+
+        __atomic_fetch_add( &netsim_sent, (unsigned long long) n, __ATOMIC_RELAXED );
+
+        if (metadata && !(metaLeft -= n))
+        {
+            unsigned char meta[ 1 + 64 ];
+            int mlen = 1;
+
+            memset( meta, 0, sizeof( meta ));
+
+            if (!(blocks++ % NETSIM_TITLE_EVERY))
+            {
+                int tlen = snprintf( (char*) meta + 1, sizeof( meta ) - 1, "StreamTitle='netsim %lu';", blocks / NETSIM_TITLE_EVERY );
+
+                meta[0] = (unsigned char) ((tlen + 15) / 16);
+                mlen += meta[0] * 16;
+            }
+
+            if (netsim_server_send( srv, fd, meta, mlen, &cursor )) break;
+
+            metaLeft = NETSIM_METAINT;
+        }
+    }
+
+    // the live stream "goes silent" instead of closing (the reader would reconnect):
+    if (srv->icy && pos == srv->len)
+    {
+        __atomic_store_n( &netsim_sent_all, 1, __ATOMIC_RELEASE );
+
+        while (!__atomic_load_n( &srv->stopped, __ATOMIC_ACQUIRE )) netsim_sleep_until( netsim_now() + 1, &srv->stopped );
+    }
+}
+
+
+static void* netsim_server_run( void *arg )
+{
+    NetSimServer *srv = (NetSimServer*) arg;
+
+    while (!__atomic_load_n( &srv->stopped, __ATOMIC_ACQUIRE ))
+    {
+        struct pollfd pfd = { srv->fd, POLLIN, 0 };
+
+        if (poll( &pfd, 1, NETSIM_SLICE_MS ) != 1) continue;
+
+        int fd = accept( srv->fd, NULL, NULL );
+
+        if (fd < 0) continue;
+
+        srv->connections++;
+
+        // one connection at a time - a reconnecting client waits in the backlog:
+        netsim_server_connection( srv, fd );
+
+        close( fd );
+    }
+
+    return NULL;
+}
+
+
+static int netsim_server_start( NetSimServer *srv )
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof( addr );
+
+    memset( &addr, 0, sizeof( addr ));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    srv->fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    if (srv->fd < 0
+        || bind( srv->fd, (struct sockaddr*) &addr, sizeof( addr ))
+        || listen( srv->fd, 4 )
+        || getsockname( srv->fd, (struct sockaddr*) &addr, &alen )
+        || pthread_create( &srv->thread, NULL, netsim_server_run, srv ))
+    {
+        if (srv->fd >= 0) close( srv->fd );
+        return -1;
+    }
+
+    srv->port = ntohs( addr.sin_port );
+
+    return 0;
+}
+
+
+static void netsim_server_stop( NetSimServer *srv )
+{
+    __atomic_store_n( &srv->stopped, 1, __ATOMIC_RELEASE );
+
+    pthread_join( srv->thread, NULL );
+    close( srv->fd );
+}
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Reader
+ ****************************************************************************************************/
+
+/**
+ * Returns the bytes received and not consumed by the decoder yet.
+ */
+static unsigned long long netsim_input_buffered()
+{
+    static unsigned long long snap[ AACD_METRICS_SNAPSHOT ];
+
+    unsigned long long received = __atomic_load_n( &netsim_received, __ATOMIC_RELAXED );
+
+    if (aacd_metrics_snapshot( snap, AACD_METRICS_SNAPSHOT ) < 0) return 0;
+
+    unsigned long long consumed = snap[ AACD_METRIC_BYTES ] + snap[ AACD_METRIC_SKIPPED ];
+
+    return received > consumed ? received - consumed : 0;
+}
+
+
+/**
+ * The native HTTP reader counting the received audio bytes.
+ */
+static const char* netsim_reader_name()
+{
+    return "NetSim";
+}
+
+
+static long netsim_reader_read( AACDInfo *info )
+{
+    long n = aacd_http_reader.read( info );
+
+    if (n > 0) __atomic_fetch_add( &netsim_received, (unsigned long long) n, __ATOMIC_RELAXED );
+
+    return n;
+}
+
+
+static void netsim_reader_destroy( AACDInfo *info )
+{
+    aacd_http_reader.destroy( info );
+}
+
+
+static int netsim_reader_seek( AACDInfo *info, unsigned long offset )
+{
+    return aacd_http_reader.seek( info, offset );
+}
+
+
+static AACDReader netsim_reader = {
+    netsim_reader_name,
+    netsim_reader_read,
+    netsim_reader_destroy,
+    netsim_reader_seek
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS - Fake AudioTrack
+ ****************************************************************************************************/
+
+static const char* netsim_track_name()
+{
+    return "NetSimTrack";
+}
+
+
+static int netsim_track_open( AACDOutput *out )
+{
+    AACDInfo *info = out->info;
+    NetSimTrack *ts = &netsim_track_stats;
+
+    ts->samplesLen = info->samplerate * NETSIM_PERIOD_MS / 1000 * info->channels;
+    ts->samples = (short*) malloc( sizeof( short ) * ts->samplesLen );
+
+    out->sink_ext = ts;
+
+    return 0;
+}
+
+
+/**
+ * Plays one period per NETSIM_PERIOD_MS (simulated) - a short pull is silence.
+ */
+static void* netsim_track_run( void *arg )
+{
+    AACDOutput *out = (AACDOutput*) arg;
+    NetSimTrack *ts = (NetSimTrack*) out->sink_ext;
+
+    double next = netsim_now();
+
+    for (;;)
+    {
+        // the same condition as in aacd_output_pull() - the end of the stream is not an underrun:
+        int eof = __atomic_load_n( &out->eof, __ATOMIC_ACQUIRE );
+        unsigned long n = (unsigned long) aacd_output_pull( out, ts->samples, ts->samplesLen );
+
+        if (n && !ts->firstAudioUs)
+        {
+            __atomic_store_n( &ts->firstAudioUs, (unsigned long long) (netsim_now() * 1e6) + 1, __ATOMIC_RELAXED );
+        }
+
+        // the live stream ended - everything was received, decoded and played:
+        if (n < ts->samplesLen && !eof && __atomic_load_n( &netsim_sent_all, __ATOMIC_ACQUIRE )
+            && __atomic_load_n( &netsim_received, __ATOMIC_RELAXED ) == __atomic_load_n( &netsim_sent, __ATOMIC_RELAXED )
+            && netsim_input_buffered() < NETSIM_TAIL) break;
+
+        if (n < ts->samplesLen && !eof)
+        {
+            __atomic_fetch_add( &ts->silence, ts->samplesLen - n, __ATOMIC_RELAXED );
+
+            if (!ts->starving) __atomic_fetch_add( &ts->underruns, 1, __ATOMIC_RELAXED );
+            ts->starving = 1;
+        }
+        else ts->starving = 0;
+
+        if (aacd_output_drained( out )) break;
+
+        next += NETSIM_PERIOD_MS / 1000.0;
+
+        if (netsim_sleep_until( next, &ts->stopped )) break;
+    }
+
+    aacd_output_finish( out );
+
+    return NULL;
+}
+
+
+static int netsim_track_start( AACDOutput *out )
+{
+    NetSimTrack *ts = (NetSimTrack*) out->sink_ext;
+
+    if (pthread_create( &ts->thread, NULL, netsim_track_run, out )) return -1;
+
+    ts->running = 1;
+
+    return 0;
+}
+
+
+static void netsim_track_close( AACDOutput *out )
+{
+    NetSimTrack *ts = (NetSimTrack*) out->sink_ext;
+
+    if (!ts) return;
+
+    __atomic_store_n( &ts->stopped, 1, __ATOMIC_RELEASE );
+
+    if (ts->running) pthread_join( ts->thread, NULL );
+
+    free( ts->samples );
+    ts->samples = NULL;
+    ts->running = 0;
+
+    out->sink_ext = NULL;
+}
+
+
+static AACDSink netsim_track = {
+    netsim_track_name,
+    netsim_track_open,
+    netsim_track_start,
+    netsim_track_close
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+static unsigned char* netsim_load( const char *file, unsigned long *len )
+{
+    FILE *f = fopen( file, "rb" );
+
+    if (!f) return NULL;
+
+    fseek( f, 0, SEEK_END );
+    long size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+
+    unsigned char *data = size > 0 ? (unsigned char*) malloc( size ) : NULL;
+
+    if (data && fread( data, 1, size, f ) != (size_t) size)
+    {
+        free( data );
+        data = NULL;
+    }
+
+    fclose( f );
+
+    *len = (unsigned long) size;
+
+    return data;
+}
+
+
+/**
+ * Computes the bitrate (bytes/s) of the recording from its ADTS / MP3 frame headers.
+ * @return the bitrate or 0 if no frames found
+ */
+static double netsim_bitrate( const unsigned char *data, unsigned long len, int isMp3 )
+{
+    static const unsigned long adtsRates[] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+    };
+    static const unsigned long mp3Rates[] = { 44100, 48000, 32000 };
+
+    unsigned long pos = 0, bytes = 0;
+    double secs = 0;
+
+    while (pos + 8 <= len)
+    {
+        const unsigned char *p = data + pos;
+        int n = isMp3 ? aacd_mp3_header( p, len - pos ) : aacd_adts_header( p, len - pos );
+
+        if (n <= 0)
+        {
+            pos++;
+            continue;
+        }
+
+        if (isMp3)
+        {
+            int version = (p[1] >> 3) & 3;     // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+            int sri = (p[2] >> 2) & 3;
+
+            if (sri < 3) secs += (version == 3 ? 1152.0 : 576.0) / (mp3Rates[ sri ] >> (version == 3 ? 0 : version == 2 ? 1 : 2));
+        }
+        else
+        {
+            int sri = (p[2] >> 2) & 15;
+
+            if (sri < 13) secs += 1024.0 * ((p[6] & 3) + 1) / adtsRates[ sri ];
+        }
+
+        bytes += n;
+        pos += n;
+    }
+
+    return secs > 0 ? bytes / secs : 0;
+}
+
+
+static void usage( const char *prog )
+{
+    int i;
+
+    fprintf( stderr, "Usage: %s [-d decoder] [-p profile] [-l ms] [-c bytes] [-r kbit/s] [-B bytes] [-x N] [-b ms] [-i ms] [-t s] [-P] [-q] file\n", prog );
+    fprintf( stderr, "  -d decoder  the decoder name: OpenCORE or OpenCORE-MP3 (default: by the file suffix)\n" );
+    fprintf( stderr, "  -p profile  the bandwidth profile \"kbit/s[:seconds],...\" or a preset (default: wifi):\n" );
+
+    for (i=0; netsim_presets[i].name; i++) fprintf( stderr, "                %-7s %s\n", netsim_presets[i].name, netsim_presets[i].spec );
+
+    fprintf( stderr, "  -l ms       the latency of each connection - before the response (default: 0)\n" );
+    fprintf( stderr, "  -c bytes    the bytes sent at once - larger chunks make the link bursty (default: %d)\n", NETSIM_CHUNK );
+    fprintf( stderr, "  -r kbit/s   the bitrate of the live source (default: computed from the frames)\n" );
+    fprintf( stderr, "  -B bytes    the burst of the live stream sent to a new connection (default: %d)\n", NETSIM_BURST );
+    fprintf( stderr, "  -x N        the simulated clock runs N times faster than the real one (default: 1)\n" );
+    fprintf( stderr, "  -b ms       the capacity of the PCM ring in ms (default: 500)\n" );
+    fprintf( stderr, "  -i ms       the interval of the timeline (default: 1000)\n" );
+    fprintf( stderr, "  -t s        stops after the time (default: the end of the stream)\n" );
+    fprintf( stderr, "  -P          plain HTTP file with Range support (default: a live ICY stream with metadata)\n" );
+    fprintf( stderr, "  -q          prints the summary only\n" );
+    fprintf( stderr, "All the times are simulated (see -x).\n" );
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *decoderName = NULL;
+    const char *spec = "wifi";
+    NetSimProfile profile;
+    NetSimServer srv;
+    unsigned long bufferMs = 500;
+    unsigned long intervalMs = 1000;
+    double limit = -1;
+    int quiet = 0;
+    int opt;
+
+    memset( &srv, 0, sizeof( srv ));
+    srv.chunk = NETSIM_CHUNK;
+    srv.burst = NETSIM_BURST;
+    srv.icy = 1;
+
+    while ((opt = getopt( argc, argv, "d:p:l:c:r:B:x:b:i:t:Pqh" )) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': decoderName = optarg; break;
+            case 'p': spec = optarg; break;
+            case 'l': srv.latencyMs = strtol( optarg, NULL, 10 ); break;
+            case 'c': srv.chunk = strtoul( optarg, NULL, 10 ); break;
+            case 'r': srv.sourceBps = strtod( optarg, NULL ) * 1000 / 8; break;
+            case 'B': srv.burst = strtoul( optarg, NULL, 10 ); break;
+            case 'x': netsim_scale = strtod( optarg, NULL ); break;
+            case 'b': bufferMs = strtoul( optarg, NULL, 10 ); break;
+            case 'i': intervalMs = strtoul( optarg, NULL, 10 ); break;
+            case 't': limit = strtod( optarg, NULL ); break;
+            case 'P': srv.icy = 0; break;
+            case 'q': quiet = 1; break;
+            default: usage( argv[0] ); return 1;
+        }
+    }
+
+    if (optind + 1 != argc || netsim_scale <= 0 || !srv.chunk || !intervalMs)
+    {
+        usage( argv[0] );
+        return 1;
+    }
+
+    if (netsim_profile_parse( &profile, spec ))
+    {
+        fprintf( stderr, "Invalid profile '%s'\n", spec );
+        return 1;
+    }
+
+    const char *file = argv[ optind ];
+    const char *ext = strrchr( file, '.' );
+    int isMp3 = ext && !strcasecmp( ext, ".mp3" );
+
+    if (!decoderName) decoderName = isMp3 ? "OpenCORE-MP3" : "OpenCORE";
+
+    AACDDecoder *decoder = aacd_decoder_get_by_name( decoderName );
+
+    if (!decoder)
+    {
+        fprintf( stderr, "Unknown decoder '%s'\n", decoderName );
+        return 1;
+    }
+
+    srv.data = netsim_load( file, &srv.len );
+    srv.contentType = isMp3 ? "audio/mpeg" : "audio/aacp";
+    srv.profile = &profile;
+
+    if (!srv.data)
+    {
+        fprintf( stderr, "Cannot read file '%s'\n", file );
+        return 1;
+    }
+
+    if (!srv.sourceBps) srv.sourceBps = netsim_bitrate( srv.data, srv.len, isMp3 );
+
+    if (srv.icy && !srv.sourceBps)
+    {
+        fprintf( stderr, "Cannot compute the bitrate of '%s' - please use -r\n", file );
+        return 1;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &netsim_t0 );
+    aacd_metrics_reset();
+
+    if (netsim_server_start( &srv ))
+    {
+        fprintf( stderr, "Cannot start the server\n" );
+        return 1;
+    }
+
+    printf( "%s [%s, %s]: profile=", file, decoderName, srv.icy ? "ICY" : "HTTP" );
+    netsim_profile_print( &profile );
+    printf( ", latency=%ld ms, chunk=%lu B, clock=x%g\n", srv.latencyMs, srv.chunk, netsim_scale );
+
+    if (srv.icy) printf( "  live source=%.0f kbit/s, burst=%lu B\n", srv.sourceBps * 8 / 1000, srv.burst );
+
+    char url[ 64 ];
+    snprintf( url, sizeof( url ), "http://127.0.0.1:%d/stream", srv.port );
+
+    AACDHttp *http = aacd_http_open( url, 1 );
+    AACDInfo *info = http ? aacd_start( decoder, &netsim_reader, http ) : NULL;
+    AACDOutput *out = info ? aacd_output_start( info, &netsim_track, NULL, bufferMs, NULL, NULL ) : NULL;
+
+    if (!out)
+    {
+        fprintf( stderr, "Cannot start playing '%s'\n", url );
+
+        if (info) aacd_stop( info );
+        else if (http) aacd_http_close( http );
+
+        netsim_server_stop( &srv );
+        return 1;
+    }
+
+    NetSimTrack *ts = &netsim_track_stats;
+    unsigned long long lastReceived = 0;
+    double pcmSum = 0, pcmMin = -1, pcmMax = 0;
+    double inSum = 0, inMax = 0;
+    double sockSum = 0, sockMax = 0;
+    int ticks = 0, samples = 0, finished = 0;
+
+    // the socket buffers (sent, not received) hold the lead of the native reader reading on demand:
+    if (!quiet) printf( "   time  net kbit/s  recv kbit/s  socket KB  input KB  pcm ms  underruns\n" );
+
+    for (;;)
+    {
+        double tick = (ticks + 1) * intervalMs / 1000.0;
+        long waitMs = (long) ((tick - netsim_now()) / netsim_scale * 1000);
+
+        if (waitMs > 0 && aacd_output_wait( out, waitMs )) finished = 1;
+
+        ticks++;
+
+        double until;
+        unsigned long long received = __atomic_load_n( &netsim_received, __ATOMIC_RELAXED );
+        unsigned long long sent = __atomic_load_n( &netsim_sent, __ATOMIC_RELAXED );
+        double recvKbps = (received - lastReceived) * 8.0 / intervalMs;
+        double sock = sent > received ? (sent - received) / 1024.0 : 0;
+        double in = netsim_input_buffered() / 1024.0;
+        double pcm = aacd_output_buffered( out ) * 1000.0 / info->channels / info->samplerate;
+
+        lastReceived = received;
+
+        // the occupancy is measured from the first audio - the startup is reported separately:
+        if (__atomic_load_n( &ts->firstAudioUs, __ATOMIC_RELAXED ))
+        {
+            samples++;
+            pcmSum += pcm;
+            inSum += in;
+            sockSum += sock;
+            if (sock > sockMax) sockMax = sock;
+            if (pcmMin < 0 || pcm < pcmMin) pcmMin = pcm;
+            if (pcm > pcmMax) pcmMax = pcm;
+            if (in > inMax) inMax = in;
+        }
+
+        if (!quiet)
+        {
+            printf( "%7.2f  %10lu  %11.0f  %9.1f  %8.1f  %6.0f  %9lu\n", tick,
+                    netsim_profile_rate( &profile, tick, &until ), recvKbps, sock, in, pcm,
+                    __atomic_load_n( &ts->underruns, __ATOMIC_RELAXED ));
+        }
+
+        if (finished || (limit > 0 && tick >= limit)) break;
+    }
+
+    double secs = netsim_now();
+
+    // the reader may be blocked by the server - the server is stopped first:
+    netsim_server_stop( &srv );
+
+    unsigned long long played = out->played;
+    unsigned long long firstAudioUs = ts->firstAudioUs;
+    unsigned long underruns = ts->underruns;
+    double silence = (double) ts->silence / info->channels / info->samplerate;
+
+    aacd_output_stop( out );
+
+    printf( "summary:\n" );
+
+    if (firstAudioUs) printf( "  time to first audio  %.3f s\n", (firstAudioUs - 1) / 1e6 );
+    else printf( "  time to first audio  - (no audio)\n" );
+
+    printf( "  underruns            %lu (%.2f s of silence)\n", underruns, silence );
+
+    if (samples)
+    {
+        printf( "  pcm buffer           avg=%.0f min=%.0f max=%.0f ms (capacity %lu ms)\n",
+                pcmSum / samples, pcmMin, pcmMax, bufferMs );
+        printf( "  socket buffers       avg=%.1f max=%.1f KB\n", sockSum / samples, sockMax );
+        printf( "  input buffer         avg=%.1f max=%.1f KB\n", inSum / samples, inMax );
+    }
+
+    printf( "  connections          %d\n", srv.connections );
+    printf( "  audio=%.2f s, time=%.2f s%s\n",
+            (double) played / info->channels / info->samplerate, secs, finished ? "" : " (stopped)" );
+
+    aacd_stop( info );
+    free( (void*) srv.data );
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host player of the native output.
+ * Plays ADTS AAC / MP3 files through a sink - the same code path as
+ * Decoder.startOutput() on Android, but with the Null or WAV sink:
+ *
+ *   aacd-play stream.aac                   (real time, the samples are dropped)
+ *   aacd-play -k WAV -o out.wav stream.aac (as fast as possible)
+ *
+ * HTTP / ICY streams are read by the native HTTP reader (the metadata are printed
+ * when they change) - e.g. from a local test server:
+ *
+ *   aacd-play -d OpenCORE http://127.0.0.1:8000/stream
+ */
+
+#define AACD_MODULE "Play"
+
+#include "aac-output.h"
+#include "aac-metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/****************************************************************************************************
+ * FUNCTIONS - File reader
+ ****************************************************************************************************/
+
+#define PLAY_CHUNK  4096
+
+static const char* play_reader_name()
+{
+    return "File";
+}
+
+
+static long play_reader_read( AACDInfo *info )
+{
+    FILE *f = (FILE*) info->reader_ext;
+    unsigned char buf[ PLAY_CHUNK ];
+
+    size_t n = fread( buf, 1, sizeof( buf ), f );
+
+    if (n) memcpy( aacd_prepare_buffer( info, n ), buf, n );
+
+    return (long) n;
+}
+
+
+static void play_reader_destroy( AACDInfo *info )
+{
+    if (info->reader_ext) fclose( (FILE*) info->reader_ext );
+
+    info->reader_ext = NULL;
+}
+
+
+static int play_reader_seek( AACDInfo *info, unsigned long offset )
+{
+    return fseek( (FILE*) info->reader_ext, (long) offset, SEEK_SET );
+}
+
+
+static AACDReader play_reader = {
+    play_reader_name,
+    play_reader_read,
+    play_reader_destroy,
+    play_reader_seek
+};
+
+
+/****************************************************************************************************
+ * FUNCTIONS
+ ****************************************************************************************************/
+
+static double play_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static const char *play_counters[ AACD_METRIC_COUNT ] = {
+    "frames", "bytes", "resyncs", "skipped", "reads", "starved", "out-underruns", "at-underruns", "in-underruns"
+};
+
+static const char *play_hists[ AACD_HIST_COUNT ] = {
+    "read", "jni", "round", "pcm-queue"
+};
+
+
+static void play_hist( const char *name, const unsigned long long *hist )
+{
+    if (!hist[0]) return;
+
+    printf( "  %-14s n=%llu mean=%llu p50=%llu p99=%llu p99.9=%llu max=%llu\n", name,
+            hist[0], hist[1] / hist[0],
+            aacd_metrics_percentile( hist, 50 ),
+            aacd_metrics_percentile( hist, 99 ),
+            aacd_metrics_percentile( hist, 99.9 ),
+            hist[2] );
+}
+
+
+static void play_metrics()
+{
+    static unsigned long long snap[ AACD_METRICS_SNAPSHOT ];
+
+    if (aacd_metrics_snapshot( snap, AACD_METRICS_SNAPSHOT ) < 0) return;
+
+    int i;
+
+    printf( "metrics:\n" );
+
+    for (i = 0; i < AACD_METRIC_COUNT; i++) printf( "  %-14s %llu\n", play_counters[i], snap[i] );
+
+    const unsigned long long *hist = snap + AACD_METRIC_COUNT + 1;
+
+    for (i = 0; i < AACD_HIST_COUNT; i++, hist += AACD_HIST_SNAPSHOT) play_hist( play_hists[i], hist );
+
+    for (i = 0; i < (int) snap[ AACD_METRIC_COUNT ]; i++, hist += AACD_HIST_SNAPSHOT)
+    {
+        char name[ 64 ];
+        snprintf( name, sizeof( name ), "frame/%s", aacd_metrics_backend( i ));
+        play_hist( name, hist );
+    }
+}
+
+
+static void usage( const char *prog )
+{
+    fprintf( stderr, "Usage: %s [-d decoder] [-k sink] [-o param] [-b ms] [-M] [-m] file | url\n", prog );
+    fprintf( stderr, "  -d decoder  the decoder name: OpenCORE, OpenCORE-MP3, OpenCORE-FLV or OpenCORE-MP4\n" );
+    fprintf( stderr, "              (default: by the file suffix)\n" );
+    fprintf( stderr, "  -k sink     the sink name: Null or WAV (default: Null)\n" );
+    fprintf( stderr, "  -o param    the sink parameter - the output file of the WAV sink\n" );
+    fprintf( stderr, "  -b ms       the capacity of the PCM ring in ms (default: 500)\n" );
+    fprintf( stderr, "  -M          the ICY metadata are not requested (http:// only)\n" );
+    fprintf( stderr, "  -m          print the metrics (counters and latency percentiles in us)\n" );
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *decoderName = NULL;
+    const char *sinkName = "Null";
+    const char *param = NULL;
+    unsigned long bufferMs = 500;
+    int metadata = 1;
+    int metrics = 0;
+    int opt;
+
+    while ((opt = getopt( argc, argv, "d:k:o:b:Mmh" )) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': decoderName = optarg; break;
+            case 'k': sinkName = optarg; break;
+            case 'o': param = optarg; break;
+            case 'b': bufferMs = strtoul( optarg, NULL, 10 ); break;
+            case 'M': metadata = 0; break;
+            case 'm': metrics = 1; break;
+            default: usage( argv[0] ); return 1;
+        }
+    }
+
+    if (optind + 1 != argc)
+    {
+        usage( argv[0] );
+        return 1;
+    }
+
+    const char *file = argv[ optind ];
+
+    if (!decoderName)
+    {
+        const char *ext = strrchr( file, '.' );
+        decoderName = ext && !strcasecmp( ext, ".mp3" ) ? "OpenCORE-MP3"
+                    : ext && !strcasecmp( ext, ".flv" ) ? "OpenCORE-FLV"
+                    : ext && (!strcasecmp( ext, ".m4a" ) || !strcasecmp( ext, ".mp4" ) || !strcasecmp( ext, ".m4b" )) ? "OpenCORE-MP4"
+                    : "OpenCORE";
+    }
+
+    AACDDecoder *decoder = aacd_decoder_get_by_name( decoderName );
+    AACDSink *sink = aacd_sink_get_by_name( sinkName );
+
+    if (!decoder || !sink)
+    {
+        fprintf( stderr, "Unknown decoder '%s' or sink '%s'\n", decoderName, sinkName );
+        return 1;
+    }
+
+    double t0 = play_now();
+
+    AACDHttp *http = NULL;
+    AACDInfo *info;
+
+    if (!strncasecmp( file, "http://", 7 ) || !strncasecmp( file, "icy://", 6 ))
+    {
+        http = aacd_http_open( file, metadata );
+
+        if (!http)
+        {
+            fprintf( stderr, "Cannot open '%s'\n", file );
+            return 1;
+        }
+
+        printf( "%s", aacd_http_headers( http ));
+
+        info = aacd_start( decoder, &aacd_http_reader, http );
+    }
+    else
+    {
+        FILE *f = fopen( file, "rb" );
+
+        if (!f)
+        {
+            fprintf( stderr, "Cannot read file '%s'\n", file );
+            return 1;
+        }
+
+        info = aacd_start( decoder, &play_reader, f );
+    }
+
+    if (!info)
+    {
+        fprintf( stderr, "Cannot start decoding '%s'\n", file );
+        return 1;
+    }
+
+    AACDOutput *out = aacd_output_start( info, sink, param, bufferMs, NULL, NULL );
+
+    if (!out)
+    {
+        fprintf( stderr, "Cannot start sink '%s'\n", sinkName );
+        aacd_stop( info );
+        return 1;
+    }
+
+    // the metadata are read by the decoding thread:
+    while (!aacd_output_wait( out, http ? 100 : -1 ))
+    {
+        char meta[ 4096 ];
+
+        if (aacd_http_metadata( http, meta, sizeof( meta )) >= 0) printf( "metadata: %s\n", meta );
+    }
+
+    double secs = play_now() - t0;
+    unsigned long long played = out->played;
+    unsigned long underruns = out->underruns;
+
+    aacd_output_stop( out );
+
+    printf( "%s [%s -> %s]: %lu Hz, %d ch\n", file, decoderName, sinkName, info->samplerate, info->channels );
+    printf( "  audio=%.2f s, wall=%.2f s, underruns=%lu\n",
+            (double) played / info->channels / info->samplerate, secs, underruns );
+
+    if (metrics) play_metrics();
+
+    aacd_stop( info );
+
+    return 0;
+}
+
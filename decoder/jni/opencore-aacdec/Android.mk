@@ -175,7 +175,7 @@ PV_CFLAGS :=
 # Unfortunately PS causes crash for certain streams:
 # fixed 2012-06-28
 #LOCAL_CFLAGS := -DAAC_PLUS -DHQ_SBR $(PV_CFLAGS)
-LOCAL_CFLAGS := -DAAC_PLUS -DHQ_SBR -DPARAMETRICSTEREO $(PV_CFLAGS)
+LOCAL_CFLAGS := -DAAC_PLUS -DHQ_SBR -DPARAMETRICSTEREO $(PV_CFLAGS) $(ABI_CFLAGS)
 
 ifeq ($(TARGET_ARCH),arm)
 	LOCAL_ARM_MODE := arm
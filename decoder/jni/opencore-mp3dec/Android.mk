@@ -73,7 +73,7 @@ ifeq ($(TARGET_ARCH),arm)
   LOCAL_CFLAGS := -DPV_ARM_GCC_V4 $(PV_CFLAGS)
   LOCAL_ARM_MODE := arm
 else
-  LOCAL_CFLAGS :=  $(PV_CFLAGS)
+  LOCAL_CFLAGS :=  $(PV_CFLAGS) $(ABI_CFLAGS)
 endif
 
 LOCAL_STATIC_LIBRARIES := 
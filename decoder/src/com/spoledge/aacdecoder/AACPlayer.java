@@ -19,6 +19,9 @@
 */
 package com.spoledge.aacdecoder;
 
+import android.media.AudioManager;
+import android.media.AudioTrack;
+
 import android.util.Log;
 
 import java.io.FileInputStream;
@@ -29,6 +32,9 @@ import java.net.HttpURLConnection;
 import java.net.URL;
 import java.net.URLConnection;
 
+import java.util.List;
+import java.util.Map;
+
 
 /**
  * This is the AAC Stream player class.
@@ -64,8 +70,26 @@ public class AACPlayer {
     public static final int DEFAULT_DECODE_BUFFER_CAPACITY_MS = 700;
 
 
+    /**
+     * The output sample rate meaning the native rate of the device.
+     * @see setOutputSampleRate(int)
+     */
+    public static final int OUTPUT_SAMPLE_RATE_DEVICE = -1;
+
+
+    /**
+     * How often the native output reports the buffer state.
+     */
+    private static final int NATIVE_OUTPUT_POLL_MS = 200;
+
+
     private static final String LOG = "AACPlayer";
 
+    /**
+     * The per-round debug messages are built only when enabled by "setprop log.tag.AACPlayer DEBUG".
+     */
+    private static final boolean DEBUG = Log.isLoggable( LOG, Log.DEBUG );
+
 
     ////////////////////////////////////////////////////////////////////////////
     // Attributes
@@ -74,19 +98,55 @@ public class AACPlayer {
     protected boolean stopped;
     protected boolean metadataEnabled = true;
     protected boolean responseCodeCheckEnabled = true;
+    protected boolean directInputEnabled = false;
+    protected boolean directOutputEnabled = false;
+    protected boolean nativeOutputEnabled = false;
+    protected boolean mmapInputEnabled = false;
+    protected boolean nativeHttpEnabled = false;
+
+    protected int outputSampleRate = 0;
+    protected float downmixCenter = PostProcessor.DEFAULT_CENTER_GAIN;
+    protected float downmixSurround = PostProcessor.DEFAULT_SURROUND_GAIN;
+    protected float downmixLfe = PostProcessor.DEFAULT_LFE_GAIN;
 
     protected int audioBufferCapacityMs;
     protected int decodeBufferCapacityMs;
+    protected int inputBufferCount = BufferReader.DEFAULT_BUFFER_COUNT;
+    protected int decodeBufferCount = PCMFeed.DEFAULT_QUEUE_DEPTH + 1;
+    protected int burstMs = 0;
     protected PlayerCallback playerCallback;
     protected String metadataCharEnc;
 
     protected Decoder decoder;
+    protected NativeHttpStream httpStream;
+    protected JitterBuffer jitterBuffer = new JitterBuffer();
+
+    /**
+     * The time spent by connecting to the URL - reported as a part of the time to first samples.
+     */
+    protected long connectMs;
+
+    /**
+     * The pending seek request in ms or -1.
+     */
+    protected volatile int seekMs = -1;
+
+    /**
+     * The requested quality level and the flag that it was not applied yet.
+     */
+    protected volatile int quality = Decoder.QUALITY_FULL;
+    protected volatile boolean qualityPending;
 
     /**
      * The bit rate declared by the stream header - kb/s.
      */
     protected int declaredBitRate = -1;
 
+    /**
+     * The power profile of the last stream or null.
+     */
+    protected volatile PowerStats powerStats;
+
     // variables used for computing average bitrate
     private int sumKBitSecRate = 0;
     private int countKBitSecRate = 0;
@@ -199,6 +259,104 @@ public class AACPlayer {
     }
 
 
+    /**
+     * Sets the minimum number of the input buffers (BufferReader).
+     * More buffers allow the reading thread to get ahead of the decoder.
+     * The jitter buffer uses more buffers if it needs them for its maximum target.
+     * The default is 3.
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setInputBufferCount( int inputBufferCount ) {
+        this.inputBufferCount = inputBufferCount;
+    }
+
+
+    /**
+     * Returns the number of the input buffers.
+     */
+    public int getInputBufferCount() {
+        return inputBufferCount;
+    }
+
+
+    /**
+     * Returns the jitter buffer controller of the input.
+     * Its state (the target and buffered durations, the underruns) can be read
+     * by any thread while playing.
+     */
+    public JitterBuffer getJitterBuffer() {
+        return jitterBuffer;
+    }
+
+
+    /**
+     * Sets the jitter buffer controller of the input - e.g. with different limits.
+     * The controller keeps the learned network jitter between the streams.
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setJitterBuffer( JitterBuffer jitterBuffer ) {
+        this.jitterBuffer = jitterBuffer;
+    }
+
+
+    /**
+     * Sets the number of the output buffers used for decoding.
+     * One is used by the decoder, the others are queued to / played by the PCMFeed.
+     * More buffers allow the decoder to get ahead of the playback.
+     * The default is 3 (at least 2).
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setDecodeBufferCount( int decodeBufferCount ) {
+        this.decodeBufferCount = decodeBufferCount;
+    }
+
+
+    /**
+     * Returns the number of the output buffers used for decoding.
+     */
+    public int getDecodeBufferCount() {
+        return decodeBufferCount;
+    }
+
+
+    /**
+     * Sets the burst (race-to-idle) mode for saving the battery.
+     * The AudioTrack is enlarged by the burst and refilled at once when it drains
+     * to the audio buffer capacity (the low watermark) - the decoder decodes the burst
+     * as fast as possible and then all the threads sleep until the next refill.
+     * Longer bursts mean less wakeups, but more memory (PCM buffers of the burst length)
+     * and more audio decoded in vain when stopped.
+     * The default is 0 - the burst mode is disabled.
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     * @param burstMs the duration of a burst in ms (e.g. 8000) or 0
+     * @see getPowerStats()
+     */
+    public void setBurstMs( int burstMs ) {
+        this.burstMs = burstMs;
+    }
+
+
+    /**
+     * Returns the duration of a burst in ms or 0 if the burst mode is disabled.
+     */
+    public int getBurstMs() {
+        return burstMs;
+    }
+
+
+    /**
+     * Returns the power profile (wakeups, CPU time) of the last stream
+     * or null if no stream has stopped yet.
+     */
+    public PowerStats getPowerStats() {
+        return powerStats;
+    }
+
+
     /**
      * Sets the PlayerCallback.
      * NOTE: this should be set BEFORE any of the play methods are called.
@@ -254,6 +412,180 @@ public class AACPlayer {
     }
 
 
+    /**
+     * Returns the flag if the input data are passed to the decoder in direct ByteBuffers.
+     */
+    public boolean getDirectInputEnabled() {
+        return directInputEnabled;
+    }
+
+
+    /**
+     * Sets the flag if the input data are passed to the decoder in direct ByteBuffers.
+     * The native decoder then decodes the data in place - without copying
+     * them from Java arrays into native memory.
+     * This is disabled by default.
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setDirectInputEnabled( boolean directInputEnabled ) {
+        this.directInputEnabled = directInputEnabled;
+    }
+
+
+    /**
+     * Returns the flag if the decoder writes the samples directly into the Java array.
+     */
+    public boolean getDirectOutputEnabled() {
+        return directOutputEnabled;
+    }
+
+
+    /**
+     * Sets the flag if the decoder writes the samples directly into the Java array.
+     * This saves one copy of the PCM data per decoding round.
+     * This is disabled by default.
+     * @see Decoder#setCriticalEnabled(boolean)
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setDirectOutputEnabled( boolean directOutputEnabled ) {
+        this.directOutputEnabled = directOutputEnabled;
+    }
+
+
+    /**
+     * Returns the flag if the stream is played by the native output.
+     */
+    public boolean getNativeOutputEnabled() {
+        return nativeOutputEnabled;
+    }
+
+
+    /**
+     * Sets the flag if the stream is played by the native output (OpenSL ES).
+     * The samples are decoded and played by native threads - no AudioTrack
+     * and no PCM buffers in Java. Requires Android 2.3+.
+     * The audio buffer capacity is used as the capacity of the native PCM buffer.
+     * This is disabled by default.
+     * @see Decoder#startOutput(String,String,int)
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setNativeOutputEnabled( boolean nativeOutputEnabled ) {
+        this.nativeOutputEnabled = nativeOutputEnabled;
+    }
+
+
+    /**
+     * Returns the flag if local files are memory mapped.
+     */
+    public boolean getMmapInputEnabled() {
+        return mmapInputEnabled;
+    }
+
+
+    /**
+     * Sets the flag if local files are memory mapped by the native decoder.
+     * The frames are then decoded in place - no BufferReader thread
+     * and no copying of the input data. This applies only to play(String)
+     * methods called with a file path (not an URL).
+     * This is disabled by default.
+     * @see Decoder#start(String)
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setMmapInputEnabled( boolean mmapInputEnabled ) {
+        this.mmapInputEnabled = mmapInputEnabled;
+    }
+
+
+    /**
+     * Returns the flag if HTTP streams are received by the native code.
+     */
+    public boolean getNativeHttpEnabled() {
+        return nativeHttpEnabled;
+    }
+
+
+    /**
+     * Sets the flag if HTTP streams are received by the native code.
+     * The response body is received directly into the decoder's input buffer
+     * and the ICY metadata are stripped there - no BufferReader thread,
+     * no IcyInputStream and no copying of the input data. The metadata are
+     * passed to the PlayerCallback only when they change.
+     * This applies only to play(String) methods called with an http:// or icy:// URL;
+     * the connection is not prepared by openConnection() / prepareConnection().
+     * This is disabled by default.
+     * @see NativeHttpStream
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setNativeHttpEnabled( boolean nativeHttpEnabled ) {
+        this.nativeHttpEnabled = nativeHttpEnabled;
+    }
+
+
+    /**
+     * Returns the sample rate of the output.
+     */
+    public int getOutputSampleRate() {
+        return outputSampleRate;
+    }
+
+
+    /**
+     * Sets the sample rate of the output (AudioTrack).
+     * If it differs from the rate of the stream, then the samples are resampled
+     * by the native polyphase resampler - instead of the platform one.
+     * The value OUTPUT_SAMPLE_RATE_DEVICE means the native rate of the device.
+     * The default is 0 - the rate of the stream.
+     * The native output (see setNativeOutputEnabled(boolean)) is not resampled.
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setOutputSampleRate( int outputSampleRate ) {
+        this.outputSampleRate = outputSampleRate;
+    }
+
+
+    /**
+     * Sets the gains of the multichannel downmix - relative to the front channels.
+     * Streams with more than 2 channels are downmixed into stereo;
+     * the gains are normalized so the output cannot clip.
+     * The defaults are PostProcessor.DEFAULT_*_GAIN.
+     *
+     * NOTE: this should be set BEFORE any of the play methods are called.
+     */
+    public void setDownmix( float center, float surround, float lfe ) {
+        this.downmixCenter = center;
+        this.downmixSurround = surround;
+        this.downmixLfe = lfe;
+    }
+
+
+    /**
+     * Requests the quality level of the decoder - see Decoder.QUALITY_* constants.
+     * It can be called while playing (e.g. when the device enters the battery saver mode) -
+     * it is performed by the execution thread before the next decoding round.
+     * A halved sampling rate is resampled back to the output rate natively,
+     * but changing the number of channels (mono) restarts the AudioTrack.
+     * The native output (see setNativeOutputEnabled(boolean)) does not support it.
+     */
+    public void setQuality( int quality ) {
+        this.quality = quality;
+        qualityPending = true;
+    }
+
+
+    /**
+     * Returns the requested quality level.
+     */
+    public int getQuality() {
+        return quality;
+    }
+
+
     /**
      * Sets the encoding for the metadata strings.
      * If not set, then UTF-8 is used.
@@ -323,8 +655,33 @@ public class AACPlayer {
      */
     public void play( String url, int expectedKBitSecRate ) throws Exception {
         declaredBitRate = -1;
+        connectMs = 0;
+
+        if (nativeHttpEnabled && (url.startsWith( "http:" ) || url.startsWith( "icy:" ))) {
+            long tsConnect = System.currentTimeMillis();
+
+            NativeHttpStream stream = NativeHttpStream.open( url, metadataEnabled );
+
+            try {
+                processHeaders( stream.getHeaderFields());
+
+                connectMs = System.currentTimeMillis() - tsConnect;
+
+                if (expectedKBitSecRate == -1) expectedKBitSecRate = declaredBitRate;
+
+                playStarted();
+
+                httpStream = stream;
+                playImpl( null, null, expectedKBitSecRate > 0 ? expectedKBitSecRate : DEFAULT_EXPECTED_KBITSEC_RATE );
+            }
+            finally {
+                httpStream = null;
+                stream.close();
+            }
+        }
+        else if (url.indexOf( ':' ) > 0) {
+            long tsConnect = System.currentTimeMillis();
 
-        if (url.indexOf( ':' ) > 0) {
             URLConnection cn = openConnection( url );
             InputStream is = null;
 
@@ -333,6 +690,8 @@ public class AACPlayer {
                 processHeaders( cn );
                 is = getInputStream( cn );
 
+                connectMs = System.currentTimeMillis() - tsConnect;
+
                 // try to get the expectedKBitSecRate from headers
                 // but if then expectedKBitSecRate is passed, then ignore the declared one:
                 play( is, expectedKBitSecRate != -1 ? expectedKBitSecRate : declaredBitRate );
@@ -345,6 +704,11 @@ public class AACPlayer {
                 }
             }
         }
+        else if (mmapInputEnabled) {
+            processFileType( url );
+            playStarted();
+            playImpl( null, url, expectedKBitSecRate > 0 ? expectedKBitSecRate : DEFAULT_EXPECTED_KBITSEC_RATE );
+        }
         else {
             processFileType( url );
             InputStream is = new FileInputStream( url );
@@ -374,19 +738,36 @@ public class AACPlayer {
      * @param expectedKBitSecRate the expected average bitrate in kbit/sec; -1 means unknown
      */
     public final void play( InputStream is, int expectedKBitSecRate ) throws Exception {
-        stopped = false;
-
-        if (playerCallback != null) playerCallback.playerStarted();
+        playStarted();
 
         if (expectedKBitSecRate <= 0) expectedKBitSecRate = DEFAULT_EXPECTED_KBITSEC_RATE;
 
-        sumKBitSecRate = 0;
-        countKBitSecRate = 0;
-
         playImpl( is, expectedKBitSecRate );
     }
 
 
+    /**
+     * Prepares the decoder in advance - so the next play() call starts faster.
+     * @see Decoder#prewarm()
+     */
+    public void prewarm() {
+        decoder.prewarm();
+    }
+
+
+    /**
+     * Requests seeking - it is performed by the execution thread before the next decoding round.
+     * Only local files (FileInputStream) and the native HTTP streams
+     * of servers supporting Range requests are seekable. The audio already buffered
+     * by the PCMFeed is still played.
+     * The native output (see setNativeOutputEnabled(boolean)) does not support seeking.
+     * @param ms the position from the beginning of the stream
+     */
+    public void seekTo( int ms ) {
+        seekMs = ms;
+    }
+
+
     /**
      * Stops the execution thread.
      */
@@ -406,13 +787,46 @@ public class AACPlayer {
      * @param expectedKBitSecRate the expected average bitrate in kbit/sec
      */
     protected void playImpl( InputStream is, int expectedKBitSecRate ) throws Exception {
-        BufferReader reader = new BufferReader(
-                                        computeInputBufferSize( expectedKBitSecRate, decodeBufferCapacityMs ),
-                                        is );
+        // the chunks are allocated once - the jitter buffer only changes how many are awaited:
+        jitterBuffer.start( expectedKBitSecRate );
+
+        BufferReader reader = new BufferReader( jitterBuffer.getChunkBytes(), is, directInputEnabled,
+                                        Math.max( inputBufferCount, jitterBuffer.getChunkCount()), jitterBuffer );
+
+        // a full input should not wake the reader while the burst is played:
+        if (burstMs > 0) reader.setWaitMs( burstMs );
+
         new Thread( reader ).start();
 
+        playImpl( reader, null, expectedKBitSecRate );
+    }
+
+
+    /**
+     * Resets the state before playing.
+     */
+    protected void playStarted() {
+        stopped = false;
+        seekMs = -1;
+
+        if (playerCallback != null) playerCallback.playerStarted();
+
+        sumKBitSecRate = 0;
+        countKBitSecRate = 0;
+    }
+
+
+    /**
+     * Plays a stream synchronously - from the reader, from the native HTTP stream
+     * or from the memory mapped file.
+     * @param reader the running reader or null
+     * @param path the path of the file used if the reader and the HTTP stream are null
+     * @param expectedKBitSecRate the expected average bitrate in kbit/sec
+     */
+    protected void playImpl( BufferReader reader, String path, int expectedKBitSecRate ) throws Exception {
         PCMFeed pcmfeed = null;
         Thread pcmfeedThread = null;
+        PostProcessor post = null;
 
         // profiling info
         long profMs = 0;
@@ -420,60 +834,132 @@ public class AACPlayer {
         long profSampleRate = 0;
         int profCount = 0;
 
+        PowerStats power = new PowerStats();
+        long cpuStarted = PowerStats.threadCpuNanos();
+        long tsStarted = System.currentTimeMillis();
+
         try {
-            Decoder.Info info = decoder.start( reader );
+
+            decoder.setCriticalEnabled( directOutputEnabled );
+            decoder.setFirstSamplesEnabled( false );
+
+            Decoder.Info info = reader != null ? decoder.start( reader )
+                              : httpStream != null ? decoder.start( httpStream )
+                              : decoder.start( path );
 
             Log.d( LOG, "play(): samplerate=" + info.getSampleRate() + ", channels=" + info.getChannels());
 
             profSampleRate = info.getSampleRate() * info.getChannels();
 
-            if (info.getChannels() > 2) {
-                throw new RuntimeException("Too many channels detected: " + info.getChannels());
+            if (nativeOutputEnabled) {
+                if (info.getChannels() > 2) {
+                    throw new RuntimeException("Too many channels detected: " + info.getChannels());
+                }
+
+                logTimeToFirstSamples( info, System.currentTimeMillis() - tsStarted );
+                playNativeOutput( info );
+                return;
             }
 
-            // 3 buffers for result samples:
-            //   - one is used by decoder
-            //   - one is used by the PCMFeeder
-            //   - one is enqueued / passed to PCMFeeder - non-blocking op
-            short[][] decodeBuffers = createDecodeBuffers( 3, info );
-            short[] decodeBuffer = decodeBuffers[0]; 
+            // the format of the decoded samples - the quality level can change it:
+            int outputRate = getOutputSampleRate( info );
+            int decodedRate = info.getSampleRate();
+            int decodedChannels = info.getChannels();
+
+            post = createPostProcessor( decodedRate, decodedChannels, outputRate );
+
+            // buffers for result samples:
+            //   - one is used by decoder (or by the post processor)
+            //   - the others are queued to / played by the PCMFeed - see PCMFeed.feed()
+            pcmfeed = post != null ? createPCMFeed( post.getOutputRate(), post.getOutputChannels())
+                                   : createPCMFeed( info );
+
+            short[][] decodeBuffers = createDecodeBuffers( pcmfeed.getQueueDepth() + 1, info );
+            short[] decodeBuffer = decodeBuffers[0];
             int decodeBufferIndex = 0;
 
-            pcmfeed = createPCMFeed( info );
+            short[][] postBuffers = createPostBuffers( decodeBuffers.length, post, decodeBuffer.length );
+
+            // the requested level is kept for the next streams too:
+            qualityPending = quality != Decoder.QUALITY_FULL;
+
+            // the first samples are returned by the first round:
+            FrameStats stats = createFrameStats( decodeBuffer.length, info );
+
             pcmfeedThread = new Thread( pcmfeed );
             pcmfeedThread.start();
 
-            if (info.getFirstSamples() != null) {
-                short[] firstSamples = info.getFirstSamples();
-                Log.d( LOG, "First samples length: " + firstSamples.length );
+            do {
+                if (seekMs >= 0) {
+                    seek( info );
+                    if (post != null) post.reset();
+                }
 
-                pcmfeed.feed( firstSamples, firstSamples.length );
-                info.setFirstSamples( null );
-            }
+                if (qualityPending) applyQuality();
+                if (httpStream != null) pollMetadata();
 
-            do {
                 long tsStart = System.currentTimeMillis();
 
-                info = decoder.decode( decodeBuffer, decodeBuffer.length );
-                int nsamp = info.getRoundSamples();
+                decoder.decodeFrames( decodeBuffer, decodeBuffer.length, stats );
+                int nsamp = stats.getTotalSamples();
 
                 profMs += System.currentTimeMillis() - tsStart;
                 profSamples += nsamp;
                 profCount++;
 
-                Log.d( LOG, "play(): decoded " + nsamp + " samples" );
+                if (DEBUG) Log.d( LOG, "play(): decoded " + nsamp + " samples" );
 
                 if (nsamp == 0 || stopped) break;
-                if (!pcmfeed.feed( decodeBuffer, nsamp ) || stopped) break;
 
-                int kBitSecRate = computeAvgKBitSecRate( info );
-                if (Math.abs(expectedKBitSecRate - kBitSecRate) > 1) {
+                // the round contains only the frames of the current quality level:
+                if (decoder.getCurrentSampleRate() != decodedRate || decoder.getCurrentChannels() != decodedChannels) {
+                    decodedRate = decoder.getCurrentSampleRate();
+                    decodedChannels = decoder.getCurrentChannels();
+
+                    if (post != null) post.destroy();
+                    post = createPostProcessor( decodedRate, decodedChannels, outputRate );
+                    postBuffers = createPostBuffers( decodeBuffers.length, post, decodeBuffer.length );
+
+                    int feedRate = post != null ? post.getOutputRate() : decodedRate;
+                    int feedChannels = post != null ? post.getOutputChannels() : decodedChannels;
+
+                    if (feedRate != pcmfeed.getSampleRate() || feedChannels != pcmfeed.getChannels()) {
+                        Log.i( LOG, "play(): restarting the PCM feed - " + feedRate + " Hz, " + feedChannels + " ch" );
+
+                        pcmfeed.stop( true );
+                        pcmfeedThread.join();
+                        power.add( pcmfeed.getWakeups(), pcmfeed.getCpuNanos(), pcmfeed.getWrittenMs());
+
+                        pcmfeed = createPCMFeed( feedRate, feedChannels );
+                        pcmfeedThread = new Thread( pcmfeed );
+                        pcmfeedThread.start();
+                    }
+                }
+
+                if (post != null) {
+                    short[] postBuffer = postBuffers[ decodeBufferIndex % postBuffers.length ];
+                    int npost = post.process( decodeBuffer, nsamp, postBuffer );
+
+                    if (!pcmfeed.feed( postBuffer, npost ) || stopped) break;
+                }
+                else if (!pcmfeed.feed( decodeBuffer, nsamp ) || stopped) break;
+
+                Metrics.record( Metrics.HISTOGRAM_PCM_QUEUE, pcmfeed.getQueuedCount());
+
+                if (profCount == 1) logTimeToFirstSamples( info, System.currentTimeMillis() - tsStarted );
+
+                int kBitSecRate = computeAvgKBitSecRate( stats, decodedRate, decodedChannels );
+                if (reader != null && kBitSecRate > 0 && Math.abs(expectedKBitSecRate - kBitSecRate) > 1) {
                     Log.i( LOG, "play(): changing kBitSecRate: " + expectedKBitSecRate + " -> " + kBitSecRate );
-                    reader.setCapacity( computeInputBufferSize( kBitSecRate, decodeBufferCapacityMs ));
+
+                    JitterBuffer jitter = reader.getJitterBuffer();
+
+                    if (jitter != null) jitter.setKBitSecRate( kBitSecRate );
+                    else reader.setCapacity( computeInputBufferSize( kBitSecRate, decodeBufferCapacityMs ));
                     expectedKBitSecRate = kBitSecRate;
                 }
 
-                decodeBuffer = decodeBuffers[ ++decodeBufferIndex % 3 ];
+                decodeBuffer = decodeBuffers[ ++decodeBufferIndex % decodeBuffers.length ];
             } while (!stopped);
         }
         finally {
@@ -481,8 +967,10 @@ public class AACPlayer {
             stopped = true;
 
             if (pcmfeed != null) pcmfeed.stop( !stopImmediatelly );
+
+            // the native output may be waiting for the reader:
+            if (reader != null) reader.stop();
             decoder.stop();
-            reader.stop();
 
             int perf = 0;
 
@@ -498,12 +986,97 @@ public class AACPlayer {
             }
 
             if (pcmfeedThread != null) pcmfeedThread.join();
+            if (post != null) post.destroy();
+
+            if (pcmfeed != null) power.add( pcmfeed.getWakeups(), pcmfeed.getCpuNanos(), pcmfeed.getWrittenMs());
+            if (reader != null) power.add( reader.getWakeups(), reader.getCpuNanos(), 0 );
+            power.add( 0, PowerStats.threadCpuNanos() - cpuStarted, 0 );
+            power.setWallMs( System.currentTimeMillis() - tsStarted );
+            powerStats = power;
+
+            Log.i( LOG, "play(): power: " + power );
 
             if (playerCallback != null) playerCallback.playerStopped( perf );
         }
     }
 
 
+    /**
+     * Plays the stream by the native output.
+     * The bitrate is not tracked - the input buffer keeps its initial capacity.
+     */
+    protected void playNativeOutput( Decoder.Info info ) {
+        decoder.startOutput( Decoder.SINK_OPENSLES, null, audioBufferCapacityMs );
+
+        while (!stopped && !decoder.waitOutput( NATIVE_OUTPUT_POLL_MS )) {
+            if (httpStream != null) pollMetadata();
+
+            if (playerCallback != null) {
+                int ms = PCMFeed.samplesToMs( decoder.getOutputBuffered(), info.getSampleRate(), info.getChannels());
+
+                playerCallback.playerPCMFeedBuffer( true, ms, audioBufferCapacityMs );
+            }
+        }
+
+        Log.d( LOG, "playNativeOutput(): underruns=" + decoder.getOutputUnderruns());
+    }
+
+
+    /**
+     * Performs the pending seek request.
+     */
+    protected void seek( Decoder.Info info ) {
+        int ms = seekMs;
+        seekMs = -1;
+
+        long pos = decoder.seek( (long) ms * info.getSampleRate() / 1000 );
+
+        Log.d( LOG, "seek(): " + ms + " ms -> sample " + pos );
+    }
+
+
+    /**
+     * Passes the changed metadata of the native HTTP stream to the callback.
+     */
+    protected void pollMetadata() {
+        String s = httpStream.pollMetadata( metadataCharEnc );
+
+        if (s != null) {
+            Log.d( LOG, "Metadata string: " + s );
+
+            IcyInputStream.parseMetadata( s, playerCallback );
+        }
+    }
+
+
+    /**
+     * Performs the pending quality level request.
+     */
+    protected void applyQuality() {
+        qualityPending = false;
+
+        int ret = decoder.setQuality( quality );
+
+        Log.d( LOG, "applyQuality(): " + quality + " -> " + ret );
+    }
+
+
+    /**
+     * Logs the time-to-first-samples breakdown.
+     * @param ms the time from starting the decoder until the first samples were passed to the output
+     */
+    protected void logTimeToFirstSamples( Decoder.Info info, long ms ) {
+        Log.i( LOG, "play(): time to first samples: " + (connectMs + ms) + " ms"
+            + " - connect=" + connectMs + " ms"
+            + ", context=" + info.getStartInitUs() + " us"
+            + ", firstBuffer=" + info.getStartReadUs() + " us"
+            + ", sync=" + info.getStartSyncUs() + " us"
+            + ", config+firstFrame=" + info.getStartDecodeUs() + " us");
+
+        connectMs = 0;
+    }
+
+
     protected Decoder createDecoder() {
         return Decoder.create();
     }
@@ -522,10 +1095,92 @@ public class AACPlayer {
     }
 
 
+    /**
+     * Creates the per-frame stats block big enough for one decoding round.
+     */
+    protected FrameStats createFrameStats( int decodeBufferLength, Decoder.Info info ) {
+        // the smallest frame: MPEG-2 layer III = 576 samples per channel:
+        int frameSamples = info.getFrameSamples() > 0 ? info.getFrameSamples() : 576 * info.getChannels();
+
+        return new FrameStats( decodeBufferLength / frameSamples + 1 );
+    }
+
+
     protected PCMFeed createPCMFeed( Decoder.Info info ) {
-        int size = PCMFeed.msToBytes( audioBufferCapacityMs, info.getSampleRate(), info.getChannels());
+        return createPCMFeed( info.getSampleRate(), info.getChannels());
+    }
+
+
+    protected PCMFeed createPCMFeed( int sampleRate, int channels ) {
+        if (burstMs > 0) return createBurstPCMFeed( sampleRate, channels );
+
+        int size = PCMFeed.msToBytes( audioBufferCapacityMs, sampleRate, channels );
+
+        return new PCMFeed( sampleRate, channels, size, playerCallback,
+                            Math.max( 1, decodeBufferCount - 1 ));
+    }
+
+
+    /**
+     * Creates the PCMFeed of the burst mode - see setBurstMs(int).
+     * The audio buffer capacity is kept below the burst as the low watermark,
+     * the queue holds the decoded burst while the AudioTrack drains.
+     */
+    protected PCMFeed createBurstPCMFeed( int sampleRate, int channels ) {
+        int size = PCMFeed.msToBytes( audioBufferCapacityMs + burstMs, sampleRate, channels );
+        int depth = (burstMs + decodeBufferCapacityMs - 1) / decodeBufferCapacityMs + 1;
+
+        PCMFeed ret = new PCMFeed( sampleRate, channels, size, playerCallback,
+                                   Math.max( depth, decodeBufferCount - 1 ));
+
+        ret.setBurstMode( audioBufferCapacityMs, audioBufferCapacityMs );
+
+        return ret;
+    }
+
+
+    /**
+     * Returns the sample rate of the output - see setOutputSampleRate(int).
+     */
+    protected int getOutputSampleRate( Decoder.Info info ) {
+        int rate = outputSampleRate == OUTPUT_SAMPLE_RATE_DEVICE
+                    ? AudioTrack.getNativeOutputSampleRate( AudioManager.STREAM_MUSIC ) : outputSampleRate;
+
+        return rate > 0 ? rate : info.getSampleRate();
+    }
+
 
-        return new PCMFeed( info.getSampleRate(), info.getChannels(), size, playerCallback );
+    /**
+     * Creates the post-decode stage if the stream needs to be downmixed or resampled.
+     * @return the post processor or null if the decoded samples are played as they are
+     */
+    protected PostProcessor createPostProcessor( int sampleRate, int channels, int outputRate ) {
+        if (channels <= 2 && outputRate == sampleRate) return null;
+
+        PostProcessor ret = PostProcessor.create( channels, sampleRate, outputRate != sampleRate ? outputRate : 0 );
+        ret.setDownmix( downmixCenter, downmixSurround, downmixLfe, true );
+
+        Log.d( LOG, "play(): post processing " + channels + " ch " + sampleRate
+                + " Hz -> " + ret.getOutputChannels() + " ch " + ret.getOutputRate() + " Hz" );
+
+        return ret;
+    }
+
+
+    /**
+     * Creates the output buffers of the post-decode stage - rotated like the decode buffers.
+     * @return the buffers or null if there is no post processor
+     */
+    protected short[][] createPostBuffers( int count, PostProcessor post, int decodeBufferLength ) {
+        if (post == null) return null;
+
+        short[][] ret = new short[ count ][];
+
+        for (int i=0; i < ret.length; i++) {
+            ret[i] = new short[ post.getMaxOutputLength( decodeBufferLength ) ];
+        }
+
+        return ret;
     }
 
 
@@ -679,9 +1334,19 @@ public class AACPlayer {
      * This method is called after the connection is established.
      */
     protected void processHeaders( URLConnection cn ) {
-        dumpHeaders( cn );
+        processHeaders( cn.getHeaderFields());
+    }
+
+
+    /**
+     * This method is called after the connection is established - by processHeaders( URLConnection )
+     * or directly for the native HTTP streams.
+     * @param headers the response headers - may be null
+     */
+    protected void processHeaders( Map<String, List<String>> headers ) {
+        dumpHeaders( headers );
 
-        String br = cn.getHeaderField( "icy-br" );
+        String br = getHeaderField( headers, "icy-br" );
 
         if (br != null) {
             try {
@@ -700,8 +1365,8 @@ public class AACPlayer {
             }
         }
 
-        if (playerCallback != null) {
-            for (java.util.Map.Entry<String, java.util.List<String>> me : cn.getHeaderFields().entrySet()) {
+        if (playerCallback != null && headers != null) {
+            for (Map.Entry<String, List<String>> me : headers.entrySet()) {
                 for (String s : me.getValue()) {
                     playerCallback.playerMetadata( me.getKey(), s );
                 }
@@ -711,12 +1376,17 @@ public class AACPlayer {
 
 
     protected void dumpHeaders( URLConnection cn ) {
-        if (cn.getHeaderFields() == null) {
+        dumpHeaders( cn.getHeaderFields());
+    }
+
+
+    protected void dumpHeaders( Map<String, List<String>> headers ) {
+        if (headers == null) {
             Log.d( LOG, "No headers - not an HTTP response ?" );
             return;
         }
 
-        for (java.util.Map.Entry<String, java.util.List<String>> me : cn.getHeaderFields().entrySet()) {
+        for (Map.Entry<String, List<String>> me : headers.entrySet()) {
             for (String s : me.getValue()) {
                 Log.d( LOG, "header: key=" + me.getKey() + ", val=" + s);
             }
@@ -724,6 +1394,21 @@ public class AACPlayer {
     }
 
 
+    /**
+     * Returns the first value of the header - the name is case insensitive.
+     * @return the value or null
+     */
+    protected static String getHeaderField( Map<String, List<String>> headers, String name ) {
+        if (headers == null) return null;
+
+        for (Map.Entry<String, List<String>> me : headers.entrySet()) {
+            if (name.equalsIgnoreCase( me.getKey()) && !me.getValue().isEmpty()) return me.getValue().get( 0 );
+        }
+
+        return null;
+    }
+
+
     /**
      * This method is called before opening the file.
      * Actually this method does nothing, but subclasses may override it.
@@ -747,6 +1432,28 @@ public class AACPlayer {
     }
 
 
+    /**
+     * Computes the average bitrate from the per-frame statistics.
+     * The frames preceded by a decoding error are not counted.
+     * @param sampleRate the sample rate of the decoded frames - it depends on the quality level
+     * @param channels the channels of the decoded frames - it depends on the quality level
+     * @return the average bitrate or 0 if not known yet
+     */
+    protected int computeAvgKBitSecRate( FrameStats stats, int sampleRate, int channels ) {
+        // do not change the value after a while - avoid changing of the out buffer:
+        for (int i=0; i < stats.getFrames() && countKBitSecRate < 64; i++) {
+            if ((stats.getFlags( i ) & FrameStats.FLAG_RESYNC) != 0 || stats.getSamples( i ) <= 0) continue;
+
+            sumKBitSecRate += computeKBitSecRate( stats.getBytesConsumed( i ), stats.getSamples( i ),
+                                                  sampleRate, channels );
+            countKBitSecRate++;
+            avgKBitSecRate = sumKBitSecRate / countKBitSecRate;
+        }
+
+        return avgKBitSecRate;
+    }
+
+
     protected static int computeKBitSecRate( Decoder.Info info ) {
         if (info.getRoundSamples() <= 0) return -1;
 
@@ -21,9 +21,15 @@ package com.spoledge.aacdecoder;
 
 import android.util.Log;
 
+import java.io.FileInputStream;
 import java.io.InputStream;
 import java.io.IOException;
 
+import java.nio.ByteBuffer;
+import java.nio.channels.Channels;
+import java.nio.channels.FileChannel;
+import java.nio.channels.ReadableByteChannel;
+
 
 /**
  * This is a separate thread for reading data from a stream.
@@ -48,46 +54,147 @@ import java.io.IOException;
  *      ...
  *  }
  * </pre>
+ *
+ * In the direct mode the data are stored in direct ByteBuffers instead of byte arrays.
+ * The native decoder then decodes them in place without copying them into native memory.
+ *
+ * The buffers are passed between the threads by a lock-free ring (SPSCRing);
+ * the number of buffers can be configured.
+ *
+ * File streams are seekable - see seek(long). The end of a seekable stream
+ * does not stop the thread, so it is possible to seek back.
+ *
+ * If a JitterBuffer is attached, then the buffers are a fixed pool of chunks and
+ * next() holds the consumer back until the target duration is buffered - at the start,
+ * after seeking and after an underrun. The capacity is never changed then.
  */
 public class BufferReader implements Runnable {
 
     public static class Buffer {
         private byte[] data;
+        private ByteBuffer direct;
         private int size;
 
-        Buffer( int capacity ) {
-            data = new byte[ capacity ];
+        /**
+         * The seek generation the data were read in.
+         */
+        private int generation;
+
+        Buffer( int capacity, boolean isDirect ) {
+            if (isDirect) direct = ByteBuffer.allocateDirect( capacity );
+            else data = new byte[ capacity ];
         }
 
+        /**
+         * Returns the data array or null in the direct mode.
+         */
         public final byte[] getData() {
             return data;
         }
 
+        /**
+         * Returns the direct buffer or null if not in the direct mode.
+         */
+        public final ByteBuffer getDirect() {
+            return direct;
+        }
+
+        public final int getCapacity() {
+            return direct != null ? direct.capacity() : data.length;
+        }
+
         public final int getSize() {
             return size;
         }
     }
 
-    private static String LOG = "BufferReader";
+    /**
+     * The request passed from the consumer to the reading thread.
+     */
+    private static final class SeekRequest {
+        final long offset;
+        final int generation;
+
+        SeekRequest( long offset, int generation ) {
+            this.offset = offset;
+            this.generation = generation;
+        }
+    }
+
+
+    /**
+     * The default number of buffers.
+     */
+    public static final int DEFAULT_BUFFER_COUNT = 3;
+
+    /**
+     * How long the threads wait for a buffer before checking the stopped flag again.
+     */
+    private static final long WAIT_MS = 100;
 
-    int capacity;
+    private static final String LOG = "BufferReader";
+
+    /**
+     * The per-round debug messages are built only when enabled by "setprop log.tag.BufferReader DEBUG".
+     */
+    private static final boolean DEBUG = Log.isLoggable( LOG, Log.DEBUG );
+
+    volatile int capacity;
 
     private Buffer[] buffers;
 
     /**
-     * The buffer to be write into.
+     * The ring of filled buffers - the indexes into the buffers array.
      */
-    private int indexMine;
+    private SPSCRing ring;
 
     /**
-     * The index of the buffer last returned in the next() method.
+     * The buffer last returned in the next() method or null.
      */
-    private int indexBlocked;
+    private Buffer taken;
 
-    private boolean stopped;
+    private volatile boolean stopped;
 
     private InputStream is;
 
+    /**
+     * The channel used in the direct mode - null otherwise.
+     */
+    private ReadableByteChannel channel;
+
+    /**
+     * The channel of the file stream or null if the stream is not seekable.
+     */
+    private FileChannel fileChannel;
+
+    /**
+     * The last seek request - it is applied by the reading thread.
+     */
+    private volatile SeekRequest seekRequest;
+
+    /**
+     * The generation of the last seek request - accessed by the consumer only.
+     */
+    private int generation;
+
+    /**
+     * The jitter buffer controller or null.
+     */
+    private JitterBuffer jitter;
+
+    /**
+     * True if the consumer waits for the target duration - accessed by the consumer only.
+     */
+    private boolean buffering = true;
+
+    /**
+     * The ring timeout, the reads of the stream and the CPU time of the reading thread - see getWakeups().
+     */
+    private long waitMs = WAIT_MS;
+
+    private volatile int reads;
+    private volatile long cpuNanos;
+
 
     ////////////////////////////////////////////////////////////////////////////
     // Constructors
@@ -102,19 +209,72 @@ public class BufferReader implements Runnable {
      * @param is the input stream
      */
     public BufferReader( int capacity, InputStream is ) {
+        this( capacity, is, false );
+    }
+
+
+    /**
+     * Creates a new buffer.
+     *
+     * @param capacity the capacity of one buffer in bytes
+     *          = total allocated memory
+     *
+     * @param is the input stream
+     * @param direct if true, then direct ByteBuffers are used (zero-copy input of the decoder)
+     */
+    public BufferReader( int capacity, InputStream is, boolean direct ) {
+        this( capacity, is, direct, DEFAULT_BUFFER_COUNT );
+    }
+
+
+    /**
+     * Creates a new buffer.
+     *
+     * @param capacity the capacity of one buffer in bytes
+     *          = total allocated memory
+     *
+     * @param is the input stream
+     * @param direct if true, then direct ByteBuffers are used (zero-copy input of the decoder)
+     * @param count the number of buffers - at least 2 (one is being filled, one is being processed)
+     */
+    public BufferReader( int capacity, InputStream is, boolean direct, int count ) {
+        this( capacity, is, direct, count, null );
+    }
+
+
+    /**
+     * Creates a new buffer controlled by the jitter buffer.
+     *
+     * @param capacity the capacity of one buffer (chunk) in bytes - see JitterBuffer.getChunkBytes()
+     * @param is the input stream
+     * @param direct if true, then direct ByteBuffers are used (zero-copy input of the decoder)
+     * @param count the number of buffers - see JitterBuffer.getChunkCount()
+     * @param jitter the controller - may be null
+     */
+    public BufferReader( int capacity, InputStream is, boolean direct, int count, JitterBuffer jitter ) {
+        if (count < 2) throw new IllegalArgumentException( "At least 2 buffers needed: " + count );
+
         this.capacity = capacity;
         this.is = is;
 
-        Log.d( LOG, "init(): capacity=" + capacity );
+        Log.d( LOG, "init(): capacity=" + capacity + ", direct=" + direct + ", count=" + count );
+
+        if (is instanceof FileInputStream) fileChannel = ((FileInputStream) is).getChannel();
+
+        if (direct) {
+            // files are read straight into the direct memory:
+            channel = fileChannel != null ? fileChannel : Channels.newChannel( is );
+        }
 
-        buffers = new Buffer[3];
+        ring = new SPSCRing( count );
+        buffers = new Buffer[ count ];
 
         for (int i=0; i < buffers.length; i++) {
-            buffers[i] = new Buffer( capacity );
+            buffers[i] = new Buffer( capacity, direct );
         }
 
-        indexMine = 0;
-        indexBlocked = buffers.length-1;
+        this.jitter = jitter;
+        if (jitter != null) jitter.attach( ring );
     }
 
 
@@ -123,61 +283,126 @@ public class BufferReader implements Runnable {
     ////////////////////////////////////////////////////////////////////////////
 
     /**
-     * Changes the capacity of the buffer.
+     * Changes the capacity of the buffer - the buffers are reallocated by the reading thread.
+     * This is ignored if a JitterBuffer is attached - the chunks are fixed then.
      */
-    public synchronized void setCapacity( int capacity ) {
+    public void setCapacity( int capacity ) {
+        if (jitter != null) return;
+
         Log.d( LOG, "setCapacity(): " + capacity );
         this.capacity = capacity;
     }
 
 
+    /**
+     * Returns the jitter buffer controller or null.
+     */
+    public JitterBuffer getJitterBuffer() {
+        return jitter;
+    }
+
+
+    /**
+     * Sets how long the threads wait for a buffer before checking the stopped flag again.
+     * Both threads are woken by stop() - so long waits only save the idle wakeups
+     * (e.g. in the burst mode of AACPlayer).
+     *
+     * NOTE: this must be set BEFORE the execution thread is started.
+     */
+    public void setWaitMs( long waitMs ) {
+        this.waitMs = waitMs;
+    }
+
+
+    /**
+     * Returns how many times the reading thread and the consumer woke up:
+     * the reads of the stream and the waits for the ring (including the buffering consumer).
+     * @see PowerStats
+     */
+    public int getWakeups() {
+        return reads + ring.getWaits();
+    }
+
+
+    /**
+     * Returns the CPU time consumed by the reading thread in ns - updated after each buffer.
+     */
+    public long getCpuNanos() {
+        return cpuNanos;
+    }
+
+
     /**
      * The main loop.
      */
     public void run() {
         Log.d( LOG, "run() started...." );
 
-        int cap = capacity;
-        int total = 0;
+        SeekRequest applied = null;
+        boolean eof = false;
+        long cpuStarted = PowerStats.threadCpuNanos();
 
         while (!stopped) {
-            Buffer buffer = buffers[ indexMine ];
-            total = 0;
+            int index = ring.tryPut( waitMs );
+
+            if (index == -1) continue;
+
+            SeekRequest request = seekRequest;
 
-            if (cap != buffer.data.length) {
-                Log.d( LOG, "run() capacity changed: " + buffer.data.length + " -> " + cap);
-                buffers[ indexMine ] = buffer = null;
-                buffers[ indexMine ] = buffer = new Buffer( cap );
+            if (request != applied) {
+                applied = request;
+                eof = false;
+
+                try {
+                    fileChannel.position( request.offset );
+                }
+                catch (IOException e) {
+                    Log.e( LOG, "Exception when seeking: " + e );
+                    eof = true;
+                }
+            }
+
+            Buffer buffer = buffers[ index ];
+            int cap = capacity;
+            int total = 0;
+
+            if (cap != buffer.getCapacity()) {
+                Log.d( LOG, "run() capacity changed: " + buffer.getCapacity() + " -> " + cap);
+                buffers[ index ] = buffer = null;
+                buffers[ index ] = buffer = new Buffer( cap, channel != null );
             }
 
-            while (!stopped && total < cap) {
+            long tsFill = System.currentTimeMillis();
+
+            while (!stopped && !eof && total < cap) {
                 try {
-                    int n = is.read( buffer.data, total, cap - total );
+                    int n = channel != null ?
+                                readDirect( buffer.direct, total, cap ) :
+                                is.read( buffer.data, total, cap - total );
+
+                    reads++;
 
-                    if (n == -1) stopped = true;
+                    if (n == -1) eof = true;
                     else total += n;
                 }
                 catch (IOException e) {
                     Log.e( LOG, "Exception when reading: " + e );
-                    stopped = true;
+                    eof = true;
                 }
             }
 
+            if (jitter != null && total == cap) jitter.chunkArrived( System.currentTimeMillis() - tsFill );
+
             buffer.size = total;
+            buffer.generation = applied != null ? applied.generation : 0;
 
-            synchronized (this) {
-                notify();
-                int indexNew = (indexMine + 1) % buffers.length;
+            // the last (partial) buffer is passed before the stopped flag is set:
+            ring.put();
 
-                while (!stopped && indexNew == indexBlocked) {
-                    //Log.d( LOG, "run() waiting...." );
-                    try { wait(); } catch (InterruptedException e) {}
-                    //Log.d( LOG, "run() awaken" );
-                }
+            cpuNanos = PowerStats.threadCpuNanos() - cpuStarted;
 
-                indexMine = indexNew;
-                cap = capacity;
-            }
+            // seekable streams keep passing empty buffers until the next seek:
+            if (eof && fileChannel == null) stopped = true;
         }
 
         Log.d( LOG, "run() stopped." );
@@ -187,9 +412,52 @@ public class BufferReader implements Runnable {
     /**
      * Stops the thread - the object cannot be longer used.
      */
-    public synchronized void stop() {
+    public void stop() {
         stopped = true;
-        notify();
+        ring.wakeUp();
+    }
+
+
+    /**
+     * Returns true if the direct ByteBuffers are used.
+     */
+    public boolean isDirect() {
+        return channel != null;
+    }
+
+
+    /**
+     * Returns true if the stream is seekable (a file stream).
+     */
+    public boolean isSeekable() {
+        return fileChannel != null;
+    }
+
+
+    /**
+     * Repositions the stream. The buffers read so far are dropped -
+     * the next() method returns the data from the new position.
+     * This must be called by the consumer thread.
+     * The buffer last returned by next() cannot be used after this call.
+     * @param offset the byte offset from the beginning of the stream
+     * @return false if the stream is not seekable
+     */
+    public boolean seek( long offset ) {
+        if (fileChannel == null || stopped) return false;
+
+        Log.d( LOG, "seek(): " + offset );
+
+        seekRequest = new SeekRequest( offset, ++generation );
+
+        // the dropped buffers are not an underrun:
+        buffering = true;
+
+        if (taken != null) {
+            taken = null;
+            ring.take();
+        }
+
+        return true;
     }
 
 
@@ -203,25 +471,95 @@ public class BufferReader implements Runnable {
 
     /**
      * Returns next available buffer instance.
-     * The returned instance can be freely used by another thread.
+     * The returned instance can be freely used by another thread
+     * until this method is called again.
      * Blocks the caller until a buffer is ready.
+     * @return the buffer or null if stopped and no more buffers are available
      */
-    public synchronized Buffer next() {
-        int indexNew = (indexBlocked + 1) % buffers.length;
+    public Buffer next() {
+        // the previous buffer is returned back to the reading thread:
+        if (taken != null) {
+            taken = null;
+            ring.take();
+        }
+
+        for (;;) {
+            if (jitter != null) {
+                if (!buffering && ring.size() == 0 && !stopped) {
+                    jitter.underrun();
+                    Metrics.increment( Metrics.COUNTER_INPUT_UNDERRUNS );
+                    buffering = true;
+                }
+
+                if (buffering) waitBuffered();
+            }
+
+            int index = ring.tryTake();
+
+            if (index == -1) {
+                if (DEBUG) Log.d( LOG, "next() waiting...." );
+
+                for (;;) {
+                    // the last buffer is put before the flag is set:
+                    boolean wasStopped = stopped;
+
+                    index = ring.tryTake( waitMs );
+
+                    if (index != -1 || wasStopped) break;
+                }
+
+                if (DEBUG) Log.d( LOG, "next() awaken" );
+            }
+
+            if (index == -1) return null;
+
+            // the buffers read before the last seek are dropped (and not counted as buffered):
+            if (buffers[ index ].generation != generation) {
+                ring.take();
+                buffering = true;
+                continue;
+            }
 
-        while (!stopped && indexNew == indexMine) {
-            Log.d( LOG, "next() waiting...." );
-            try { wait(); } catch (InterruptedException e) {}
-            Log.d( LOG, "next() awaken" );
+            taken = buffers[ index ];
+
+            return taken;
         }
+    }
 
-        if (indexNew == indexMine) return null;
 
-        indexBlocked = indexNew;
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
 
-        notify();
+    /**
+     * Holds the consumer back until the target duration is buffered
+     * (or the pool is full or the reader stopped).
+     * The consumer is parked on the ring - each buffer put by the reading thread wakes it up.
+     */
+    private void waitBuffered() {
+        int target = jitter.getTargetChunks( buffers.length );
+
+        if (DEBUG) Log.d( LOG, "waitBuffered(): target=" + target + " chunks" );
+
+        for (;;) {
+            // the last buffer is put before the flag is set:
+            boolean wasStopped = stopped;
+
+            if (ring.awaitSize( target, waitMs ) || wasStopped) break;
+        }
+
+        buffering = false;
+    }
+
+    /**
+     * Reads data into the direct buffer.
+     * @return the number of bytes read or -1 on end of stream
+     */
+    private int readDirect( ByteBuffer bb, int offset, int limit ) throws IOException {
+        bb.limit( limit );
+        bb.position( offset );
 
-        return buffers[ indexBlocked ]; 
+        return channel.read( bb );
     }
 
 }
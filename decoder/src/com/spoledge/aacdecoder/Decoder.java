@@ -19,6 +19,10 @@
 */
 package com.spoledge.aacdecoder;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.ShortBuffer;
+
 
 /**
  * The decoder which calls native implementation(s).
@@ -41,6 +45,13 @@ public class Decoder {
 
         private short[] firstSamples;
 
+        private int duration;
+
+        private int startInitUs;
+        private int startReadUs;
+        private int startSyncUs;
+        private int startDecodeUs;
+
 
         ////////////////////////////////////////////////////////////////////////////
         // Public
@@ -118,6 +129,53 @@ public class Decoder {
         }
 
 
+        /**
+         * Returns the duration of the stream in samples per channel.
+         * @return the duration - known only for MP3 streams having the Xing / VBRI header
+         *      and for MP4 files, otherwise 0
+         */
+        public int getDuration() {
+            return duration;
+        }
+
+
+        /**
+         * Returns the time spent by start() getting the decoder's context.
+         * This is short if the context was pooled - see Decoder.prewarm().
+         * @return the time in microseconds
+         */
+        public int getStartInitUs() {
+            return startInitUs;
+        }
+
+
+        /**
+         * Returns the time spent by start() waiting for the first input buffer.
+         * @return the time in microseconds
+         */
+        public int getStartReadUs() {
+            return startReadUs;
+        }
+
+
+        /**
+         * Returns the time spent by start() searching for the first frame.
+         * @return the time in microseconds
+         */
+        public int getStartSyncUs() {
+            return startSyncUs;
+        }
+
+
+        /**
+         * Returns the time spent by start() configuring the decoder and decoding the first frame.
+         * @return the time in microseconds
+         */
+        public int getStartDecodeUs() {
+            return startDecodeUs;
+        }
+
+
         /**
          * Sets the first samples data.
          * This method can be used only for clearing memory.
@@ -128,8 +186,60 @@ public class Decoder {
     }
 
 
+    /**
+     * The OpenSL ES sink of the native output (Android 2.3+).
+     */
+    public static final String SINK_OPENSLES = "OpenSLES";
+
+    /**
+     * The sink of the native output which drops the samples (in real time).
+     */
+    public static final String SINK_NULL = "Null";
+
+    /**
+     * The sink of the native output which writes the samples into a WAV file.
+     */
+    public static final String SINK_WAV = "WAV";
+
+    /**
+     * The output format: 16-bit signed samples - decode( short[], int ).
+     */
+    public static final int OUTPUT_PCM_16 = 0;
+
+    /**
+     * The output format: 32-bit signed samples (full scale) - decode( int[], int ).
+     */
+    public static final int OUTPUT_PCM_32 = 1;
+
+    /**
+     * The output format: float samples in the range [-1.0, 1.0) - decode( float[], int ).
+     */
+    public static final int OUTPUT_FLOAT = 2;
+
+    /**
+     * The quality level: all the tools of the stream (HE-AACv2).
+     * @see setQuality(int)
+     */
+    public static final int QUALITY_FULL = 0;
+
+    /**
+     * The quality level: no parametric stereo (SBR only).
+     */
+    public static final int QUALITY_SBR = 1;
+
+    /**
+     * The quality level: no SBR - the core AAC at the half sampling rate.
+     */
+    public static final int QUALITY_CORE = 2;
+
+    /**
+     * The quality level: no SBR and the stereo downmixed into mono by the decoder.
+     */
+    public static final int QUALITY_MONO = 3;
+
     protected static int STATE_IDLE = 0;
     protected static int STATE_RUNNING = 1;
+    protected static int STATE_OUTPUT = 2;
 
     private static boolean libLoaded = false;
 
@@ -143,14 +253,26 @@ public class Decoder {
      * This is by default 0 - which means that the OpenCORE aacdec decoder is used.
      * Otherwise it must be set to a valid C pointer to a AACDDecoder struct.
      */
-    protected int decoder;
+    protected long decoder;
 
 
     /**
      * The decoding context pointer.
      * This is used between calls to C functions to kkep pointer to a C struct.
      */
-    protected int aacdw;
+    protected long aacdw;
+
+
+    /**
+     * The native output pointer or 0.
+     */
+    protected long aacdo;
+
+
+    /**
+     * The native HTTP stream owned by the decoder or null.
+     */
+    protected NativeHttpStream httpStream;
 
 
     /**
@@ -165,11 +287,35 @@ public class Decoder {
     protected Info info;
 
 
+    /**
+     * If true, then the samples are decoded directly into the Java array.
+     */
+    protected boolean criticalEnabled;
+
+
+    /**
+     * If true, then start() returns the first samples in the Info object.
+     */
+    protected boolean firstSamplesEnabled = true;
+
+
+    /**
+     * The output format of the stream - see OUTPUT_* constants.
+     */
+    protected int outputFormat = OUTPUT_PCM_16;
+
+
+    /**
+     * The quality level of the stream - see QUALITY_* constants.
+     */
+    protected int quality = QUALITY_FULL;
+
+
     ////////////////////////////////////////////////////////////////////////////
     // Constructors
     ////////////////////////////////////////////////////////////////////////////
 
-    protected Decoder( int decoder ) {
+    protected Decoder( long decoder ) {
         this.decoder = decoder;
     }
 
@@ -206,7 +352,7 @@ public class Decoder {
     public static Decoder createByName( String name ) {
         loadLibrary();
 
-        int aacdw = nativeDecoderGetByName( name );
+        long aacdw = nativeDecoderGetByName( name );
 
         return aacdw != 0 ? create( aacdw ) : null;
     }
@@ -217,25 +363,147 @@ public class Decoder {
      * @param decoder the poiter to a C struct AACDDecoder. 0 means that the default OpenCORE aacdec
      *      decoder will be used.
      */
-    public static synchronized Decoder create( int decoder ) {
+    public static synchronized Decoder create( long decoder ) {
         loadLibrary();
 
         return new Decoder( decoder );
     }
 
 
+    /**
+     * Releases all pooled decoders' contexts - see prewarm().
+     */
+    public static void clearPool() {
+        loadLibrary();
+
+        nativePoolClear();
+    }
+
+
+    /**
+     * Allocates a direct buffer which can be passed to the decode( ShortBuffer ) method.
+     * @param len the capacity in samples
+     */
+    public static ShortBuffer allocateDirectSamples( int len ) {
+        return ByteBuffer.allocateDirect( len * 2 ).order( ByteOrder.nativeOrder()).asShortBuffer();
+    }
+
+
+    /**
+     * Returns the flag if the samples are decoded directly into the Java array.
+     */
+    public boolean getCriticalEnabled() {
+        return criticalEnabled;
+    }
+
+
+    /**
+     * Sets the flag if the samples are decoded directly into the Java array.
+     * This saves one copy of the PCM data per decode() round, but the array
+     * is pinned while a part of the round is being decoded - the VM may
+     * postpone garbage collection until then.
+     * This is disabled by default.
+     */
+    public void setCriticalEnabled( boolean criticalEnabled ) {
+        this.criticalEnabled = criticalEnabled;
+    }
+
+
+    /**
+     * Returns the flag if start() returns the first samples in the Info object.
+     */
+    public boolean getFirstSamplesEnabled() {
+        return firstSamplesEnabled;
+    }
+
+
+    /**
+     * Sets the flag if start() returns the first samples in the Info object.
+     * If disabled, then no array is allocated and the first samples
+     * are returned by the first decoding round instead.
+     * This is enabled by default.
+     *
+     * NOTE: this should be set BEFORE the start() method is called.
+     */
+    public void setFirstSamplesEnabled( boolean firstSamplesEnabled ) {
+        this.firstSamplesEnabled = firstSamplesEnabled;
+    }
+
+
+    /**
+     * Prepares the decoder's context in advance - so the next start()
+     * does not allocate and initialize the codec.
+     * This can be called e.g. when the user is about to switch streams.
+     * The contexts of the stopped streams are pooled and reused automatically.
+     * @return false if the decoder does not support pooling
+     */
+    public boolean prewarm() {
+        return nativePrewarm( decoder );
+    }
+
+
     /**
      * Starts decoding stream.
+     * If the reader is seekable, then the frame index is built while decoding - see seek(long).
      */
     public Info start( BufferReader reader ) {
+        return start( reader, OUTPUT_PCM_16 );
+    }
+
+
+    /**
+     * Starts decoding stream in the given output format.
+     * The samples of the other formats than OUTPUT_PCM_16 are converted by the native code
+     * (the conversion is exact) and the first samples are returned by the first decoding round -
+     * not in the Info object.
+     * @param outputFormat see OUTPUT_* constants
+     */
+    public Info start( BufferReader reader, int outputFormat ) {
         if (state != STATE_IDLE) throw new IllegalStateException();
 
+        setOutputFormat( outputFormat );
+
         info = new Info();
 
-        aacdw = nativeStart( decoder, reader, info );
+        aacdw = nativeStart( decoder, reader, info, firstSamplesEnabled && outputFormat == OUTPUT_PCM_16, reader.isSeekable());
 
         if (aacdw == 0) throw new RuntimeException("Cannot start native decoder");
 
+        quality = QUALITY_FULL;
+        state = STATE_RUNNING;
+
+        return info;
+    }
+
+
+    /**
+     * Starts decoding a local file.
+     * The file is memory mapped and decoded in place - no BufferReader
+     * (and its thread) is needed. The stream is seekable - see seek(long).
+     * @param path the path of the file
+     */
+    public Info start( String path ) {
+        return start( path, OUTPUT_PCM_16 );
+    }
+
+
+    /**
+     * Starts decoding a local file in the given output format - see start( BufferReader, int ).
+     * @param path the path of the file
+     * @param outputFormat see OUTPUT_* constants
+     */
+    public Info start( String path, int outputFormat ) {
+        if (state != STATE_IDLE) throw new IllegalStateException();
+
+        setOutputFormat( outputFormat );
+
+        info = new Info();
+
+        aacdw = nativeStartFile( decoder, path, info, firstSamplesEnabled && outputFormat == OUTPUT_PCM_16 );
+
+        if (aacdw == 0) throw new RuntimeException("Cannot start native decoder for file " + path);
+
+        quality = QUALITY_FULL;
         state = STATE_RUNNING;
 
         return info;
@@ -249,16 +517,259 @@ public class Decoder {
     public Info decode( short[] samples, int outLen ) {
         if (state != STATE_RUNNING) throw new IllegalStateException();
 
-        nativeDecode( aacdw, samples, outLen );
+        if (criticalEnabled) nativeDecodeCritical( aacdw, samples, outLen );
+        else nativeDecode( aacdw, samples, outLen );
 
         return info;
     }
 
 
+    /**
+     * Decodes stream into float samples - the stream must be started with OUTPUT_FLOAT.
+     * This saves the conversion of the 16-bit samples in Java (e.g. for effects).
+     * @return the number of samples produced (totally all channels = the length of the filled array)
+     */
+    public Info decode( float[] samples, int outLen ) {
+        checkOutputFormat( OUTPUT_FLOAT, samples.length, outLen );
+
+        nativeDecodePCM( aacdw, samples, outLen, OUTPUT_FLOAT );
+
+        return info;
+    }
+
+
+    /**
+     * Decodes stream into 32-bit samples - the stream must be started with OUTPUT_PCM_32.
+     * @return the number of samples produced (totally all channels = the length of the filled array)
+     */
+    public Info decode( int[] samples, int outLen ) {
+        checkOutputFormat( OUTPUT_PCM_32, samples.length, outLen );
+
+        nativeDecodePCM( aacdw, samples, outLen, OUTPUT_PCM_32 );
+
+        return info;
+    }
+
+
+    /**
+     * Decodes stream and stores the statistics of each frame.
+     * The round is finished when the array is (almost) filled or when
+     * the stats capacity is reached.
+     * Unlike decode() this method does not update the Info object -
+     * all the round's values can be computed from the stats.
+     * @return the number of frames decoded
+     */
+    public int decodeFrames( short[] samples, int outLen, FrameStats stats ) {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+
+        int n = nativeDecodeFrames( aacdw, samples, outLen, stats.getBlock(), criticalEnabled );
+
+        stats.setFrames( n > 0 ? n : 0 );
+
+        return stats.getFrames();
+    }
+
+
+    /**
+     * Decodes stream directly into a direct buffer.
+     * The buffer is filled from the beginning up to its capacity (at most).
+     * After the call the position is 0 and the limit is the number of samples produced.
+     * @param samples the direct buffer in the native byte order - see allocateDirectSamples(int)
+     */
+    public Info decode( ShortBuffer samples ) {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+        if (!samples.isDirect()) throw new IllegalArgumentException( "Not a direct buffer" );
+
+        int n = nativeDecodeDirect( aacdw, samples, samples.capacity());
+
+        samples.clear();
+        samples.limit( n > 0 ? n : 0 );
+
+        return info;
+    }
+
+
+    /**
+     * Seeks to the frame containing the sample position.
+     * The next decoding round starts with that frame.
+     * Seeking is possible only if the BufferReader is seekable (local files).
+     * The positions already decoded are found by the frame index, the others by walking
+     * the frame headers (without decoding). MP3 streams having the Xing / VBRI header
+     * jump far ahead by its table of contents - such positions are only approximate.
+     * MP4 files are located exactly by the sample index of the container.
+     * @param samplePosition the position in samples per channel
+     * @return the actual position (the start of the frame) or -1 if not supported / failed
+     */
+    public long seek( long samplePosition ) {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+
+        return nativeSeek( aacdw, samplePosition );
+    }
+
+
+    /**
+     * Switches the quality level in the middle of the stream - to save power (battery saver).
+     * The next decoding round contains only the frames of the new level;
+     * the sampling rate and the channels may change - see getCurrentSampleRate()
+     * and getCurrentChannels(). The positions (seek) stay in the sampling rate of Info.
+     * The decoder may not support all the levels - e.g. OpenCORE cannot skip
+     * the parametric stereo alone and the MP3 decoder supports the full quality only.
+     * @param quality see QUALITY_* constants
+     * @return the level actually used
+     */
+    public int setQuality( int quality ) {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+        if (quality < QUALITY_FULL || quality > QUALITY_MONO) throw new IllegalArgumentException( "Unknown quality: " + quality );
+
+        this.quality = nativeSetQuality( aacdw, quality );
+
+        return this.quality;
+    }
+
+
+    /**
+     * Returns the quality level actually used.
+     */
+    public int getQuality() {
+        return quality;
+    }
+
+
+    /**
+     * Returns the current sampling rate of the decoded samples.
+     * It differs from Info.getSampleRate() if the quality level halves it.
+     * A level raised by setQuality(int) may change it only after the next decoding round.
+     */
+    public int getCurrentSampleRate() {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+
+        return nativeSampleRate( aacdw );
+    }
+
+
+    /**
+     * Returns the current number of channels of the decoded samples.
+     */
+    public int getCurrentChannels() {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+
+        return nativeChannels( aacdw );
+    }
+
+
+    /**
+     * Starts the native output - the stream is decoded and played by native threads,
+     * no samples pass through Java. The decode() methods cannot be called
+     * until the output is stopped.
+     * @param sink the name of the sink - see SINK_* constants
+     * @param param the sink's parameter (e.g. the file name of the WAV sink) or null
+     * @param bufferMs the capacity of the native PCM buffer in ms
+     */
+    public void startOutput( String sink, String param, int bufferMs ) {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+
+        aacdo = nativeOutputStart( aacdw, sink, param, bufferMs );
+
+        if (aacdo == 0) throw new RuntimeException("Cannot start native output: " + sink);
+
+        state = STATE_OUTPUT;
+    }
+
+
+    /**
+     * Waits until the native output plays all samples.
+     * @param timeoutMs the max time to wait
+     * @return true if all the samples were played
+     */
+    public boolean waitOutput( int timeoutMs ) {
+        if (state != STATE_OUTPUT) throw new IllegalStateException();
+
+        return nativeOutputWait( aacdo, timeoutMs );
+    }
+
+
+    /**
+     * Returns the number of samples decoded by the native output and not played yet.
+     */
+    public int getOutputBuffered() {
+        return aacdo != 0 ? nativeOutputBuffered( aacdo ) : 0;
+    }
+
+
+    /**
+     * Returns how many times the native output had no samples to play.
+     */
+    public int getOutputUnderruns() {
+        return aacdo != 0 ? nativeOutputUnderruns( aacdo ) : 0;
+    }
+
+
+    /**
+     * Starts decoding a native HTTP stream.
+     * The stream is received directly into the decoder - no BufferReader
+     * (and its thread) is needed. The decoder owns the stream from now on:
+     * it is closed by stop(). The stream is seekable if the server supports Range requests.
+     * @param stream the opened stream
+     */
+    public Info start( NativeHttpStream stream ) {
+        return start( stream, OUTPUT_PCM_16 );
+    }
+
+
+    /**
+     * Starts decoding a native HTTP stream in the given output format - see start( BufferReader, int ).
+     * @param stream the opened stream
+     * @param outputFormat see OUTPUT_* constants
+     */
+    public Info start( NativeHttpStream stream, int outputFormat ) {
+        if (state != STATE_IDLE) throw new IllegalStateException();
+
+        setOutputFormat( outputFormat );
+
+        info = new Info();
+
+        aacdw = nativeStartHttp( decoder, stream.attach(), info, firstSamplesEnabled && outputFormat == OUTPUT_PCM_16 );
+
+        // the native stream is freed even if the decoder cannot start:
+        if (aacdw == 0) {
+            stream.detach();
+            throw new RuntimeException("Cannot start native decoder for the HTTP stream");
+        }
+
+        httpStream = stream;
+        quality = QUALITY_FULL;
+        state = STATE_RUNNING;
+
+        return info;
+    }
+
+
+    /**
+     * Stops the native output immediately.
+     * The BufferReader should be stopped before, otherwise this call may block
+     * until the reader returns the next buffer.
+     */
+    public void stopOutput() {
+        if (aacdo != 0) {
+            nativeOutputStop( aacdo );
+            aacdo = 0;
+            state = STATE_RUNNING;
+        }
+    }
+
+
     /**
      * Stops the decoder and releases all resources.
      */
     public void stop() {
+        stopOutput();
+
+        // the stream must not be polled after it is freed:
+        if (httpStream != null) {
+            httpStream.detach();
+            httpStream = null;
+        }
+
         if (aacdw != 0) {
             nativeStop( aacdw );
             aacdw = 0;
@@ -288,13 +799,48 @@ public class Decoder {
     ////////////////////////////////////////////////////////////////////////////
 
 
+    private void setOutputFormat( int outputFormat ) {
+        if (outputFormat < OUTPUT_PCM_16 || outputFormat > OUTPUT_FLOAT) {
+            throw new IllegalArgumentException( "Unknown output format: " + outputFormat );
+        }
+
+        this.outputFormat = outputFormat;
+    }
+
+
+    private void checkOutputFormat( int outputFormat, int capacity, int outLen ) {
+        if (state != STATE_RUNNING) throw new IllegalStateException();
+        if (this.outputFormat != outputFormat) throw new IllegalStateException( "The stream was started with output format " + this.outputFormat );
+        if (outLen > capacity) throw new IllegalArgumentException( "outLen exceeds the array" );
+    }
+
+
     /**
      * Actually starts decoding the stream.
      * Detects the stream type.
      * @param decoder the pointer to the C struct AACDDecoder or NULL
+     * @param firstSamples if false, the first samples are returned by the first decoding round
+     * @param seekable if true, then the frame index is built
      * @return the pointer to the C struct
      */
-    protected native int nativeStart( int decoder, BufferReader reader, Info info );
+    protected native long nativeStart( long decoder, BufferReader reader, Info info, boolean firstSamples, boolean seekable );
+
+
+    /**
+     * Actually starts decoding the memory mapped file.
+     * @param decoder the pointer to the C struct AACDDecoder or NULL
+     * @return the pointer to the C struct or 0 if the file cannot be mapped / decoded
+     */
+    protected native long nativeStartFile( long decoder, String path, Info info, boolean firstSamples );
+
+
+    /**
+     * Actually starts decoding the native HTTP stream - it is closed by nativeStop().
+     * @param decoder the pointer to the C struct AACDDecoder or NULL
+     * @param aacdh the pointer to the C struct AACDHttp
+     * @return the pointer to the C struct or 0 if the stream cannot be decoded
+     */
+    protected native long nativeStartHttp( long decoder, long aacdh, Info info, boolean firstSamples );
 
 
     /**
@@ -302,21 +848,136 @@ public class Decoder {
      * Calls back Java method BufferReader.next() when additional input is needed.
      * @param aacdw the pointer to the C struct
      */
-    protected native int nativeDecode( int aacdw, short[] samples, int outLen );
+    protected native int nativeDecode( long aacdw, short[] samples, int outLen );
+
+
+    /**
+     * Actually decodes a chunk of data directly into the Java array.
+     * The array is accessed as a critical region which is released
+     * when BufferReader.next() is called back.
+     * @param aacdw the pointer to the C struct
+     */
+    protected native int nativeDecodeCritical( long aacdw, short[] samples, int outLen );
+
+
+    /**
+     * Actually decodes a chunk of data directly into the direct buffer.
+     * Calls back Java method BufferReader.next() when additional input is needed.
+     * @param aacdw the pointer to the C struct
+     * @return the number of samples produced or -1 if the buffer is not direct
+     */
+    protected native int nativeDecodeDirect( long aacdw, ShortBuffer samples, int outLen );
+
+
+    /**
+     * Actually decodes a chunk of data and converts the samples into the output format.
+     * Calls back Java method BufferReader.next() when additional input is needed.
+     * @param aacdw the pointer to the C struct
+     * @param samples float[] or int[] - matching the format
+     * @param format see OUTPUT_* constants
+     */
+    protected native int nativeDecodePCM( long aacdw, Object samples, int outLen, int format );
+
+
+    /**
+     * Actually decodes a chunk of data and stores the per-frame statistics.
+     * @param aacdw the pointer to the C struct
+     * @param stats the direct buffer holding the native struct AACDFrameStats array
+     * @param critical if true, then the samples are decoded directly into the Java array
+     * @return the number of frames decoded or -1 if the stats buffer is not direct
+     */
+    protected native int nativeDecodeFrames( long aacdw, short[] samples, int outLen, ByteBuffer stats, boolean critical );
+
+
+    /**
+     * Actually starts the native output.
+     * @param aacdw the pointer to the C struct
+     * @return the pointer to the C struct AACDOutput or 0
+     */
+    protected native long nativeOutputStart( long aacdw, String sink, String param, int bufferMs );
+
+
+    /**
+     * Actually waits for the native output.
+     * @param aacdo the pointer to the C struct AACDOutput
+     */
+    protected native boolean nativeOutputWait( long aacdo, int timeoutMs );
+
+
+    /**
+     * Returns the number of samples buffered by the native output.
+     * @param aacdo the pointer to the C struct AACDOutput
+     */
+    protected native int nativeOutputBuffered( long aacdo );
+
+
+    /**
+     * Returns the number of underruns of the native output.
+     * @param aacdo the pointer to the C struct AACDOutput
+     */
+    protected native int nativeOutputUnderruns( long aacdo );
+
+
+    /**
+     * Actually stops the native output.
+     * @param aacdo the pointer to the C struct AACDOutput
+     */
+    protected native void nativeOutputStop( long aacdo );
+
+
+    /**
+     * Actually seeks.
+     * Calls back Java method BufferReader.seek() and next().
+     * @param aacdw the pointer to the C struct
+     * @return the actual position or -1
+     */
+    protected native long nativeSeek( long aacdw, long samplePosition );
+
+
+    /**
+     * Actually switches the quality level.
+     * @return the level actually used
+     */
+    protected native int nativeSetQuality( long aacdw, int quality );
+
+
+    /**
+     * Returns the current sampling rate.
+     */
+    protected native int nativeSampleRate( long aacdw );
+
+
+    /**
+     * Returns the current number of channels.
+     */
+    protected native int nativeChannels( long aacdw );
 
 
     /**
      * Actually stops decoding - releases all resources.
      * @param aacdw the pointer to the C struct
      */
-    protected native void nativeStop( int aacdw );
+    protected native void nativeStop( long aacdw );
+
+
+    /**
+     * Actually prepares the pooled context.
+     * @param decoder the pointer to the C struct AACDDecoder or NULL
+     */
+    protected static native boolean nativePrewarm( long decoder );
+
+
+    /**
+     * Actually releases the pooled contexts.
+     */
+    protected static native void nativePoolClear();
 
 
     /**
      * Returns the decoder pointer struct or NULL.
      * @param name the name of the decoder
      */
-    protected static native int nativeDecoderGetByName( String name );
+    protected static native long nativeDecoderGetByName( String name );
 
 
 }
@@ -0,0 +1,245 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+
+/**
+ * The engine decoding many streams by a fixed pool of native worker threads.
+ * Unlike Decoder, the streams do not read the input - the caller pushes
+ * the encoded data and pulls the decoded samples, none of the calls blocks:
+ * <pre>
+ *  DecoderEngine engine = DecoderEngine.create( 2 );
+ *  DecoderEngine.Stream stream = engine.open( 0, 65536, 32768 );
+ *
+ *  stream.feed( data, 0, len );    // returns the number of bytes accepted
+ *  ...
+ *  stream.eof();
+ *
+ *  int n = stream.read( samples ); // 0 if nothing is decoded yet
+ *  ...
+ *  stream.close();
+ *  engine.destroy();
+ * </pre>
+ * Each stream can be fed and read by a different thread, but one stream
+ * must not be fed (or read) by two threads at once.
+ */
+public class DecoderEngine {
+
+    /**
+     * The stream is waiting for enough input to start the decoder.
+     */
+    public static final int STATE_STARTING = 0;
+
+    /**
+     * The stream is being decoded.
+     */
+    public static final int STATE_RUNNING = 1;
+
+    /**
+     * All the input was decoded - the rest of the samples can be read.
+     */
+    public static final int STATE_FINISHED = 2;
+
+    /**
+     * The decoder cannot start or decode the stream.
+     */
+    public static final int STATE_ERROR = 3;
+
+
+    /**
+     * One stream decoded by the engine.
+     */
+    public final class Stream {
+
+        /**
+         * The native stream pointer.
+         */
+        private long aacds;
+
+
+        private Stream( long aacds ) {
+            this.aacds = aacds;
+        }
+
+
+        /**
+         * Appends the encoded data.
+         * @return the number of bytes accepted - less than len if the input buffer is full
+         * @throws ArrayIndexOutOfBoundsException if off / len are outside of the array
+         */
+        public int feed( byte[] data, int off, int len ) {
+            if (aacds == 0) throw new IllegalStateException();
+
+            // the native side copies from the pinned array without any checks:
+            if (off < 0 || len < 0 || off > data.length - len) {
+                throw new ArrayIndexOutOfBoundsException( "off=" + off + ", len=" + len + ", length=" + data.length );
+            }
+
+            return nativeFeed( aacds, data, off, len );
+        }
+
+
+        /**
+         * Marks the end of the input.
+         */
+        public void eof() {
+            if (aacds == 0) throw new IllegalStateException();
+
+            nativeEof( aacds );
+        }
+
+
+        /**
+         * Takes the decoded samples.
+         * @return the number of samples copied (0 if nothing is decoded now)
+         */
+        public int read( short[] samples ) {
+            if (aacds == 0) throw new IllegalStateException();
+
+            return nativeRead( aacds, samples, samples.length );
+        }
+
+
+        /**
+         * Returns the state - see the STATE_* constants.
+         */
+        public int getState() {
+            return aacds != 0 ? nativeState( aacds ) : STATE_FINISHED;
+        }
+
+
+        /**
+         * Returns the sampling rate in Hz.
+         * @return the sampling rate or 0 if the stream is not started yet
+         */
+        public int getSampleRate() {
+            return aacds != 0 ? nativeSampleRate( aacds ) : 0;
+        }
+
+
+        /**
+         * Returns the number of channels.
+         * @return the channels or 0 if the stream is not started yet
+         */
+        public int getChannels() {
+            return aacds != 0 ? nativeChannels( aacds ) : 0;
+        }
+
+
+        /**
+         * Closes the stream - its native resources are released by the engine.
+         */
+        public void close() {
+            if (aacds != 0) {
+                nativeClose( aacds );
+                aacds = 0;
+            }
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Attributes
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * The native engine pointer.
+     */
+    private long aacde;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    private DecoderEngine( long aacde ) {
+        this.aacde = aacde;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Creates the engine and starts the workers.
+     * @param workers the number of worker threads - e.g. the number of CPU cores
+     */
+    public static DecoderEngine create( int workers ) {
+        Decoder.loadLibrary();
+
+        long aacde = nativeCreate( workers );
+
+        if (aacde == 0) throw new RuntimeException("Cannot start native decoder engine");
+
+        return new DecoderEngine( aacde );
+    }
+
+
+    /**
+     * Opens a new stream.
+     * @param decoder the pointer to a C struct AACDDecoder - see Decoder.create( long ); 0 means OpenCORE aacdec
+     * @param inputCapacity the capacity of the input buffer in bytes
+     * @param outputCapacity the capacity of the output buffer in samples
+     */
+    public synchronized Stream open( long decoder, int inputCapacity, int outputCapacity ) {
+        if (aacde == 0) throw new IllegalStateException();
+
+        return new Stream( nativeOpen( aacde, decoder, inputCapacity, outputCapacity ));
+    }
+
+
+    /**
+     * Stops the workers.
+     * All the streams must be closed before.
+     */
+    public synchronized void destroy() {
+        if (aacde != 0) {
+            nativeDestroy( aacde );
+            aacde = 0;
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
+
+    private static native long nativeCreate( int workers );
+
+    private static native void nativeDestroy( long aacde );
+
+    private static native long nativeOpen( long aacde, long decoder, int inputCapacity, int outputCapacity );
+
+    private static native int nativeFeed( long aacds, byte[] data, int off, int len );
+
+    private static native void nativeEof( long aacds );
+
+    private static native int nativeRead( long aacds, short[] samples, int len );
+
+    private static native int nativeState( long aacds );
+
+    private static native int nativeSampleRate( long aacds );
+
+    private static native int nativeChannels( long aacds );
+
+    private static native void nativeClose( long aacds );
+
+}
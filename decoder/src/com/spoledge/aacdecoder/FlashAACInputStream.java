@@ -15,6 +15,12 @@ import java.io.*;
 import java.net.URL;
 import java.net.URLConnection;
 
+/**
+ * Converts the FLV stream into the ADTS stream.
+ * @deprecated FlashAACPlayer does not use this class anymore - the FLV stream
+ *      is parsed natively by the "OpenCORE-FLV" decoder (no ADTS headers are synthesized).
+ */
+@Deprecated
 public class FlashAACInputStream extends InputStream {
     private DataInputStream dis = null;
     private int countInBackBuffer = 0;
@@ -1,23 +1,39 @@
 package com.spoledge.aacdecoder;
 
-import com.spoledge.aacdecoder.FlashAACInputStream;
-
 import android.util.Log;
 
-import java.io.FileInputStream;
-import java.io.InputStream;
-import java.io.IOException;
-
-import java.net.URL;
-import java.net.URLConnection;
 
+/**
+ * This is the player of AAC streams wrapped in FLV (Flash Video).
+ * The FLV tags are parsed natively by the "OpenCORE-FLV" decoder: the raw AAC frames
+ * and the AudioSpecificConfig are passed to the decoder directly (no ADTS headers
+ * are synthesized) and the video and script data tags are skipped.
+ * Seeking is not supported.
+ * This class is not thread safe.
+ * <pre>
+ *  FlashAACPlayer player = new FlashAACPlayer();
+ *
+ *  String url = ...;
+ *  player.playAsync( url );
+ * </pre>
+ */
 public class FlashAACPlayer extends AACPlayer {
-    private InputStream istream = null;
 
+    private static final String LOG = "FlashAACPlayer";
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Creates a new player.
+     */
     public FlashAACPlayer() {
         this( null );
     }
 
+
     /**
      * Creates a new player.
      * @param playerCallback the callback, can be null
@@ -36,30 +52,26 @@ public class FlashAACPlayer extends AACPlayer {
      * @see setDecodeBufferCapacityMs(int)
      */
     public FlashAACPlayer( PlayerCallback playerCallback, int audioBufferCapacityMs, int decodeBufferCapacityMs ) {
-        setPlayerCallback( playerCallback );
-        setAudioBufferCapacityMs( audioBufferCapacityMs );
-        setDecodeBufferCapacityMs( decodeBufferCapacityMs );
-
-        decoder = createDecoder();
+        super( playerCallback, audioBufferCapacityMs, decodeBufferCapacityMs );
     }
 
-    /** 
-     * Plays a stream synchronously. 
-     * @param url the URL of the stream or file 
-     * @param expectedKBitSecRate the expected average bitrate in kbit/sec; -1 means unknown 
-     */ 
-    public void play( String url, int expectedKBitSecRate ) throws Exception { 
-        if (url.indexOf( ':' ) > 0) { 
-            URLConnection cn = new URL( url ).openConnection(); 
-            cn.connect(); 
- 
-            dumpHeaders( cn ); 
-            istream = cn.getInputStream();
-            FlashAACInputStream flvStream = new FlashAACInputStream(istream);
-
-            // TODO: try to get the expectedKBitSecRate from headers 
-            play(flvStream, expectedKBitSecRate); 
-        } 
-        else play( new FileInputStream( url ), expectedKBitSecRate ); 
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Protected
+    ////////////////////////////////////////////////////////////////////////////
+
+    @Override
+    protected Decoder createDecoder() {
+        String name = "OpenCORE-FLV";
+
+        Decoder ret = Decoder.createByName( name );
+
+        if (ret == null) {
+            Log.e( LOG, "Cannot find decoder by name '" + name + "'");
+            throw new RuntimeException("FLV Decoder not found");
+        }
+
+        return ret;
     }
+
 }
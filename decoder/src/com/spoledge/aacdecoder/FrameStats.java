@@ -0,0 +1,167 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.IntBuffer;
+
+
+/**
+ * Per-frame statistics filled by Decoder.decodeFrames().
+ * The native decoder writes the statistics directly into a direct buffer,
+ * so no JNI calls are needed to pass them to Java.
+ * <pre>
+ *  FrameStats stats = new FrameStats( 64 );
+ *
+ *  while (decoder.decodeFrames( samples, samples.length, stats ) > 0) {
+ *      int n = stats.getTotalSamples();
+ *      ...
+ *  }
+ * </pre>
+ */
+public final class FrameStats {
+
+    /**
+     * The frame was preceded by a decoding error - some input bytes were skipped.
+     */
+    public static final int FLAG_RESYNC = 0x01;
+
+    /**
+     * The frame was decoded by the Decoder.start() method.
+     */
+    public static final int FLAG_FIRST = 0x02;
+
+    /**
+     * The number of ints per frame - the layout of the native struct AACDFrameStats.
+     */
+    private static final int INTS_PER_FRAME = 4;
+
+    private ByteBuffer block;
+    private IntBuffer ints;
+    private int frames;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Creates a new stats block.
+     * @param capacity the maximum number of frames decoded by one decodeFrames() call
+     */
+    public FrameStats( int capacity ) {
+        block = ByteBuffer.allocateDirect( capacity * INTS_PER_FRAME * 4 ).order( ByteOrder.nativeOrder());
+        ints = block.asIntBuffer();
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Returns the maximum number of frames.
+     */
+    public int getCapacity() {
+        return ints.capacity() / INTS_PER_FRAME;
+    }
+
+
+    /**
+     * Returns the number of frames decoded by the last decodeFrames() call.
+     */
+    public int getFrames() {
+        return frames;
+    }
+
+
+    /**
+     * Returns the stream offset of the frame (the lower 32 bits).
+     */
+    public int getOffset( int frame ) {
+        return ints.get( frame * INTS_PER_FRAME );
+    }
+
+
+    /**
+     * Returns the number of bytes consumed by the frame.
+     */
+    public int getBytesConsumed( int frame ) {
+        return ints.get( frame * INTS_PER_FRAME + 1 );
+    }
+
+
+    /**
+     * Returns the number of samples (all channels) produced by the frame.
+     */
+    public int getSamples( int frame ) {
+        return ints.get( frame * INTS_PER_FRAME + 2 );
+    }
+
+
+    /**
+     * Returns the FLAG_* flags of the frame.
+     */
+    public int getFlags( int frame ) {
+        return ints.get( frame * INTS_PER_FRAME + 3 );
+    }
+
+
+    /**
+     * Returns the number of bytes consumed by all frames.
+     */
+    public int getTotalBytesConsumed() {
+        int ret = 0;
+
+        for (int i=0; i < frames; i++) ret += getBytesConsumed( i );
+
+        return ret;
+    }
+
+
+    /**
+     * Returns the number of samples produced by all frames
+     * = the length of the filled array.
+     */
+    public int getTotalSamples() {
+        int ret = 0;
+
+        for (int i=0; i < frames; i++) ret += getSamples( i );
+
+        return ret;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Package
+    ////////////////////////////////////////////////////////////////////////////
+
+    ByteBuffer getBlock() {
+        return block;
+    }
+
+
+    void setFrames( int frames ) {
+        this.frames = frames;
+    }
+
+}
+
@@ -211,6 +211,17 @@ public class IcyInputStream extends FilterInputStream {
      * @param s the metadata string like: StreamTitle='...';StreamUrl='...';
      */
     protected void parseMetadata( String s ) {
+        parseMetadata( s, playerCallback );
+    }
+
+
+    /**
+     * Parses the metadata and sends them to PlayerCallback.
+     * This is shared with the native HTTP stream which strips the metadata itself.
+     * @param s the metadata string like: StreamTitle='...';StreamUrl='...';
+     * @param playerCallback the callback - may be null
+     */
+    public static void parseMetadata( String s, PlayerCallback playerCallback ) {
         String[] kvs = s.split( ";" );
 
         for (String kv : kvs) {
@@ -0,0 +1,308 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+import android.util.Log;
+
+
+/**
+ * The adaptive jitter buffer controller of the BufferReader.
+ * The reader uses a fixed pool of equally sized chunks (nothing is reallocated) and this
+ * controller decides how much of the stream must be buffered before the decoder is allowed
+ * to continue - at the start, after seeking and after an underrun (the decoder found no chunk):
+ * <pre>
+ *  JitterBuffer jitter = new JitterBuffer();
+ *  jitter.start( 128 );    // the expected bitrate in kbit/sec
+ *
+ *  BufferReader reader = new BufferReader( jitter.getChunkBytes(), is, false, jitter.getChunkCount(), jitter );
+ *  ...
+ *  int target = jitter.getTargetMs();
+ *  int buffered = jitter.getBufferedMs();
+ *  int underruns = jitter.getUnderruns();
+ * </pre>
+ * The target is derived from the arrival jitter - the mean lateness of the chunks relative
+ * to their playing time (the RFC 3550 estimator) - plus a boost which is doubled by every underrun
+ * and decays after a period without underruns. So good networks start with the minimum latency
+ * and bad networks stop rebuffering.
+ * The learned jitter and boost are kept by start(), so the controller can be reused for
+ * the next streams. The getters can be called by any thread.
+ */
+public class JitterBuffer {
+
+    /**
+     * The default minimum target - the start latency on good networks.
+     */
+    public static final int DEFAULT_MIN_MS = 400;
+
+    /**
+     * The default maximum target.
+     */
+    public static final int DEFAULT_MAX_MS = 8000;
+
+    /**
+     * The default playing time of one chunk.
+     */
+    public static final int DEFAULT_CHUNK_MS = 200;
+
+    /**
+     * The target covers this multiple of the jitter.
+     */
+    private static final int JITTER_FACTOR = 4;
+
+    /**
+     * The gain of the jitter estimator: 1/16 as in RFC 3550.
+     */
+    private static final float JITTER_GAIN = 1f / 16;
+
+    /**
+     * The boost decays by SHRINK_PERCENT after each period without underruns.
+     */
+    private static final long SHRINK_PERIOD_MS = 30000;
+    private static final int SHRINK_PERCENT = 25;
+
+    private static String LOG = "JitterBuffer";
+
+    private final int minMs;
+    private final int maxMs;
+    private final int chunkMs;
+
+    private int chunkBytes;
+    private int chunkCount;
+
+    /**
+     * The stream bitrate in bytes per second - updated by the consumer.
+     */
+    private volatile int byteRate;
+
+    /**
+     * The jitter estimate - updated only by the reading thread.
+     */
+    private volatile float jitterMs;
+
+    /**
+     * The underrun boost - updated only by the consumer.
+     */
+    private volatile int boostMs;
+    private volatile long boostChangedMs;
+
+    private volatile int underruns;
+
+    /**
+     * The ring of the filled chunks - set by the BufferReader.
+     */
+    private volatile SPSCRing ring;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Creates a new controller with the default limits.
+     */
+    public JitterBuffer() {
+        this( DEFAULT_MIN_MS, DEFAULT_MAX_MS, DEFAULT_CHUNK_MS );
+    }
+
+
+    /**
+     * Creates a new controller.
+     * @param minMs the minimum target - the start latency on good networks
+     * @param maxMs the maximum target - it also determines the size of the chunk pool
+     * @param chunkMs the playing time of one chunk at the expected bitrate
+     */
+    public JitterBuffer( int minMs, int maxMs, int chunkMs ) {
+        if (chunkMs <= 0 || minMs < chunkMs || maxMs < minMs) {
+            throw new IllegalArgumentException( "Invalid limits: min=" + minMs + ", max=" + maxMs + ", chunk=" + chunkMs );
+        }
+
+        this.minMs = minMs;
+        this.maxMs = maxMs;
+        this.chunkMs = chunkMs;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Prepares the controller for a new stream - computes the chunk pool.
+     * The learned jitter and boost are kept, the underrun counter is reset.
+     * @param kBitSecRate the expected bitrate in kbit/sec
+     */
+    public void start( int kBitSecRate ) {
+        setKBitSecRate( kBitSecRate );
+
+        chunkBytes = Math.max( byteRate * chunkMs / 1000, 512 );
+
+        // the consumer holds one chunk, the reader fills another one:
+        chunkCount = (maxMs + chunkMs - 1) / chunkMs + 2;
+
+        underruns = 0;
+        ring = null;
+
+        Log.d( LOG, "start(): chunk=" + chunkBytes + " bytes, count=" + chunkCount + ", target=" + getTargetMs() + " ms" );
+    }
+
+
+    /**
+     * Updates the bitrate used to convert the buffered bytes into the playing time.
+     * The chunks are not reallocated.
+     */
+    public void setKBitSecRate( int kBitSecRate ) {
+        if (kBitSecRate > 0) byteRate = kBitSecRate * 1000 / 8;
+    }
+
+
+    /**
+     * Returns the size of one chunk in bytes.
+     */
+    public int getChunkBytes() {
+        return chunkBytes;
+    }
+
+
+    /**
+     * Returns the number of chunks needed to buffer the maximum target.
+     */
+    public int getChunkCount() {
+        return chunkCount;
+    }
+
+
+    public int getMinMs() {
+        return minMs;
+    }
+
+
+    public int getMaxMs() {
+        return maxMs;
+    }
+
+
+    /**
+     * Returns the buffered duration the decoder waits for after an underrun.
+     */
+    public int getTargetMs() {
+        int ret = Math.max( minMs, (int)(JITTER_FACTOR * jitterMs) ) + getBoostMs();
+
+        return ret < maxMs ? ret : maxMs;
+    }
+
+
+    /**
+     * Returns the duration of the chunks ready to be decoded.
+     */
+    public int getBufferedMs() {
+        SPSCRing r = ring;
+        int rate = byteRate;
+
+        return r != null && rate > 0 ? (int)(1000L * r.size() * chunkBytes / rate) : 0;
+    }
+
+
+    /**
+     * Returns the current jitter estimate.
+     */
+    public int getJitterMs() {
+        return (int) jitterMs;
+    }
+
+
+    /**
+     * Returns the number of underruns of the current stream.
+     */
+    public int getUnderruns() {
+        return underruns;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Package - called by the BufferReader
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Attaches the ring of the reader.
+     */
+    void attach( SPSCRing ring ) {
+        this.ring = ring;
+    }
+
+
+    /**
+     * Called by the reading thread when a whole chunk was read.
+     * @param fillMs how long the reading took (not waiting for a free chunk)
+     */
+    void chunkArrived( long fillMs ) {
+        int rate = byteRate;
+
+        if (rate <= 0) return;
+
+        // only the late chunks count - a fast network has no jitter:
+        long late = fillMs - 1000L * chunkBytes / rate;
+
+        jitterMs += ((late > 0 ? late : 0) - jitterMs) * JITTER_GAIN;
+    }
+
+
+    /**
+     * Called by the consumer when it found no chunk.
+     */
+    void underrun() {
+        underruns++;
+
+        int boost = getBoostMs();
+        boostMs = Math.min( boost + Math.max( boost, 2 * chunkMs ), maxMs );
+        boostChangedMs = System.currentTimeMillis();
+
+        Log.w( LOG, "underrun(): count=" + underruns + ", jitter=" + (int) jitterMs + " ms, target=" + getTargetMs() + " ms" );
+    }
+
+
+    /**
+     * Returns the number of chunks the consumer waits for - called by the consumer.
+     * @param capacity the number of chunks of the reader
+     */
+    int getTargetChunks( int capacity ) {
+        int rate = byteRate;
+        int ret = rate > 0 ? (int)(((long) getTargetMs() * rate / 1000 + chunkBytes - 1) / chunkBytes) : 1;
+
+        return ret < 1 ? 1 : ret < capacity ? ret : capacity;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Returns the boost decayed by the periods without underruns.
+     */
+    private int getBoostMs() {
+        int ret = boostMs;
+        long periods = (System.currentTimeMillis() - boostChangedMs) / SHRINK_PERIOD_MS;
+
+        for (long i=0; i < periods && ret > 0; i++) ret = ret * (100 - SHRINK_PERCENT) / 100;
+
+        return ret;
+    }
+
+}
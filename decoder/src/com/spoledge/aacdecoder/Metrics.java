@@ -0,0 +1,377 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+
+/**
+ * The hot path metrics - lock-free counters and latency histograms
+ * recorded by the native decoding core and by the Java players.
+ * The registry is process wide (shared by all decoders) and enabled by default.
+ * <pre>
+ *  Metrics.Snapshot snap = Metrics.snapshot();
+ *
+ *  long resyncs = snap.getCounter( Metrics.COUNTER_RESYNCS );
+ *  long p99 = snap.getHistogram( Metrics.HISTOGRAM_ROUND ).getPercentile( 99 );
+ * </pre>
+ * The times are in microseconds. The histograms are log-linear (HDR style) -
+ * the relative error of the percentiles is at most 12.5 %, the max is exact.
+ */
+public class Metrics {
+
+    /**
+     * Decoded frames.
+     */
+    public static final int COUNTER_FRAMES = 0;
+
+    /**
+     * Bytes consumed by the decoded frames.
+     */
+    public static final int COUNTER_BYTES = 1;
+
+    /**
+     * Frames failed to decode - the stream was resynced.
+     */
+    public static final int COUNTER_RESYNCS = 2;
+
+    /**
+     * Bytes skipped when searching for the sync word.
+     */
+    public static final int COUNTER_SKIPPED = 3;
+
+    /**
+     * The calls of the input reader.
+     */
+    public static final int COUNTER_READS = 4;
+
+    /**
+     * The calls of the input reader blocked for 10 ms at least.
+     */
+    public static final int COUNTER_STARVED = 5;
+
+    /**
+     * The native output had no samples to play.
+     */
+    public static final int COUNTER_OUTPUT_UNDERRUNS = 6;
+
+    /**
+     * The AudioTrack ran dry - see PCMFeed.
+     */
+    public static final int COUNTER_AUDIOTRACK_UNDERRUNS = 7;
+
+    /**
+     * The input (jitter) buffer ran dry - see BufferReader.
+     */
+    public static final int COUNTER_INPUT_UNDERRUNS = 8;
+
+    /**
+     * The number of counters.
+     */
+    public static final int COUNTERS = 9;
+
+    /**
+     * Time blocked in the input reader (us).
+     */
+    public static final int HISTOGRAM_READ = 0;
+
+    /**
+     * Time of the JNI transfers - the Java arrays and fields (us).
+     */
+    public static final int HISTOGRAM_JNI = 1;
+
+    /**
+     * Time of one decoding round (us).
+     */
+    public static final int HISTOGRAM_ROUND = 2;
+
+    /**
+     * The number of PCM buffers queued to the AudioTrack (sampled every round).
+     */
+    public static final int HISTOGRAM_PCM_QUEUE = 3;
+
+    /**
+     * The number of histograms (without the per-backend ones).
+     */
+    public static final int HISTOGRAMS = 4;
+
+    private static final String[] COUNTER_NAMES = {
+        "frames", "bytes", "resyncs", "skipped", "reads", "starved",
+        "outputUnderruns", "audioTrackUnderruns", "inputUnderruns"
+    };
+
+    private static final String[] HISTOGRAM_NAMES = { "read", "jni", "round", "pcmQueue" };
+
+    // must match the native layout - see aac-metrics.h:
+    private static final int BACKENDS = 8;
+    private static final int SUB_BITS = 3;
+    private static final int SUB = 1 << SUB_BITS;
+    private static final int BUCKETS = (32 - SUB_BITS + 1) * SUB;
+    private static final int HISTOGRAM_SIZE = 3 + BUCKETS;
+    private static final int SNAPSHOT_SIZE = COUNTERS + 1 + (HISTOGRAMS + BACKENDS) * HISTOGRAM_SIZE;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Takes a snapshot of all the counters and histograms.
+     * The values are not mutually consistent (recording does not stop), but each of them is exact.
+     */
+    public static Snapshot snapshot() {
+        Decoder.loadLibrary();
+
+        long[] data = new long[ SNAPSHOT_SIZE ];
+
+        if (nativeSnapshot( data ) < 0) throw new RuntimeException( "Cannot take the metrics snapshot" );
+
+        String[] backends = new String[ (int) data[ COUNTERS ] ];
+
+        for (int i=0; i < backends.length; i++) backends[i] = nativeBackend( i );
+
+        return new Snapshot( data, backends );
+    }
+
+
+    /**
+     * Clears all the counters and histograms.
+     */
+    public static void reset() {
+        Decoder.loadLibrary();
+        nativeReset();
+    }
+
+
+    /**
+     * Enables or disables recording. Disabled recording makes all the hooks no-ops
+     * (not even the clock is read).
+     */
+    public static void setEnabled( boolean enabled ) {
+        Decoder.loadLibrary();
+        nativeSetEnabled( enabled );
+    }
+
+
+    /**
+     * Increments the counter.
+     * @param counter one of COUNTER_* constants
+     */
+    public static void increment( int counter ) {
+        Decoder.loadLibrary();
+        nativeCount( counter, 1 );
+    }
+
+
+    /**
+     * Records the value into the histogram.
+     * @param histogram one of HISTOGRAM_* constants
+     */
+    public static void record( int histogram, long value ) {
+        Decoder.loadLibrary();
+        nativeRecord( histogram, value );
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Inner classes
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * One histogram of a snapshot.
+     */
+    public static final class Histogram {
+        private final String name;
+        private final long[] data;
+        private final int offset;
+
+        private Histogram( String name, long[] data, int offset ) {
+            this.name = name;
+            this.data = data;
+            this.offset = offset;
+        }
+
+
+        /**
+         * Returns the name - the backend name for the per-frame decoding histograms.
+         */
+        public String getName() {
+            return name;
+        }
+
+
+        /**
+         * Returns the number of the recorded values.
+         */
+        public long getCount() {
+            return data[ offset ];
+        }
+
+
+        /**
+         * Returns the mean or 0 if empty.
+         */
+        public long getMean() {
+            long count = getCount();
+
+            return count != 0 ? data[ offset + 1 ] / count : 0;
+        }
+
+
+        /**
+         * Returns the exact max.
+         */
+        public long getMax() {
+            return data[ offset + 2 ];
+        }
+
+
+        /**
+         * Returns the value at the percentile - the middle of the bucket containing it.
+         * @param percentile 0 - 100 (e.g. 99.9)
+         */
+        public long getPercentile( double percentile ) {
+            long count = getCount();
+
+            if (count == 0) return 0;
+
+            long rank = Math.max( 1, (long) (percentile * count / 100 + 0.5));
+            long seen = 0;
+
+            for (int i=0; i < BUCKETS; i++) {
+                seen += data[ offset + 3 + i ];
+
+                if (seen >= rank) {
+                    long lo = bucketLow( i );
+                    long hi = i + 1 < BUCKETS ? bucketLow( i + 1 ) : lo;
+
+                    return Math.min( lo + (hi - lo) / 2, getMax());
+                }
+            }
+
+            return getMax();
+        }
+
+
+        @Override
+        public String toString() {
+            return name + ": n=" + getCount() + ", mean=" + getMean()
+                + ", p50=" + getPercentile( 50 ) + ", p99=" + getPercentile( 99 )
+                + ", p99.9=" + getPercentile( 99.9 ) + ", max=" + getMax();
+        }
+
+
+        private static long bucketLow( int bucket ) {
+            if (bucket < SUB) return bucket;
+
+            int e = bucket / SUB + SUB_BITS - 1;
+
+            return ((long)(SUB + bucket % SUB)) << (e - SUB_BITS);
+        }
+    }
+
+
+    /**
+     * A snapshot of the metrics.
+     */
+    public static final class Snapshot {
+        private final long[] data;
+        private final String[] backends;
+
+        private Snapshot( long[] data, String[] backends ) {
+            this.data = data;
+            this.backends = backends;
+        }
+
+
+        /**
+         * Returns the value of the counter.
+         * @param counter one of COUNTER_* constants
+         */
+        public long getCounter( int counter ) {
+            if (counter < 0 || counter >= COUNTERS) throw new IllegalArgumentException( "Unknown counter " + counter );
+
+            return data[ counter ];
+        }
+
+
+        /**
+         * Returns the histogram.
+         * @param histogram one of HISTOGRAM_* constants
+         */
+        public Histogram getHistogram( int histogram ) {
+            if (histogram < 0 || histogram >= HISTOGRAMS) throw new IllegalArgumentException( "Unknown histogram " + histogram );
+
+            return new Histogram( HISTOGRAM_NAMES[ histogram ], data, COUNTERS + 1 + histogram * HISTOGRAM_SIZE );
+        }
+
+
+        /**
+         * Returns the per-frame decoding times (us) - one histogram for each decoder used.
+         */
+        public Histogram[] getBackendHistograms() {
+            Histogram[] ret = new Histogram[ backends.length ];
+
+            for (int i=0; i < ret.length; i++) {
+                ret[i] = new Histogram( backends[i], data, COUNTERS + 1 + (HISTOGRAMS + i) * HISTOGRAM_SIZE );
+            }
+
+            return ret;
+        }
+
+
+        @Override
+        public String toString() {
+            StringBuilder sb = new StringBuilder();
+
+            for (int i=0; i < COUNTERS; i++) {
+                sb.append( COUNTER_NAMES[i] ).append( '=' ).append( data[i] ).append( '\n' );
+            }
+
+            for (int i=0; i < HISTOGRAMS; i++) {
+                Histogram h = getHistogram( i );
+                if (h.getCount() != 0) sb.append( h ).append( '\n' );
+            }
+
+            for (Histogram h : getBackendHistograms()) {
+                if (h.getCount() != 0) sb.append( "frame/" ).append( h ).append( '\n' );
+            }
+
+            return sb.toString();
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
+
+    private static native int nativeSnapshot( long[] dest );
+
+    private static native String nativeBackend( int index );
+
+    private static native void nativeCount( int counter, long delta );
+
+    private static native void nativeRecord( int histogram, long value );
+
+    private static native void nativeReset();
+
+    private static native void nativeSetEnabled( boolean enabled );
+
+}
+
@@ -21,12 +21,16 @@ package com.spoledge.aacdecoder;
 
 import android.util.Log;
 
-import java.net.URLConnection;
+import java.util.List;
+import java.util.Map;
 
 
 /**
- * This is the Multi (MP3/AAC) Stream player class.
+ * This is the Multi (MP3/AAC/MP4) Stream player class.
  * It uses Decoder to decode Multi stream into PCM samples.
+ * The MP4 / M4A files are demuxed natively by the "OpenCORE-MP4" decoder - if the 'moov' box
+ * follows the media data, then the stream must be seekable (a local file or a native HTTP stream
+ * of a server supporting Range requests - see setNativeHttpEnabled(boolean)).
  * This class is not thread safe.
  * <pre>
  *  MultiPlayer player = new MultiPlayer();
@@ -46,6 +50,7 @@ public class MultiPlayer extends AACPlayer {
 
     private Decoder aacDecoder;
     private Decoder mp3Decoder;
+    private Decoder mp4Decoder;
 
 
     ////////////////////////////////////////////////////////////////////////////
@@ -99,15 +104,24 @@ public class MultiPlayer extends AACPlayer {
             throw new RuntimeException("MP3 Decoder not found");
         }
 
+        name = "OpenCORE-MP4";
+
+        mp4Decoder = Decoder.createByName( name );
+
+        if (mp4Decoder == null) {
+            Log.e( LOG, "Cannot find decoder by name '" + name + "'");
+            throw new RuntimeException("MP4 Decoder not found");
+        }
+
         return aacDecoder;
     }
 
 
     @Override
-    protected void processHeaders( URLConnection cn ) {
-        super.processHeaders( cn );
+    protected void processHeaders( Map<String, List<String>> headers ) {
+        super.processHeaders( headers );
 
-        for (java.util.Map.Entry<String, java.util.List<String>> me : cn.getHeaderFields().entrySet()) {
+        for (Map.Entry<String, List<String>> me : headers.entrySet()) {
             if ("content-type".equalsIgnoreCase( me.getKey())) {
                 for (String s : me.getValue()) {
                     String ct = s;
@@ -126,8 +140,11 @@ public class MultiPlayer extends AACPlayer {
                         || s.startsWith( "mpeg" )
                         || s.startsWith( "mpg" );
 
-                    Log.i( LOG, "Setting " + (isMp3 ? "MP3" : "AAC") + " decoder for content type " + ct );
-                    setDecoder( isMp3 ? mp3Decoder : aacDecoder );
+                    // MP4: audio/mp4, audio/m4a, audio/x-m4a
+                    boolean isMp4 = s.startsWith( "mp4" ) || s.startsWith( "m4a" );
+
+                    Log.i( LOG, "Setting " + (isMp3 ? "MP3" : isMp4 ? "MP4" : "AAC") + " decoder for content type " + ct );
+                    setDecoder( isMp3 ? mp3Decoder : isMp4 ? mp4Decoder : aacDecoder );
 
                     return;
                 }
@@ -146,10 +163,12 @@ public class MultiPlayer extends AACPlayer {
      */
     @Override
     protected void processFileType( String file ) {
-        boolean isMp3 = file.toLowerCase().endsWith( ".mp3" );
+        String lc = file.toLowerCase();
+        boolean isMp3 = lc.endsWith( ".mp3" );
+        boolean isMp4 = lc.endsWith( ".m4a" ) || lc.endsWith( ".mp4" ) || lc.endsWith( ".m4b" );
 
-        Log.i( LOG, "Setting " + (isMp3 ? "MP3" : "AAC") + " decoder for file " + file );
-        setDecoder( isMp3 ? mp3Decoder : aacDecoder );
+        Log.i( LOG, "Setting " + (isMp3 ? "MP3" : isMp4 ? "MP4" : "AAC") + " decoder for file " + file );
+        setDecoder( isMp3 ? mp3Decoder : isMp4 ? mp4Decoder : aacDecoder );
     }
 
 }
@@ -0,0 +1,231 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+import java.io.UnsupportedEncodingException;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+import java.util.Map;
+import java.util.TreeMap;
+
+
+/**
+ * The HTTP / Icecast / SHOUTcast stream received by the native code.
+ * The response body is received directly into the decoder's input buffer -
+ * the chunked transfer framing and the ICY metadata are stripped there in place,
+ * so no BufferReader (and its thread) is needed:
+ * <pre>
+ *  NativeHttpStream stream = NativeHttpStream.open( url, true );
+ *  String type = stream.getHeaderField( "content-type" );
+ *
+ *  Decoder.Info info = decoder.start( stream );   // the decoder owns the stream now
+ *  ...
+ *  String meta = stream.pollMetadata( null );     // null if not changed
+ *  ...
+ *  decoder.stop();
+ * </pre>
+ * A dropped connection is reconnected: live streams continue, the others are
+ * resumed by a Range request (if the server supports it). Such streams are also seekable.
+ * Only plain http:// (and icy://) URLs are supported - not https://.
+ */
+public class NativeHttpStream {
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Attributes
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * The native pointer.
+     */
+    private long aacdh;
+
+    /**
+     * Set when the stream is passed to the decoder.
+     */
+    private boolean owned;
+
+    private Map<String, List<String>> headers;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    private NativeHttpStream( long aacdh ) {
+        this.aacdh = aacdh;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Connects and receives the response headers.
+     * @param url the http:// or icy:// URL
+     * @param metadata if true, then the ICY metadata are requested
+     * @throws java.io.IOException if the stream cannot be opened
+     */
+    public static NativeHttpStream open( String url, boolean metadata ) throws java.io.IOException {
+        Decoder.loadLibrary();
+
+        long aacdh = nativeOpen( url, metadata );
+
+        if (aacdh == 0) throw new java.io.IOException("Cannot open stream " + url);
+
+        NativeHttpStream ret = new NativeHttpStream( aacdh );
+        ret.headers = parseHeaders( nativeHeaders( aacdh ));
+
+        return ret;
+    }
+
+
+    /**
+     * Returns the response headers - the keys are case insensitive.
+     */
+    public Map<String, List<String>> getHeaderFields() {
+        return headers;
+    }
+
+
+    /**
+     * Returns the first value of the header.
+     * @param name the case insensitive name
+     * @return the value or null
+     */
+    public String getHeaderField( String name ) {
+        List<String> vals = headers.get( name );
+
+        return vals != null ? vals.get( 0 ) : null;
+    }
+
+
+    /**
+     * Returns the metadata string if it changed since the last call.
+     * This can be called while the decoder reads the stream.
+     * @param characterEncoding the encoding of the metadata - may be null = default is UTF-8
+     * @return the metadata string like: StreamTitle='...';StreamUrl='...'; or null if not changed
+     */
+    public synchronized String pollMetadata( String characterEncoding ) {
+        if (aacdh == 0) return null;
+
+        byte[] b = nativeMetadata( aacdh );
+
+        if (b == null) return null;
+
+        try {
+            return new String( b, characterEncoding != null ? characterEncoding : "UTF-8" );
+        }
+        catch (UnsupportedEncodingException e) {
+            return new String( b );
+        }
+    }
+
+
+    /**
+     * Closes the stream - unless it was passed to the decoder (then it is closed by Decoder.stop()).
+     */
+    public synchronized void close() {
+        if (aacdh != 0 && !owned) nativeClose( aacdh );
+
+        aacdh = 0;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Package
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Passes the stream to the decoder.
+     * @return the native pointer
+     */
+    synchronized long attach() {
+        if (aacdh == 0 || owned) throw new IllegalStateException();
+
+        owned = true;
+
+        return aacdh;
+    }
+
+
+    /**
+     * Called by the decoder before it frees the stream.
+     */
+    synchronized void detach() {
+        aacdh = 0;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Protected
+    ////////////////////////////////////////////////////////////////////////////
+
+    @Override
+    protected void finalize() {
+        try {
+            close();
+        }
+        catch (Throwable t) {
+            t.printStackTrace();
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Parses the "name: value" lines.
+     */
+    private static Map<String, List<String>> parseHeaders( byte[] b ) throws UnsupportedEncodingException {
+        Map<String, List<String>> ret = new TreeMap<String, List<String>>( String.CASE_INSENSITIVE_ORDER );
+
+        for (String line : new String( b, "ISO-8859-1" ).split( "\n" )) {
+            int n = line.indexOf( ':' );
+            if (n < 1) continue;
+
+            String key = line.substring( 0, n ).trim();
+            List<String> vals = ret.get( key );
+
+            if (vals == null) {
+                vals = new ArrayList<String>();
+                ret.put( key, vals );
+            }
+
+            vals.add( line.substring( n+1 ).trim());
+        }
+
+        return Collections.unmodifiableMap( ret );
+    }
+
+
+    private static native long nativeOpen( String url, boolean metadata );
+
+    private static native byte[] nativeHeaders( long aacdh );
+
+    private static native byte[] nativeMetadata( long aacdh );
+
+    private static native void nativeClose( long aacdh );
+
+}
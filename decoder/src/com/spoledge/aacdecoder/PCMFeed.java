@@ -44,6 +44,13 @@ import android.util.Log;
  *      if (!pcmfeed.feed( samples, samples.length )) break;
  *  }
  * </pre>
+ *
+ * The arrays are passed to the execution thread by a lock-free ring (SPSCRing).
+ * An array passed to feed() cannot be reused until the ring cycles through it -
+ * so the caller needs (queue depth + 1) arrays.
+ *
+ * In the burst mode (see setBurstMode(int,int)) the AudioTrack is refilled at once
+ * when it drains to the low watermark and the thread sleeps in between.
  */
 public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateListener {
 
@@ -61,9 +68,33 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
      */
     public static final int MARKER_REACHED_ACTION_PAUSE = 1;
 
+    /**
+     * Constant value for waking up the execution thread when reached a marker position.
+     * Used by the burst mode for the low watermark.
+     * @see markerReachedAction
+     */
+    public static final int MARKER_REACHED_ACTION_NOTIFY = 2;
+
+
+    /**
+     * The default number of arrays held by the feeder (queued + being played).
+     * @see #PCMFeed(int,int,int,PlayerCallback,int)
+     */
+    public static final int DEFAULT_QUEUE_DEPTH = 2;
+
 
     private static final String LOG = "PCMFeed";
 
+    /**
+     * The per-round debug messages are built only when enabled by "setprop log.tag.PCMFeed DEBUG".
+     */
+    private static final boolean DEBUG = Log.isLoggable( LOG, Log.DEBUG );
+
+    /**
+     * How long the threads wait for the ring before checking the stopped flags again.
+     */
+    private static final long WAIT_MS = 100;
+
 
     ////////////////////////////////////////////////////////////////////////////
     // Attributes
@@ -93,13 +124,13 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
     /**
      * Flag for stopping immediatelly.
      */
-    protected boolean stopped;
+    protected volatile boolean stopped;
 
     /**
      * Stopped by End-Of-File.
      * @since 0.8
      */
-    protected boolean stoppedByEOF;
+    protected volatile boolean stoppedByEOF;
 
 
     /**
@@ -109,15 +140,21 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
 
 
     /**
-     * The variable set by feed() method and consumed in run().
+     * The ring of the arrays set by feed() method and consumed in run().
+     */
+    protected SPSCRing ring;
+
+
+    /**
+     * The arrays set by feed() method - indexed by the ring.
      */
-    protected short[] samples;
+    protected short[][] queuedSamples;
 
 
     /**
-     * The variable set by feed() method and consumed in run().
+     * The lengths of the arrays set by feed() method - indexed by the ring.
      */
-    protected int samplesCount;
+    protected int[] queuedCounts;
 
 
     /**
@@ -126,6 +163,44 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
     protected int writtenTotal = 0;
 
 
+    /**
+     * How many times the AudioTrack ran dry while playing.
+     */
+    protected volatile int underruns;
+
+
+    /**
+     * How many times the execution thread woke up besides the ring - see getWakeups().
+     */
+    protected volatile int wakeups;
+
+
+    /**
+     * The CPU time consumed by the execution thread - set at its end.
+     */
+    protected volatile long cpuNanos;
+
+
+    /**
+     * The low watermark and the start threshold of the burst mode in ms;
+     * the low watermark is 0 if the burst mode is disabled.
+     */
+    protected int lowWatermarkMs;
+    protected int burstStartMs;
+
+
+    /**
+     * How long the threads wait for the ring before checking the stopped flags again.
+     */
+    protected long waitMs = WAIT_MS;
+
+
+    /**
+     * Set by the marker listener when the low watermark was reached - guarded by this.
+     */
+    protected boolean markerReached;
+
+
     /**
      * The action which to be executed when the marker position is reached.
      * Actually this is used for very short audio data workaround.
@@ -146,11 +221,28 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
      * @param playerCallback the callback - may be null
      */
     protected PCMFeed( int sampleRate, int channels, int bufferSizeInBytes, PlayerCallback playerCallback ) {
+        this( sampleRate, channels, bufferSizeInBytes, playerCallback, DEFAULT_QUEUE_DEPTH );
+    }
+
+
+    /**
+     * Creates a new PCMFeed object.
+     * @param sampleRate the sampling rate in Hz (e.g. 44100)
+     * @param channels the number of channels - only allowed values are 1 (mono) and 2 (stereo).
+     * @param bufferSizeInBytes the size of the audio buffer in bytes
+     * @param playerCallback the callback - may be null
+     * @param queueDepth the number of arrays held by the feeder (queued + being played)
+     */
+    protected PCMFeed( int sampleRate, int channels, int bufferSizeInBytes, PlayerCallback playerCallback, int queueDepth ) {
         this.sampleRate = sampleRate;
         this.channels = channels;
         this.bufferSizeInBytes = bufferSizeInBytes;
         this.bufferSizeInMs = bytesToMs( bufferSizeInBytes, sampleRate, channels );
         this.playerCallback = playerCallback;
+
+        ring = new SPSCRing( queueDepth );
+        queuedSamples = new short[ queueDepth ][];
+        queuedCounts = new int[ queueDepth ];
     }
 
 
@@ -190,6 +282,87 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
     }
 
 
+    /**
+     * Returns the number of arrays held by the feeder (queued + being played).
+     */
+    public final int getQueueDepth() {
+        return ring.getCapacity();
+    }
+
+
+    /**
+     * Returns the number of arrays currently held by the feeder (queued + being played).
+     */
+    public final int getQueuedCount() {
+        return ring.size();
+    }
+
+
+    /**
+     * Returns how many times the AudioTrack ran dry while playing
+     * - it was fed too late and played silence.
+     */
+    public final int getUnderruns() {
+        return underruns;
+    }
+
+
+    /**
+     * Returns how many times the feeding and the execution threads woke up:
+     * the waits for the ring, for the low watermark and for a full AudioTrack.
+     * @see PowerStats
+     */
+    public final int getWakeups() {
+        return wakeups + ring.getWaits();
+    }
+
+
+    /**
+     * Returns the CPU time consumed by the execution thread in ns - valid after it stopped.
+     */
+    public final long getCpuNanos() {
+        return cpuNanos;
+    }
+
+
+    /**
+     * Returns the duration of the samples written to the AudioTrack in ms.
+     */
+    public final int getWrittenMs() {
+        return samplesToMs( writtenTotal, sampleRate, channels );
+    }
+
+
+    /**
+     * Enables the burst (race-to-idle) mode.
+     * The execution thread fills the whole AudioTrack at once, then sleeps until the track
+     * drains to the low watermark - instead of blocking in every write and waking up
+     * with every period of the AudioTrack. The periodic buffer notifications
+     * (PlayerCallback.playerPCMFeedBuffer) are replaced by one call per burst.
+     * The buffer size should be the burst plus the low watermark and the queue depth
+     * should cover the burst, so the decoder can also decode it at once.
+     *
+     * NOTE: this must be set BEFORE the execution thread is started.
+     * @param lowWatermarkMs the buffered audio (ms) triggering the refill of the AudioTrack
+     * @param startMs the buffered audio (ms) needed to start the AudioTrack
+     */
+    public void setBurstMode( int lowWatermarkMs, int startMs ) {
+        this.lowWatermarkMs = lowWatermarkMs;
+        this.burstStartMs = startMs;
+
+        // both threads are woken by the other side or by stop() - the timeout is only a safety net:
+        waitMs = lowWatermarkMs > 0 ? Math.max( WAIT_MS, bufferSizeInMs ) : WAIT_MS;
+    }
+
+
+    /**
+     * Returns true if the burst mode is enabled.
+     */
+    public final boolean isBurstMode() {
+        return lowWatermarkMs > 0;
+    }
+
+
     /**
      * This is called by main thread when a new data are available.
      *
@@ -197,20 +370,43 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
      * @param n the length of the PCM data
      * @return true if ok, false if the execution thread is not responding
      */
-    public synchronized boolean feed( short[] samples, int n ) {
-        while (this.samples != null && !stopped) {
-            try { wait(); } catch (InterruptedException e) {}
+    public boolean feed( short[] samples, int n ) {
+        int index;
+
+        while ((index = ring.tryPut( waitMs )) == -1) {
+            if (stopped) return false;
         }
 
-        this.samples = samples;
-        this.samplesCount = n;
+        queuedSamples[ index ] = samples;
+        queuedCounts[ index ] = n;
 
-        notify();
+        ring.put();
 
         return !stopped;
     }
 
 
+    /**
+     * Tries to feed the new data without blocking.
+     *
+     * @param samples the array containing the PCM data
+     * @param n the length of the PCM data
+     * @return true if accepted, false if the queue is full or the feeder was stopped
+     */
+    public boolean tryFeed( short[] samples, int n ) {
+        int index = ring.tryPut();
+
+        if (index == -1 || stopped) return false;
+
+        queuedSamples[ index ] = samples;
+        queuedCounts[ index ] = n;
+
+        ring.put();
+
+        return true;
+    }
+
+
     /**
      * Stops the PCM feeder immediatelly.
      * This method just asynchronously notifies the execution thread.
@@ -238,7 +434,10 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
             if (isPlaying) audioTrack.pause();
         }
 
-        notify();
+        ring.wakeUp();
+
+        // the execution thread may wait for the low watermark:
+        notifyAll();
     }
 
 
@@ -296,6 +495,12 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
         if (markerReachedAction == MARKER_REACHED_ACTION_PAUSE) {
             track.pause();
         }
+        else if (markerReachedAction == MARKER_REACHED_ACTION_NOTIFY) {
+            synchronized (this) {
+                markerReached = true;
+                notifyAll();
+            }
+        }
     }
 
 
@@ -351,7 +556,9 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
                                 AudioTrack.MODE_STREAM );
 
             atrack.setPlaybackPositionUpdateListener( this );
-            atrack.setPositionNotificationPeriod( msToSamples( 200, sampleRate, channels ));
+
+            // the burst mode reports the buffer once per burst - see runBursts():
+            if (lowWatermarkMs == 0) atrack.setPositionNotificationPeriod( msToSamples( 200, sampleRate, channels ));
 
             if (playerCallback != null) playerCallback.playerAudioTrackCreated( atrack );
 
@@ -363,6 +570,38 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
             if (playerCallback != null) playerCallback.playerException( t );
         }
 
+        long cpuStarted = PowerStats.threadCpuNanos();
+
+        if (lowWatermarkMs > 0) runBursts( atrack );
+        else runContinuous( atrack );
+
+        // Play the rest of the file:
+        if (!stopped && stoppedByEOF) waitForLastTone();
+
+        // Stop playing:
+        if (isPlaying) atrack.pause();
+        atrack.flush();
+        atrack.release();
+
+        cpuNanos = PowerStats.threadCpuNanos() - cpuStarted;
+        stopped = true;
+
+        // the feeding thread may wait for the ring (e.g. after a playback error):
+        ring.wakeUp();
+
+        Log.d( LOG, "run() stopped." );
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Protected
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * The loop of the default mode - the samples are written as soon as they are fed,
+     * the writes block while the AudioTrack is full.
+     */
+    protected void runContinuous( AudioTrack atrack ) {
         while (!stopped) {
             // fetch the samples into our "local" variable lsamples:
             int ln = acquireSamples();
@@ -376,11 +615,24 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
             int writtenNow = 0;
 
             do {
-                if (writtenNow != 0) {
-                    Log.d( LOG, "too fast for playback, sleeping...");
+                // the write blocks while playing - so sleep only when the track is not started yet:
+                if (writtenNow != 0 && !isPlaying) {
+                    if (DEBUG) Log.d( LOG, "too fast for playback, sleeping...");
+                    wakeups++;
                     try { Thread.sleep( 50 ); } catch (InterruptedException e) {}
                 }
 
+                int before = writtenTotal - atrack.getPlaybackHeadPosition()*channels;
+
+                // everything written so far was played - the track is starving:
+                if (isPlaying && before <= 0) {
+                    underruns++;
+                    Metrics.increment( Metrics.COUNTER_AUDIOTRACK_UNDERRUNS );
+                }
+
+                // the write blocks until the track has room for the rest:
+                if (isPlaying && before + ln > bufferSizeInBytes / 2) wakeups++;
+
                 int written = atrack.write( lsamples, writtenNow, ln );
 
                 if (written < 0) {
@@ -401,7 +653,7 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
                         isPlaying = true;
                     }
                     else {
-                        Log.d( LOG, "start buffer not filled enough - AudioTrack not started yet");
+                        if (DEBUG) Log.d( LOG, "start buffer not filled enough - AudioTrack not started yet");
                     }
                 }
 
@@ -411,54 +663,137 @@ public class PCMFeed implements Runnable, AudioTrack.OnPlaybackPositionUpdateLis
 
             releaseSamples();
         }
+    }
 
-        // Play the rest of the file:
-        if (!stopped && stoppedByEOF) waitForLastTone();
 
-        // Stop playing:
-        if (isPlaying) atrack.pause();
-        atrack.flush();
-        atrack.release();
+    /**
+     * The loop of the burst mode - see setBurstMode(int,int).
+     * The samples are written only as far as they fit into the AudioTrack, so the writes
+     * never block. When the track is full, the thread sleeps until the low watermark
+     * is reached and then refills the whole track at once.
+     */
+    protected void runBursts( AudioTrack atrack ) {
+        int capacity = bufferSizeInBytes / 2;
+        int low = Math.min( msToSamples( lowWatermarkMs, sampleRate, channels ), capacity / 2 );
+        int start = Math.min( msToSamples( burstStartMs, sampleRate, channels ), capacity );
 
-        stopped = true;
+        while (!stopped) {
+            int ln = acquireSamples();
 
-        Log.d( LOG, "run() stopped." );
+            if (stopped || ln == 0) {
+                releaseSamples();
+                break;
+            }
+
+            int offset = 0;
+
+            while (ln > 0 && !stopped) {
+                int buffered = writtenTotal - atrack.getPlaybackHeadPosition()*channels;
+
+                // everything written so far was played - the track is starving:
+                if (isPlaying && buffered <= 0) {
+                    underruns++;
+                    Metrics.increment( Metrics.COUNTER_AUDIOTRACK_UNDERRUNS );
+                }
+
+                int n = Math.min( ln, capacity - buffered );
+
+                if (n <= 0) {
+                    // the start threshold cannot exceed the capacity - so the track is playing:
+                    waitForLowWatermark( atrack, buffered, low );
+                    onPeriodicNotification( atrack );
+                    continue;
+                }
+
+                int written = atrack.write( lsamples, offset, n );
+
+                if (written < 0) {
+                    Log.e( LOG, "error in playback feed: " + written );
+                    stopped = true;
+                    break;
+                }
+
+                writtenTotal += written;
+                offset += written;
+                ln -= written;
+
+                if (!stopped && !isPlaying && buffered + written >= start) {
+                    Log.d( LOG, "start of AudioTrack - buffered " + (buffered + written) + " samples");
+                    atrack.play();
+                    isPlaying = true;
+                }
+            }
+
+            releaseSamples();
+        }
     }
 
 
-    ////////////////////////////////////////////////////////////////////////////
-    // Protected
-    ////////////////////////////////////////////////////////////////////////////
+    /**
+     * Sleeps until the AudioTrack drains to the low watermark.
+     * The thread is woken by the notification marker - or by the timeout
+     * computed from the buffered samples if the marker is not delivered.
+     * @param buffered the samples buffered in the AudioTrack
+     * @param low the low watermark in samples
+     */
+    protected void waitForLowWatermark( AudioTrack atrack, int buffered, int low ) {
+        long deadline = System.currentTimeMillis() + samplesToMs( buffered - low, sampleRate, channels ) + WAIT_MS;
+
+        if (DEBUG) Log.d( LOG, "waitForLowWatermark(): buffered " + buffered + " samples" );
+
+        synchronized (this) {
+            markerReached = false;
+            markerReachedAction = MARKER_REACHED_ACTION_NOTIFY;
+            atrack.setNotificationMarkerPosition( (writtenTotal - low) / channels );
+
+            wakeups++;
+
+            while (!markerReached && !stopped) {
+                long ms = deadline - System.currentTimeMillis();
+
+                if (ms <= 0) break;
+
+                try { wait( ms ); } catch (InterruptedException e) {}
+            }
+        }
+    }
+
 
     /**
      * Acquires samples into variable lsamples.
      * @return the actual size (in shorts) of the lsamples
      */
-    protected synchronized int acquireSamples() {
-        while (samplesCount == 0 && !(stopped || stoppedByEOF)) {
-            try { wait(); } catch (InterruptedException e) {}
-        }
+    protected int acquireSamples() {
+        int index = ring.tryTake();
+
+        while (index == -1) {
+            // the last samples are fed before the EOF flag is set:
+            boolean eof = stoppedByEOF;
 
-        // copy to local vars
-        lsamples = samples;
-        int ln = samplesCount;
+            if (stopped) return 0;
 
-        // clear the instance vars
-        samples = null;
-        samplesCount = 0;
+            index = ring.tryTake( waitMs );
 
-        notify();
+            if (index == -1 && eof) return 0;
+        }
+
+        lsamples = queuedSamples[ index ];
+        queuedSamples[ index ] = null;
 
-        return ln;
+        return queuedCounts[ index ];
     }
 
 
     /**
      * Releases the lsamples variable.
      * This method is called always after processing the acquired lsamples.
+     * The slot is returned back to the ring - the array can be reused by the caller of feed().
      */
     protected void releaseSamples() {
-        // nothing to be done
+        if (lsamples != null) {
+            lsamples = null;
+            ring.take();
+        }
     }
 
 
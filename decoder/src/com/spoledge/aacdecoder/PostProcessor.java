@@ -0,0 +1,206 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+
+/**
+ * The native post-decode stage: downmixes multichannel (3-8 channels) PCM into stereo
+ * and resamples it by a polyphase filter - e.g. to the native rate of the device,
+ * so the platform does not need to resample it again.
+ * <pre>
+ *  PostProcessor post = PostProcessor.create( 6, 44100, 48000 );
+ *  short[] out = new short[ post.getMaxOutputLength( samples.length ) ];
+ *
+ *  int n = post.process( samples, len, out );
+ *  ...
+ *  post.destroy();
+ * </pre>
+ * The processor keeps the history of the samples - the stream is passed in chunks
+ * of any length (whole frames of all channels). This class is not thread safe.
+ */
+public class PostProcessor {
+
+    /**
+     * The default gain of the center channel.
+     */
+    public static final float DEFAULT_CENTER_GAIN = 0.7071f;
+
+    /**
+     * The default gain of the surround channels.
+     */
+    public static final float DEFAULT_SURROUND_GAIN = 0.7071f;
+
+    /**
+     * The default gain of the LFE channel (dropped).
+     */
+    public static final float DEFAULT_LFE_GAIN = 0f;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Attributes
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * The native pointer.
+     */
+    private long aacdp;
+
+    private int channels;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    private PostProcessor( long aacdp, int channels ) {
+        this.aacdp = aacdp;
+        this.channels = channels;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Creates the post-decode stage.
+     * @param channels the number of the input channels; more than 2 are downmixed into stereo
+     * @param sampleRate the sampling rate of the input
+     * @param outputRate the sampling rate of the output; 0 means no resampling
+     * @throws IllegalArgumentException if the channels or the rates are not supported
+     */
+    public static PostProcessor create( int channels, int sampleRate, int outputRate ) {
+        Decoder.loadLibrary();
+
+        long aacdp = nativeCreate( channels, sampleRate, outputRate );
+
+        if (aacdp == 0) throw new IllegalArgumentException("Unsupported post-processing: "
+                            + channels + " channels, " + sampleRate + " -> " + outputRate + " Hz");
+
+        return new PostProcessor( aacdp, channels );
+    }
+
+
+    /**
+     * Sets the downmix gains - relative to the front channels.
+     * Has no effect for mono or stereo input.
+     * @param normalize if true, then the gains are scaled down so the output cannot clip
+     */
+    public void setDownmix( float center, float surround, float lfe, boolean normalize ) {
+        if (aacdp == 0) throw new IllegalStateException();
+
+        nativeDownmix( aacdp, center, surround, lfe, normalize );
+    }
+
+
+    /**
+     * Returns the number of the input channels.
+     */
+    public int getChannels() {
+        return channels;
+    }
+
+
+    /**
+     * Returns the number of the output channels (1 or 2).
+     */
+    public int getOutputChannels() {
+        if (aacdp == 0) throw new IllegalStateException();
+
+        return nativeChannels( aacdp );
+    }
+
+
+    /**
+     * Returns the sampling rate of the output.
+     */
+    public int getOutputRate() {
+        if (aacdp == 0) throw new IllegalStateException();
+
+        return nativeRate( aacdp );
+    }
+
+
+    /**
+     * Returns the minimal length of the output buffer for the given input length.
+     */
+    public int getMaxOutputLength( int inputLength ) {
+        if (aacdp == 0) throw new IllegalStateException();
+
+        return nativeMaxOutput( aacdp, inputLength );
+    }
+
+
+    /**
+     * Processes the next samples.
+     * @param samples the interleaved input samples
+     * @param len the number of the input samples (all channels)
+     * @param out the output buffer - see getMaxOutputLength(int)
+     * @return the number of the output samples (all channels)
+     * @throws IllegalArgumentException if len is negative or exceeds the input array
+     */
+    public int process( short[] samples, int len, short[] out ) {
+        if (aacdp == 0) throw new IllegalStateException();
+        if (len < 0 || len > samples.length) throw new IllegalArgumentException( "len exceeds the array" );
+
+        return nativeProcess( aacdp, samples, len, out );
+    }
+
+
+    /**
+     * Drops the history - e.g. after seeking.
+     */
+    public void reset() {
+        if (aacdp != 0) nativeReset( aacdp );
+    }
+
+
+    /**
+     * Releases the native resources.
+     */
+    public void destroy() {
+        if (aacdp != 0) {
+            nativeDestroy( aacdp );
+            aacdp = 0;
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
+
+    private static native long nativeCreate( int channels, int sampleRate, int outputRate );
+
+    private static native void nativeDownmix( long aacdp, float center, float surround, float lfe, boolean normalize );
+
+    private static native int nativeChannels( long aacdp );
+
+    private static native int nativeRate( long aacdp );
+
+    private static native int nativeMaxOutput( long aacdp, int inputLength );
+
+    private static native int nativeProcess( long aacdp, short[] samples, int len, short[] out );
+
+    private static native void nativeReset( long aacdp );
+
+    private static native void nativeDestroy( long aacdp );
+
+}
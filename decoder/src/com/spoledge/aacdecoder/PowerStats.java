@@ -0,0 +1,144 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+import android.os.Debug;
+
+
+/**
+ * The power profile of one played stream - how often the player threads woke up
+ * and how much CPU time they consumed per minute of audio.
+ * The stats are collected by AACPlayer and returned by AACPlayer.getPowerStats()
+ * after the stream has stopped.
+ * <pre>
+ *  player.setBurstMs( 8000 );
+ *  player.play( url );
+ *
+ *  PowerStats ps = player.getPowerStats();
+ *  Log.i( LOG, "wakeups/min=" + ps.getWakeupsPerMinute() + ", cpu ms per audio min=" + ps.getCpuMsPerAudioMinute());
+ * </pre>
+ *
+ * The wakeups counted are the parks in the rings (SPSCRing) between the reading,
+ * decoding and feeding threads, the reads of the input stream and the waits of the PCMFeed
+ * for the AudioTrack. The wakeups inside the blocking AudioTrack.write() are not visible
+ * to Java - a write which has to wait is counted once.
+ */
+public final class PowerStats {
+
+    private int wakeups;
+    private long cpuNanos;
+    private long audioMs;
+    private long wallMs;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Returns the number of wakeups of all the player threads.
+     */
+    public int getWakeups() {
+        return wakeups;
+    }
+
+
+    /**
+     * Returns the CPU time consumed by all the player threads in ms.
+     * This is 0 if the thread CPU time is not supported by the device.
+     */
+    public long getCpuMs() {
+        return cpuNanos / 1000000;
+    }
+
+
+    /**
+     * Returns the duration of the audio passed to the AudioTrack in ms.
+     */
+    public long getAudioMs() {
+        return audioMs;
+    }
+
+
+    /**
+     * Returns the wall clock duration of the playback in ms.
+     */
+    public long getWallMs() {
+        return wallMs;
+    }
+
+
+    /**
+     * Returns the average wakeups per minute of the wall clock time.
+     */
+    public int getWakeupsPerMinute() {
+        return wallMs > 0 ? (int)(60000L * wakeups / wallMs) : 0;
+    }
+
+
+    /**
+     * Returns the CPU time (ms) consumed per minute of the audio.
+     */
+    public long getCpuMsPerAudioMinute() {
+        return audioMs > 0 ? 60000L * getCpuMs() / audioMs : 0;
+    }
+
+
+    @Override
+    public String toString() {
+        return "wakeups=" + wakeups + " (" + getWakeupsPerMinute() + "/min)"
+            + ", cpu=" + getCpuMs() + " ms (" + getCpuMsPerAudioMinute() + " ms/audio min)"
+            + ", audio=" + audioMs + " ms, wall=" + wallMs + " ms";
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Package
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Returns the CPU time of the current thread in ns or 0 if not supported.
+     */
+    static long threadCpuNanos() {
+        long ns = Debug.threadCpuTimeNanos();
+
+        return ns > 0 ? ns : 0;
+    }
+
+
+    /**
+     * Adds the values of one of the threads / PCM feeds.
+     */
+    void add( int wakeups, long cpuNanos, long audioMs ) {
+        this.wakeups += wakeups;
+        this.cpuNanos += cpuNanos;
+        this.audioMs += audioMs;
+    }
+
+
+    /**
+     * Sets the wall clock duration of the playback.
+     */
+    void setWallMs( long wallMs ) {
+        this.wallMs = wallMs;
+    }
+
+}
+
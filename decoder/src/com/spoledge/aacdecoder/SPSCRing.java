@@ -0,0 +1,276 @@
+/*
+** AACDecoder - Freeware Advanced Audio (AAC) Decoder for Android
+** Copyright (C) 2014 Spolecne s.r.o., http://www.spoledge.com
+**
+** This file is a part of AACDecoder.
+**
+** AACDecoder is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published
+** by the Free Software Foundation; either version 3 of the License,
+** or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+package com.spoledge.aacdecoder;
+
+import java.util.concurrent.locks.LockSupport;
+
+
+/**
+ * Lock-free single-producer / single-consumer ring.
+ * The ring manages only the slot indexes - the slots themselves (buffers)
+ * are kept by the user in an array of the same capacity, so nothing is allocated
+ * when passing data between the threads.
+ * <pre>
+ *  SPSCRing ring = new SPSCRing( 3 );
+ *  short[][] slots = new short[ ring.getCapacity() ][ 4096 ];
+ *
+ *  // producer thread:
+ *  int i = ring.tryPut();
+ *  if (i != -1) {
+ *      fill( slots[i] );
+ *      ring.put();
+ *  }
+ *
+ *  // consumer thread:
+ *  int j = ring.tryTake();
+ *  if (j != -1) {
+ *      process( slots[j] );
+ *      ring.take();
+ *  }
+ * </pre>
+ *
+ * The blocking variants of tryPut() / tryTake() and awaitSize() wait with a timeout;
+ * the waiting thread is woken up by the other side or by wakeUp().
+ */
+public final class SPSCRing {
+
+    private final int capacity;
+
+    /**
+     * The position of the next slot to be taken - written only by the consumer.
+     * The positions wrap at 2*capacity, so full and empty states differ.
+     */
+    private volatile int head;
+
+    /**
+     * The position of the next slot to be put - written only by the producer.
+     */
+    private volatile int tail;
+
+    private volatile Thread producerWaiting;
+    private volatile Thread consumerWaiting;
+
+    /**
+     * How many times the threads parked - each is written only by its side.
+     */
+    private volatile int producerWaits;
+    private volatile int consumerWaits;
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Creates a new ring.
+     * @param capacity the number of slots
+     */
+    public SPSCRing( int capacity ) {
+        if (capacity < 1) throw new IllegalArgumentException( "Invalid capacity: " + capacity );
+
+        this.capacity = capacity;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Public
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * Returns the number of slots.
+     */
+    public int getCapacity() {
+        return capacity;
+    }
+
+
+    /**
+     * Returns the number of slots put and not taken yet.
+     */
+    public int size() {
+        return size( tail, head );
+    }
+
+
+    /**
+     * Returns how many times the producer and the consumer parked in the blocking
+     * tryPut() / tryTake() / awaitSize() - every park ends by a wakeup of the thread.
+     */
+    public int getWaits() {
+        return producerWaits + consumerWaits;
+    }
+
+
+    /**
+     * Producer: returns the index of the free slot which can be filled.
+     * The slot is passed to the consumer by calling put().
+     * @return the slot index or -1 if the ring is full
+     */
+    public int tryPut() {
+        int t = tail;
+
+        return size( t, head ) < capacity ? t % capacity : -1;
+    }
+
+
+    /**
+     * Producer: waits for a free slot.
+     * @return the slot index or -1 on timeout / wakeUp()
+     */
+    public int tryPut( long timeoutMs ) {
+        int ret = tryPut();
+
+        if (ret != -1) return ret;
+
+        producerWaiting = Thread.currentThread();
+
+        try {
+            ret = tryPut();
+            if (ret == -1) {
+                producerWaits++;
+                LockSupport.parkNanos( timeoutMs * 1000000L );
+                ret = tryPut();
+            }
+        }
+        finally {
+            producerWaiting = null;
+        }
+
+        return ret;
+    }
+
+
+    /**
+     * Producer: passes the slot returned by tryPut() to the consumer.
+     */
+    public void put() {
+        tail = next( tail );
+
+        Thread t = consumerWaiting;
+        if (t != null) LockSupport.unpark( t );
+    }
+
+
+    /**
+     * Consumer: returns the index of the oldest slot put by the producer.
+     * The slot is returned back to the producer by calling take().
+     * @return the slot index or -1 if the ring is empty
+     */
+    public int tryTake() {
+        int h = head;
+
+        return h != tail ? h % capacity : -1;
+    }
+
+
+    /**
+     * Consumer: waits for a slot put by the producer.
+     * @return the slot index or -1 on timeout / wakeUp()
+     */
+    public int tryTake( long timeoutMs ) {
+        int ret = tryTake();
+
+        if (ret != -1) return ret;
+
+        consumerWaiting = Thread.currentThread();
+
+        try {
+            ret = tryTake();
+            if (ret == -1) {
+                consumerWaits++;
+                LockSupport.parkNanos( timeoutMs * 1000000L );
+                ret = tryTake();
+            }
+        }
+        finally {
+            consumerWaiting = null;
+        }
+
+        return ret;
+    }
+
+
+    /**
+     * Consumer: waits until at least n slots are put and not taken yet.
+     * The consumer is woken up by each put() - so it re-checks the size
+     * after each slot, not periodically.
+     * @param n the required size - at most the capacity
+     * @return true if the size was reached, false on timeout / wakeUp()
+     */
+    public boolean awaitSize( int n, long timeoutMs ) {
+        if (size() >= n) return true;
+
+        consumerWaiting = Thread.currentThread();
+
+        try {
+            // the producer may put the slot(s) before it sees the waiting consumer:
+            if (size() >= n) return true;
+
+            consumerWaits++;
+            LockSupport.parkNanos( timeoutMs * 1000000L );
+
+            return size() >= n;
+        }
+        finally {
+            consumerWaiting = null;
+        }
+    }
+
+
+    /**
+     * Consumer: releases the slot returned by tryTake() - it can be reused by the producer.
+     */
+    public void take() {
+        head = next( head );
+
+        Thread t = producerWaiting;
+        if (t != null) LockSupport.unpark( t );
+    }
+
+
+    /**
+     * Wakes up the waiting threads - e.g. when stopping.
+     */
+    public void wakeUp() {
+        Thread t = producerWaiting;
+        if (t != null) LockSupport.unpark( t );
+
+        t = consumerWaiting;
+        if (t != null) LockSupport.unpark( t );
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Private
+    ////////////////////////////////////////////////////////////////////////////
+
+    private int next( int pos ) {
+        return ++pos == 2*capacity ? 0 : pos;
+    }
+
+
+    private int size( int t, int h ) {
+        int n = t - h;
+
+        return n < 0 ? n + 2*capacity : n;
+    }
+
+}
+